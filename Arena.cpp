@@ -0,0 +1,74 @@
+// Arena.cpp
+//
+// Author: Marco Jacques
+//
+// Bump pointer allocator
+//
+
+#include "Arena.hpp"
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * Constructor: the first slab is allocated on the first allocation
+ */
+Arena::Arena(size_t slabSize_) :
+    slabSize(slabSize_),
+    currPtr(nullptr),
+    endPtr(nullptr),
+    slabs(),
+    bytesAllocated(0),
+    bytesReserved(0)
+{
+    // Nothing else to do
+}
+
+/**
+ * Destructor: free all the slabs
+ */
+Arena::~Arena()
+{
+    for( auto slab : slabs ) {
+        std::free(slab);
+    }
+}
+
+/**
+ * The current slab is full: start a new one.  Objects larger than a slab get
+ * their own slab, and the current one stays in use.
+ */
+void* Arena::allocateSlow(size_t size, size_t alignment)
+{
+    size_t neededSize = size + alignment - 1;
+    bool customSlab = neededSize > slabSize;
+    size_t newSlabSize = customSlab ? neededSize : slabSize;
+
+    char* slab = static_cast<char *>(std::malloc(newSlabSize));
+    if( slab == nullptr ) {
+        throw std::bad_alloc();
+    }
+
+    slabs.push_back(slab);
+    bytesReserved += newSlabSize;
+
+    uintptr_t aligned = (reinterpret_cast<uintptr_t>(slab) + alignment - 1) & ~(alignment - 1);
+    if( !customSlab ) {
+        currPtr = reinterpret_cast<char *>(aligned + size);
+        endPtr = slab + newSlabSize;
+    }
+
+    bytesAllocated += size;
+    return reinterpret_cast<void *>(aligned);
+}
+
+/**
+ * Copy a string in the arena, with its terminating null character
+ */
+const char* Arena::copyString(const char* str, size_t length)
+{
+    char* result = static_cast<char *>(allocate(length + 1, 1));
+    std::memcpy(result, str, length);
+    result[length] = '\0';
+
+    return result;
+}
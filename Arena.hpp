@@ -0,0 +1,96 @@
+// Arena.hpp
+//
+// Author: Marco Jacques
+//
+// Bump pointer allocator
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * Bump pointer allocator.  Memory is taken from large slabs and is only released
+ * all at once, when the arena is destroyed.  Destructors of the objects created
+ * in the arena are never run: they must not own any resource.
+ */
+class Arena {
+public:
+    /**
+     * Constructor
+     */
+    Arena(size_t slabSize_ = DEFAULT_SLAB_SIZE);
+
+    /**
+     * Destructor: free all the slabs
+     */
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * Allocate memory, with the given alignment (a power of 2)
+     */
+    void* allocate(size_t size, size_t alignment)
+    {
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(currPtr) + alignment - 1) & ~(alignment - 1);
+        if( aligned + size <= reinterpret_cast<uintptr_t>(endPtr) ) {
+            currPtr = reinterpret_cast<char *>(aligned + size);
+            bytesAllocated += size;
+            return reinterpret_cast<void *>(aligned);
+        }
+
+        return allocateSlow(size, alignment);
+    }
+
+    /**
+     * Create an object in the arena
+     */
+    template<typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * Copy an array in the arena
+     */
+    template<typename T>
+    T* copyArray(const T* elements, size_t nbElements)
+    {
+        T* result = static_cast<T *>(allocate(sizeof(T) * nbElements, alignof(T)));
+        for( size_t i = 0; i < nbElements; ++i ) {
+            new (result + i) T(elements[i]);
+        }
+
+        return result;
+    }
+
+    /**
+     * Copy a string in the arena, with its terminating null character
+     */
+    const char* copyString(const char* str, size_t length);
+
+    /**
+     * Statistics
+     */
+    size_t getBytesAllocated() const { return bytesAllocated; }
+    size_t getBytesReserved() const { return bytesReserved; }
+
+    static const size_t DEFAULT_SLAB_SIZE = 64 * 1024;
+
+private:
+    void* allocateSlow(size_t size, size_t alignment);
+
+    size_t slabSize;
+    char* currPtr;
+    char* endPtr;
+    std::vector<char *> slabs;
+    size_t bytesAllocated;
+    size_t bytesReserved;
+};
@@ -7,6 +7,22 @@
 
 #include "C90Expression.hpp"
 
+/**
+ * Constructor
+ */
+template<typename Builder>
+BasicC90Expression<Builder>::BasicC90Expression(
+    const std::shared_ptr<Lexer>& lexer_,
+    const std::shared_ptr<TypeParser>& typeParser_,
+    const std::shared_ptr<Builder>& builder_
+    ) :
+    lexer(lexer_),
+    typeParser(typeParser_),
+    builder(builder_)
+{
+    // Nothing else to do
+}
+
 /**
 
     primary-expression:
@@ -16,21 +32,25 @@
         ( expression )
 
  */
-IRExprPtr C90Expression::primaryExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::primaryExpression()
 {
     LexerTokenPtr nextToken = lexer->nextToken();
     switch(nextToken->getKind()) {
         case LexerToken::IDENTIFIER:
-            return IRFactory::createIdExpr(nextToken);
+            return builder->createIdExpr(nextToken);
 
         case LexerToken::INTEGER_LITERAL:
-            return IRFactory::createIntLitExpr(nextToken);
+            return builder->createIntLitExpr(nextToken);
+
+        case LexerToken::FLOAT_LITERAL:
+            return builder->createFloatLitExpr(nextToken);
 
         case LexerToken::STRING_LITERAL:
-            return IRFactory::createStringLitExpr(nextToken);
+            return builder->createStringLitExpr(nextToken);
 
         case LexerToken::LEFT_PARAR: {
-            IRExprPtr subExpr = expression();
+            ExprPtr subExpr = expression();
             lexer->acceptToken(LexerToken::RIGHT_PARAR);
             return subExpr;
         }
@@ -58,56 +78,64 @@ IRExprPtr C90Expression::primaryExpression()
 
 
 */
-IRExprPtr C90Expression::postfixExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::postfixExpression()
 {
-    IRExprPtr currExpr = primaryExpression();
+    return postfixOperators(primaryExpression());
+}
 
+/**
+ * Apply all the postfix operators following an expression
+ */
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::postfixOperators(ExprPtr currExpr)
+{
     for(;;) {
         switch(lexer->peekToken()->getKind()) {
             case LexerToken::LEFT_BRACKET: {
                 lexer->acceptToken(LexerToken::LEFT_BRACKET);
-                IRExprPtr indexExpr = expression();
+                ExprPtr indexExpr = expression();
                 lexer->acceptToken(LexerToken::RIGHT_BRACKET);
-                currExpr = IRFactory::createArraySubscripting(currExpr, indexExpr);
+                currExpr = builder->createArraySubscripting(currExpr, indexExpr);
                 break;
             }
 
             case LexerToken::LEFT_PARAR: {
                 lexer->acceptToken(LexerToken::LEFT_PARAR);
-                std::vector<IRExprPtr> args;
+                std::vector<ExprPtr> args;
                 
                 if( lexer->peekToken()->getKind() != LexerToken::RIGHT_PARAR ) {
                     args = argumentExpressionList();
                 }
 
                 lexer->acceptToken(LexerToken::RIGHT_PARAR);
-                currExpr = IRFactory::createCallExpr(currExpr, args);
+                currExpr = builder->createCallExpr(currExpr, args);
                 break;
             }
 
             case LexerToken::DOT: {
                 lexer->acceptToken(LexerToken::DOT);
                 LexerTokenPtr fieldId = lexer->acceptToken(LexerToken::IDENTIFIER);
-                currExpr = IRFactory::createStructFieldDirectAccess(currExpr, fieldId);
+                currExpr = builder->createStructFieldDirectAccess(currExpr, fieldId);
                 break;
             }
 
             case LexerToken::LEFT_ARROW: {
                 lexer->acceptToken(LexerToken::LEFT_ARROW);
                 LexerTokenPtr ptrFieldId = lexer->acceptToken(LexerToken::IDENTIFIER);
-                currExpr = IRFactory::createStructFieldIndirectAccess(currExpr, ptrFieldId);
+                currExpr = builder->createStructFieldIndirectAccess(currExpr, ptrFieldId);
                 break;
             }
 
             case LexerToken::INCR: {
                 lexer->acceptToken(LexerToken::INCR);
-                currExpr = IRFactory::createPostIncrExpr(currExpr);
+                currExpr = builder->createPostIncrExpr(currExpr);
                 break;
             }
 
             case LexerToken::DECR: {
                 lexer->acceptToken(LexerToken::DECR);
-                currExpr = IRFactory::createPostDecrExpr(currExpr);
+                currExpr = builder->createPostDecrExpr(currExpr);
                 break;
             }
 
@@ -127,12 +155,14 @@ IRExprPtr C90Expression::postfixExpression()
                   argument-expression-list ,  assignment-expression
 
  */
-std::vector<IRExprPtr> C90Expression::argumentExpressionList()
+template<typename Builder>
+std::vector<typename BasicC90Expression<Builder>::ExprPtr> BasicC90Expression<Builder>::argumentExpressionList()
 {
-    std::vector<IRExprPtr> args;
+    std::vector<ExprPtr> args;
 
     args.push_back(assignmentExpression());
     while( lexer->peekToken()->getKind() == LexerToken::COMMA ) {
+        lexer->acceptToken(LexerToken::COMMA);
         args.push_back(assignmentExpression());
     }
 
@@ -152,41 +182,41 @@ std::vector<IRExprPtr> C90Expression::argumentExpressionList()
                   &  *  +  -  ~  !
 
 */
-IRExprPtr C90Expression::unaryExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::unaryExpression()
 {
-    IRExprPtr unaryExpr;
     switch( lexer->peekToken()->getKind()) {
         case LexerToken::INCR:
             lexer->acceptToken(LexerToken::INCR);
-            return IRFactory::createPreIncrExpr(unaryExpression());
+            return builder->createPreIncrExpr(unaryExpression());
 
         case LexerToken::DECR:
             lexer->acceptToken(LexerToken::DECR);
-            return IRFactory::createPreDecrExpr(unaryExpression());
+            return builder->createPreDecrExpr(unaryExpression());
 
         case LexerToken::BIT_AND:
             lexer->acceptToken(LexerToken::BIT_AND);
-            return IRFactory::createAddressOfExpr(castExpression());
+            return builder->createAddressOfExpr(castExpression());
 
         case LexerToken::MUL:
             lexer->acceptToken(LexerToken::MUL);
-            return IRFactory::createDereferenceExpr(castExpression());
+            return builder->createDereferenceExpr(castExpression());
 
         case LexerToken::ADD:
             lexer->acceptToken(LexerToken::ADD);
-            return IRFactory::createUnaryPlusExpr(castExpression());
+            return builder->createUnaryPlusExpr(castExpression());
 
         case LexerToken::SUB:
             lexer->acceptToken(LexerToken::SUB);
-            return IRFactory::createUnaryMinusExpr(castExpression());
+            return builder->createUnaryMinusExpr(castExpression());
 
         case LexerToken::BIT_NOT:
             lexer->acceptToken(LexerToken::BIT_NOT);
-            return IRFactory::createBitNotExpr(castExpression());
+            return builder->createBitNotExpr(castExpression());
 
         case LexerToken::BOOL_NOT:
             lexer->acceptToken(LexerToken::BOOL_NOT);
-            return IRFactory::createBoolNotExpr(castExpression());
+            return builder->createBoolNotExpr(castExpression());
 
         case LexerToken::SIZEOF: {
             // Might need to replace by
@@ -200,20 +230,22 @@ IRExprPtr C90Expression::unaryExpression()
             if( lexer->peekToken()->getKind() == LexerToken::LEFT_PARAR ) {
                 lexer->acceptToken(LexerToken::LEFT_PARAR);
                 IRTypePtr typeName = typeParser->typeName();
-                IRExprPtr result;
+                ExprPtr result;
 
                 if( typeName ) {
-                    result = IRFactory::createSizeofTypeExpr(typeName);
+                    result = builder->createSizeofTypeExpr(typeName);
                 } 
                 else {
-                    result = IRFactory::createSizeofExpr(expression());
+                    ExprPtr subExpr = expression();
+                    lexer->acceptToken(LexerToken::RIGHT_PARAR);
+                    return builder->createSizeofExpr(postfixOperators(subExpr));
                 }
 
                 lexer->acceptToken(LexerToken::RIGHT_PARAR);
                 return result;
             }
             else {
-                return IRFactory::createSizeofExpr(unaryExpression());
+                return builder->createSizeofExpr(unaryExpression());
             }
         }
 
@@ -229,19 +261,20 @@ IRExprPtr C90Expression::unaryExpression()
                   ( type-name )  cast-expression
 
 */
-IRExprPtr C90Expression::castExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::castExpression()
 {
     if( lexer->peekToken()->getKind() == LexerToken::LEFT_PARAR ) {
         lexer->acceptToken(LexerToken::LEFT_PARAR);
         IRTypePtr typeName = typeParser->typeName();
         if( typeName ) {
             lexer->acceptToken(LexerToken::RIGHT_PARAR);
-            return IRFactory::createCastExpr(typeName, castExpression());
+            return builder->createCastExpr(typeName, castExpression());
         }
         else {
-            IRExprPtr result = expression();
+            ExprPtr result = expression();
             lexer->acceptToken(LexerToken::RIGHT_PARAR);
-            return result;
+            return postfixOperators(result);
         }
     }
     else {
@@ -251,72 +284,532 @@ IRExprPtr C90Expression::castExpression()
 
 /*
 
-        multiplicative-expression:
-                  cast-expression
-                  multiplicative-expression *  cast-expression
-                  multiplicative-expression /  cast-expression
-                  multiplicative-expression %  cast-expression
+        Binary operators, from the tightest to the loosest binding:
+
+          multiplicative-expression:   *  /  %
+          additive-expression:         +  -
+          shift-expression:            <<  >>
+          relational-expression:       <  >  <=  >=
+          equality-expression:         ==  !=
+          AND-expression:              &
+          exclusive-OR-expression:     ^
+          inclusive-OR-expression:     |
+          logical-AND-expression:      &&
+          logical-OR-expression:       ||
+          conditional-expression:      ?  :                  (right to left)
+          assignment-expression:       =  *=  /=  %=  +=  -=
+                                       <<=  >>=  &=  ^=  |=  (right to left)
+          expression:                  ,
+
+        Instead of one function per grammar level, each of them looping on its
+        own operators, the operators are kept in a table indexed by the token kind.
+        An operand goes through a single table lookup to know if the expression
+        continues, whatever the level the parsing started from.
 
 */
-IRExprPtr C90Expression::multiplicativeExpression()
+namespace {
+
+    /**
+     * Binary operator table of a builder, indexed by token kind
+     */
+    template<typename Builder>
+    class BinaryOperatorTable {
+    public:
+        BinaryOperatorTable() : operators()
+        {
+            set(LexerToken::MUL, &Builder::createMulExpr);
+            set(LexerToken::DIV, &Builder::createDivExpr);
+            set(LexerToken::MOD, &Builder::createModExpr);
+
+            set(LexerToken::ADD, &Builder::createAddExpr);
+            set(LexerToken::SUB, &Builder::createSubExpr);
+
+            set(LexerToken::SHIFT_LEFT, &Builder::createShiftLeftExpr);
+            set(LexerToken::SHIFT_RIGHT, &Builder::createShiftRightExpr);
+
+            set(LexerToken::LT, &Builder::createLessThanExpr);
+            set(LexerToken::GT, &Builder::createGreaterThanExpr);
+            set(LexerToken::LE, &Builder::createLessEqualExpr);
+            set(LexerToken::GE, &Builder::createGreaterEqualExpr);
+
+            set(LexerToken::EQUAL, &Builder::createEqualExpr);
+            set(LexerToken::NOT_EQUAL, &Builder::createNotEqualExpr);
+
+            set(LexerToken::BIT_AND, &Builder::createBitAndExpr);
+            set(LexerToken::BIT_XOR, &Builder::createBitXorExpr);
+            set(LexerToken::BIT_IOR, &Builder::createBitIorExpr);
+
+            set(LexerToken::BOOL_AND, &Builder::createBoolAndExpr);
+            set(LexerToken::BOOL_OR, &Builder::createBoolOrExpr);
+
+            // The conditional operator is ternary: it is handled directly by the parser
+            //
+            set(LexerToken::QUESTION_MARK, nullptr);
+
+            set(LexerToken::ASSIGN, &Builder::createAssignExpr);
+            set(LexerToken::MUL_ASSIGN, &Builder::createMulAssignExpr);
+            set(LexerToken::DIV_ASSIGN, &Builder::createDivAssignExpr);
+            set(LexerToken::MOD_ASSIGN, &Builder::createModAssignExpr);
+            set(LexerToken::ADD_ASSIGN, &Builder::createAddAssignExpr);
+            set(LexerToken::SUB_ASSIGN, &Builder::createSubAssignExpr);
+            set(LexerToken::SHIFT_LEFT_ASSIGN, &Builder::createShiftLeftAssignExpr);
+            set(LexerToken::SHIFT_RIGHT_ASSIGN, &Builder::createShiftRightAssignExpr);
+            set(LexerToken::BIT_AND_ASSIGN, &Builder::createBitAndAssignExpr);
+            set(LexerToken::BIT_XOR_ASSIGN, &Builder::createBitXorAssignExpr);
+            set(LexerToken::BIT_IOR_ASSIGN, &Builder::createBitIorAssignExpr);
+
+            set(LexerToken::COMMA, &Builder::createCommaExpr);
+        }
+
+        const typename BasicC90Expression<Builder>::BinaryOperator& operator[](LexerToken::Kind kind) const { return operators[kind]; }
+
+    private:
+        /**
+         * The precedence and the associativity come from C90ExpressionBase
+         */
+        void set(LexerToken::Kind kind, typename BasicC90Expression<Builder>::BinaryFactoryFunc factoryFunc)
+        {
+            C90ExpressionBase::Precedence precedence = C90ExpressionBase::getBinaryPrecedence(kind);
+            operators[kind] = typename BasicC90Expression<Builder>::BinaryOperator{
+                precedence, C90ExpressionBase::getAssociativity(precedence), factoryFunc
+            };
+        }
+
+        typename BasicC90Expression<Builder>::BinaryOperator operators[LexerToken::END_OF_FILE + 1];
+    };
+}
+
+namespace {
+
+    /**
+     * IR operator of the binary operators that can be chained, NB_KINDS for the others
+     */
+    IRExpr::Kind getChainKind(LexerToken::Kind kind)
+    {
+        switch( kind ) {
+            case LexerToken::MUL:       return IRExpr::MUL;
+            case LexerToken::ADD:       return IRExpr::ADD;
+            case LexerToken::BIT_AND:   return IRExpr::BIT_AND;
+            case LexerToken::BIT_XOR:   return IRExpr::BIT_XOR;
+            case LexerToken::BIT_IOR:   return IRExpr::BIT_IOR;
+            case LexerToken::BOOL_AND:  return IRExpr::BOOL_AND;
+            case LexerToken::BOOL_OR:   return IRExpr::BOOL_OR;
+            case LexerToken::COMMA:     return IRExpr::COMMA;
+            default:                    return IRExpr::NB_KINDS;
+        }
+    }
+}
+
+/**
+ * Return the binary operator information for a token
+ */
+template<typename Builder>
+const typename BasicC90Expression<Builder>::BinaryOperator& BasicC90Expression<Builder>::getBinaryOperator(LexerToken::Kind kind)
 {
-    IRExprPtr currExpr = castExpression();
+    static const BinaryOperatorTable<Builder> binaryOperators;
+    return binaryOperators[kind];
+}
+
+/**
+ * Precedence climbing: parse a cast-expression, followed by all the binary operators
+ * binding at least as tight as minPrecedence.  The right operand of an operator
+ * is parsed with the precedence just above it for left associative operators,
+ * or the same precedence for right associative ones.
+ */
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::binaryExpression(Precedence minPrecedence)
+{
+    ExprPtr currExpr = castExpression();
     for(;;) {
-        switch( lexer->peekToken()->getKind() ) {
-            case LexerToken::MUL:
-                lexer->acceptToken(LexerToken::MUL);
-                currExpr = IRFactory::createMulExpr(currExpr, castExpression());
-                break;
+        LexerToken::Kind kind = lexer->peekToken()->getKind();
+        const BinaryOperator& binaryOperator = getBinaryOperator(kind);
 
-            case LexerToken::DIV:
-                lexer->acceptToken(LexerToken::DIV);
-                currExpr = IRFactory::createDivExpr(currExpr, castExpression());
-                break;
+        // Tokens that are not operators have the lowest precedence, ending the loop
+        //
+        if( binaryOperator.precedence < minPrecedence || binaryOperator.precedence == NOT_BINARY_OPERATOR ) {
+            break;
+        }
 
-            case LexerToken::MOD:
-                lexer->acceptToken(LexerToken::MOD);
-                currExpr = IRFactory::createModExpr(currExpr, castExpression());
-                break;
+        lexer->acceptToken(kind);
 
-            default:
-                goto exitLoop;
+        //    logical-OR-expression ?  expression :  conditional-expression
+        //
+        if( kind == LexerToken::QUESTION_MARK ) {
+            ExprPtr thenExpr = expression();
+            lexer->acceptToken(LexerToken::COLON);
+            ExprPtr elseExpr = binaryExpression(PREC_CONDITIONAL);
+            currExpr = builder->createCondExpr(currExpr, thenExpr, elseExpr);
+            continue;
         }
+
+        // TODO: need to check if the left side of an assignment may be assigned... (unary-expression)
+        //
+        Precedence rightPrecedence = binaryOperator.associativity == LEFT_TO_RIGHT ?
+            static_cast<Precedence>(binaryOperator.precedence + 1) : binaryOperator.precedence;
+
+        ExprPtr rightExpr = binaryExpression(rightPrecedence);
+
+        // A chain of the same associative operator is given to the factory at once
+        //
+        IRExpr::Kind chainKind = getChainKind(kind);
+        if( chainKind != IRExpr::NB_KINDS && lexer->peekToken()->getKind() == kind ) {
+            std::vector<ExprPtr> operands{currExpr, rightExpr};
+            while( lexer->peekToken()->getKind() == kind ) {
+                lexer->acceptToken(kind);
+                operands.push_back(binaryExpression(rightPrecedence));
+            }
+
+            currExpr = builder->createAssociativeChain(chainKind, operands);
+            continue;
+        }
+
+        currExpr = (builder.get()->*binaryOperator.factoryFunc)(currExpr, rightExpr);
     }
 
-exitLoop:
     return currExpr;
 }
 
-/*
+/**
+ * Parse an expression made of operators binding at least as tight as minPrecedence,
+ * with the current parse mode
+ */
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::parseExpression(Precedence minPrecedence)
+{
+    if( parseMode == EXPLICIT_STACK ) {
+        return explicitStackExpression(minPrecedence);
+    }
 
-          additive-expression:
-                  multiplicative-expression
-                  additive-expression +  multiplicative-expression
-                  additive-expression -  multiplicative-expression
+    return binaryExpression(minPrecedence);
+}
 
-*/
-IRExprPtr C90Expression::additiveExpression()
+/**
+ * Build the IR for a prefix operator (or cast) once its operand is complete
+ */
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::createPrefixExpr(LexerToken::Kind token, IRTypePtr type, ExprPtr operand)
 {
-    IRExprPtr currExpr = multiplicativeExpression();
+    switch( token ) {
+        case LexerToken::INCR:      return builder->createPreIncrExpr(operand);
+        case LexerToken::DECR:      return builder->createPreDecrExpr(operand);
+        case LexerToken::BIT_AND:   return builder->createAddressOfExpr(operand);
+        case LexerToken::MUL:       return builder->createDereferenceExpr(operand);
+        case LexerToken::ADD:       return builder->createUnaryPlusExpr(operand);
+        case LexerToken::SUB:       return builder->createUnaryMinusExpr(operand);
+        case LexerToken::BIT_NOT:   return builder->createBitNotExpr(operand);
+        case LexerToken::BOOL_NOT:  return builder->createBoolNotExpr(operand);
+        case LexerToken::SIZEOF:    return builder->createSizeofExpr(operand);
+        default:                    return builder->createCastExpr(type, operand);
+    }
+}
+
+/**
+ * Pop the operand on top of the operand stack
+ */
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::popOperand()
+{
+    ExprPtr operand = operandStack.back();
+    operandStack.pop_back();
+    return operand;
+}
+
+/**
+ * Same grammar as the recursive descent (cast, unary, postfix and primary expressions,
+ * then the precedence climbing of binaryExpression), without recursion.
+ *
+ * Every construct that would recurse pushes a pending operation instead: prefix
+ * operators and casts wait for their operand to be complete, binary operators for
+ * their right operand, and parenthesis/brackets for their closing token.  The
+ * operation on top of the stack gives the lowest precedence that may continue the
+ * current operand; any other token completes the operation on top.
+ *
+ * The stacks are members, reused between expressions.  Only the part above the
+ * entries present on entry is used, in case the type parser calls back in.
+ */
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::explicitStackExpression(Precedence minPrecedence)
+{
+    operationStack.push_back(PendingOperation(PendingOperation::ENTRY, minPrecedence));
+
     for(;;) {
-        switch( lexer->peekToken()->getKind() ) {
-            case LexerToken::ADD:
-                lexer->acceptToken(LexerToken::ADD);
-                currExpr = IRFactory::createAddExpr(currExpr, multiplicativeExpression());
-                break;
 
-            case LexerToken::SUB:
-                lexer->acceptToken(LexerToken::SUB);
-                currExpr = IRFactory::createSubExpr(currExpr, multiplicativeExpression());
-                break;
+        // Operand: prefix operators and casts, then a primary expression
+        //
+        bool castAllowed = true;
+        bool postfixAllowed = true;
+        bool operandDone = false;
+
+        while( !operandDone ) {
+            LexerToken::Kind kind = lexer->peekToken()->getKind();
+            switch( kind ) {
+                // ++ and -- apply to an unary-expression: no cast may follow
+                //
+                case LexerToken::INCR:
+                case LexerToken::DECR:
+                    lexer->acceptToken(kind);
+                    operationStack.push_back(PendingOperation(PendingOperation::PREFIX, NOT_BINARY_OPERATOR, kind));
+                    castAllowed = false;
+                    break;
+
+                case LexerToken::BIT_AND:
+                case LexerToken::MUL:
+                case LexerToken::ADD:
+                case LexerToken::SUB:
+                case LexerToken::BIT_NOT:
+                case LexerToken::BOOL_NOT:
+                    lexer->acceptToken(kind);
+                    operationStack.push_back(PendingOperation(PendingOperation::PREFIX, NOT_BINARY_OPERATOR, kind));
+                    castAllowed = true;
+                    break;
+
+                case LexerToken::SIZEOF:
+                    lexer->acceptToken(LexerToken::SIZEOF);
+                    if( lexer->peekToken()->getKind() == LexerToken::LEFT_PARAR ) {
+                        lexer->acceptToken(LexerToken::LEFT_PARAR);
+                        IRTypePtr typeName = typeParser->typeName();
+                        if( typeName ) {
+                            lexer->acceptToken(LexerToken::RIGHT_PARAR);
+                            operandStack.push_back(builder->createSizeofTypeExpr(typeName));
+                            postfixAllowed = false;
+                            operandDone = true;
+                        }
+                        else {
+                            operationStack.push_back(PendingOperation(PendingOperation::PREFIX, NOT_BINARY_OPERATOR, kind));
+                            operationStack.push_back(PendingOperation(PendingOperation::GROUP, PREC_COMMA));
+                            castAllowed = true;
+                        }
+                    }
+                    else {
+                        operationStack.push_back(PendingOperation(PendingOperation::PREFIX, NOT_BINARY_OPERATOR, kind));
+                        castAllowed = false;
+                    }
+                    break;
+
+                case LexerToken::LEFT_PARAR: {
+                    lexer->acceptToken(LexerToken::LEFT_PARAR);
+                    IRTypePtr typeName = castAllowed ? typeParser->typeName() : nullptr;
+                    if( typeName ) {
+                        lexer->acceptToken(LexerToken::RIGHT_PARAR);
+                        PendingOperation cast(PendingOperation::CAST, NOT_BINARY_OPERATOR);
+                        cast.type = typeName;
+                        operationStack.push_back(cast);
+                    }
+                    else {
+                        operationStack.push_back(PendingOperation(PendingOperation::GROUP, PREC_COMMA));
+                    }
+                    castAllowed = true;
+                    break;
+                }
 
-            default:
-                goto exitLoop;
+                default:
+                    operandStack.push_back(primaryExpression());
+                    operandDone = true;
+                    break;
+            }
+        }
+
+        // Operators following the operand, until one needs another operand
+        //
+        for(;;) {
+            LexerToken::Kind kind = lexer->peekToken()->getKind();
+
+            if( postfixAllowed ) {
+                switch( kind ) {
+                    case LexerToken::LEFT_BRACKET:
+                        lexer->acceptToken(LexerToken::LEFT_BRACKET);
+                        operationStack.push_back(PendingOperation(PendingOperation::SUBSCRIPT, PREC_COMMA));
+                        goto nextOperand;
+
+                    case LexerToken::LEFT_PARAR: {
+                        lexer->acceptToken(LexerToken::LEFT_PARAR);
+                        if( lexer->peekToken()->getKind() == LexerToken::RIGHT_PARAR ) {
+                            lexer->acceptToken(LexerToken::RIGHT_PARAR);
+                            operandStack.back() = builder->createCallExpr(operandStack.back(), std::vector<ExprPtr>());
+                            continue;
+                        }
+
+                        PendingOperation call(PendingOperation::CALL, PREC_ASSIGNMENT);
+                        call.firstOperand = operandStack.size() - 1;
+                        operationStack.push_back(call);
+                        goto nextOperand;
+                    }
+
+                    case LexerToken::DOT: {
+                        lexer->acceptToken(LexerToken::DOT);
+                        LexerTokenPtr fieldId = lexer->acceptToken(LexerToken::IDENTIFIER);
+                        operandStack.back() = builder->createStructFieldDirectAccess(operandStack.back(), fieldId);
+                        continue;
+                    }
+
+                    case LexerToken::LEFT_ARROW: {
+                        lexer->acceptToken(LexerToken::LEFT_ARROW);
+                        LexerTokenPtr ptrFieldId = lexer->acceptToken(LexerToken::IDENTIFIER);
+                        operandStack.back() = builder->createStructFieldIndirectAccess(operandStack.back(), ptrFieldId);
+                        continue;
+                    }
+
+                    case LexerToken::INCR:
+                        lexer->acceptToken(LexerToken::INCR);
+                        operandStack.back() = builder->createPostIncrExpr(operandStack.back());
+                        continue;
+
+                    case LexerToken::DECR:
+                        lexer->acceptToken(LexerToken::DECR);
+                        operandStack.back() = builder->createPostDecrExpr(operandStack.back());
+                        continue;
+
+                    default:
+                        break;
+                }
+
+                postfixAllowed = false;
+            }
+
+            // The operand is complete: the prefix operators and casts apply to it
+            //
+            while( operationStack.back().kind == PendingOperation::PREFIX ||
+                    operationStack.back().kind == PendingOperation::CAST ) {
+                const PendingOperation& prefix = operationStack.back();
+                operandStack.back() = createPrefixExpr(prefix.token, prefix.type, operandStack.back());
+                operationStack.pop_back();
+            }
+
+            // A binary operator binding tight enough continues the operation on top
+            //
+            const BinaryOperator& binaryOperator = getBinaryOperator(kind);
+            PendingOperation& top = operationStack.back();
+
+            if( binaryOperator.precedence != NOT_BINARY_OPERATOR && binaryOperator.precedence >= top.rightPrecedence ) {
+                lexer->acceptToken(kind);
+                if( kind == LexerToken::QUESTION_MARK ) {
+                    operationStack.push_back(PendingOperation(PendingOperation::CONDITIONAL_THEN, PREC_COMMA));
+                }
+                else {
+                    Precedence rightPrecedence = binaryOperator.associativity == LEFT_TO_RIGHT ?
+                        static_cast<Precedence>(binaryOperator.precedence + 1) : binaryOperator.precedence;
+                    PendingOperation binary(PendingOperation::BINARY, rightPrecedence, kind);
+                    binary.firstOperand = operandStack.size() - 1;
+                    operationStack.push_back(binary);
+                }
+                goto nextOperand;
+            }
+
+            // Otherwise, the operation on top is complete
+            //
+            switch( top.kind ) {
+                case PendingOperation::BINARY: {
+                    // The same associative operator extends the chain
+                    //
+                    IRExpr::Kind chainKind = getChainKind(top.token);
+                    if( chainKind != IRExpr::NB_KINDS && kind == top.token ) {
+                        lexer->acceptToken(kind);
+                        goto nextOperand;
+                    }
+
+                    if( operandStack.size() - top.firstOperand > 2 ) {
+                        std::vector<ExprPtr> operands(operandStack.begin() + top.firstOperand, operandStack.end());
+                        operandStack.resize(top.firstOperand);
+                        operandStack.push_back(builder->createAssociativeChain(chainKind, operands));
+                    }
+                    else {
+                        ExprPtr rightExpr = popOperand();
+                        ExprPtr leftExpr = popOperand();
+                        operandStack.push_back((builder.get()->*getBinaryOperator(top.token).factoryFunc)(leftExpr, rightExpr));
+                    }
+                    operationStack.pop_back();
+                    break;
+                }
+
+                case PendingOperation::CONDITIONAL_THEN:
+                    lexer->acceptToken(LexerToken::COLON);
+                    top.kind = PendingOperation::CONDITIONAL_ELSE;
+                    top.rightPrecedence = PREC_CONDITIONAL;
+                    goto nextOperand;
+
+                case PendingOperation::CONDITIONAL_ELSE: {
+                    ExprPtr elseExpr = popOperand();
+                    ExprPtr thenExpr = popOperand();
+                    ExprPtr condExpr = popOperand();
+                    operandStack.push_back(builder->createCondExpr(condExpr, thenExpr, elseExpr));
+                    operationStack.pop_back();
+                    break;
+                }
+
+                case PendingOperation::GROUP:
+                    lexer->acceptToken(LexerToken::RIGHT_PARAR);
+                    operationStack.pop_back();
+                    postfixAllowed = true;
+                    break;
+
+                case PendingOperation::SUBSCRIPT: {
+                    lexer->acceptToken(LexerToken::RIGHT_BRACKET);
+                    ExprPtr indexExpr = popOperand();
+                    operandStack.back() = builder->createArraySubscripting(operandStack.back(), indexExpr);
+                    operationStack.pop_back();
+                    postfixAllowed = true;
+                    break;
+                }
+
+                case PendingOperation::CALL: {
+                    if( kind == LexerToken::COMMA ) {
+                        lexer->acceptToken(LexerToken::COMMA);
+                        goto nextOperand;
+                    }
+
+                    lexer->acceptToken(LexerToken::RIGHT_PARAR);
+                    std::vector<ExprPtr> args(operandStack.begin() + top.firstOperand + 1, operandStack.end());
+                    operandStack.resize(top.firstOperand + 1);
+                    operandStack.back() = builder->createCallExpr(operandStack.back(), args);
+                    operationStack.pop_back();
+                    postfixAllowed = true;
+                    break;
+                }
+
+                case PendingOperation::ENTRY:
+                    operationStack.pop_back();
+                    return popOperand();
+
+                case PendingOperation::PREFIX:
+                case PendingOperation::CAST:
+                    // applied above, as soon as their operand is complete
+                    //
+                    break;
+            }
         }
+
+    nextOperand:
+        continue;
     }
+}
 
-exitLoop:
-    return currExpr;
+/*
+
+        multiplicative-expression:
+                  cast-expression
+                  multiplicative-expression *  cast-expression
+                  multiplicative-expression /  cast-expression
+                  multiplicative-expression %  cast-expression
+
+*/
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::multiplicativeExpression()
+{
+    return parseExpression(PREC_MULTIPLICATIVE);
+}
+
+/*
+
+          additive-expression:
+                  multiplicative-expression
+                  additive-expression +  multiplicative-expression
+                  additive-expression -  multiplicative-expression
+
+*/
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::additiveExpression()
+{
+    return parseExpression(PREC_ADDITIVE);
 }
 
 /*
@@ -327,28 +820,10 @@ exitLoop:
                   shift-expression >>  additive-expression
 
 */
-IRExprPtr C90Expression::shiftExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::shiftExpression()
 {
-    IRExprPtr currExpr = additiveExpression();
-    for(;;) {
-        switch( lexer->peekToken()->getKind()) {
-            case LexerToken::SHIFT_LEFT:
-                lexer->acceptToken(LexerToken::SHIFT_LEFT);
-                currExpr = IRFactory::createShiftLeftExpr(currExpr, additiveExpression());
-                break;
-
-            case LexerToken::SHIFT_RIGHT:
-                lexer->acceptToken(LexerToken::SHIFT_RIGHT);
-                currExpr = IRFactory::createShiftRightExpr(currExpr, additiveExpression());
-                break;
-
-            default:
-                goto exitLoop;
-        }
-    }
-
-exitLoop:
-    return currExpr;
+    return parseExpression(PREC_SHIFT);
 }
 
 /*
@@ -361,38 +836,10 @@ exitLoop:
                   relational-expression >=  shift-expression
 
 */
-IRExprPtr C90Expression::relationalExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::relationalExpression()
 {
-    IRExprPtr currExpr = shiftExpression();
-    for(;;) {
-        switch( lexer->peekToken()->getKind() ) {
-            case LexerToken::LT:
-                lexer->acceptToken(LexerToken::LT);
-                currExpr = IRFactory::createLessThanExpr(currExpr, shiftExpression());
-                break;
-
-            case LexerToken::GT:
-                lexer->acceptToken(LexerToken::GT);
-                currExpr = IRFactory::createGreaterThanExpr(currExpr, shiftExpression());
-                break;
-
-            case LexerToken::LE:
-                lexer->acceptToken(LexerToken::LE);
-                currExpr = IRFactory::createLessEqualExpr(currExpr, shiftExpression());
-                break;
-
-            case LexerToken::GE:
-                lexer->acceptToken(LexerToken::GE);
-                currExpr = IRFactory::createGreaterEqualExpr(currExpr, shiftExpression());
-                break;
-
-            default:
-                goto exitLoop;
-        }
-    }
-
-exitLoop:
-    return currExpr;
+    return parseExpression(PREC_RELATIONAL);
 }
 
 /*
@@ -403,28 +850,10 @@ exitLoop:
                   equality-expression !=  relational-expression
 
 */
-IRExprPtr C90Expression::equalityExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::equalityExpression()
 {
-    IRExprPtr currExpr = relationalExpression();
-    for(;;) {
-        switch( lexer->peekToken()->getKind()) {
-            case LexerToken::EQUAL:
-                lexer->acceptToken(LexerToken::EQUAL);
-                currExpr = IRFactory::createEqualExpr(currExpr, relationalExpression());
-                break;
-
-            case LexerToken::NOT_EQUAL:
-                lexer->acceptToken(LexerToken::NOT_EQUAL);
-                currExpr = IRFactory::createNotEqualExpr(currExpr, relationalExpression());
-                break;
-                
-            default:
-                goto exitLoop;
-        }
-    }
-
-exitLoop:
-    return currExpr;
+    return parseExpression(PREC_EQUALITY);
 }
 
 /*
@@ -434,21 +863,10 @@ exitLoop:
                   AND-expression &  equality-expression
 
 */
-
-IRExprPtr C90Expression::bitAndExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::bitAndExpression()
 {
-    IRExprPtr currExpr = equalityExpression();
-    for(;;) {
-        if( lexer->peekToken()->getKind() == LexerToken::BIT_AND ) {
-            lexer->acceptToken(LexerToken::BIT_AND );
-            currExpr = IRFactory::createBitAndExpr(currExpr, equalityExpression());
-        }
-        else {
-            break;
-        }
-    }
-
-    return currExpr;
+    return parseExpression(PREC_BIT_AND);
 }
 
 /*
@@ -458,21 +876,10 @@ IRExprPtr C90Expression::bitAndExpression()
                   exclusive-OR-expression ^  AND-expression
 
 */
-IRExprPtr C90Expression::bitXorExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::bitXorExpression()
 {
-    IRExprPtr currExpr = bitAndExpression();
-    for(;;) {
-        if( lexer->peekToken()->getKind() == LexerToken::BIT_XOR ) {
-            lexer->acceptToken(LexerToken::BIT_XOR );
-            currExpr = IRFactory::createBitXorExpr(currExpr, bitAndExpression());
-        }
-        else {
-            break;
-        }
-    }
-
-    return currExpr;
-
+    return parseExpression(PREC_BIT_XOR);
 }
 
 /*
@@ -482,21 +889,10 @@ IRExprPtr C90Expression::bitXorExpression()
                   inclusive-OR-expression |  exclusive-OR-expression
 
 */
-IRExprPtr C90Expression::bitIorExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::bitIorExpression()
 {
-    IRExprPtr currExpr = bitXorExpression();
-    for(;;) {
-        if( lexer->peekToken()->getKind() == LexerToken::BIT_IOR ) {
-            lexer->acceptToken(LexerToken::BIT_IOR );
-            currExpr = IRFactory::createBitIorExpr(currExpr, bitXorExpression());
-        }
-        else {
-            break;
-        }
-    }
-
-    return currExpr;
-
+    return parseExpression(PREC_BIT_IOR);
 }
 
 /*
@@ -506,21 +902,10 @@ IRExprPtr C90Expression::bitIorExpression()
                   logical-AND-expression &&  inclusive-OR-expression
 
 */
-IRExprPtr C90Expression::logicalAndExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::logicalAndExpression()
 {
-    IRExprPtr currExpr = bitIorExpression();
-    for(;;) {
-        if( lexer->peekToken()->getKind() == LexerToken::BOOL_AND ) {
-            lexer->acceptToken(LexerToken::BOOL_AND );
-            currExpr = IRFactory::createBoolAndExpr(currExpr, bitIorExpression());
-        }
-        else {
-            break;
-        }
-    }
-
-    return currExpr;
-
+    return parseExpression(PREC_LOGICAL_AND);
 }
 
 /*
@@ -530,20 +915,10 @@ IRExprPtr C90Expression::logicalAndExpression()
                   logical-OR-expression ||  logical-AND-expression
 
 */
-IRExprPtr C90Expression::logicalOrExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::logicalOrExpression()
 {
-    IRExprPtr currExpr = logicalAndExpression();
-    for(;;) {
-        if( lexer->peekToken()->getKind() == LexerToken::BOOL_OR ) {
-            lexer->acceptToken(LexerToken::BOOL_OR );
-            currExpr = IRFactory::createBoolOrExpr(currExpr, logicalAndExpression());
-        }
-        else {
-            break;
-        }
-    }
-
-    return currExpr;
+    return parseExpression(PREC_LOGICAL_OR);
 }
 
 /*
@@ -553,19 +928,10 @@ IRExprPtr C90Expression::logicalOrExpression()
                   logical-OR-expression ?  expression :  conditional-expression
 
 */
-IRExprPtr C90Expression::conditionalExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::conditionalExpression()
 {
-    IRExprPtr currExpr = logicalOrExpression();
-
-    if( lexer->peekToken()->getKind() == LexerToken::QUESTION_MARK ) {
-        lexer->acceptToken(LexerToken::QUESTION_MARK);
-        IRExprPtr thenExpr = expression();
-        lexer->acceptToken(LexerToken::COLON);
-        IRExprPtr elseExpr = conditionalExpression();
-        currExpr = IRFactory::createCondExpr(currExpr, thenExpr, elseExpr);
-    }
-
-    return currExpr;
+    return parseExpression(PREC_CONDITIONAL);
 }
 
 /*
@@ -578,74 +944,10 @@ IRExprPtr C90Expression::conditionalExpression()
                   =  *=  /=  %=  +=  -=  <<=  >>=  &=  ^=  |=
 
 */
-IRExprPtr C90Expression::assignmentExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::assignmentExpression()
 {
-    IRExprPtr currExpr = conditionalExpression();
-
-    // TODO: need to check if currExpr may be assigned... (unary-expression)
-    //
-    IRExprPtr (*factoryExprFunc)(const IRExprPtr&, const IRExprPtr&);
-    switch( lexer->peekToken()->getKind() ) {
-        case LexerToken::ASSIGN:
-            lexer->acceptToken(LexerToken::ASSIGN);
-            factoryExprFunc = IRFactory::createAssignExpr;
-            break;
-
-        case LexerToken::MUL_ASSIGN:
-            lexer->acceptToken(LexerToken::MUL_ASSIGN);
-            factoryExprFunc = IRFactory::createMulAssignExpr;
-            break;
-
-        case LexerToken::DIV_ASSIGN:
-            lexer->acceptToken(LexerToken::DIV_ASSIGN);
-            factoryExprFunc = IRFactory::createDivAssignExpr;
-            break;
-
-        case LexerToken::MOD_ASSIGN:
-            lexer->acceptToken(LexerToken::MOD_ASSIGN);
-            factoryExprFunc = IRFactory::createModAssignExpr;
-            break;
-
-        case LexerToken::ADD_ASSIGN:
-            lexer->acceptToken(LexerToken::ADD_ASSIGN);
-            factoryExprFunc = IRFactory::createAddAssignExpr;
-            break;
-
-        case LexerToken::SUB_ASSIGN:
-            lexer->acceptToken(LexerToken::SUB_ASSIGN);
-            factoryExprFunc = IRFactory::createSubAssignExpr;
-            break;
-
-        case LexerToken::SHIFT_LEFT_ASSIGN:
-            lexer->acceptToken(LexerToken::SHIFT_LEFT_ASSIGN);
-            factoryExprFunc = IRFactory::createShiftLeftAssignExpr;
-            break;
-
-        case LexerToken::SHIFT_RIGHT_ASSIGN:
-            lexer->acceptToken(LexerToken::SHIFT_RIGHT_ASSIGN);
-            factoryExprFunc = IRFactory::createShiftRightAssignExpr;
-            break;
-
-        case LexerToken::BIT_AND_ASSIGN:
-            lexer->acceptToken(LexerToken::BIT_AND_ASSIGN);
-            factoryExprFunc = IRFactory::createBitAndAssignExpr;
-            break;
-
-        case LexerToken::BIT_XOR_ASSIGN:
-            lexer->acceptToken(LexerToken::BIT_XOR_ASSIGN);
-            factoryExprFunc = IRFactory::createBitXorAssignExpr;
-            break;
-
-        case LexerToken::BIT_IOR_ASSIGN:
-            lexer->acceptToken(LexerToken::BIT_IOR_ASSIGN);
-            factoryExprFunc = IRFactory::createBitIorAssignExpr;
-            break;
-
-        default:
-            return currExpr;   
-    }
-
-    return factoryExprFunc(currExpr, assignmentExpression());
+    return parseExpression(PREC_ASSIGNMENT);
 }
 
 /*
@@ -655,20 +957,10 @@ IRExprPtr C90Expression::assignmentExpression()
                   expression ,  assignment-expression
 
 */
-IRExprPtr C90Expression::expression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::expression()
 {
-    IRExprPtr currExpr = assignmentExpression();
-    for(;;) {
-        if( lexer->peekToken()->getKind() == LexerToken::COMMA ) {
-            lexer->acceptToken(LexerToken::BOOL_OR );
-            currExpr = IRFactory::createCommaExpr(currExpr, assignmentExpression());
-        }
-        else {
-            break;
-        }
-    }
-
-    return currExpr;
+    return parseExpression(PREC_COMMA);
 }
 
 /*
@@ -677,10 +969,13 @@ IRExprPtr C90Expression::expression()
                   conditional-expression
 
 */
-IRExprPtr C90Expression::constantExpression()
+template<typename Builder>
+typename BasicC90Expression<Builder>::ExprPtr BasicC90Expression<Builder>::constantExpression()
 {
     return conditionalExpression();
 }
 
-
-
+// The parsers used: building the IR, and checking the syntax only
+//
+template class BasicC90Expression<IRFactory>;
+template class BasicC90Expression<NullIRBuilder>;
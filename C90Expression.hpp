@@ -2,41 +2,125 @@
 //
 // Author: Marco Jacques
 //
-// Expression parsing for C90 
+// Expression parsing for C90
 //
 
 #pragma once
 
 #include <memory>
+#include "C90ExpressionBase.hpp"
 #include "IR.hpp"
+#include "NullIRBuilder.hpp"
 #include "Lexer.hpp"
 #include "TypeParser.hpp"
 
-class C90Expression {
+/**
+ * Expression parser, building the expressions with a builder: IRFactory for the
+ * IR, NullIRBuilder to only check the syntax.  The builder has the interface of
+ * IRFactory, with its own ExprPtr.
+ *
+ * The parser is only instantiated for these builders, in C90Expression.cpp.
+ */
+template<typename Builder>
+class BasicC90Expression : public C90ExpressionBase {
+public:
+    using ExprPtr = typename Builder::ExprPtr;
+    using BinaryFactoryFunc = ExprPtr (Builder::*)(ExprPtr, ExprPtr);
+
+    /**
+     * Entry of the binary operator table, indexed by the operator token kind
+     */
+    struct BinaryOperator {
+        Precedence precedence;
+        Associativity associativity;
+        BinaryFactoryFunc factoryFunc;
+    };
+
+    /**
+     * Return the binary operator information for a token.  Tokens that are not
+     * binary operators have a precedence of NOT_BINARY_OPERATOR.
+     */
+    static const BinaryOperator& getBinaryOperator(LexerToken::Kind kind);
+
+    /**
+     * Constructor
+     */
+    BasicC90Expression(
+        const std::shared_ptr<Lexer>& lexer_,
+        const std::shared_ptr<TypeParser>& typeParser_,
+        const std::shared_ptr<Builder>& builder_
+        );
+
+    void setParseMode(ParseMode parseMode_) { parseMode = parseMode_; }
+    ParseMode getParseMode() const { return parseMode; }
+
 protected:
     std::shared_ptr<Lexer> lexer;
     std::shared_ptr<TypeParser> typeParser;
-    
-public: 
-    std::shared_ptr<IRExpr> primaryExpression();
-    std::shared_ptr<IRExpr> postfixExpression();
-    std::vector<IRExprPtr> argumentExpressionList();
-    std::shared_ptr<IRExpr> unaryExpression();
-    std::shared_ptr<IRExpr> unaryOperator();
-    std::shared_ptr<IRExpr> castExpression();
-    std::shared_ptr<IRExpr> multiplicativeExpression();
-    std::shared_ptr<IRExpr> additiveExpression();
-    std::shared_ptr<IRExpr> shiftExpression();
-    std::shared_ptr<IRExpr> relationalExpression();
-    std::shared_ptr<IRExpr> equalityExpression();
-    std::shared_ptr<IRExpr> bitAndExpression();
-    std::shared_ptr<IRExpr> bitXorExpression();
-    std::shared_ptr<IRExpr> bitIorExpression();
-    std::shared_ptr<IRExpr> logicalAndExpression();
-    std::shared_ptr<IRExpr> logicalOrExpression();
-    std::shared_ptr<IRExpr> conditionalExpression();
-    std::shared_ptr<IRExpr> assignmentExpression();
-    std::shared_ptr<IRExpr> expression();
-    std::shared_ptr<IRExpr> constantExpression();
-
-};
\ No newline at end of file
+    std::shared_ptr<Builder> builder;
+    ParseMode parseMode = RECURSIVE_DESCENT;
+
+    /**
+     * Operation waiting for its operands while parsing with the explicit stack
+     */
+    struct PendingOperation {
+        enum Kind {
+            ENTRY,              // start of the expression being parsed
+            PREFIX,             // unary operator, sizeof
+            CAST,               // ( type-name )
+            BINARY,             // binary operator, waiting for its right operand
+            CONDITIONAL_THEN,   // ?  expression
+            CONDITIONAL_ELSE,   // :  conditional-expression
+            GROUP,              // ( expression )
+            SUBSCRIPT,          // [ expression ]
+            CALL                // ( argument-expression-list )
+        };
+
+        Kind kind;
+        LexerToken::Kind token;         // PREFIX and BINARY operator
+        Precedence rightPrecedence;     // lowest precedence continuing the operand on the right
+        IRTypePtr type;                 // CAST type
+        size_t firstOperand;            // CALL: index of the function in the operand stack, BINARY: of the left operand
+
+        PendingOperation(Kind kind_, Precedence rightPrecedence_, LexerToken::Kind token_ = LexerToken::UNKNOWN) :
+            kind(kind_), token(token_), rightPrecedence(rightPrecedence_), type(nullptr), firstOperand(0)
+        {
+        }
+    };
+
+    std::vector<ExprPtr> operandStack;
+    std::vector<PendingOperation> operationStack;
+
+    ExprPtr parseExpression(Precedence minPrecedence);
+    ExprPtr binaryExpression(Precedence minPrecedence);
+    ExprPtr explicitStackExpression(Precedence minPrecedence);
+    ExprPtr postfixOperators(ExprPtr currExpr);
+    ExprPtr popOperand();
+    ExprPtr createPrefixExpr(LexerToken::Kind token, IRTypePtr type, ExprPtr operand);
+
+public:
+    ExprPtr primaryExpression();
+    ExprPtr postfixExpression();
+    std::vector<ExprPtr> argumentExpressionList();
+    ExprPtr unaryExpression();
+    ExprPtr unaryOperator();
+    ExprPtr castExpression();
+    ExprPtr multiplicativeExpression();
+    ExprPtr additiveExpression();
+    ExprPtr shiftExpression();
+    ExprPtr relationalExpression();
+    ExprPtr equalityExpression();
+    ExprPtr bitAndExpression();
+    ExprPtr bitXorExpression();
+    ExprPtr bitIorExpression();
+    ExprPtr logicalAndExpression();
+    ExprPtr logicalOrExpression();
+    ExprPtr conditionalExpression();
+    ExprPtr assignmentExpression();
+    ExprPtr expression();
+    ExprPtr constantExpression();
+
+};
+
+using C90Expression = BasicC90Expression<IRFactory>;
+using C90SyntaxChecker = BasicC90Expression<NullIRBuilder>;
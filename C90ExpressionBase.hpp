@@ -0,0 +1,118 @@
+// C90ExpressionBase.hpp
+//
+// Author: Marco Jacques
+//
+// Operator precedences of C90 expressions, shared by the expression parser and
+// the preprocessor
+//
+
+#pragma once
+
+#include "LexerToken.hpp"
+
+/**
+ * Definitions of the expression parser that don't depend on what it builds
+ */
+class C90ExpressionBase {
+public:
+    /**
+     * Binary operator precedences, from the loosest to the tightest binding.
+     * NOT_BINARY_OPERATOR is used for tokens that can't continue an expression.
+     */
+    enum Precedence {
+        NOT_BINARY_OPERATOR = 0,
+        PREC_COMMA,
+        PREC_ASSIGNMENT,
+        PREC_CONDITIONAL,
+        PREC_LOGICAL_OR,
+        PREC_LOGICAL_AND,
+        PREC_BIT_IOR,
+        PREC_BIT_XOR,
+        PREC_BIT_AND,
+        PREC_EQUALITY,
+        PREC_RELATIONAL,
+        PREC_SHIFT,
+        PREC_ADDITIVE,
+        PREC_MULTIPLICATIVE
+    };
+
+    enum Associativity {
+        LEFT_TO_RIGHT,
+        RIGHT_TO_LEFT
+    };
+
+    /**
+     * Precedence of a binary operator token, NOT_BINARY_OPERATOR for the other
+     * tokens.  The conditional operator is the ? token.
+     */
+    static Precedence getBinaryPrecedence(LexerToken::Kind kind)
+    {
+        switch( kind ) {
+            case LexerToken::MUL:
+            case LexerToken::DIV:
+            case LexerToken::MOD:
+                return PREC_MULTIPLICATIVE;
+
+            case LexerToken::ADD:
+            case LexerToken::SUB:
+                return PREC_ADDITIVE;
+
+            case LexerToken::SHIFT_LEFT:
+            case LexerToken::SHIFT_RIGHT:
+                return PREC_SHIFT;
+
+            case LexerToken::LT:
+            case LexerToken::GT:
+            case LexerToken::LE:
+            case LexerToken::GE:
+                return PREC_RELATIONAL;
+
+            case LexerToken::EQUAL:
+            case LexerToken::NOT_EQUAL:
+                return PREC_EQUALITY;
+
+            case LexerToken::BIT_AND:       return PREC_BIT_AND;
+            case LexerToken::BIT_XOR:       return PREC_BIT_XOR;
+            case LexerToken::BIT_IOR:       return PREC_BIT_IOR;
+            case LexerToken::BOOL_AND:      return PREC_LOGICAL_AND;
+            case LexerToken::BOOL_OR:       return PREC_LOGICAL_OR;
+            case LexerToken::QUESTION_MARK: return PREC_CONDITIONAL;
+
+            case LexerToken::ASSIGN:
+            case LexerToken::MUL_ASSIGN:
+            case LexerToken::DIV_ASSIGN:
+            case LexerToken::MOD_ASSIGN:
+            case LexerToken::ADD_ASSIGN:
+            case LexerToken::SUB_ASSIGN:
+            case LexerToken::SHIFT_LEFT_ASSIGN:
+            case LexerToken::SHIFT_RIGHT_ASSIGN:
+            case LexerToken::BIT_AND_ASSIGN:
+            case LexerToken::BIT_XOR_ASSIGN:
+            case LexerToken::BIT_IOR_ASSIGN:
+                return PREC_ASSIGNMENT;
+
+            case LexerToken::COMMA:         return PREC_COMMA;
+            default:                        return NOT_BINARY_OPERATOR;
+        }
+    }
+
+    /**
+     * Only the conditional and the assignment operators group right to left
+     */
+    static Associativity getAssociativity(Precedence precedence)
+    {
+        return precedence == PREC_CONDITIONAL || precedence == PREC_ASSIGNMENT ? RIGHT_TO_LEFT : LEFT_TO_RIGHT;
+    }
+
+    /**
+     * How expressions are parsed.  RECURSIVE_DESCENT uses the native stack, one
+     * frame (or more) per nesting level.  EXPLICIT_STACK keeps the pending operators
+     * and operands on heap-allocated stacks, so that deeply nested expressions
+     * (ex: machine generated ((((...)))) or !!!!...x) can't overflow the thread stack.
+     * Both produce the same IR.
+     */
+    enum ParseMode {
+        RECURSIVE_DESCENT,
+        EXPLICIT_STACK
+    };
+};
@@ -6,6 +6,10 @@
 //
 
 #include "C90Preprocess.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
 #include <map>
 #include <initializer_list>
 
@@ -127,6 +131,35 @@ void PreprocessorPhases::convertNewlinesAndTrigraphs(
     }
 }
 
+bool PreprocessorPhases::isUnchanged(const std::string& text) const
+{
+    // Characters kept by phase 1, except ? and \ which are checked with the next
+    // character
+    //
+    static const struct PlainCharTable {
+        bool plain[256];
+
+        PlainCharTable() : plain()
+        {
+            for( int c = 0; c < 256; ++c ) {
+                plain[c] = c != '?' && c != '\\' && c != '\r' && (isprint(c) || isspace(c));
+            }
+        }
+    } plainCharTable;
+
+    size_t size = text.size();
+    for( size_t i = 0; i < size; ++i ) {
+        char c = text[i];
+        if( !plainCharTable.plain[static_cast<uint8_t>(c)] &&
+            !(c == '?' && (i + 1 == size || text[i + 1] != '?')) &&
+            !(c == '\\' && (i + 1 == size || text[i + 1] != '\n')) ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 /**
  * Phase 2 of translation, remove all occurences of backslash + newline
  */
@@ -172,4 +205,764 @@ void PreprocessorPhases::removeEndOfLineBacklashes(
     }
 }
 
+namespace {
+
+    /**
+     * Check if a pp-token is a punctuator
+     */
+    bool isPunctuator(const PPToken& token, LexerToken::Kind punctuator)
+    {
+        return token.getKind() == PPToken::PUNCTUATOR && token.getPunctuator() == punctuator;
+    }
+
+    /**
+     * Directives without effect for now
+     */
+    bool isOtherDirective(const std::string& name)
+    {
+        static const char* const directives[] = {
+            "line", "error", "pragma"
+        };
+
+        for( const char* directive : directives ) {
+            if( name == directive ) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Check if a spelling is in the text of a source
+     */
+    bool isInSource(const PPSource& source, const char* spelling)
+    {
+        return spelling >= source.getText() && spelling < source.getText() + source.getSize();
+    }
+
+    /**
+     * Messages passed to another Message, and counted
+     */
+    class CountingMessage : public Message {
+    public:
+        CountingMessage(const std::shared_ptr<Message>& msg_) : msg(msg_), nbMessages(0) { }
+
+        virtual void issueMessage(const SourcePosition& sourcePosition, Msg message, std::initializer_list<std::string> args) override
+        {
+            ++nbMessages;
+            msg->issueMessage(sourcePosition, message, args);
+        }
+
+        size_t getNbMessages() const { return nbMessages; }
+
+    private:
+        std::shared_ptr<Message> msg;
+        size_t nbMessages;
+    };
+
+    /**
+     * Directory of a file, empty for the current directory
+     */
+    std::string getDirectory(const std::string& path)
+    {
+        size_t slash = path.rfind('/');
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+}
+
+/**
+ * Constructor
+ */
+C90Preprocessor::C90Preprocessor(const std::shared_ptr<Message>& msg_) :
+    C90Preprocessor(msg_, std::make_shared<PPHeaderSearch>())
+{
+    // Nothing else to do
+}
+
+/**
+ * Constructor with a shared header search
+ */
+C90Preprocessor::C90Preprocessor(const std::shared_ptr<Message>& msg_, const std::shared_ptr<PPHeaderSearch>& headerSearch_) :
+    msg(msg_),
+    macroTable(std::make_shared<PPMacroTable>()),
+    macroExpander(macroTable, msg_),
+    conditionEvaluator(macroTable, msg_),
+    conditionals(),
+    includeStack(),
+    includePaths(),
+    headerSearch(headerSearch_),
+    headerCache(),
+    diskCache(),
+    includeGuards(),
+    nbIncludes(0),
+    nbSkippedIncludes(0),
+    nbTokensLexed(0),
+    nbSkippedGroups(0),
+    scanOnly(false),
+    dependencies(),
+    dependencyHashes(),
+    dependencyIds(),
+    includedSources(),
+    sourcesByText(),
+    textTokens(),
+    directiveTokens(),
+    bodyTokens(),
+    paramIndexes(),
+    params()
+{
+    // Nothing else to do
+}
+
+/**
+ * Preprocess a source: phases 1 to 4 of translation
+ */
+void C90Preprocessor::doPreprocessor(const CharacterStreamList& input, CharacterStreamList& output)
+{
+    CharacterStreamList phase1;
+    CharacterStreamList phase2;
+    PreprocessorPhases phases;
+    phases.convertNewlinesAndTrigraphs(input, phase1, msg);
+    phases.removeEndOfLineBacklashes(phase1, phase2);
+
+    PPSource source(phase2);
+    PPExpandedTokenList expandedTokens;
+    preprocess(source, expandedTokens);
+    writeLines(source, expandedTokens, output);
+}
+
+/**
+ * Phases 3 and 4 of translation
+ */
+void C90Preprocessor::preprocess(const PPSource& source, PPExpandedTokenList& output)
+{
+    // The files may have changed since the last translation unit using the
+    // search
+    //
+    headerSearch->revalidate();
+
+    std::shared_ptr<std::string> filename = source.getSourcePosition(0).getFilename();
+    std::string directory = filename != nullptr ? getDirectory(*filename) : std::string();
+    includeStack.push_back(IncludeFrame{false, PPFileId{0, 0}, directory, conditionals.size(), GUARD_START, std::string()});
+    preprocessFile(source, output);
+    includeStack.pop_back();
+}
+
+/**
+ * Phases 1 to 4 of a file, kept like an included file
+ */
+bool C90Preprocessor::preprocessMainFile(const std::string& path, PPExpandedTokenList& output)
+{
+    std::string text;
+    PPFileId fileId;
+    if( !readSourceFile(path, text) || !getFileId(path, fileId) ) {
+        return false;
+    }
+    addDependency(path, fileId, PPHeaderCache::hashContent(text));
+
+    bool anyPhaseMessage = false;
+    std::shared_ptr<const PPSource> source = convertSource(path, text, anyPhaseMessage);
+    includedSources.push_back(source);
+    sourcesByText[source->getText()] = source.get();
+
+    headerSearch->revalidate();
+    includeStack.push_back(IncludeFrame{true, fileId, getDirectory(path), conditionals.size(), GUARD_START, std::string()});
+    preprocessFile(*source, output);
+    includeStack.pop_back();
+    return true;
+}
+
+/**
+ * Phase 4 of translation without the lines of text
+ */
+void C90Preprocessor::scanDependencies(const PPSource& source)
+{
+    PPExpandedTokenList output;
+    scanOnly = true;
+    preprocess(source, output);
+    scanOnly = false;
+}
+
+void C90Preprocessor::addDependency(const std::string& path, const PPFileId& fileId, uint64_t contentHash)
+{
+    if( dependencyIds.insert(fileId).second ) {
+        dependencies.push_back(path);
+        dependencyHashes.push_back(contentHash);
+    }
+}
+
+/**
+ * Preprocess a file, lexing it a line at a time
+ */
+void C90Preprocessor::preprocessFile(const PPSource& source, PPExpandedTokenList& output)
+{
+    PPLexer lexer(source, msg);
+    preprocessTokens(source, lexer, output);
+}
+
+/**
+ * Preprocess the tokens of a file, from a PPLexer or a PPTokenReader.  The lines
+ * of text between two directives are expanded together, as an invocation may be
+ * on several lines.  The lexer doesn't lex the skipped groups, only their
+ * directives.
+ */
+template<typename TokenReader>
+void C90Preprocessor::preprocessTokens(const PPSource& source, TokenReader& lexer, PPExpandedTokenList& output)
+{
+    PPTokenList directiveLine;
+    PPToken token = lexer.nextToken();
+    ++nbTokensLexed;
+
+    while( token.getKind() != PPToken::END_OF_FILE ) {
+        if( token.isStartOfLine() && isPunctuator(token, LexerToken::HASH) ) {
+            directiveLine.clear();
+            while( !lexer.isAtEndOfLine() ) {
+                directiveLine.push_back(lexer.nextToken());
+            }
+            handleDirective(source, directiveLine.data(), directiveLine.size(), output);
+
+            if( isActive() ) {
+                token = lexer.nextToken();
+            }
+            else {
+                ++nbSkippedGroups;
+                token = lexer.skipGroup();
+            }
+            nbTokensLexed += directiveLine.size() + 1;
+            continue;
+        }
+
+        IncludeFrame& frame = includeStack.back();
+        if( frame.guardState != GUARD_INSIDE ) {
+            frame.guardState = GUARD_NONE;
+        }
+
+        if( scanOnly ) {
+            token = lexer.skipText();
+            ++nbTokensLexed;
+            continue;
+        }
+
+        SourcePosition position = source.getSourcePosition(token.getOffset());
+        textTokens.clear();
+        do {
+            textTokens.push_back(PPExpandedToken::fromToken(token, source));
+            token = lexer.nextToken();
+        } while( token.getKind() != PPToken::END_OF_FILE && !(token.isStartOfLine() && isPunctuator(token, LexerToken::HASH)) );
+
+        nbTokensLexed += textTokens.size();
+        macroExpander.expand(textTokens.data(), textTokens.size(), position, output);
+    }
+
+    // The conditionals can't continue in the including file
+    //
+    IncludeFrame& frame = includeStack.back();
+    if( conditionals.size() > frame.conditionalBase ) {
+        msg->issueMessage(source.getSourcePosition(token.getOffset()), Message::ERROR_UNTERMINATED_CONDITIONAL, {});
+        conditionals.resize(frame.conditionalBase);
+    }
+
+    if( frame.guardState == GUARD_AFTER && frame.hasFileId ) {
+        includeGuards.setGuardMacro(frame.fileId, frame.guardMacro);
+    }
+}
+
+/**
+ * Execute a directive, given the tokens after the #.  In a skipped group, only
+ * the conditional directives are executed, for their nesting.
+ */
+void C90Preprocessor::handleDirective(const PPSource& source, const PPToken* tokens, size_t nbTokens, PPExpandedTokenList& output)
+{
+    std::string name = nbTokens > 0 && tokens[0].getKind() == PPToken::IDENTIFIER ? tokens[0].getSpelling(source) : std::string();
+    updateIncludeGuard(name, source, tokens, nbTokens);
+
+    // Null directive
+    //
+    if( nbTokens == 0 || handleConditional(name, source, tokens, nbTokens) || !isActive() ) {
+        return;
+    }
+
+    if( name == "define" ) {
+        defineMacro(source, tokens + 1, nbTokens - 1);
+    }
+    else if( name == "undef" ) {
+        undefineMacro(source, tokens + 1, nbTokens - 1);
+    }
+    else if( name == "include" ) {
+        includeFile(source, tokens + 1, nbTokens - 1, output);
+    }
+    else if( name == "pragma" && nbTokens > 1 && tokens[1].getSpelling(source) == "once" ) {
+        if( includeStack.back().hasFileId ) {
+            includeGuards.setPragmaOnce(includeStack.back().fileId);
+        }
+    }
+    else if( !isOtherDirective(name) ) {
+        msg->issueMessage(source.getSourcePosition(tokens[0].getOffset()), Message::ERROR_INVALID_DIRECTIVE, {tokens[0].getSpelling(source)});
+    }
+}
+
+/**
+ * #if, #ifdef, #ifndef, #elif, #else and #endif.  Returns false for the other
+ * directives.
+ */
+bool C90Preprocessor::handleConditional(const std::string& name, const PPSource& source, const PPToken* tokens, size_t nbTokens)
+{
+    if( name == "if" || name == "ifdef" || name == "ifndef" ) {
+        bool parentActive = isActive();
+        bool condition = false;
+        if( !parentActive ) {
+            // Nested in a skipped group, the condition is not evaluated
+            //
+        }
+        else if( name == "if" ) {
+            condition = evaluateCondition(source, tokens + 1, nbTokens - 1);
+        }
+        else if( nbTokens != 2 || tokens[1].getKind() != PPToken::IDENTIFIER ) {
+            msg->issueMessage(source.getSourcePosition(tokens[0].getOffset()), Message::ERROR_INVALID_DIRECTIVE, {name});
+        }
+        else {
+            condition = (macroTable->find(source.getText() + tokens[1].getOffset(), tokens[1].getLength()) != nullptr) == (name == "ifdef");
+        }
+
+        conditionals.push_back(Conditional{parentActive && condition, !parentActive || condition, false});
+        return true;
+    }
+
+    if( name != "elif" && name != "else" && name != "endif" ) {
+        return false;
+    }
+
+    if( conditionals.size() == includeStack.back().conditionalBase || (conditionals.back().sawElse && name != "endif") ) {
+        msg->issueMessage(source.getSourcePosition(tokens[0].getOffset()), Message::ERROR_UNMATCHED_CONDITIONAL, {name});
+        return true;
+    }
+
+    Conditional& conditional = conditionals.back();
+    if( name == "endif" ) {
+        conditionals.pop_back();
+    }
+    else if( name == "else" ) {
+        conditional.active = !conditional.taken;
+        conditional.taken = true;
+        conditional.sawElse = true;
+    }
+    else {
+        conditional.active = !conditional.taken && evaluateCondition(source, tokens + 1, nbTokens - 1);
+        conditional.taken = conditional.taken || conditional.active;
+    }
+
+    return true;
+}
+
+/**
+ * Condition of #if and #elif (C90 6.8.1): defined NAME is replaced before the
+ * macro expansion, which would replace NAME, then the expression is evaluated.
+ * The buffers are reused, so nothing is allocated.
+ */
+bool C90Preprocessor::evaluateCondition(const PPSource& source, const PPToken* tokens, size_t nbTokens)
+{
+    SourcePosition position = source.getSourcePosition(tokens[-1].getOffset());
+
+    directiveTokens.clear();
+    for( size_t i = 0; i < nbTokens; ++i ) {
+        PPExpandedToken token = PPExpandedToken::fromToken(tokens[i], source);
+        if( token.kind == PPToken::IDENTIFIER && token.length == 7 && std::memcmp(token.spelling, "defined", 7) == 0 ) {
+            bool parens = i + 1 < nbTokens && isPunctuator(tokens[i + 1], LexerToken::LEFT_PARAR);
+            size_t nameIndex = parens ? i + 2 : i + 1;
+            if( nameIndex < nbTokens && tokens[nameIndex].getKind() == PPToken::IDENTIFIER &&
+                (!parens || (nameIndex + 1 < nbTokens && isPunctuator(tokens[nameIndex + 1], LexerToken::RIGHT_PARAR))) ) {
+                bool defined = macroTable->find(source.getText() + tokens[nameIndex].getOffset(), tokens[nameIndex].getLength()) != nullptr;
+                token = PPExpandedToken{defined ? "1" : "0", 1, PPHidesetTable::EMPTY, PPToken::PP_NUMBER,
+                    static_cast<uint8_t>(LexerToken::UNKNOWN), token.flags};
+                i = parens ? nameIndex + 1 : nameIndex;
+            }
+        }
+        directiveTokens.push_back(token);
+    }
+
+    textTokens.clear();
+    macroExpander.expand(directiveTokens.data(), directiveTokens.size(), position, textTokens);
+
+    PPExpressionEvaluator::Value value;
+    return conditionEvaluator.evaluate(textTokens.data(), textTokens.size(), position, value) && value.isTrue();
+}
+
+/**
+ * Follow the include guard pattern: the first directive of the file is #ifndef
+ * GUARD or #if !defined GUARD, and its #endif is the last thing in the file
+ */
+void C90Preprocessor::updateIncludeGuard(const std::string& name, const PPSource& source, const PPToken* tokens, size_t nbTokens)
+{
+    IncludeFrame& frame = includeStack.back();
+    bool guardLevel = conditionals.size() == frame.conditionalBase + 1;
+
+    switch( frame.guardState ) {
+        case GUARD_START: {
+            size_t nameIndex = 0;
+            if( name == "ifndef" && nbTokens == 2 ) {
+                nameIndex = 1;
+            }
+            else if( name == "if" && nbTokens >= 4 && isPunctuator(tokens[1], LexerToken::BOOL_NOT) &&
+                     tokens[2].getSpelling(source) == "defined" ) {
+                if( nbTokens == 4 ) {
+                    nameIndex = 3;
+                }
+                else if( nbTokens == 6 && isPunctuator(tokens[3], LexerToken::LEFT_PARAR) && isPunctuator(tokens[5], LexerToken::RIGHT_PARAR) ) {
+                    nameIndex = 4;
+                }
+            }
+
+            if( nameIndex != 0 && tokens[nameIndex].getKind() == PPToken::IDENTIFIER ) {
+                frame.guardState = GUARD_INSIDE;
+                frame.guardMacro = tokens[nameIndex].getSpelling(source);
+            }
+            else {
+                frame.guardState = GUARD_NONE;
+            }
+            break;
+        }
+
+        case GUARD_INSIDE:
+            if( guardLevel && name == "endif" ) {
+                frame.guardState = GUARD_AFTER;
+            }
+            else if( guardLevel && (name == "else" || name == "elif") ) {
+                frame.guardState = GUARD_NONE;
+            }
+            break;
+
+        case GUARD_AFTER:
+            frame.guardState = GUARD_NONE;
+            break;
+
+        case GUARD_NONE:
+            break;
+    }
+}
+
+/**
+ * #define: the name, the parameters of a function-like macro, and the
+ * replacement list (C90 6.8.3)
+ */
+void C90Preprocessor::defineMacro(const PPSource& source, const PPToken* tokens, size_t nbTokens)
+{
+    if( nbTokens == 0 || tokens[0].getKind() != PPToken::IDENTIFIER ) {
+        SourcePosition position = source.getSourcePosition(nbTokens == 0 ? tokens[-1].getOffset() : tokens[0].getOffset());
+        msg->issueMessage(position, Message::ERROR_INVALID_DIRECTIVE, {"define"});
+        return;
+    }
 
+    // The parameters: a ( right after the name
+    //
+    size_t i = 1;
+    bool functionLike = i < nbTokens && isPunctuator(tokens[i], LexerToken::LEFT_PARAR) && !tokens[i].hasLeadingSpace();
+    params.clear();
+    if( functionLike ) {
+        ++i;
+        bool valid = true;
+        if( i < nbTokens && isPunctuator(tokens[i], LexerToken::RIGHT_PARAR) ) {
+            ++i;
+        }
+        else {
+            for( ;; ) {
+                if( i >= nbTokens || tokens[i].getKind() != PPToken::IDENTIFIER ) {
+                    valid = false;
+                    break;
+                }
+
+                std::string param = tokens[i].getSpelling(source);
+                if( std::find(params.begin(), params.end(), param) != params.end() ) {
+                    valid = false;
+                    break;
+                }
+                params.push_back(param);
+                ++i;
+
+                if( i < nbTokens && isPunctuator(tokens[i], LexerToken::RIGHT_PARAR) ) {
+                    ++i;
+                    break;
+                }
+                if( i >= nbTokens || !isPunctuator(tokens[i], LexerToken::COMMA) ) {
+                    valid = false;
+                    break;
+                }
+                ++i;
+            }
+        }
+
+        if( !valid ) {
+            const PPToken& token = tokens[std::min(i, nbTokens - 1)];
+            msg->issueMessage(source.getSourcePosition(token.getOffset()), Message::ERROR_INVALID_DIRECTIVE, {"define"});
+            return;
+        }
+    }
+
+    // The replacement list, with the parameters numbered
+    //
+    bodyTokens.clear();
+    paramIndexes.clear();
+    for( size_t j = i; j < nbTokens; ++j ) {
+        PPExpandedToken token = PPExpandedToken::fromToken(tokens[j], source);
+        uint32_t paramIndex = PPMacro::NOT_PARAM;
+        if( token.kind == PPToken::IDENTIFIER ) {
+            auto param = std::find(params.begin(), params.end(), token.getSpelling());
+            if( param != params.end() ) {
+                paramIndex = static_cast<uint32_t>(param - params.begin());
+            }
+        }
+
+        bodyTokens.push_back(token);
+        paramIndexes.push_back(paramIndex);
+    }
+
+    if( !bodyTokens.empty() ) {
+        bodyTokens.front().flags &= ~PPToken::LEADING_SPACE;
+    }
+
+    // # must be followed by a parameter, ## can't be at either end
+    //
+    size_t bodySize = bodyTokens.size();
+    for( size_t j = 0; j < bodySize; ++j ) {
+        bool invalidHash = functionLike && bodyTokens[j].isPunctuator(LexerToken::HASH) &&
+            (j + 1 == bodySize || paramIndexes[j + 1] == PPMacro::NOT_PARAM);
+        bool invalidPaste = bodyTokens[j].isPunctuator(LexerToken::HASH_HASH) && (j == 0 || j + 1 == bodySize);
+        if( invalidHash || invalidPaste ) {
+            msg->issueMessage(source.getSourcePosition(tokens[i + j].getOffset()), Message::ERROR_INVALID_DIRECTIVE, {"define"});
+            return;
+        }
+    }
+
+    const PPMacro* previous = macroTable->define(source.getText() + tokens[0].getOffset(), tokens[0].getLength(), functionLike,
+        static_cast<unsigned>(params.size()), bodyTokens.data(), paramIndexes.data(), static_cast<unsigned>(bodySize));
+
+    if( previous != nullptr && !previous->isSameDefinition(*macroTable->find(previous->getName())) ) {
+        msg->issueMessage(source.getSourcePosition(tokens[0].getOffset()), Message::ERROR_MACRO_REDEFINED, {previous->getName()});
+    }
+}
+
+/**
+ * #undef
+ */
+void C90Preprocessor::undefineMacro(const PPSource& source, const PPToken* tokens, size_t nbTokens)
+{
+    if( nbTokens != 1 || tokens[0].getKind() != PPToken::IDENTIFIER ) {
+        SourcePosition position = source.getSourcePosition(nbTokens == 0 ? tokens[-1].getOffset() : tokens[0].getOffset());
+        msg->issueMessage(position, Message::ERROR_INVALID_DIRECTIVE, {"undef"});
+        return;
+    }
+
+    macroTable->undefine(source.getText() + tokens[0].getOffset(), tokens[0].getLength());
+}
+
+/**
+ * #include: the header name is "..." or <...>, else it comes from the expansion of
+ * the tokens (C90 6.8.2).  A file whose guard is defined, or with #pragma once, is
+ * not read again.
+ */
+void C90Preprocessor::includeFile(const PPSource& source, const PPToken* tokens, size_t nbTokens, PPExpandedTokenList& output)
+{
+    SourcePosition position = source.getSourcePosition(tokens[-1].getOffset());
+    directiveTokens.clear();
+    for( size_t i = 0; i < nbTokens; ++i ) {
+        directiveTokens.push_back(PPExpandedToken::fromToken(tokens[i], source));
+    }
+
+    if( nbTokens > 0 && tokens[0].getKind() != PPToken::STRING_LITERAL && !isPunctuator(tokens[0], LexerToken::LT) ) {
+        textTokens.clear();
+        macroExpander.expand(directiveTokens.data(), directiveTokens.size(), position, textTokens);
+        directiveTokens.swap(textTokens);
+    }
+
+    std::string name;
+    bool angled = false;
+    size_t nbNameTokens = directiveTokens.size();
+    if( nbNameTokens == 1 && directiveTokens[0].kind == PPToken::STRING_LITERAL && directiveTokens[0].spelling[0] == '"' ) {
+        name.assign(directiveTokens[0].spelling + 1, directiveTokens[0].length - 2);
+    }
+    else if( nbNameTokens >= 3 && directiveTokens[0].isPunctuator(LexerToken::LT) && directiveTokens.back().isPunctuator(LexerToken::GT) ) {
+        angled = true;
+        for( size_t i = 1; i + 1 < nbNameTokens; ++i ) {
+            if( i > 1 && directiveTokens[i].hasLeadingSpace() ) {
+                name += ' ';
+            }
+            name.append(directiveTokens[i].spelling, directiveTokens[i].length);
+        }
+    }
+    else {
+        msg->issueMessage(position, Message::ERROR_INVALID_DIRECTIVE, {"include"});
+        return;
+    }
+
+    if( includeStack.size() >= MAX_INCLUDE_DEPTH ) {
+        msg->issueMessage(position, Message::ERROR_INCLUDE_TOO_DEEP, {name});
+        return;
+    }
+
+    std::string path;
+    PPFileId fileId;
+    if( !findInclude(name, angled, path, fileId) ) {
+        msg->issueMessage(position, Message::ERROR_INCLUDE_NOT_FOUND, {name});
+        return;
+    }
+
+    if( includeGuards.canSkip(fileId, *macroTable) ) {
+        ++nbSkippedIncludes;
+        return;
+    }
+
+    std::string text;
+    if( !readSourceFile(path, text) ) {
+        msg->issueMessage(position, Message::ERROR_INCLUDE_NOT_FOUND, {name});
+        return;
+    }
+    ++nbIncludes;
+
+    // The hash of the content as read, for the caches and the precompiled headers
+    //
+    uint64_t contentHash = PPHeaderCache::hashContent(text);
+    addDependency(path, fileId, contentHash);
+
+    // Phases 1 to 3, unless the header is cached for this content, in this process
+    // or on disk
+    //
+    std::shared_ptr<const PPCachedHeader> cachedHeader;
+    if( headerCache != nullptr ) {
+        cachedHeader = headerCache->find(fileId, contentHash);
+    }
+    if( cachedHeader == nullptr && diskCache != nullptr ) {
+        PPDiskCache::Status status;
+        cachedHeader = diskCache->load(contentHash, path, status);
+        if( cachedHeader != nullptr && headerCache != nullptr ) {
+            cachedHeader = headerCache->insert(fileId, contentHash, cachedHeader);
+        }
+    }
+
+    std::shared_ptr<const PPSource> includedSource;
+    if( cachedHeader != nullptr ) {
+        includedSource = cachedHeader->getSource();
+    }
+    else {
+        bool anyPhaseMessage = false;
+        includedSource = convertSource(path, text, anyPhaseMessage);
+
+        // The messages of phases 1 and 2 would not be issued by the next inclusions:
+        // the header is not cached.  Those of the lexer are kept with the header.
+        //
+        if( (headerCache != nullptr || diskCache != nullptr) && !anyPhaseMessage ) {
+            PPLexer lexer(*includedSource, nullptr);
+            PPTokenList headerTokens;
+            do {
+                headerTokens.push_back(lexer.nextToken());
+            } while( headerTokens.back().getKind() != PPToken::END_OF_FILE );
+
+            std::vector<PPLexer::Error> errors = lexer.getErrors();
+            cachedHeader = std::make_shared<PPCachedHeader>(includedSource, std::move(headerTokens), std::move(errors));
+            if( diskCache != nullptr ) {
+                diskCache->store(contentHash, *cachedHeader);
+            }
+            if( headerCache != nullptr ) {
+                cachedHeader = headerCache->insert(fileId, contentHash, cachedHeader);
+            }
+            includedSource = cachedHeader->getSource();
+        }
+    }
+
+    includedSources.push_back(includedSource);
+    sourcesByText[includedSource->getText()] = includedSource.get();
+
+    includeStack.push_back(IncludeFrame{true, fileId, getDirectory(path), conditionals.size(), GUARD_START, std::string()});
+    if( cachedHeader != nullptr ) {
+        PPTokenReader reader(*includedSource, cachedHeader->getTokens(), cachedHeader->getErrors(), msg);
+        preprocessTokens(*includedSource, reader, output);
+    }
+    else {
+        preprocessFile(*includedSource, output);
+    }
+    includeStack.pop_back();
+}
+
+/**
+ * Phases 1 and 2 of an included file, unless they have nothing to do
+ */
+std::shared_ptr<const PPSource> C90Preprocessor::convertSource(const std::string& path, const std::string& text, bool& anyMessage)
+{
+    auto filename = std::make_shared<std::string>(path);
+    PreprocessorPhases phases;
+    if( phases.isUnchanged(text) ) {
+        return std::make_shared<PPSource>(text, filename);
+    }
+
+    CharacterStreamList streams;
+    CharacterStreamList phase1;
+    CharacterStreamList phase2;
+    auto countingMsg = std::make_shared<CountingMessage>(msg);
+    splitSourceLines(text, filename, streams);
+    phases.convertNewlinesAndTrigraphs(streams, phase1, countingMsg);
+    phases.removeEndOfLineBacklashes(phase1, phase2);
+
+    anyMessage = countingMsg->getNbMessages() > 0;
+    return std::make_shared<PPSource>(phase2);
+}
+
+/**
+ * Search an included file: in the directory of the including file for "...",
+ * then in the include paths
+ */
+bool C90Preprocessor::findInclude(const std::string& name, bool angled, std::string& path, PPFileId& fileId)
+{
+    if( !name.empty() && name[0] == '/' ) {
+        return headerSearch->find(std::string(), name, path, fileId);
+    }
+
+    if( !angled && headerSearch->find(includeStack.back().directory, name, path, fileId) ) {
+        return true;
+    }
+
+    for( const std::string& directory : includePaths ) {
+        if( headerSearch->find(directory, name, path, fileId) ) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Write the tokens, a stream per line.  A line has the position of its first
+ * token when it comes from a source, else the position of the previous line.
+ */
+void C90Preprocessor::writeLines(const PPSource& source, const PPExpandedTokenList& tokens, CharacterStreamList& output)
+{
+    SourcePosition position = source.getSourcePosition(0);
+    std::string line;
+
+    for( size_t i = 0; i < tokens.size(); ++i ) {
+        const PPExpandedToken& token = tokens[i];
+        if( i == 0 || token.isStartOfLine() ) {
+            if( i > 0 ) {
+                output.push_back(CharacterStream(line + "\n", position));
+                line.clear();
+            }
+
+            // The source of the token: the main one, or an included one
+            //
+            const PPSource* tokenSource = &source;
+            if( !isInSource(source, token.spelling) ) {
+                auto found = sourcesByText.upper_bound(token.spelling);
+                tokenSource = found != sourcesByText.begin() ? std::prev(found)->second : nullptr;
+            }
+
+            if( tokenSource != nullptr && isInSource(*tokenSource, token.spelling) ) {
+                position = tokenSource->getSourcePosition(static_cast<uint32_t>(token.spelling - tokenSource->getText()));
+            }
+        }
+        else if( token.hasLeadingSpace() ) {
+            line += ' ';
+        }
+
+        line.append(token.spelling, token.length);
+    }
+
+    if( !tokens.empty() ) {
+        output.push_back(CharacterStream(line + "\n", position));
+    }
+}
@@ -6,10 +6,18 @@
 //
 #pragma once
 
+#include <map>
 #include <string>
 #include <memory>
+#include <unordered_set>
 #include <vector>
 #include "Message.hpp"
+#include "PPExpression.hpp"
+#include "PPDiskCache.hpp"
+#include "PPHeaderCache.hpp"
+#include "PPInclude.hpp"
+#include "PPMacro.hpp"
+#include "PPParser.hpp"
 #include "SourcePosition.hpp"
 
 class CharacterStream {
@@ -38,9 +46,187 @@ public:
 };
 
 
+/**
+ * Preprocessor for C90: phases 1 to 4 of translation.  The macros stay defined
+ * from one call to the next.
+ *
+ * A file included again is not read when its include guard or its #pragma once
+ * makes it produce nothing; the files are known by identity, not by path.  The
+ * included files are found through a PPHeaderSearch, which may be shared by the
+ * preprocessors of several translation units.
+ */
 class C90Preprocessor : public Preprocessor {
 public:
+    /**
+     * Constructor
+     */
+    C90Preprocessor(const std::shared_ptr<Message>& msg_);
+
+    /**
+     * Constructor with a header search shared with other preprocessors
+     */
+    C90Preprocessor(const std::shared_ptr<Message>& msg_, const std::shared_ptr<PPHeaderSearch>& headerSearch_);
+
+    /**
+     * Preprocess a source, the output has a stream per line of tokens
+     */
     virtual void doPreprocessor(const CharacterStreamList& input, CharacterStreamList& output) override;
+
+    /**
+     * Phases 3 and 4 of translation: lex a source, execute the directives and
+     * expand the macros.  The tokens of the included files refer to sources kept
+     * by the preprocessor.
+     */
+    void preprocess(const PPSource& source, PPExpandedTokenList& output);
+
+    /**
+     * Phases 1 to 4 of translation of a file read by the preprocessor, a prefix
+     * header for example: it is a dependency, and its include guard is noted, like
+     * for the included files.  Returns false if the file can't be read.
+     */
+    bool preprocessMainFile(const std::string& path, PPExpandedTokenList& output);
+
+    /**
+     * Dependency scan of a source: only the directives are executed.  The lines
+     * of text are skipped like the skipped groups, without lexing or expanding
+     * them, so nothing is output.
+     */
+    void scanDependencies(const PPSource& source);
+
+    /**
+     * Directory searched for the included files, after the directory of the
+     * including file for "..."
+     */
+    void addIncludePath(const std::string& directory) { includePaths.push_back(directory); }
+    const std::vector<std::string>& getIncludePaths() const { return includePaths; }
+
+    /**
+     * Cache of the lexed headers, shared with other preprocessors, possibly in
+     * other threads.  Without it, each included file is read and lexed.
+     */
+    void setHeaderCache(const std::shared_ptr<PPHeaderCache>& headerCache_) { headerCache = headerCache_; }
+
+    /**
+     * Cache of the lexed headers kept on disk for the next compilations, searched
+     * after the header cache
+     */
+    void setDiskCache(const std::shared_ptr<PPDiskCache>& diskCache_) { diskCache = diskCache_; }
+
+    const std::shared_ptr<PPMacroTable>& getMacroTable() const { return macroTable; }
+    const PPMacroExpander& getMacroExpander() const { return macroExpander; }
+    const PPIncludeGuardTable& getIncludeGuards() const { return includeGuards; }
+    PPIncludeGuardTable& getIncludeGuards() { return includeGuards; }
+    const std::shared_ptr<PPHeaderSearch>& getHeaderSearch() const { return headerSearch; }
+
+    /**
+     * Files read by #include, and #include skipped by the multiple-include
+     * optimization
+     */
+    size_t getNbIncludes() const { return nbIncludes; }
+    size_t getNbSkippedIncludes() const { return nbSkippedIncludes; }
+
+    /**
+     * Tokens lexed, and runs of lines of the skipped groups, passed without
+     * lexing them
+     */
+    size_t getNbTokensLexed() const { return nbTokensLexed; }
+    size_t getNbSkippedGroups() const { return nbSkippedGroups; }
+
+    /**
+     * Paths of the files read by #include or preprocessMainFile(), once each, in
+     * the order they were first read, and the hashes of their content as read
+     */
+    const std::vector<std::string>& getDependencies() const { return dependencies; }
+    const std::vector<uint64_t>& getDependencyHashes() const { return dependencyHashes; }
+
+    /**
+     * Add a file read before this preprocessor, by the compilation it resumes
+     */
+    void addDependency(const std::string& path, const PPFileId& fileId, uint64_t contentHash);
+
+private:
+    static const size_t MAX_INCLUDE_DEPTH = 200;
+
+    /**
+     * Group of a conditional directive (C90 6.8.1)
+     */
+    struct Conditional {
+        bool active;            // The tokens of the group are processed
+        bool taken;             // A group was taken, the next ones are skipped
+        bool sawElse;
+    };
+
+    /**
+     * Detection of the include guard of a file, as its directives are read
+     */
+    enum GuardState {
+        GUARD_START,            // Nothing seen yet
+        GUARD_INSIDE,           // In the group of #ifndef GUARD
+        GUARD_AFTER,            // After its #endif, nothing seen yet
+        GUARD_NONE              // No include guard
+    };
+
+    /**
+     * File being preprocessed
+     */
+    struct IncludeFrame {
+        bool hasFileId;
+        PPFileId fileId;
+        std::string directory;
+        size_t conditionalBase;
+        GuardState guardState;
+        std::string guardMacro;
+    };
+
+    void preprocessFile(const PPSource& source, PPExpandedTokenList& output);
+    template<typename TokenReader>
+    void preprocessTokens(const PPSource& source, TokenReader& lexer, PPExpandedTokenList& output);
+    void handleDirective(const PPSource& source, const PPToken* tokens, size_t nbTokens, PPExpandedTokenList& output);
+    bool handleConditional(const std::string& name, const PPSource& source, const PPToken* tokens, size_t nbTokens);
+    bool evaluateCondition(const PPSource& source, const PPToken* tokens, size_t nbTokens);
+    void updateIncludeGuard(const std::string& name, const PPSource& source, const PPToken* tokens, size_t nbTokens);
+    void defineMacro(const PPSource& source, const PPToken* tokens, size_t nbTokens);
+    void undefineMacro(const PPSource& source, const PPToken* tokens, size_t nbTokens);
+    void includeFile(const PPSource& source, const PPToken* tokens, size_t nbTokens, PPExpandedTokenList& output);
+    std::shared_ptr<const PPSource> convertSource(const std::string& path, const std::string& text, bool& anyMessage);
+    bool findInclude(const std::string& name, bool angled, std::string& path, PPFileId& fileId);
+    bool isActive() const { return conditionals.empty() || conditionals.back().active; }
+    void writeLines(const PPSource& source, const PPExpandedTokenList& tokens, CharacterStreamList& output);
+
+    std::shared_ptr<Message> msg;
+    std::shared_ptr<PPMacroTable> macroTable;
+    PPMacroExpander macroExpander;
+    PPExpressionEvaluator conditionEvaluator;
+
+    std::vector<Conditional> conditionals;
+    std::vector<IncludeFrame> includeStack;
+    std::vector<std::string> includePaths;
+    std::shared_ptr<PPHeaderSearch> headerSearch;
+    std::shared_ptr<PPHeaderCache> headerCache;
+    std::shared_ptr<PPDiskCache> diskCache;
+    PPIncludeGuardTable includeGuards;
+    size_t nbIncludes;
+    size_t nbSkippedIncludes;
+    size_t nbTokensLexed;
+    size_t nbSkippedGroups;
+    bool scanOnly;
+
+    std::vector<std::string> dependencies;
+    std::vector<uint64_t> dependencyHashes;
+    std::unordered_set<PPFileId, PPFileIdHash> dependencyIds;
+
+    // Sources of the included files, by start of their text
+    //
+    std::vector<std::shared_ptr<const PPSource>> includedSources;
+    std::map<const char *, const PPSource *> sourcesByText;
+
+    // Buffers reused for each line of text and each definition
+    //
+    PPExpandedTokenList textTokens;
+    PPExpandedTokenList directiveTokens;
+    PPExpandedTokenList bodyTokens;
+    std::vector<uint32_t> paramIndexes;
+    std::vector<std::string> params;
 };
 
 
@@ -61,6 +247,13 @@ public:
      */
     void removeEndOfLineBacklashes(const CharacterStreamList& input, CharacterStreamList& output);
 
+    /**
+     * Check if phases 1 and 2 would leave a text as it is: no \r, no ??, no
+     * unprintable character and no backslash + newline.  Most files are like
+     * this, and are lexed without the streams of the phases.
+     */
+    bool isUnchanged(const std::string& text) const;
+
 private:
     bool checkIfTrigraphSequenceComing(
         std::string::const_iterator& currCharPtr,
@@ -0,0 +1,390 @@
+// FlatIR.cpp
+//
+// Author: Marco Jacques
+//
+// Flat encoding of the expressions of the intermediate representation
+//
+
+#include "FlatIR.hpp"
+#include "IRConstantFolder.hpp"
+#include <cstring>
+#include <unordered_map>
+
+static_assert(IRExpr::NB_KINDS <= UINT8_MAX, "The kinds must fit in a byte");
+
+const FlatIR::NodeIndex FlatIR::INVALID_INDEX;
+const uint32_t FlatIR::NO_TYPE;
+const uint32_t FlatIR::NO_LOCATION;
+
+FlatIR::FlatIR() :
+    kinds(),
+    typeIds(),
+    leftOperands(),
+    rightOperands(),
+    data(),
+    locations(),
+    intValues(),
+    strings(),
+    extraOperands()
+{
+}
+
+FlatIR::NodeIndex FlatIR::addNode(IRExpr::Kind kind, uint32_t typeId, NodeIndex leftOperand, NodeIndex rightOperand, uint32_t nodeData, uint32_t location)
+{
+    NodeIndex index = static_cast<NodeIndex>(kinds.size());
+
+    kinds.push_back(static_cast<uint8_t>(kind));
+    typeIds.push_back(typeId);
+    leftOperands.push_back(leftOperand);
+    rightOperands.push_back(rightOperand);
+    data.push_back(nodeData);
+    locations.push_back(location);
+
+    return index;
+}
+
+double FlatIR::getFloatValue(NodeIndex index) const
+{
+    double value;
+    std::memcpy(&value, &intValues[data[index]], sizeof(value));
+    return value;
+}
+
+/**
+ * Add a string in the side table.  The name may be missing after a syntax error.
+ */
+uint32_t FlatIR::addString(const char* value, size_t length)
+{
+    uint32_t index = static_cast<uint32_t>(strings.size());
+    strings.push_back(value != nullptr ? std::string(value, length) : std::string());
+
+    return index;
+}
+
+
+/**
+ * Builder
+ */
+FlatIR::NodeIndex FlatIRBuilder::createNameExpr(IRExpr::Kind kind, NodeIndex operand, const char* name, size_t length)
+{
+    uint32_t nameIndex = ir->addString(name, length);
+    return ir->addNode(kind, FlatIR::NO_TYPE, operand, FlatIR::INVALID_INDEX, nameIndex, location);
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createTypeExpr(IRExpr::Kind kind, IRTypePtr type, NodeIndex operand)
+{
+    uint32_t typeId = type != nullptr ? type->getId() : FlatIR::NO_TYPE;
+    uint32_t exprTypeId = kind == IRExpr::CAST ? typeId : FlatIR::NO_TYPE;
+    return ir->addNode(kind, exprTypeId, operand, FlatIR::INVALID_INDEX, typeId, location);
+}
+
+static const char* getTokenName(const LexerTokenPtr& id, size_t& length)
+{
+    if( id == nullptr || id->getKind() != LexerToken::IDENTIFIER ) {
+        length = 0;
+        return nullptr;
+    }
+
+    const std::string& name = static_cast<const IdToken *>(id.get())->getName();
+    length = name.length();
+    return name.c_str();
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createIdExpr(const LexerTokenPtr& id)
+{
+    size_t length;
+    const char* name = getTokenName(id, length);
+    return createNameExpr(IRExpr::ID, FlatIR::INVALID_INDEX, name, length);
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createLiteralExpr(IRExpr::Kind kind, uint64_t value, IRTypePtr type)
+{
+    uint32_t valueIndex = static_cast<uint32_t>(ir->intValues.size());
+    ir->intValues.push_back(value);
+    return ir->addNode(kind, type->getId(), FlatIR::INVALID_INDEX, FlatIR::INVALID_INDEX, valueIndex, location);
+}
+
+static uint64_t getFloatBits(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createIntLitExpr(const LexerTokenPtr& intLiteral)
+{
+    const IntLiteralToken* token = static_cast<const IntLiteralToken *>(intLiteral.get());
+    IRTypePtr type = IRConstantFolder::getIntLiteralType(token->getValue(), token->isUnsigned(), token->isLong(), token->isDecimal());
+    return createLiteralExpr(IRExpr::INT_LITERAL, token->getValue(), type);
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createFloatLitExpr(const LexerTokenPtr& floatLiteral)
+{
+    const FloatLiteralToken* token = static_cast<const FloatLiteralToken *>(floatLiteral.get());
+    return createLiteralExpr(IRExpr::FLOAT_LITERAL, getFloatBits(token->getValue()), IRConstantFolder::getFloatLiteralType(token->getSuffix()));
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createStringLitExpr(const LexerTokenPtr& stringLiteral)
+{
+    const std::string& value = static_cast<const StringLiteralToken *>(stringLiteral.get())->getValue();
+    return createNameExpr(IRExpr::STRING_LITERAL, FlatIR::INVALID_INDEX, value.c_str(), value.length());
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createCallExpr(NodeIndex functor, const std::vector<NodeIndex>& args)
+{
+    uint32_t argsIndex = static_cast<uint32_t>(ir->extraOperands.size());
+    ir->extraOperands.push_back(static_cast<NodeIndex>(args.size()));
+    ir->extraOperands.insert(ir->extraOperands.end(), args.begin(), args.end());
+    return ir->addNode(IRExpr::CALL, FlatIR::NO_TYPE, functor, FlatIR::INVALID_INDEX, argsIndex, location);
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createStructFieldDirectAccess(NodeIndex structExpr, const LexerTokenPtr& id)
+{
+    size_t length;
+    const char* name = getTokenName(id, length);
+    return createNameExpr(IRExpr::FIELD_DIRECT_ACCESS, structExpr, name, length);
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createStructFieldIndirectAccess(NodeIndex structExpr, const LexerTokenPtr& id)
+{
+    size_t length;
+    const char* name = getTokenName(id, length);
+    return createNameExpr(IRExpr::FIELD_INDIRECT_ACCESS, structExpr, name, length);
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createUnaryExpr(IRExpr::Kind kind, NodeIndex operand)
+{
+    return ir->addNode(kind, FlatIR::NO_TYPE, operand, FlatIR::INVALID_INDEX, 0, location);
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createPostIncrExpr(NodeIndex expr)         { return createUnaryExpr(IRExpr::POST_INCR, expr); }
+FlatIR::NodeIndex FlatIRBuilder::createPostDecrExpr(NodeIndex expr)         { return createUnaryExpr(IRExpr::POST_DECR, expr); }
+FlatIR::NodeIndex FlatIRBuilder::createPreIncrExpr(NodeIndex expr)          { return createUnaryExpr(IRExpr::PRE_INCR, expr); }
+FlatIR::NodeIndex FlatIRBuilder::createPreDecrExpr(NodeIndex expr)          { return createUnaryExpr(IRExpr::PRE_DECR, expr); }
+FlatIR::NodeIndex FlatIRBuilder::createAddressOfExpr(NodeIndex castExpr)    { return createUnaryExpr(IRExpr::ADDRESS_OF, castExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createDereferenceExpr(NodeIndex castExpr)  { return createUnaryExpr(IRExpr::DEREFERENCE, castExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createUnaryPlusExpr(NodeIndex castExpr)    { return createUnaryExpr(IRExpr::UNARY_PLUS, castExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createUnaryMinusExpr(NodeIndex castExpr)   { return createUnaryExpr(IRExpr::UNARY_MINUS, castExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createBitNotExpr(NodeIndex castExpr)       { return createUnaryExpr(IRExpr::BIT_NOT, castExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createBoolNotExpr(NodeIndex castExpr)      { return createUnaryExpr(IRExpr::BOOL_NOT, castExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createSizeofExpr(NodeIndex unaryExpr)      { return createUnaryExpr(IRExpr::SIZEOF_EXPR, unaryExpr); }
+
+FlatIR::NodeIndex FlatIRBuilder::createSizeofTypeExpr(IRTypePtr type)
+{
+    return createTypeExpr(IRExpr::SIZEOF_TYPE, type, FlatIR::INVALID_INDEX);
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createCastExpr(IRTypePtr type, NodeIndex castExpr)
+{
+    return createTypeExpr(IRExpr::CAST, type, castExpr);
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createBinaryExpr(IRExpr::Kind kind, NodeIndex leftExpr, NodeIndex rightExpr)
+{
+    return ir->addNode(kind, FlatIR::NO_TYPE, leftExpr, rightExpr, 0, location);
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createArraySubscripting(NodeIndex leftExpr, NodeIndex rightExpr)   { return createBinaryExpr(IRExpr::ARRAY_SUBSCRIPT, leftExpr, rightExpr); }
+
+FlatIR::NodeIndex FlatIRBuilder::createMulExpr(NodeIndex leftExpr, NodeIndex rightExpr)            { return createBinaryExpr(IRExpr::MUL, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createDivExpr(NodeIndex leftExpr, NodeIndex rightExpr)            { return createBinaryExpr(IRExpr::DIV, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createModExpr(NodeIndex leftExpr, NodeIndex rightExpr)            { return createBinaryExpr(IRExpr::MOD, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createAddExpr(NodeIndex leftExpr, NodeIndex rightExpr)            { return createBinaryExpr(IRExpr::ADD, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createSubExpr(NodeIndex leftExpr, NodeIndex rightExpr)            { return createBinaryExpr(IRExpr::SUB, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createShiftLeftExpr(NodeIndex leftExpr, NodeIndex rightExpr)      { return createBinaryExpr(IRExpr::SHIFT_LEFT, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createShiftRightExpr(NodeIndex leftExpr, NodeIndex rightExpr)     { return createBinaryExpr(IRExpr::SHIFT_RIGHT, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createLessThanExpr(NodeIndex leftExpr, NodeIndex rightExpr)       { return createBinaryExpr(IRExpr::LESS_THAN, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createGreaterThanExpr(NodeIndex leftExpr, NodeIndex rightExpr)    { return createBinaryExpr(IRExpr::GREATER_THAN, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createLessEqualExpr(NodeIndex leftExpr, NodeIndex rightExpr)      { return createBinaryExpr(IRExpr::LESS_EQUAL, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createGreaterEqualExpr(NodeIndex leftExpr, NodeIndex rightExpr)   { return createBinaryExpr(IRExpr::GREATER_EQUAL, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createEqualExpr(NodeIndex leftExpr, NodeIndex rightExpr)          { return createBinaryExpr(IRExpr::EQUAL, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createNotEqualExpr(NodeIndex leftExpr, NodeIndex rightExpr)       { return createBinaryExpr(IRExpr::NOT_EQUAL, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createBitAndExpr(NodeIndex leftExpr, NodeIndex rightExpr)         { return createBinaryExpr(IRExpr::BIT_AND, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createBitXorExpr(NodeIndex leftExpr, NodeIndex rightExpr)         { return createBinaryExpr(IRExpr::BIT_XOR, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createBitIorExpr(NodeIndex leftExpr, NodeIndex rightExpr)         { return createBinaryExpr(IRExpr::BIT_IOR, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createBoolAndExpr(NodeIndex leftExpr, NodeIndex rightExpr)        { return createBinaryExpr(IRExpr::BOOL_AND, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createBoolOrExpr(NodeIndex leftExpr, NodeIndex rightExpr)         { return createBinaryExpr(IRExpr::BOOL_OR, leftExpr, rightExpr); }
+
+FlatIR::NodeIndex FlatIRBuilder::createAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr)             { return createBinaryExpr(IRExpr::ASSIGN, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createMulAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr)          { return createBinaryExpr(IRExpr::MUL_ASSIGN, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createDivAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr)          { return createBinaryExpr(IRExpr::DIV_ASSIGN, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createModAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr)          { return createBinaryExpr(IRExpr::MOD_ASSIGN, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createAddAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr)          { return createBinaryExpr(IRExpr::ADD_ASSIGN, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createSubAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr)          { return createBinaryExpr(IRExpr::SUB_ASSIGN, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createShiftLeftAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr)    { return createBinaryExpr(IRExpr::SHIFT_LEFT_ASSIGN, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createShiftRightAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr)   { return createBinaryExpr(IRExpr::SHIFT_RIGHT_ASSIGN, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createBitAndAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr)       { return createBinaryExpr(IRExpr::BIT_AND_ASSIGN, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createBitXorAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr)       { return createBinaryExpr(IRExpr::BIT_XOR_ASSIGN, leftExpr, rightExpr); }
+FlatIR::NodeIndex FlatIRBuilder::createBitIorAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr)       { return createBinaryExpr(IRExpr::BIT_IOR_ASSIGN, leftExpr, rightExpr); }
+
+FlatIR::NodeIndex FlatIRBuilder::createCommaExpr(NodeIndex leftExpr, NodeIndex rightExpr)              { return createBinaryExpr(IRExpr::COMMA, leftExpr, rightExpr); }
+
+FlatIR::NodeIndex FlatIRBuilder::createCondExpr(NodeIndex cond, NodeIndex thenExpr, NodeIndex elseExpr)
+{
+    return ir->addNode(IRExpr::COND, FlatIR::NO_TYPE, cond, thenExpr, elseExpr, location);
+}
+
+FlatIR::NodeIndex FlatIRBuilder::createAssociativeChain(IRExpr::Kind operatorKind, const std::vector<NodeIndex>& operands)
+{
+    if( operands.size() < chainThreshold ) {
+        NodeIndex currExpr = operands[0];
+        for( size_t i = 1; i < operands.size(); ++i ) {
+            currExpr = createBinaryExpr(operatorKind, currExpr, operands[i]);
+        }
+        return currExpr;
+    }
+
+    uint32_t operandsIndex = static_cast<uint32_t>(ir->extraOperands.size());
+    ir->extraOperands.push_back(static_cast<NodeIndex>(operatorKind));
+    ir->extraOperands.push_back(static_cast<NodeIndex>(operands.size()));
+    ir->extraOperands.insert(ir->extraOperands.end(), operands.begin(), operands.end());
+    return ir->addNode(IRExpr::CHAIN, FlatIR::NO_TYPE, FlatIR::INVALID_INDEX, FlatIR::INVALID_INDEX, operandsIndex, location);
+}
+
+IRTypePtr FlatIRBuilder::getPointerType(IRTypePtr targetType)
+{
+    return typeTable->getPointerType(targetType);
+}
+
+IRTypePtr FlatIRBuilder::getArrayType(IRTypePtr elementType, uint64_t nbElements)
+{
+    return typeTable->getArrayType(elementType, nbElements);
+}
+
+IRTypePtr FlatIRBuilder::getFunctionType(IRTypePtr returnType, const std::vector<IRTypePtr>& argsType, bool isKandR, bool hasVarArgs)
+{
+    return typeTable->getFunctionType(returnType, argsType, isKandR, hasVarArgs);
+}
+
+/**
+ * Flatten a tree in post-order.  Done with explicit stacks, as the trees can be
+ * deeper than what the native stack allows.  The subtrees shared by hash-consing
+ * are flattened once, and their node is used by all their parents.
+ */
+FlatIR::NodeIndex FlatIRBuilder::copyExpr(IRExprPtr expr)
+{
+    struct PendingNode {
+        IRExprPtr expr;
+        size_t nbOperands;      // Set once the operands are pushed
+    };
+
+    std::vector<PendingNode> pendingNodes;
+    std::vector<NodeIndex> results;
+    std::vector<IRExprPtr> operands;
+    std::unordered_map<IRExprPtr, NodeIndex> copiedNodes;
+
+    pendingNodes.push_back(PendingNode{expr, SIZE_MAX});
+    while( !pendingNodes.empty() ) {
+        PendingNode& pendingNode = pendingNodes.back();
+        IRExprPtr currExpr = pendingNode.expr;
+
+        if( currExpr == nullptr ) {
+            pendingNodes.pop_back();
+            results.push_back(FlatIR::INVALID_INDEX);
+            continue;
+        }
+
+        if( pendingNode.nbOperands == SIZE_MAX ) {
+            auto copiedNode = copiedNodes.find(currExpr);
+            if( copiedNode != copiedNodes.end() ) {
+                pendingNodes.pop_back();
+                results.push_back(copiedNode->second);
+                continue;
+            }
+
+            // First visit: flatten the operands first, left to right
+            //
+            operands.clear();
+            forEachOperand(currExpr, [&](IRExprPtr operand) { operands.push_back(operand); });
+            pendingNode.nbOperands = operands.size();
+
+            for( auto iter = operands.rbegin(); iter != operands.rend(); ++iter ) {
+                pendingNodes.push_back(PendingNode{*iter, SIZE_MAX});
+            }
+            continue;
+        }
+
+        // Second visit: the operands are at the top of the results
+        //
+        size_t nbOperands = pendingNode.nbOperands;
+        pendingNodes.pop_back();
+
+        const NodeIndex* operandIndexes = results.data() + results.size() - nbOperands;
+        NodeIndex newIndex;
+
+        switch( currExpr->getKind() ) {
+            case IRExpr::ID: {
+                const char* name = static_cast<const IRIdExpr *>(currExpr)->getName();
+                newIndex = createNameExpr(IRExpr::ID, FlatIR::INVALID_INDEX, name, name != nullptr ? strlen(name) : 0);
+                break;
+            }
+
+            case IRExpr::INT_LITERAL: {
+                const IRIntLitExpr* intLit = static_cast<const IRIntLitExpr *>(currExpr);
+                newIndex = createLiteralExpr(IRExpr::INT_LITERAL, intLit->getValue(), intLit->getType());
+                break;
+            }
+
+            case IRExpr::FLOAT_LITERAL: {
+                const IRFloatLitExpr* floatLit = static_cast<const IRFloatLitExpr *>(currExpr);
+                newIndex = createLiteralExpr(IRExpr::FLOAT_LITERAL, getFloatBits(floatLit->getValue()), floatLit->getType());
+                break;
+            }
+
+            case IRExpr::STRING_LITERAL: {
+                const IRStringLitExpr* stringLit = static_cast<const IRStringLitExpr *>(currExpr);
+                newIndex = createNameExpr(IRExpr::STRING_LITERAL, FlatIR::INVALID_INDEX, stringLit->getValue(), stringLit->getLength());
+                break;
+            }
+
+            case IRExpr::CALL:
+                newIndex = createCallExpr(operandIndexes[0], std::vector<NodeIndex>(operandIndexes + 1, operandIndexes + nbOperands));
+                break;
+
+            case IRExpr::FIELD_DIRECT_ACCESS:
+            case IRExpr::FIELD_INDIRECT_ACCESS: {
+                const char* name = static_cast<const IRFieldAccessExpr *>(currExpr)->getFieldName();
+                newIndex = createNameExpr(currExpr->getKind(), operandIndexes[0], name, name != nullptr ? strlen(name) : 0);
+                break;
+            }
+
+            case IRExpr::CHAIN: {
+                // Copied as a chain, whatever the threshold
+                //
+                unsigned savedChainThreshold = chainThreshold;
+                chainThreshold = 0;
+                newIndex = createAssociativeChain(static_cast<const IRChainExpr *>(currExpr)->getOperatorKind(),
+                    std::vector<NodeIndex>(operandIndexes, operandIndexes + nbOperands));
+                chainThreshold = savedChainThreshold;
+                break;
+            }
+
+            case IRExpr::SIZEOF_TYPE:
+                newIndex = createSizeofTypeExpr(static_cast<const IRSizeofTypeExpr *>(currExpr)->getType());
+                break;
+
+            case IRExpr::CAST:
+                newIndex = createCastExpr(static_cast<const IRCastExpr *>(currExpr)->getType(), operandIndexes[0]);
+                break;
+
+            case IRExpr::COND:
+                newIndex = createCondExpr(operandIndexes[0], operandIndexes[1], operandIndexes[2]);
+                break;
+
+            default:
+                if( IRUnaryExpr::classof(currExpr) ) {
+                    newIndex = createUnaryExpr(currExpr->getKind(), operandIndexes[0]);
+                }
+                else {
+                    newIndex = createBinaryExpr(currExpr->getKind(), operandIndexes[0], operandIndexes[1]);
+                }
+                break;
+        }
+
+        copiedNodes[currExpr] = newIndex;
+        results.resize(results.size() - nbOperands);
+        results.push_back(newIndex);
+    }
+
+    return results.back();
+}
@@ -0,0 +1,285 @@
+// FlatIR.hpp
+//
+// Author: Marco Jacques
+//
+// Flat encoding of the expressions of the intermediate representation
+//
+
+#pragma once
+
+#include "IR.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Expressions of a translation unit stored as parallel arrays (one entry per node),
+ * instead of linked nodes.  Nodes are referred to by their index, and they are in
+ * post-order: the operands of a node always come before it.  A pass that doesn't
+ * care about the tree shape just walks the arrays from begin to end.  A subtree
+ * shared in the tree is one node, operand of several nodes.
+ *
+ * What doesn't fit in the fixed arrays is in side tables, found with the data
+ * field of the node:
+ *   - ID, STRING_LITERAL, FIELD_*_ACCESS: index of the string
+ *   - INT_LITERAL, FLOAT_LITERAL: index of the value (the bits of a floating value)
+ *   - SIZEOF_TYPE, CAST: id of the type operand
+ *   - CALL: index in the extra operands, where the number of args then the args are
+ *   - CHAIN: index in the extra operands, where the operator kind, the number of
+ *     operands then the operands are
+ *   - COND: the else operand
+ */
+class FlatIR {
+public:
+    using NodeIndex = uint32_t;
+
+    static const NodeIndex INVALID_INDEX = UINT32_MAX;
+    static const uint32_t NO_TYPE = 0;
+    static const uint32_t NO_LOCATION = 0;
+
+    FlatIR();
+
+    FlatIR(const FlatIR&) = delete;
+    FlatIR& operator=(const FlatIR&) = delete;
+
+    size_t getNbNodes() const { return kinds.size(); }
+
+    IRExpr::Kind getKind(NodeIndex index) const { return static_cast<IRExpr::Kind>(kinds[index]); }
+    uint32_t getTypeId(NodeIndex index) const { return typeIds[index]; }
+    uint32_t getLocation(NodeIndex index) const { return locations[index]; }
+    NodeIndex getOperand(NodeIndex index) const { return leftOperands[index]; }
+    NodeIndex getLeftOperand(NodeIndex index) const { return leftOperands[index]; }
+    NodeIndex getRightOperand(NodeIndex index) const { return rightOperands[index]; }
+    NodeIndex getElseOperand(NodeIndex index) const { return data[index]; }
+    uint32_t getTypeOperandId(NodeIndex index) const { return data[index]; }
+
+    uint64_t getIntValue(NodeIndex index) const { return intValues[data[index]]; }
+    double getFloatValue(NodeIndex index) const;
+    const std::string& getString(NodeIndex index) const { return strings[data[index]]; }
+
+    unsigned getNbArgs(NodeIndex index) const { return extraOperands[data[index]]; }
+    NodeIndex getArg(NodeIndex index, unsigned argIndex) const { return extraOperands[data[index] + 1 + argIndex]; }
+
+    IRExpr::Kind getChainOperatorKind(NodeIndex index) const { return static_cast<IRExpr::Kind>(extraOperands[data[index]]); }
+    unsigned getNbChainOperands(NodeIndex index) const { return extraOperands[data[index] + 1]; }
+    NodeIndex getChainOperand(NodeIndex index, unsigned operandIndex) const { return extraOperands[data[index] + 2 + operandIndex]; }
+
+    /**
+     * The type ids are filled by the passes computing the types
+     */
+    void setTypeId(NodeIndex index, uint32_t typeId) { typeIds[index] = typeId; }
+
+    /**
+     * Raw arrays, for passes streaming over all the nodes
+     */
+    const uint8_t* getKinds() const { return kinds.data(); }
+    const uint32_t* getTypeIds() const { return typeIds.data(); }
+    const NodeIndex* getLeftOperands() const { return leftOperands.data(); }
+    const NodeIndex* getRightOperands() const { return rightOperands.data(); }
+
+    /**
+     * Light view of one node, for the iterators
+     */
+    class Node {
+    public:
+        Node(const FlatIR* ir_, NodeIndex index_) : ir(ir_), index(index_) { }
+
+        NodeIndex getIndex() const { return index; }
+        IRExpr::Kind getKind() const { return ir->getKind(index); }
+        uint32_t getTypeId() const { return ir->getTypeId(index); }
+        uint32_t getLocation() const { return ir->getLocation(index); }
+        NodeIndex getOperand() const { return ir->getOperand(index); }
+        NodeIndex getLeftOperand() const { return ir->getLeftOperand(index); }
+        NodeIndex getRightOperand() const { return ir->getRightOperand(index); }
+        NodeIndex getElseOperand() const { return ir->getElseOperand(index); }
+        uint32_t getTypeOperandId() const { return ir->getTypeOperandId(index); }
+        uint64_t getIntValue() const { return ir->getIntValue(index); }
+        double getFloatValue() const { return ir->getFloatValue(index); }
+        const std::string& getString() const { return ir->getString(index); }
+        unsigned getNbArgs() const { return ir->getNbArgs(index); }
+        NodeIndex getArg(unsigned argIndex) const { return ir->getArg(index, argIndex); }
+        IRExpr::Kind getChainOperatorKind() const { return ir->getChainOperatorKind(index); }
+        unsigned getNbChainOperands() const { return ir->getNbChainOperands(index); }
+        NodeIndex getChainOperand(unsigned operandIndex) const { return ir->getChainOperand(index, operandIndex); }
+
+    private:
+        const FlatIR* ir;
+        NodeIndex index;
+    };
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Node;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Node*;
+        using reference = Node;
+
+        const_iterator(const FlatIR* ir_, NodeIndex index_) : ir(ir_), index(index_) { }
+
+        Node operator*() const { return Node(ir, index); }
+        const_iterator& operator++() { ++index; return *this; }
+        const_iterator operator++(int) { const_iterator result = *this; ++index; return result; }
+
+        bool operator==(const const_iterator& other) const { return index == other.index; }
+        bool operator!=(const const_iterator& other) const { return index != other.index; }
+
+    private:
+        const FlatIR* ir;
+        NodeIndex index;
+    };
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, static_cast<NodeIndex>(getNbNodes())); }
+
+    Node getNode(NodeIndex index) const { return Node(this, index); }
+
+private:
+    friend class FlatIRBuilder;
+    friend class IRImage;
+
+    NodeIndex addNode(IRExpr::Kind kind, uint32_t typeId, NodeIndex leftOperand, NodeIndex rightOperand, uint32_t nodeData, uint32_t location);
+    uint32_t addString(const char* value, size_t length);
+
+    std::vector<uint8_t> kinds;
+    std::vector<uint32_t> typeIds;
+    std::vector<NodeIndex> leftOperands;
+    std::vector<NodeIndex> rightOperands;
+    std::vector<uint32_t> data;
+    std::vector<uint32_t> locations;
+
+    std::vector<uint64_t> intValues;
+    std::vector<std::string> strings;
+    std::vector<NodeIndex> extraOperands;
+};
+
+
+/**
+ * Creation of the nodes of a FlatIR, mostly by converting the trees built by an
+ * IRFactory with copyExpr.  The create functions mirror the ones of IRFactory,
+ * with node indexes instead of node pointers, for building nodes directly.
+ */
+class FlatIRBuilder {
+public:
+    using NodeIndex = FlatIR::NodeIndex;
+
+    FlatIRBuilder(const std::shared_ptr<FlatIR>& ir_, const std::shared_ptr<IRTypeTable>& typeTable_) :
+        ir(ir_), typeTable(typeTable_), location(FlatIR::NO_LOCATION), chainThreshold(IRFactory::DEFAULT_CHAIN_THRESHOLD) { }
+
+    const std::shared_ptr<FlatIR>& getIR() const { return ir; }
+
+    /**
+     * Location given to the nodes created from now on
+     */
+    void setLocation(uint32_t location_) { location = location_; }
+
+    void setChainThreshold(unsigned chainThreshold_) { chainThreshold = chainThreshold_; }
+
+    NodeIndex createIdExpr(const LexerTokenPtr& id);
+    NodeIndex createIntLitExpr(const LexerTokenPtr& intLiteral);
+    NodeIndex createFloatLitExpr(const LexerTokenPtr& floatLiteral);
+    NodeIndex createStringLitExpr(const LexerTokenPtr& stringLiteral);
+
+    NodeIndex createArraySubscripting(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createCallExpr(NodeIndex functor, const std::vector<NodeIndex>& args);
+    NodeIndex createStructFieldDirectAccess(NodeIndex structExpr, const LexerTokenPtr& id);
+    NodeIndex createStructFieldIndirectAccess(NodeIndex structExpr, const LexerTokenPtr& id);
+    NodeIndex createPostIncrExpr(NodeIndex expr);
+    NodeIndex createPostDecrExpr(NodeIndex expr);
+
+    NodeIndex createPreIncrExpr(NodeIndex expr);
+    NodeIndex createPreDecrExpr(NodeIndex expr);
+    NodeIndex createAddressOfExpr(NodeIndex castExpr);
+    NodeIndex createDereferenceExpr(NodeIndex castExpr);
+    NodeIndex createUnaryPlusExpr(NodeIndex castExpr);
+    NodeIndex createUnaryMinusExpr(NodeIndex castExpr);
+    NodeIndex createBitNotExpr(NodeIndex castExpr);
+    NodeIndex createBoolNotExpr(NodeIndex castExpr);
+    NodeIndex createSizeofExpr(NodeIndex unaryExpr);
+    NodeIndex createSizeofTypeExpr(IRTypePtr type);
+
+    NodeIndex createCastExpr(IRTypePtr type, NodeIndex castExpr);
+
+    NodeIndex createMulExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createDivExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createModExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+
+    NodeIndex createAddExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createSubExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+
+    NodeIndex createShiftLeftExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createShiftRightExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+
+    NodeIndex createLessThanExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createGreaterThanExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createLessEqualExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createGreaterEqualExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+
+    NodeIndex createEqualExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createNotEqualExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+
+    NodeIndex createBitAndExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createBitXorExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createBitIorExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+
+    NodeIndex createBoolAndExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createBoolOrExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+
+    NodeIndex createCondExpr(NodeIndex cond, NodeIndex thenExpr, NodeIndex elseExpr);
+
+    NodeIndex createAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createMulAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createDivAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createModAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createAddAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createSubAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createShiftLeftAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createShiftRightAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createBitAndAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createBitXorAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createBitIorAssignExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+
+    NodeIndex createCommaExpr(NodeIndex leftExpr, NodeIndex rightExpr);
+
+    NodeIndex createAssociativeChain(IRExpr::Kind operatorKind, const std::vector<NodeIndex>& operands);
+
+    IRTypePtr getCharType()          { return IRTypeTable::getCharType(); }
+    IRTypePtr getSignedCharType()    { return IRTypeTable::getSignedCharType(); }
+    IRTypePtr getUnsignedCharType()  { return IRTypeTable::getUnsignedCharType(); }
+    IRTypePtr getShortType()         { return IRTypeTable::getShortType(); }
+    IRTypePtr getUnsignedShortType() { return IRTypeTable::getUnsignedShortType(); }
+    IRTypePtr getIntType()           { return IRTypeTable::getIntType(); }
+    IRTypePtr getUnsignedType()      { return IRTypeTable::getUnsignedType(); }
+    IRTypePtr getLongType()          { return IRTypeTable::getLongType(); }
+    IRTypePtr getUnsignedLongType()  { return IRTypeTable::getUnsignedLongType(); }
+
+    IRTypePtr getVoidType()          { return IRTypeTable::getVoidType(); }
+    IRTypePtr getFloatType()         { return IRTypeTable::getFloatType(); }
+    IRTypePtr getDoubleType()        { return IRTypeTable::getDoubleType(); }
+
+    IRTypePtr getPointerType(IRTypePtr targetType);
+    IRTypePtr getArrayType(IRTypePtr elementType, uint64_t nbElements);
+    IRTypePtr getFunctionType(IRTypePtr returnType, const std::vector<IRTypePtr>& argsType, bool isKandR, bool hasVarArgs);
+
+    /**
+     * Append the flat encoding of an expression tree, and return the index of its
+     * root.  A subtree appearing several times in the tree (hash-consed) gets one
+     * node.
+     */
+    NodeIndex copyExpr(IRExprPtr expr);
+
+private:
+    NodeIndex createLiteralExpr(IRExpr::Kind kind, uint64_t value, IRTypePtr type);
+    NodeIndex createUnaryExpr(IRExpr::Kind kind, NodeIndex operand);
+    NodeIndex createBinaryExpr(IRExpr::Kind kind, NodeIndex leftExpr, NodeIndex rightExpr);
+    NodeIndex createNameExpr(IRExpr::Kind kind, NodeIndex operand, const char* name, size_t length);
+    NodeIndex createTypeExpr(IRExpr::Kind kind, IRTypePtr type, NodeIndex operand);
+
+    std::shared_ptr<FlatIR> ir;
+    std::shared_ptr<IRTypeTable> typeTable;
+    uint32_t location;
+    unsigned chainThreshold;
+};
@@ -0,0 +1,65 @@
+// Hashing.hpp
+//
+// Author: Marco Jacques
+//
+// Hashing utilities
+//
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace Hashing {
+
+    /**
+     * Final mixing of a 64 bits value, spreading all the bits (from MurmurHash3)
+     */
+    inline uint64_t mix(uint64_t value)
+    {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdULL;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ULL;
+        value ^= value >> 33;
+        return value;
+    }
+
+    /**
+     * Combine a value in a hash
+     */
+    inline uint64_t combine(uint64_t hash, uint64_t value)
+    {
+        return mix(hash ^ (value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2)));
+    }
+
+    /**
+     * Hash of a pointer
+     */
+    inline uint64_t combine(uint64_t hash, const void* ptr)
+    {
+        return combine(hash, static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ptr)));
+    }
+
+    /**
+     * Hash of a sequence of bytes, 8 bytes at a time
+     */
+    inline uint64_t hashBytes(const void* data, size_t length, uint64_t seed = 0)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char *>(data);
+        uint64_t hash = seed ^ (length * 0x9e3779b97f4a7c15ULL);
+
+        while( length >= 8 ) {
+            uint64_t word;
+            std::memcpy(&word, bytes, 8);
+            hash = mix(hash ^ word) * 0x9e3779b97f4a7c15ULL;
+            bytes += 8;
+            length -= 8;
+        }
+
+        uint64_t lastWord = 0;
+        std::memcpy(&lastWord, bytes, length);
+        return mix(hash ^ lastWord);
+    }
+}
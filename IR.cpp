@@ -0,0 +1,591 @@
+// IR.cpp
+//
+// Author: Marco Jacques
+//
+// Intermediate representation
+//
+
+#include "IR.hpp"
+#include "IRConstantFolder.hpp"
+#include "Hashing.hpp"
+#include <cstring>
+
+namespace {
+
+    bool isSameName(const char* name1, const char* name2)
+    {
+        return name1 == name2 || (name1 != nullptr && name2 != nullptr && std::strcmp(name1, name2) == 0);
+    }
+
+    uint64_t hashName(const char* name)
+    {
+        return name != nullptr ? Hashing::hashBytes(name, std::strlen(name)) : 0;
+    }
+
+    uint64_t getBits(double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    /**
+     * Compare everything but the operands, of two expressions of the same kind.
+     * Floating values are compared by their bits, so that 0.0 and -0.0 differ.
+     */
+    bool isSameData(IRExprPtr expr1, IRExprPtr expr2)
+    {
+        switch( expr1->getKind() ) {
+            case IRExpr::ID:
+                return isSameName(static_cast<const IRIdExpr *>(expr1)->getName(), static_cast<const IRIdExpr *>(expr2)->getName());
+
+            case IRExpr::INT_LITERAL: {
+                const IRIntLitExpr* intLit1 = static_cast<const IRIntLitExpr *>(expr1);
+                const IRIntLitExpr* intLit2 = static_cast<const IRIntLitExpr *>(expr2);
+                return intLit1->getValue() == intLit2->getValue() && intLit1->getType() == intLit2->getType();
+            }
+
+            case IRExpr::FLOAT_LITERAL: {
+                const IRFloatLitExpr* floatLit1 = static_cast<const IRFloatLitExpr *>(expr1);
+                const IRFloatLitExpr* floatLit2 = static_cast<const IRFloatLitExpr *>(expr2);
+                return getBits(floatLit1->getValue()) == getBits(floatLit2->getValue()) && floatLit1->getType() == floatLit2->getType();
+            }
+
+            case IRExpr::STRING_LITERAL: {
+                const IRStringLitExpr* stringLit1 = static_cast<const IRStringLitExpr *>(expr1);
+                const IRStringLitExpr* stringLit2 = static_cast<const IRStringLitExpr *>(expr2);
+                return stringLit1->getLength() == stringLit2->getLength() &&
+                    std::memcmp(stringLit1->getValue(), stringLit2->getValue(), stringLit1->getLength()) == 0;
+            }
+
+            case IRExpr::CALL:
+                return static_cast<const IRCallExpr *>(expr1)->getNbArgs() == static_cast<const IRCallExpr *>(expr2)->getNbArgs();
+
+            case IRExpr::FIELD_DIRECT_ACCESS:
+            case IRExpr::FIELD_INDIRECT_ACCESS:
+                return isSameName(static_cast<const IRFieldAccessExpr *>(expr1)->getFieldName(),
+                                  static_cast<const IRFieldAccessExpr *>(expr2)->getFieldName());
+
+            case IRExpr::SIZEOF_TYPE:
+                return static_cast<const IRSizeofTypeExpr *>(expr1)->getType() == static_cast<const IRSizeofTypeExpr *>(expr2)->getType();
+
+            case IRExpr::CAST:
+                return static_cast<const IRCastExpr *>(expr1)->getType() == static_cast<const IRCastExpr *>(expr2)->getType();
+
+            case IRExpr::CHAIN: {
+                const IRChainExpr* chain1 = static_cast<const IRChainExpr *>(expr1);
+                const IRChainExpr* chain2 = static_cast<const IRChainExpr *>(expr2);
+                return chain1->getOperatorKind() == chain2->getOperatorKind() && chain1->getNbOperands() == chain2->getNbOperands();
+            }
+
+            default:
+                return true;
+        }
+    }
+
+    /**
+     * Hash of everything but the operands
+     */
+    uint64_t hashData(IRExprPtr expr)
+    {
+        switch( expr->getKind() ) {
+            case IRExpr::ID:
+                return hashName(static_cast<const IRIdExpr *>(expr)->getName());
+
+            case IRExpr::INT_LITERAL: {
+                const IRIntLitExpr* intLit = static_cast<const IRIntLitExpr *>(expr);
+                return Hashing::combine(intLit->getValue(), static_cast<uint64_t>(intLit->getType()->getId()));
+            }
+
+            case IRExpr::FLOAT_LITERAL: {
+                const IRFloatLitExpr* floatLit = static_cast<const IRFloatLitExpr *>(expr);
+                return Hashing::combine(getBits(floatLit->getValue()), static_cast<uint64_t>(floatLit->getType()->getId()));
+            }
+
+            case IRExpr::STRING_LITERAL: {
+                const IRStringLitExpr* stringLit = static_cast<const IRStringLitExpr *>(expr);
+                return Hashing::hashBytes(stringLit->getValue(), stringLit->getLength());
+            }
+
+            case IRExpr::FIELD_DIRECT_ACCESS:
+            case IRExpr::FIELD_INDIRECT_ACCESS:
+                return hashName(static_cast<const IRFieldAccessExpr *>(expr)->getFieldName());
+
+            case IRExpr::SIZEOF_TYPE:
+                return static_cast<const IRSizeofTypeExpr *>(expr)->getType()->getId();
+
+            case IRExpr::CAST:
+                return static_cast<const IRCastExpr *>(expr)->getType()->getId();
+
+            case IRExpr::CHAIN:
+                return static_cast<const IRChainExpr *>(expr)->getOperatorKind();
+
+            default:
+                return 0;
+        }
+    }
+
+    /**
+     * Size of what a node points to in the arena: names and operand arrays
+     */
+    size_t getDataSize(const IRExpr&)
+    {
+        return 0;
+    }
+
+    size_t getDataSize(const IRIdExpr& expr)
+    {
+        return expr.getName() != nullptr ? std::strlen(expr.getName()) + 1 : 0;
+    }
+
+    size_t getDataSize(const IRStringLitExpr& expr)
+    {
+        return expr.getLength() + 1;
+    }
+
+    size_t getDataSize(const IRCallExpr& expr)
+    {
+        return expr.getNbArgs() * sizeof(IRExprPtr);
+    }
+
+    size_t getDataSize(const IRFieldAccessExpr& expr)
+    {
+        return expr.getFieldName() != nullptr ? std::strlen(expr.getFieldName()) + 1 : 0;
+    }
+
+    size_t getDataSize(const IRChainExpr& expr)
+    {
+        return expr.getNbOperands() * sizeof(IRExprPtr);
+    }
+
+    bool hasSideEffects(IRExprPtr expr)
+    {
+        switch( expr->getKind() ) {
+            case IRExpr::POST_INCR:
+            case IRExpr::POST_DECR:
+            case IRExpr::PRE_INCR:
+            case IRExpr::PRE_DECR:
+            case IRExpr::CALL:
+                return true;
+
+            default:
+                return expr->getKind() >= IRExpr::ASSIGN && expr->getKind() <= IRExpr::BIT_IOR_ASSIGN;
+        }
+    }
+}
+
+/**
+ * Structural equality, without recursion: the trees may be very deep
+ */
+bool IRExpr::isStructurallyEqual(const IRExpr* expr1, const IRExpr* expr2)
+{
+    std::vector<IRExprPtr> pending1(1, expr1);
+    std::vector<IRExprPtr> pending2(1, expr2);
+
+    while( !pending1.empty() ) {
+        IRExprPtr currExpr1 = pending1.back();
+        IRExprPtr currExpr2 = pending2.back();
+        pending1.pop_back();
+        pending2.pop_back();
+
+        if( currExpr1 == currExpr2 ) {
+            continue;
+        }
+
+        // The hashes are 0 when they were not computed
+        //
+        if( currExpr1 == nullptr || currExpr2 == nullptr || currExpr1->getKind() != currExpr2->getKind() ||
+            (currExpr1->hash != 0 && currExpr2->hash != 0 && currExpr1->hash != currExpr2->hash) ||
+            !isSameData(currExpr1, currExpr2) ) {
+            return false;
+        }
+
+        forEachOperand(currExpr1, [&](IRExprPtr operand) { pending1.push_back(operand); });
+        forEachOperand(currExpr2, [&](IRExprPtr operand) { pending2.push_back(operand); });
+    }
+
+    return true;
+}
+
+/**
+ * Every node is created here.  The flags and the hash only depend on the node
+ * data and its operands, which already have theirs.
+ *
+ * For hash-consing, the node is first built on the stack to look it up; it is
+ * copied in the arena only if it is new.  Until then, its names and operand
+ * arrays are the caller's, so that a shared node costs no allocation.  The
+ * operands are compared by pointer: the operands without side effects are
+ * already shared, and the others are never the same.
+ */
+template<typename T, typename... Args>
+IRExprPtr IRFactory::createExpr(Args&&... args)
+{
+    T expr(std::forward<Args>(args)...);
+
+    bool sideEffects = hasSideEffects(&expr);
+    forEachOperand(&expr, [&](IRExprPtr operand) { sideEffects = sideEffects || (operand != nullptr && operand->hasSideEffects()); });
+
+    expr.flags = sideEffects ? IRExpr::SIDE_EFFECTS : 0;
+    if( hashingMode == NO_HASHING ) {
+        copyData(expr);
+        return context->create<T>(expr);
+    }
+
+    uint64_t exprHash = Hashing::combine(hashData(&expr), static_cast<uint64_t>(expr.getKind()));
+    forEachOperand(&expr, [&](IRExprPtr operand) {
+        exprHash = Hashing::combine(exprHash, static_cast<uint64_t>(operand != nullptr ? operand->hash : 0));
+    });
+    expr.hash = static_cast<uint32_t>(exprHash ^ (exprHash >> 32));
+    if( hashingMode == STRUCTURAL_HASH || sideEffects ) {
+        copyData(expr);
+        return context->create<T>(expr);
+    }
+
+    std::vector<IRExprPtr> operands;
+    forEachOperand(&expr, [&](IRExprPtr operand) { operands.push_back(operand); });
+
+    auto range = hashConsingTable.equal_range(expr.hash);
+    for( auto it = range.first; it != range.second; ++it ) {
+        IRExprPtr candidate = it->second;
+        if( candidate->getKind() != expr.getKind() || !isSameData(candidate, &expr) ) {
+            continue;
+        }
+
+        size_t operandIndex = 0;
+        bool sameOperands = true;
+        forEachOperand(candidate, [&](IRExprPtr operand) { sameOperands = sameOperands && operand == operands[operandIndex++]; });
+        if( sameOperands ) {
+            ++hashConsingStatistics.nbSharedExprs;
+            hashConsingStatistics.nbBytesSaved += sizeof(T) + getDataSize(expr);
+            return candidate;
+        }
+    }
+
+    copyData(expr);
+    IRExprPtr newExpr = context->create<T>(expr);
+    hashConsingTable.emplace(expr.hash, newExpr);
+    return newExpr;
+}
+
+/**
+ * Name of an identifier token, copied in the arena with the node.  The token may
+ * be missing after a syntax error.
+ */
+const char* IRFactory::getName(const LexerTokenPtr& id)
+{
+    if( id == nullptr || id->getKind() != LexerToken::IDENTIFIER ) {
+        return nullptr;
+    }
+
+    return static_cast<const IdToken *>(id.get())->getName().c_str();
+}
+
+/**
+ * Copy in the arena what a new node points to
+ */
+void IRFactory::copyData(IRIdExpr& expr)
+{
+    if( expr.name != nullptr ) {
+        expr.name = context->getArena().copyString(expr.name, std::strlen(expr.name));
+    }
+}
+
+void IRFactory::copyData(IRStringLitExpr& expr)
+{
+    expr.value = context->getArena().copyString(expr.value, expr.length);
+}
+
+void IRFactory::copyData(IRCallExpr& expr)
+{
+    expr.args = context->getArena().copyArray(expr.args, expr.nbArgs);
+}
+
+void IRFactory::copyData(IRFieldAccessExpr& expr)
+{
+    if( expr.fieldName != nullptr ) {
+        expr.fieldName = context->getArena().copyString(expr.fieldName, std::strlen(expr.fieldName));
+    }
+}
+
+void IRFactory::copyData(IRChainExpr& expr)
+{
+    expr.operands = context->getArena().copyArray(expr.operands, expr.nbOperands);
+}
+
+IRExprPtr IRFactory::createIdExpr(const LexerTokenPtr& id)
+{
+    return createExpr<IRIdExpr>(getName(id));
+}
+
+IRExprPtr IRFactory::createIntLitExpr(const LexerTokenPtr& intLiteral)
+{
+    const IntLiteralToken* token = static_cast<const IntLiteralToken *>(intLiteral.get());
+    IRTypePtr type = IRConstantFolder::getIntLiteralType(token->getValue(), token->isUnsigned(), token->isLong(), token->isDecimal());
+    return createExpr<IRIntLitExpr>(token->getValue(), type);
+}
+
+IRExprPtr IRFactory::createFloatLitExpr(const LexerTokenPtr& floatLiteral)
+{
+    const FloatLiteralToken* token = static_cast<const FloatLiteralToken *>(floatLiteral.get());
+    return createExpr<IRFloatLitExpr>(token->getValue(), IRConstantFolder::getFloatLiteralType(token->getSuffix()));
+}
+
+/**
+ * Literal for the result of a folding
+ */
+IRExprPtr IRFactory::createConstantExpr(const IRConstant& constant)
+{
+    if( constant.isFloating() ) {
+        return createExpr<IRFloatLitExpr>(constant.floatValue, constant.type);
+    }
+
+    return createExpr<IRIntLitExpr>(constant.intValue, constant.type);
+}
+
+IRExprPtr IRFactory::createStringLitExpr(const LexerTokenPtr& stringLiteral)
+{
+    const std::string& value = static_cast<const StringLiteralToken *>(stringLiteral.get())->getValue();
+    return createExpr<IRStringLitExpr>(value.c_str(), value.length());
+}
+
+IRExprPtr IRFactory::createCallExpr(IRExprPtr functor, const std::vector<IRExprPtr>& args)
+{
+    return createExpr<IRCallExpr>(functor, args.data(), args.size());
+}
+
+IRExprPtr IRFactory::createStructFieldDirectAccess(IRExprPtr structExpr, const LexerTokenPtr& id)
+{
+    return createExpr<IRFieldAccessExpr>(IRExpr::FIELD_DIRECT_ACCESS, structExpr, getName(id));
+}
+
+IRExprPtr IRFactory::createStructFieldIndirectAccess(IRExprPtr structExpr, const LexerTokenPtr& id)
+{
+    return createExpr<IRFieldAccessExpr>(IRExpr::FIELD_INDIRECT_ACCESS, structExpr, getName(id));
+}
+
+IRExprPtr IRFactory::createUnaryExpr(IRExpr::Kind kind, IRExprPtr operand)
+{
+    IRConstant operandValue;
+    IRConstant result;
+    if( constantFolder != nullptr && IRConstant::fromExpr(operand, operandValue) &&
+        constantFolder->foldUnary(kind, operandValue, result) ) {
+        return createConstantExpr(result);
+    }
+
+    return createExpr<IRUnaryExpr>(kind, operand);
+}
+
+IRExprPtr IRFactory::createPostIncrExpr(IRExprPtr expr)         { return createUnaryExpr(IRExpr::POST_INCR, expr); }
+IRExprPtr IRFactory::createPostDecrExpr(IRExprPtr expr)         { return createUnaryExpr(IRExpr::POST_DECR, expr); }
+IRExprPtr IRFactory::createPreIncrExpr(IRExprPtr expr)          { return createUnaryExpr(IRExpr::PRE_INCR, expr); }
+IRExprPtr IRFactory::createPreDecrExpr(IRExprPtr expr)          { return createUnaryExpr(IRExpr::PRE_DECR, expr); }
+IRExprPtr IRFactory::createAddressOfExpr(IRExprPtr castExpr)    { return createUnaryExpr(IRExpr::ADDRESS_OF, castExpr); }
+IRExprPtr IRFactory::createDereferenceExpr(IRExprPtr castExpr)  { return createUnaryExpr(IRExpr::DEREFERENCE, castExpr); }
+IRExprPtr IRFactory::createUnaryPlusExpr(IRExprPtr castExpr)    { return createUnaryExpr(IRExpr::UNARY_PLUS, castExpr); }
+IRExprPtr IRFactory::createUnaryMinusExpr(IRExprPtr castExpr)   { return createUnaryExpr(IRExpr::UNARY_MINUS, castExpr); }
+IRExprPtr IRFactory::createBitNotExpr(IRExprPtr castExpr)       { return createUnaryExpr(IRExpr::BIT_NOT, castExpr); }
+IRExprPtr IRFactory::createBoolNotExpr(IRExprPtr castExpr)      { return createUnaryExpr(IRExpr::BOOL_NOT, castExpr); }
+IRExprPtr IRFactory::createSizeofExpr(IRExprPtr unaryExpr)      { return createUnaryExpr(IRExpr::SIZEOF_EXPR, unaryExpr); }
+
+IRExprPtr IRFactory::createSizeofTypeExpr(IRTypePtr type)
+{
+    return createExpr<IRSizeofTypeExpr>(type);
+}
+
+IRExprPtr IRFactory::createCastExpr(IRTypePtr type, IRExprPtr castExpr)
+{
+    IRConstant operandValue;
+    IRConstant result;
+    if( constantFolder != nullptr && IRConstant::fromExpr(castExpr, operandValue) &&
+        constantFolder->foldCast(type, operandValue, result) ) {
+        return createConstantExpr(result);
+    }
+
+    return createExpr<IRCastExpr>(type, castExpr);
+}
+
+IRExprPtr IRFactory::createBinaryExpr(IRExpr::Kind kind, IRExprPtr leftExpr, IRExprPtr rightExpr)
+{
+    IRConstant leftValue;
+    IRConstant rightValue;
+    IRConstant result;
+    if( constantFolder != nullptr && IRConstant::fromExpr(leftExpr, leftValue) && IRConstant::fromExpr(rightExpr, rightValue) &&
+        constantFolder->foldBinary(kind, leftValue, rightValue, result) ) {
+        return createConstantExpr(result);
+    }
+
+    return createExpr<IRBinaryExpr>(kind, leftExpr, rightExpr);
+}
+
+IRExprPtr IRFactory::createArraySubscripting(IRExprPtr leftExpr, IRExprPtr rightExpr)    { return createBinaryExpr(IRExpr::ARRAY_SUBSCRIPT, leftExpr, rightExpr); }
+
+IRExprPtr IRFactory::createMulExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)              { return createBinaryExpr(IRExpr::MUL, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createDivExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)              { return createBinaryExpr(IRExpr::DIV, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createModExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)              { return createBinaryExpr(IRExpr::MOD, leftExpr, rightExpr); }
+
+IRExprPtr IRFactory::createAddExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)              { return createBinaryExpr(IRExpr::ADD, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createSubExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)              { return createBinaryExpr(IRExpr::SUB, leftExpr, rightExpr); }
+
+IRExprPtr IRFactory::createShiftLeftExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)        { return createBinaryExpr(IRExpr::SHIFT_LEFT, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createShiftRightExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)       { return createBinaryExpr(IRExpr::SHIFT_RIGHT, leftExpr, rightExpr); }
+
+IRExprPtr IRFactory::createLessThanExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)         { return createBinaryExpr(IRExpr::LESS_THAN, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createGreaterThanExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)      { return createBinaryExpr(IRExpr::GREATER_THAN, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createLessEqualExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)        { return createBinaryExpr(IRExpr::LESS_EQUAL, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createGreaterEqualExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)     { return createBinaryExpr(IRExpr::GREATER_EQUAL, leftExpr, rightExpr); }
+
+IRExprPtr IRFactory::createEqualExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)            { return createBinaryExpr(IRExpr::EQUAL, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createNotEqualExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)         { return createBinaryExpr(IRExpr::NOT_EQUAL, leftExpr, rightExpr); }
+
+IRExprPtr IRFactory::createBitAndExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)           { return createBinaryExpr(IRExpr::BIT_AND, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createBitXorExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)           { return createBinaryExpr(IRExpr::BIT_XOR, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createBitIorExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)           { return createBinaryExpr(IRExpr::BIT_IOR, leftExpr, rightExpr); }
+
+IRExprPtr IRFactory::createBoolAndExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)          { return createBinaryExpr(IRExpr::BOOL_AND, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createBoolOrExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)           { return createBinaryExpr(IRExpr::BOOL_OR, leftExpr, rightExpr); }
+
+IRExprPtr IRFactory::createAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)           { return createBinaryExpr(IRExpr::ASSIGN, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createMulAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)        { return createBinaryExpr(IRExpr::MUL_ASSIGN, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createDivAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)        { return createBinaryExpr(IRExpr::DIV_ASSIGN, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createModAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)        { return createBinaryExpr(IRExpr::MOD_ASSIGN, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createAddAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)        { return createBinaryExpr(IRExpr::ADD_ASSIGN, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createSubAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)        { return createBinaryExpr(IRExpr::SUB_ASSIGN, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createShiftLeftAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)  { return createBinaryExpr(IRExpr::SHIFT_LEFT_ASSIGN, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createShiftRightAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr) { return createBinaryExpr(IRExpr::SHIFT_RIGHT_ASSIGN, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createBitAndAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)     { return createBinaryExpr(IRExpr::BIT_AND_ASSIGN, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createBitXorAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)     { return createBinaryExpr(IRExpr::BIT_XOR_ASSIGN, leftExpr, rightExpr); }
+IRExprPtr IRFactory::createBitIorAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)     { return createBinaryExpr(IRExpr::BIT_IOR_ASSIGN, leftExpr, rightExpr); }
+
+IRExprPtr IRFactory::createCommaExpr(IRExprPtr leftExpr, IRExprPtr rightExpr)            { return createBinaryExpr(IRExpr::COMMA, leftExpr, rightExpr); }
+
+IRExprPtr IRFactory::createCondExpr(IRExprPtr cond, IRExprPtr thenExpr, IRExprPtr elseExpr)
+{
+    IRConstant condValue;
+    IRConstant thenValue;
+    IRConstant elseValue;
+    IRConstant result;
+    if( constantFolder != nullptr && IRConstant::fromExpr(cond, condValue) &&
+        IRConstant::fromExpr(thenExpr, thenValue) && IRConstant::fromExpr(elseExpr, elseValue) &&
+        constantFolder->foldCond(condValue, thenValue, elseValue, result) ) {
+        return createConstantExpr(result);
+    }
+
+    return createExpr<IRCondExpr>(cond, thenExpr, elseExpr);
+}
+
+const unsigned IRFactory::DEFAULT_CHAIN_THRESHOLD;
+
+IRExprPtr IRFactory::createAssociativeChain(IRExpr::Kind operatorKind, const std::vector<IRExprPtr>& operands)
+{
+    if( operands.size() < chainThreshold ) {
+        IRExprPtr currExpr = operands[0];
+        for( size_t i = 1; i < operands.size(); ++i ) {
+            currExpr = createBinaryExpr(operatorKind, currExpr, operands[i]);
+        }
+        return currExpr;
+    }
+
+    // Fold the constant prefix, as the binary tree would
+    //
+    std::vector<IRExprPtr> chainOperands(1, operands[0]);
+    size_t i = 1;
+    IRConstant leftConstant, rightConstant;
+    while( constantFolder != nullptr && i < operands.size() &&
+           IRConstant::fromExpr(chainOperands[0], leftConstant) && IRConstant::fromExpr(operands[i], rightConstant) ) {
+        chainOperands[0] = createBinaryExpr(operatorKind, chainOperands[0], operands[i++]);
+    }
+    chainOperands.insert(chainOperands.end(), operands.begin() + i, operands.end());
+
+    if( chainOperands.size() == 1 ) {
+        return chainOperands[0];
+    }
+
+    return createExpr<IRChainExpr>(operatorKind, chainOperands.data(), chainOperands.size());
+}
+
+/**
+ * Binary view
+ */
+IRExprView::IRExprView(IRExprPtr expr_) :
+    expr(expr_),
+    nbOperands(expr_ != nullptr && IRChainExpr::classof(expr_) ? static_cast<const IRChainExpr *>(expr_)->getNbOperands() : 0)
+{
+}
+
+IRExpr::Kind IRExprView::getKind() const
+{
+    if( nbOperands != 0 ) {
+        return static_cast<const IRChainExpr *>(expr)->getOperatorKind();
+    }
+
+    return expr->getKind();
+}
+
+bool IRExprView::isBinary() const
+{
+    return nbOperands != 0 || IRBinaryExpr::classof(expr);
+}
+
+IRExprPtr IRExprView::getExpr() const
+{
+    if( nbOperands != 0 && nbOperands != static_cast<const IRChainExpr *>(expr)->getNbOperands() ) {
+        return nullptr;
+    }
+
+    return expr;
+}
+
+IRExprView IRExprView::getLeftExpr() const
+{
+    if( nbOperands == 0 ) {
+        return IRExprView(static_cast<const IRBinaryExpr *>(expr)->getLeftExpr());
+    }
+
+    const IRChainExpr* chain = static_cast<const IRChainExpr *>(expr);
+    if( nbOperands == 2 ) {
+        return IRExprView(chain->getOperand(0));
+    }
+
+    return IRExprView(chain, nbOperands - 1);
+}
+
+IRExprView IRExprView::getRightExpr() const
+{
+    if( nbOperands == 0 ) {
+        return IRExprView(static_cast<const IRBinaryExpr *>(expr)->getRightExpr());
+    }
+
+    return IRExprView(static_cast<const IRChainExpr *>(expr)->getOperand(nbOperands - 1));
+}
+
+/**
+ * Types
+ */
+IRTypePtr IRFactory::getCharType()          { return IRTypeTable::getBuiltinType(IRType::CHAR); }
+IRTypePtr IRFactory::getSignedCharType()    { return IRTypeTable::getBuiltinType(IRType::SIGNED_CHAR); }
+IRTypePtr IRFactory::getUnsignedCharType()  { return IRTypeTable::getBuiltinType(IRType::UNSIGNED_CHAR); }
+IRTypePtr IRFactory::getShortType()         { return IRTypeTable::getBuiltinType(IRType::SHORT); }
+IRTypePtr IRFactory::getUnsignedShortType() { return IRTypeTable::getBuiltinType(IRType::UNSIGNED_SHORT); }
+IRTypePtr IRFactory::getIntType()           { return IRTypeTable::getBuiltinType(IRType::INT); }
+IRTypePtr IRFactory::getUnsignedType()      { return IRTypeTable::getBuiltinType(IRType::UNSIGNED); }
+IRTypePtr IRFactory::getLongType()          { return IRTypeTable::getBuiltinType(IRType::LONG); }
+IRTypePtr IRFactory::getUnsignedLongType()  { return IRTypeTable::getBuiltinType(IRType::UNSIGNED_LONG); }
+IRTypePtr IRFactory::getVoidType()          { return IRTypeTable::getBuiltinType(IRType::VOID); }
+IRTypePtr IRFactory::getFloatType()         { return IRTypeTable::getBuiltinType(IRType::FLOAT); }
+IRTypePtr IRFactory::getDoubleType()        { return IRTypeTable::getBuiltinType(IRType::DOUBLE); }
+IRTypePtr IRFactory::getLongDoubleType()    { return IRTypeTable::getBuiltinType(IRType::LONG_DOUBLE); }
+
+IRTypePtr IRFactory::getPointerType(IRTypePtr targetType)
+{
+    return context->getTypeTable()->getPointerType(targetType);
+}
+
+IRTypePtr IRFactory::getArrayType(IRTypePtr elementType, uint64_t nbElements)
+{
+    return context->getTypeTable()->getArrayType(elementType, nbElements);
+}
+
+IRTypePtr IRFactory::getFunctionType(IRTypePtr returnType, const std::vector<IRTypePtr>& argsType, bool isKandR, bool hasVarArgs)
+{
+    return context->getTypeTable()->getFunctionType(returnType, argsType, isKandR, hasVarArgs);
+}
@@ -7,88 +7,574 @@
 
 #pragma once
 
+#include "Arena.hpp"
+#include "IRType.hpp"
 #include "LexerToken.hpp"
+#include <memory>
+#include <unordered_map>
 #include <vector>
 
-class IRType {
+/**
+ * Expressions.  The kinds are grouped by node class.
+ */
+class IRExpr {
 public:
-    virtual ~IRType() = 0;
+    enum Kind {
+        ID,
+        INT_LITERAL,
+        FLOAT_LITERAL,
+        STRING_LITERAL,
+
+        CALL,
+        FIELD_DIRECT_ACCESS, FIELD_INDIRECT_ACCESS,
+
+        /* unary expressions */
+        POST_INCR, POST_DECR,
+        PRE_INCR, PRE_DECR,
+        ADDRESS_OF, DEREFERENCE,
+        UNARY_PLUS, UNARY_MINUS,
+        BIT_NOT, BOOL_NOT,
+        SIZEOF_EXPR,
+
+        SIZEOF_TYPE,
+        CAST,
+
+        /* binary expressions */
+        ARRAY_SUBSCRIPT,
+        MUL, DIV, MOD,
+        ADD, SUB,
+        SHIFT_LEFT, SHIFT_RIGHT,
+        LESS_THAN, GREATER_THAN, LESS_EQUAL, GREATER_EQUAL,
+        EQUAL, NOT_EQUAL,
+        BIT_AND, BIT_XOR, BIT_IOR,
+        BOOL_AND, BOOL_OR,
+        ASSIGN,
+        MUL_ASSIGN, DIV_ASSIGN, MOD_ASSIGN, ADD_ASSIGN, SUB_ASSIGN,
+        SHIFT_LEFT_ASSIGN, SHIFT_RIGHT_ASSIGN,
+        BIT_AND_ASSIGN, BIT_XOR_ASSIGN, BIT_IOR_ASSIGN,
+        COMMA,
+
+        COND,
+
+        CHAIN,
+
+        NB_KINDS,
+
+        FIRST_UNARY = POST_INCR, LAST_UNARY = SIZEOF_EXPR,
+        FIRST_BINARY = ARRAY_SUBSCRIPT, LAST_BINARY = COMMA
+    };
+
+    Kind getKind() const { return static_cast<Kind>(kind); }
+
+    /**
+     * Structural hash, computed from the kind, the data and the hashes of the
+     * operands.  It is only set when the factory computes the hashes, else it is 0.
+     */
+    uint32_t getHash() const { return hash; }
+
+    /**
+     * The expression, or one of its operands, is an assignment, an increment or
+     * decrement, or a call
+     */
+    bool hasSideEffects() const { return (flags & SIDE_EFFECTS) != 0; }
+
+    /**
+     * Same tree, compared node by node
+     */
+    static bool isStructurallyEqual(const IRExpr* expr1, const IRExpr* expr2);
+
+protected:
+    IRExpr(Kind kind_) : kind(kind_), flags(0), hash(0) { }
+    IRExpr(const IRExpr&) = default;
+
+    // Not virtual: the nodes live in the IRContext arena and are never destroyed
+    // one by one.  The passes dispatch on the kind (see IRVisitor.hpp).
+    //
+    ~IRExpr() = default;
+
+private:
+    friend class IRFactory;
+
+    enum Flags {
+        SIDE_EFFECTS = 1
+    };
+
+    // Packed in 8 bytes: the hash costs no memory
+    //
+    uint16_t kind;
+    uint16_t flags;
+    uint32_t hash;
 };
 
-class IRExpr {
+using IRExprPtr = const IRExpr*;
+
+class IRIdExpr : public IRExpr {
+public:
+    IRIdExpr(const char* name_) : IRExpr(ID), name(name_) { }
+
+    const char* getName() const { return name; }
+
+    static bool classof(const IRExpr* expr) { return expr->getKind() == ID; }
+
+private:
+    friend class IRFactory;
+
+    const char* name;
+};
+
+class IRIntLitExpr : public IRExpr {
+public:
+    IRIntLitExpr(uint64_t value_, IRTypePtr type_) : IRExpr(INT_LITERAL), value(value_), type(type_) { }
+
+    uint64_t getValue() const { return value; }
+    IRTypePtr getType() const { return type; }
+
+    static bool classof(const IRExpr* expr) { return expr->getKind() == INT_LITERAL; }
+
+private:
+    uint64_t value;
+    IRTypePtr type;
+};
+
+class IRFloatLitExpr : public IRExpr {
+public:
+    IRFloatLitExpr(double value_, IRTypePtr type_) : IRExpr(FLOAT_LITERAL), value(value_), type(type_) { }
+
+    double getValue() const { return value; }
+    IRTypePtr getType() const { return type; }
+
+    static bool classof(const IRExpr* expr) { return expr->getKind() == FLOAT_LITERAL; }
+
+private:
+    double value;
+    IRTypePtr type;
+};
+
+class IRStringLitExpr : public IRExpr {
+public:
+    IRStringLitExpr(const char* value_, size_t length_) : IRExpr(STRING_LITERAL), value(value_), length(length_) { }
+
+    const char* getValue() const { return value; }
+    size_t getLength() const { return length; }
+
+    static bool classof(const IRExpr* expr) { return expr->getKind() == STRING_LITERAL; }
+
+private:
+    friend class IRFactory;
+
+    const char* value;
+    size_t length;
+};
+
+class IRCallExpr : public IRExpr {
+public:
+    IRCallExpr(IRExprPtr functor_, const IRExprPtr* args_, unsigned nbArgs_) :
+        IRExpr(CALL), functor(functor_), args(args_), nbArgs(nbArgs_) { }
+
+    IRExprPtr getFunctor() const { return functor; }
+    unsigned getNbArgs() const { return nbArgs; }
+    IRExprPtr getArg(unsigned index) const { return args[index]; }
+
+    static bool classof(const IRExpr* expr) { return expr->getKind() == CALL; }
+
+private:
+    friend class IRFactory;
+
+    IRExprPtr functor;
+    const IRExprPtr* args;
+    unsigned nbArgs;
+};
+
+class IRFieldAccessExpr : public IRExpr {
+public:
+    IRFieldAccessExpr(Kind kind_, IRExprPtr structExpr_, const char* fieldName_) :
+        IRExpr(kind_), structExpr(structExpr_), fieldName(fieldName_) { }
+
+    IRExprPtr getStructExpr() const { return structExpr; }
+    const char* getFieldName() const { return fieldName; }
+
+    static bool classof(const IRExpr* expr)
+    {
+        return expr->getKind() == FIELD_DIRECT_ACCESS || expr->getKind() == FIELD_INDIRECT_ACCESS;
+    }
+
+private:
+    friend class IRFactory;
+
+    IRExprPtr structExpr;
+    const char* fieldName;
+};
+
+class IRUnaryExpr : public IRExpr {
+public:
+    IRUnaryExpr(Kind kind_, IRExprPtr operand_) : IRExpr(kind_), operand(operand_) { }
+
+    IRExprPtr getOperand() const { return operand; }
+
+    static bool classof(const IRExpr* expr)
+    {
+        return expr->getKind() >= FIRST_UNARY && expr->getKind() <= LAST_UNARY;
+    }
+
+private:
+    IRExprPtr operand;
+};
+
+class IRSizeofTypeExpr : public IRExpr {
+public:
+    IRSizeofTypeExpr(IRTypePtr type_) : IRExpr(SIZEOF_TYPE), type(type_) { }
+
+    IRTypePtr getType() const { return type; }
+
+    static bool classof(const IRExpr* expr) { return expr->getKind() == SIZEOF_TYPE; }
+
+private:
+    IRTypePtr type;
+};
+
+class IRCastExpr : public IRExpr {
+public:
+    IRCastExpr(IRTypePtr type_, IRExprPtr operand_) : IRExpr(CAST), type(type_), operand(operand_) { }
+
+    IRTypePtr getType() const { return type; }
+    IRExprPtr getOperand() const { return operand; }
+
+    static bool classof(const IRExpr* expr) { return expr->getKind() == CAST; }
+
+private:
+    IRTypePtr type;
+    IRExprPtr operand;
+};
+
+class IRBinaryExpr : public IRExpr {
+public:
+    IRBinaryExpr(Kind kind_, IRExprPtr leftExpr_, IRExprPtr rightExpr_) :
+        IRExpr(kind_), leftExpr(leftExpr_), rightExpr(rightExpr_) { }
+
+    IRExprPtr getLeftExpr() const { return leftExpr; }
+    IRExprPtr getRightExpr() const { return rightExpr; }
+
+    static bool classof(const IRExpr* expr)
+    {
+        return expr->getKind() >= FIRST_BINARY && expr->getKind() <= LAST_BINARY;
+    }
+
+private:
+    IRExprPtr leftExpr;
+    IRExprPtr rightExpr;
+};
+
+class IRCondExpr : public IRExpr {
+public:
+    IRCondExpr(IRExprPtr cond_, IRExprPtr thenExpr_, IRExprPtr elseExpr_) :
+        IRExpr(COND), cond(cond_), thenExpr(thenExpr_), elseExpr(elseExpr_) { }
+
+    IRExprPtr getCond() const { return cond; }
+    IRExprPtr getThenExpr() const { return thenExpr; }
+    IRExprPtr getElseExpr() const { return elseExpr; }
+
+    static bool classof(const IRExpr* expr) { return expr->getKind() == COND; }
+
+private:
+    IRExprPtr cond;
+    IRExprPtr thenExpr;
+    IRExprPtr elseExpr;
+};
+
+
+/**
+ * Chain of one associative operator: a + b + c + ... is one node, instead of a
+ * left-leaning tree of binary nodes as deep as the number of operands.  It means
+ * the same as the tree (((a + b) + c) + ...).
+ */
+class IRChainExpr : public IRExpr {
 public:
-    virtual ~IRExpr() = 0;    
+    IRChainExpr(Kind operatorKind_, const IRExprPtr* operands_, unsigned nbOperands_) :
+        IRExpr(CHAIN), operatorKind(operatorKind_), operands(operands_), nbOperands(nbOperands_) { }
+
+    Kind getOperatorKind() const { return operatorKind; }
+    unsigned getNbOperands() const { return nbOperands; }
+    IRExprPtr getOperand(unsigned index) const { return operands[index]; }
+
+    /**
+     * Operators that can be chained
+     */
+    static bool isChainable(Kind kind)
+    {
+        return kind == MUL || kind == ADD || kind == BIT_AND || kind == BIT_XOR || kind == BIT_IOR ||
+            kind == BOOL_AND || kind == BOOL_OR || kind == COMMA;
+    }
+
+    static bool classof(const IRExpr* expr) { return expr->getKind() == CHAIN; }
+
+private:
+    friend class IRFactory;
+
+    Kind operatorKind;
+    const IRExprPtr* operands;
+    unsigned nbOperands;
 };
 
-using IRExprPtr = std::shared_ptr<IRExpr>;
-using IRTypePtr = std::shared_ptr<IRType>;
+/**
+ * Call a function on each operand of an expression, left to right
+ */
+template<typename Func>
+void forEachOperand(IRExprPtr expr, Func func)
+{
+    switch( expr->getKind() ) {
+        case IRExpr::ID:
+        case IRExpr::INT_LITERAL:
+        case IRExpr::FLOAT_LITERAL:
+        case IRExpr::STRING_LITERAL:
+        case IRExpr::SIZEOF_TYPE:
+            break;
+
+        case IRExpr::CALL: {
+            const IRCallExpr* call = static_cast<const IRCallExpr *>(expr);
+            func(call->getFunctor());
+            for( unsigned i = 0; i < call->getNbArgs(); ++i ) {
+                func(call->getArg(i));
+            }
+            break;
+        }
+
+        case IRExpr::FIELD_DIRECT_ACCESS:
+        case IRExpr::FIELD_INDIRECT_ACCESS:
+            func(static_cast<const IRFieldAccessExpr *>(expr)->getStructExpr());
+            break;
+
+        case IRExpr::CAST:
+            func(static_cast<const IRCastExpr *>(expr)->getOperand());
+            break;
+
+        case IRExpr::COND: {
+            const IRCondExpr* cond = static_cast<const IRCondExpr *>(expr);
+            func(cond->getCond());
+            func(cond->getThenExpr());
+            func(cond->getElseExpr());
+            break;
+        }
+
+        case IRExpr::CHAIN: {
+            const IRChainExpr* chain = static_cast<const IRChainExpr *>(expr);
+            for( unsigned i = 0; i < chain->getNbOperands(); ++i ) {
+                func(chain->getOperand(i));
+            }
+            break;
+        }
+
+        default:
+            if( IRUnaryExpr::classof(expr) ) {
+                func(static_cast<const IRUnaryExpr *>(expr)->getOperand());
+            }
+            else {
+                const IRBinaryExpr* binary = static_cast<const IRBinaryExpr *>(expr);
+                func(binary->getLeftExpr());
+                func(binary->getRightExpr());
+            }
+            break;
+    }
+}
+
+/**
+ * Binary view of an expression, for the passes that only know the binary operators.
+ * A chain of n operands is seen as its operator applied to the chain of its first
+ * n - 1 operands and its last operand.  These partial chains are not nodes, only
+ * views.
+ */
+class IRExprView {
+public:
+    IRExprView(IRExprPtr expr_);
+
+    IRExpr::Kind getKind() const;
+    bool isBinary() const;
+
+    /**
+     * The viewed node, or nullptr for a partial chain
+     */
+    IRExprPtr getExpr() const;
+
+    /**
+     * Operands of a binary view
+     */
+    IRExprView getLeftExpr() const;
+    IRExprView getRightExpr() const;
+
+private:
+    IRExprView(const IRChainExpr* chain, unsigned nbOperands_) : expr(chain), nbOperands(nbOperands_) { }
+
+    IRExprPtr expr;
+    unsigned nbOperands;        // Chains: number of operands in the view
+};
+
+
+/**
+ * Owner of the IR of a translation unit.  All the nodes are allocated in its arena
+ * and referenced by raw pointers; they are freed all at once with the context.
+ *
+ * The types are in a type table, which can be shared by several contexts so
+ * that the types of all the translation units are uniqued together.
+ */
+class IRContext {
+public:
+    IRContext() : arena(), nbNodes(0), typeTable(std::make_shared<IRTypeTable>()) { }
+    IRContext(const std::shared_ptr<IRTypeTable>& typeTable_) : arena(), nbNodes(0), typeTable(typeTable_) { }
+
+    IRContext(const IRContext&) = delete;
+    IRContext& operator=(const IRContext&) = delete;
+
+    /**
+     * Create a node in the arena
+     */
+    template<typename T, typename... Args>
+    T* create(Args&&... args)
+    {
+        ++nbNodes;
+        return arena.create<T>(std::forward<Args>(args)...);
+    }
+
+    Arena& getArena() { return arena; }
+    const std::shared_ptr<IRTypeTable>& getTypeTable() const { return typeTable; }
+
+    /**
+     * Statistics
+     */
+    size_t getNbNodes() const { return nbNodes; }
+    size_t getBytesAllocated() const { return arena.getBytesAllocated(); }
+
+private:
+    Arena arena;
+    size_t nbNodes;
+    std::shared_ptr<IRTypeTable> typeTable;
+};
+
+
+class IRConstantFolder;
+struct IRConstant;
+
+/**
+ * Creation of the IR nodes, in an IRContext.
+ *
+ * With a constant folder, the operators on constant operands are evaluated as
+ * the nodes are created, and give a literal instead of a tree.
+ *
+ * The factory can also compute the structural hash of the nodes as they are
+ * created.  With hash-consing, creating an expression without side effects that
+ * is the same as an existing one returns the existing node: the IR is then a DAG,
+ * and the repeated subexpressions are shared.
+ */
+class IRFactory {
+public:
+    using ExprPtr = IRExprPtr;
+
+    enum HashingMode {
+        NO_HASHING,
+        STRUCTURAL_HASH,
+        HASH_CONSING
+    };
+
+    struct HashConsingStatistics {
+        size_t nbSharedExprs;       // Creations that returned an existing node
+        size_t nbBytesSaved;        // Size of the nodes not allocated, with their names and operand arrays
+    };
+
+    IRFactory(const std::shared_ptr<IRContext>& context_) :
+        context(context_), constantFolder(nullptr), chainThreshold(DEFAULT_CHAIN_THRESHOLD),
+        hashingMode(NO_HASHING), hashConsingStatistics{0, 0} { }
+
+    const std::shared_ptr<IRContext>& getContext() const { return context; }
+
+    void setConstantFolder(const std::shared_ptr<IRConstantFolder>& constantFolder_) { constantFolder = constantFolder_; }
+    const std::shared_ptr<IRConstantFolder>& getConstantFolder() const { return constantFolder; }
+
+    /**
+     * Chains of an associative operator with at least this number of operands are
+     * created as IRChainExpr nodes, shorter ones as binary nodes
+     */
+    static const unsigned DEFAULT_CHAIN_THRESHOLD = 16;
+
+    void setChainThreshold(unsigned chainThreshold_) { chainThreshold = chainThreshold_; }
+    unsigned getChainThreshold() const { return chainThreshold; }
+
+    /**
+     * Must be set before creating the nodes
+     */
+    void setHashingMode(HashingMode hashingMode_) { hashingMode = hashingMode_; }
+    HashingMode getHashingMode() const { return hashingMode; }
+
+    const HashConsingStatistics& getHashConsingStatistics() const { return hashConsingStatistics; }
 
-namespace IRFactory {
     IRExprPtr createIdExpr(const LexerTokenPtr& id);
     IRExprPtr createIntLitExpr(const LexerTokenPtr& intLiteral);
+    IRExprPtr createFloatLitExpr(const LexerTokenPtr& floatLiteral);
     IRExprPtr createStringLitExpr(const LexerTokenPtr& stringLiteral);
- 
-    IRExprPtr createArraySubscripting(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createCallExpr(const IRExprPtr& functor, const std::vector<IRExprPtr>& args);
-    IRExprPtr createStructFieldDirectAccess(const IRExprPtr& structExpr, const LexerTokenPtr& id);
-    IRExprPtr createStructFieldIndirectAccess(const IRExprPtr& structExpr, const LexerTokenPtr& id);
-    IRExprPtr createPostIncrExpr(const IRExprPtr& expr);
-    IRExprPtr createPostDecrExpr(const IRExprPtr& expr);
-
-    IRExprPtr createPreIncrExpr(const IRExprPtr& expr);
-    IRExprPtr createPreDecrExpr(const IRExprPtr& expr);
-    IRExprPtr createAddressOfExpr(const IRExprPtr& castExpr);
-    IRExprPtr createDereferenceExpr(const IRExprPtr& castExpr);
-    IRExprPtr createUnaryPlusExpr(const IRExprPtr& castExpr);
-    IRExprPtr createUnaryMinusExpr(const IRExprPtr& castExpr);
-    IRExprPtr createBitNotExpr(const IRExprPtr& castExpr);
-    IRExprPtr createBoolNotExpr(const IRExprPtr& castExpr);
-    IRExprPtr createSizeofExpr(const IRExprPtr& unaryExpr);
-    IRExprPtr createSizeofTypeExpr(const IRTypePtr& type);
-
-    IRExprPtr createCastExpr(const IRTypePtr& type, const IRExprPtr& castExpr);
-
-    IRExprPtr createMulExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createDivExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createModExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-
-    IRExprPtr createAddExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createSubExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-
-    IRExprPtr createShiftLeftExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createShiftRightExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-
-    IRExprPtr createLessThanExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createGreaterThanExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createLessEqualExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createGreaterEqualExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-
-    IRExprPtr createEqualExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createNotEqualExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-
-    IRExprPtr createBitAndExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createBitXorExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createBitIorExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-
-    IRExprPtr createBoolAndExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createBoolOrExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-
-    IRExprPtr createCondExpr(const IRExprPtr& cond, const IRExprPtr& thenExpr, const IRExprPtr& elseExpr);
-    
-    IRExprPtr createAssignExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createMulAssignExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createDivAssignExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createModAssignExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createAddAssignExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createSubAssignExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createShiftLeftAssignExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createShiftRightAssignExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createBitAndAssignExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createBitXorAssignExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    IRExprPtr createBitIorAssignExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    
-    IRExprPtr createCommaExpr(const IRExprPtr& leftExpr, const IRExprPtr& rightExpr);
-    
+
+    IRExprPtr createArraySubscripting(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createCallExpr(IRExprPtr functor, const std::vector<IRExprPtr>& args);
+    IRExprPtr createStructFieldDirectAccess(IRExprPtr structExpr, const LexerTokenPtr& id);
+    IRExprPtr createStructFieldIndirectAccess(IRExprPtr structExpr, const LexerTokenPtr& id);
+    IRExprPtr createPostIncrExpr(IRExprPtr expr);
+    IRExprPtr createPostDecrExpr(IRExprPtr expr);
+
+    IRExprPtr createPreIncrExpr(IRExprPtr expr);
+    IRExprPtr createPreDecrExpr(IRExprPtr expr);
+    IRExprPtr createAddressOfExpr(IRExprPtr castExpr);
+    IRExprPtr createDereferenceExpr(IRExprPtr castExpr);
+    IRExprPtr createUnaryPlusExpr(IRExprPtr castExpr);
+    IRExprPtr createUnaryMinusExpr(IRExprPtr castExpr);
+    IRExprPtr createBitNotExpr(IRExprPtr castExpr);
+    IRExprPtr createBoolNotExpr(IRExprPtr castExpr);
+    IRExprPtr createSizeofExpr(IRExprPtr unaryExpr);
+    IRExprPtr createSizeofTypeExpr(IRTypePtr type);
+
+    IRExprPtr createCastExpr(IRTypePtr type, IRExprPtr castExpr);
+
+    IRExprPtr createMulExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createDivExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createModExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+
+    IRExprPtr createAddExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createSubExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+
+    IRExprPtr createShiftLeftExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createShiftRightExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+
+    IRExprPtr createLessThanExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createGreaterThanExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createLessEqualExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createGreaterEqualExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+
+    IRExprPtr createEqualExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createNotEqualExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+
+    IRExprPtr createBitAndExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createBitXorExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createBitIorExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+
+    IRExprPtr createBoolAndExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createBoolOrExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+
+    IRExprPtr createCondExpr(IRExprPtr cond, IRExprPtr thenExpr, IRExprPtr elseExpr);
+
+    IRExprPtr createAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createMulAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createDivAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createModAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createAddAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createSubAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createShiftLeftAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createShiftRightAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createBitAndAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createBitXorAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createBitIorAssignExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+
+    IRExprPtr createCommaExpr(IRExprPtr leftExpr, IRExprPtr rightExpr);
+
+    /**
+     * Left associative chain op1 op op2 op ... opN of a chainable operator
+     */
+    IRExprPtr createAssociativeChain(IRExpr::Kind operatorKind, const std::vector<IRExprPtr>& operands);
+
     IRTypePtr getCharType();
     IRTypePtr getSignedCharType();
     IRTypePtr getUnsignedCharType();
@@ -98,12 +584,37 @@ namespace IRFactory {
     IRTypePtr getUnsignedType();
     IRTypePtr getLongType();
     IRTypePtr getUnsignedLongType();
-    
+
     IRTypePtr getVoidType();
     IRTypePtr getFloatType();
     IRTypePtr getDoubleType();
+    IRTypePtr getLongDoubleType();
+
+    IRTypePtr getPointerType(IRTypePtr targetType);
+    IRTypePtr getArrayType(IRTypePtr elementType, uint64_t nbElements);
+    IRTypePtr getFunctionType(IRTypePtr returnType, const std::vector<IRTypePtr>& argsType, bool isKandR, bool hasVarArgs);
+
+private:
+    IRExprPtr createUnaryExpr(IRExpr::Kind kind, IRExprPtr operand);
+    IRExprPtr createBinaryExpr(IRExpr::Kind kind, IRExprPtr leftExpr, IRExprPtr rightExpr);
+    IRExprPtr createConstantExpr(const IRConstant& constant);
+    const char* getName(const LexerTokenPtr& id);
 
-    IRTypePtr getPointerType(const IRTypePtr& targetType);
-    IRTypePtr getArrayType(const IRTypePtr& elementType, uint64_t nbElements);
-    IRTypePtr getFunctionType(const IRTypePtr& returnType, const std::vector<IRTypePtr>& argsType, bool isKandR, bool hasVarArgs);
-}
\ No newline at end of file
+    template<typename T, typename... Args>
+    IRExprPtr createExpr(Args&&... args);
+
+    void copyData(IRExpr&) { }
+    void copyData(IRIdExpr& expr);
+    void copyData(IRStringLitExpr& expr);
+    void copyData(IRCallExpr& expr);
+    void copyData(IRFieldAccessExpr& expr);
+    void copyData(IRChainExpr& expr);
+
+    std::shared_ptr<IRContext> context;
+    std::shared_ptr<IRConstantFolder> constantFolder;
+    unsigned chainThreshold;
+
+    HashingMode hashingMode;
+    std::unordered_multimap<uint32_t, IRExprPtr> hashConsingTable;
+    HashConsingStatistics hashConsingStatistics;
+};
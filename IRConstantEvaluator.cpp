@@ -0,0 +1,428 @@
+// IRConstantEvaluator.cpp
+//
+// Author: Marco Jacques
+//
+// Evaluation of the integer constant expressions
+//
+
+#include "IRConstantEvaluator.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+    bool isIntegerType(IRTypePtr type)
+    {
+        return type->getKind() >= IRType::CHAR && type->getKind() <= IRType::UNSIGNED_LONG;
+    }
+
+    /**
+     * Operators evaluated from the values of both operands
+     */
+    bool isArithmeticOperator(IRExpr::Kind kind)
+    {
+        return kind >= IRExpr::MUL && kind <= IRExpr::BIT_IOR;
+    }
+
+    IRConstant makeIntConstant(IRTypePtr type, uint64_t value)
+    {
+        IRConstant constant;
+        constant.type = type;
+        constant.intValue = value;
+
+        return constant;
+    }
+}
+
+/**
+ * Constructor
+ */
+IRConstantEvaluator::IRConstantEvaluator(
+    const std::shared_ptr<SymbolTable>& symbolTable_,
+    const std::shared_ptr<IRLayoutEngine>& layoutEngine_
+    ) :
+    symbolTable(symbolTable_),
+    layoutEngine(layoutEngine_),
+    folder(),
+    cache(),
+    stack(),
+    nbEvaluatedExprs(0)
+{
+    // Nothing else to do
+}
+
+/**
+ * Cached result of a node, nullptr if there is none or if it is stale
+ */
+const IRConstantEvaluator::Entry* IRConstantEvaluator::findValidEntry(IRExprPtr expr) const
+{
+    auto found = cache.find(expr);
+    if( found == cache.end() ) {
+        return nullptr;
+    }
+
+    const Entry& entry = found->second;
+    switch( entry.validity ) {
+        case ALWAYS:            return &entry;
+        case SAME_GENERATION:   return entry.generation == symbolTable->getGeneration() ? &entry : nullptr;
+        default:                return nullptr;
+    }
+}
+
+/**
+ * Evaluate the nodes in post order, with an explicit stack.  A node is evaluated
+ * once the operands it needs have a valid result in the cache.
+ */
+IRConstantEvaluator::Result IRConstantEvaluator::evaluate(IRExprPtr expr)
+{
+    const Entry* entry = findValidEntry(expr);
+    if( entry != nullptr ) {
+        return entry->result;
+    }
+
+    stack.push_back(Frame{expr, 0});
+    while( !stack.empty() ) {
+        Frame& frame = stack.back();
+        IRExprPtr operand = getNextOperand(frame);
+        if( operand != nullptr ) {
+            ++frame.nbEvaluated;
+            if( findValidEntry(operand) == nullptr ) {
+                stack.push_back(Frame{operand, 0});
+            }
+            continue;
+        }
+
+        Frame evaluatedFrame = frame;
+        stack.pop_back();
+        cache[evaluatedFrame.expr] = evaluateNode(evaluatedFrame);
+        ++nbEvaluatedExprs;
+    }
+
+    return getEntry(expr).result;
+}
+
+/**
+ * Next operand of a node to evaluate, nullptr once the operands needed are
+ * evaluated.  An operand that is not constant ends the evaluation of the node,
+ * except for the operands of ?: that are not selected.
+ */
+IRExprPtr IRConstantEvaluator::getNextOperand(const Frame& frame) const
+{
+    IRExprPtr expr = frame.expr;
+    unsigned index = frame.nbEvaluated;
+    IRExpr::Kind kind = expr->getKind();
+
+    switch( kind ) {
+        case IRExpr::UNARY_PLUS:
+        case IRExpr::UNARY_MINUS:
+        case IRExpr::BIT_NOT:
+        case IRExpr::BOOL_NOT:
+            return index == 0 ? static_cast<const IRUnaryExpr *>(expr)->getOperand() : nullptr;
+
+        case IRExpr::CAST: {
+            // A floating constant may be the operand of a cast: it is converted directly
+            //
+            IRExprPtr operand = static_cast<const IRCastExpr *>(expr)->getOperand();
+            return index == 0 && operand->getKind() != IRExpr::FLOAT_LITERAL ? operand : nullptr;
+        }
+
+        case IRExpr::BOOL_AND:
+        case IRExpr::BOOL_OR: {
+            const IRBinaryExpr* binary = static_cast<const IRBinaryExpr *>(expr);
+            if( index == 0 ) {
+                return binary->getLeftExpr();
+            }
+
+            // The right operand is only evaluated if the left one doesn't decide
+            //
+            const Result& left = getEntry(binary->getLeftExpr()).result;
+            if( index == 1 && left.status == CONSTANT && (left.value.intValue != 0) == (kind == IRExpr::BOOL_AND) ) {
+                return binary->getRightExpr();
+            }
+            return nullptr;
+        }
+
+        case IRExpr::COND: {
+            const IRCondExpr* cond = static_cast<const IRCondExpr *>(expr);
+            switch( index ) {
+                case 0:     return cond->getCond();
+                case 1:     return getEntry(cond->getCond()).result.status == CONSTANT ? cond->getThenExpr() : nullptr;
+                case 2:     return cond->getElseExpr();
+                default:    return nullptr;
+            }
+        }
+
+        case IRExpr::CHAIN: {
+            const IRChainExpr* chain = static_cast<const IRChainExpr *>(expr);
+            IRExpr::Kind operatorKind = chain->getOperatorKind();
+            if( operatorKind == IRExpr::COMMA || index == chain->getNbOperands() ) {
+                return nullptr;
+            }
+            if( index == 0 ) {
+                return chain->getOperand(0);
+            }
+
+            const Result& previous = getEntry(chain->getOperand(index - 1)).result;
+            if( previous.status != CONSTANT ) {
+                return nullptr;
+            }
+            if( operatorKind == IRExpr::BOOL_AND && previous.value.intValue == 0 ) {
+                return nullptr;
+            }
+            if( operatorKind == IRExpr::BOOL_OR && previous.value.intValue != 0 ) {
+                return nullptr;
+            }
+            return chain->getOperand(index);
+        }
+
+        default:
+            if( isArithmeticOperator(kind) ) {
+                const IRBinaryExpr* binary = static_cast<const IRBinaryExpr *>(expr);
+                if( index == 0 ) {
+                    return binary->getLeftExpr();
+                }
+                if( index == 1 && getEntry(binary->getLeftExpr()).result.status == CONSTANT ) {
+                    return binary->getRightExpr();
+                }
+            }
+            return nullptr;
+    }
+}
+
+/**
+ * Evaluate a node from the results of its operands
+ */
+IRConstantEvaluator::Entry IRConstantEvaluator::evaluateNode(const Frame& frame)
+{
+    IRExprPtr expr = frame.expr;
+    IRExpr::Kind kind = expr->getKind();
+    Entry entry{Result{CONSTANT, IRConstant(), nullptr}, ALWAYS, symbolTable->getGeneration()};
+
+    // Result of an operand, which the node result depends on
+    //
+    auto getOperandResult = [&](IRExprPtr operand) -> const Result& {
+        const Entry& operandEntry = getEntry(operand);
+        entry.validity = std::max(entry.validity, operandEntry.validity);
+        return operandEntry.result;
+    };
+    auto setStatus = [&](Status status, IRExprPtr culprit) -> Entry {
+        entry.result.status = status;
+        entry.result.culprit = culprit;
+        return entry;
+    };
+    auto setResult = [&](const Result& result) -> Entry {
+        entry.result = result;
+        return entry;
+    };
+
+    switch( kind ) {
+        case IRExpr::ID:
+        case IRExpr::INT_LITERAL:
+        case IRExpr::FLOAT_LITERAL:
+        case IRExpr::SIZEOF_TYPE:
+        case IRExpr::SIZEOF_EXPR:
+            return evaluateLeaf(expr);
+
+        case IRExpr::UNARY_PLUS:
+        case IRExpr::UNARY_MINUS:
+        case IRExpr::BIT_NOT:
+        case IRExpr::BOOL_NOT: {
+            const Result& operand = getOperandResult(static_cast<const IRUnaryExpr *>(expr)->getOperand());
+            if( operand.status != CONSTANT ) {
+                return setResult(operand);
+            }
+
+            return folder.foldUnary(kind, operand.value, entry.result.value) ? entry : setStatus(UNDEFINED, expr);
+        }
+
+        case IRExpr::CAST: {
+            const IRCastExpr* cast = static_cast<const IRCastExpr *>(expr);
+            if( !isIntegerType(cast->getType()) ) {
+                return setStatus(NOT_INTEGER, expr);
+            }
+
+            IRConstant operandValue;
+            if( !IRConstant::fromExpr(cast->getOperand(), operandValue) ) {
+                const Result& operand = getOperandResult(cast->getOperand());
+                if( operand.status != CONSTANT ) {
+                    return setResult(operand);
+                }
+                operandValue = operand.value;
+            }
+
+            return folder.foldCast(cast->getType(), operandValue, entry.result.value) ? entry : setStatus(UNDEFINED, expr);
+        }
+
+        case IRExpr::BOOL_AND:
+        case IRExpr::BOOL_OR: {
+            const IRBinaryExpr* binary = static_cast<const IRBinaryExpr *>(expr);
+            const Result& left = getOperandResult(binary->getLeftExpr());
+            if( left.status != CONSTANT ) {
+                return setResult(left);
+            }
+
+            if( frame.nbEvaluated == 1 ) {
+                entry.result.value = makeIntConstant(IRTypeTable::getIntType(), kind == IRExpr::BOOL_OR ? 1 : 0);
+                return entry;
+            }
+
+            const Result& right = getOperandResult(binary->getRightExpr());
+            if( right.status != CONSTANT ) {
+                return setResult(right);
+            }
+
+            folder.foldBinary(kind, left.value, right.value, entry.result.value);
+            return entry;
+        }
+
+        case IRExpr::COND: {
+            const IRCondExpr* condExpr = static_cast<const IRCondExpr *>(expr);
+            const Result& cond = getOperandResult(condExpr->getCond());
+            if( cond.status != CONSTANT ) {
+                return setResult(cond);
+            }
+
+            const Result& thenResult = getOperandResult(condExpr->getThenExpr());
+            const Result& elseResult = getOperandResult(condExpr->getElseExpr());
+            const Result& selected = cond.value.intValue != 0 ? thenResult : elseResult;
+            if( selected.status != CONSTANT ) {
+                return setResult(selected);
+            }
+
+            // The type is the common type of both operands: without the other
+            // operand, only the promotions are applied
+            //
+            if( thenResult.status == CONSTANT && elseResult.status == CONSTANT ) {
+                folder.foldCond(cond.value, thenResult.value, elseResult.value, entry.result.value);
+            }
+            else {
+                folder.foldUnary(IRExpr::UNARY_PLUS, selected.value, entry.result.value);
+            }
+            return entry;
+        }
+
+        case IRExpr::CHAIN: {
+            const IRChainExpr* chain = static_cast<const IRChainExpr *>(expr);
+            if( chain->getOperatorKind() == IRExpr::COMMA ) {
+                return setStatus(NOT_CONSTANT, expr);
+            }
+
+            IRConstant value;
+            for( unsigned i = 0; i < frame.nbEvaluated; ++i ) {
+                const Result& operand = getOperandResult(chain->getOperand(i));
+                if( operand.status != CONSTANT ) {
+                    return setResult(operand);
+                }
+
+                if( i == 0 ) {
+                    value = operand.value;
+                }
+                else if( !folder.foldBinary(chain->getOperatorKind(), value, operand.value, value) ) {
+                    return setStatus(UNDEFINED, expr);
+                }
+            }
+
+            // A short-circuited logical operator gives 0 or 1, like the complete one
+            //
+            if( chain->getOperatorKind() == IRExpr::BOOL_AND || chain->getOperatorKind() == IRExpr::BOOL_OR ) {
+                value = makeIntConstant(IRTypeTable::getIntType(), value.intValue != 0 ? 1 : 0);
+            }
+
+            entry.result.value = value;
+            return entry;
+        }
+
+        default:
+            break;
+    }
+
+    if( !isArithmeticOperator(kind) ) {
+        return setStatus(NOT_CONSTANT, expr);
+    }
+
+    const IRBinaryExpr* binary = static_cast<const IRBinaryExpr *>(expr);
+    const Result& left = getOperandResult(binary->getLeftExpr());
+    if( left.status != CONSTANT ) {
+        return setResult(left);
+    }
+
+    const Result& right = getOperandResult(binary->getRightExpr());
+    if( right.status != CONSTANT ) {
+        return setResult(right);
+    }
+
+    return folder.foldBinary(kind, left.value, right.value, entry.result.value) ? entry : setStatus(UNDEFINED, expr);
+}
+
+/**
+ * Evaluate a node without operands to evaluate
+ */
+IRConstantEvaluator::Entry IRConstantEvaluator::evaluateLeaf(IRExprPtr expr)
+{
+    Entry entry{Result{CONSTANT, IRConstant(), nullptr}, ALWAYS, symbolTable->getGeneration()};
+
+    switch( expr->getKind() ) {
+        case IRExpr::INT_LITERAL:
+            IRConstant::fromExpr(expr, entry.result.value);
+            return entry;
+
+        case IRExpr::FLOAT_LITERAL:
+            entry.result = Result{NOT_INTEGER, IRConstant(), expr};
+            return entry;
+
+        case IRExpr::ID: {
+            // The value depends on the visible declarations
+            //
+            entry.validity = SAME_GENERATION;
+
+            const char* name = static_cast<const IRIdExpr *>(expr)->getName();
+            const Identifier* identifier = symbolTable->findIdentifier(name, std::strlen(name));
+            const Symbol* symbol = identifier != nullptr ? symbolTable->lookup(identifier) : nullptr;
+            if( symbol == nullptr || symbol->getKind() != Symbol::ENUM_CONSTANT ) {
+                entry.result = Result{NOT_ENUM_CONSTANT, IRConstant(), expr};
+                return entry;
+            }
+
+            entry.result.value = makeIntConstant(IRTypeTable::getIntType(), static_cast<uint64_t>(symbol->getValue()));
+            return entry;
+        }
+
+        case IRExpr::SIZEOF_TYPE:
+            return evaluateSizeof(expr, static_cast<const IRSizeofTypeExpr *>(expr)->getType());
+
+        case IRExpr::SIZEOF_EXPR: {
+            // Only the literals have a type in the IR
+            //
+            IRConstant operand;
+            if( !IRConstant::fromExpr(static_cast<const IRUnaryExpr *>(expr)->getOperand(), operand) ) {
+                entry.result = Result{UNKNOWN_TYPE, IRConstant(), expr};
+                return entry;
+            }
+
+            return evaluateSizeof(expr, operand.type);
+        }
+
+        default:
+            entry.result = Result{NOT_CONSTANT, IRConstant(), expr};
+            return entry;
+    }
+}
+
+/**
+ * sizeof gives a size_t, which is unsigned long.  An incomplete type may be
+ * completed later: its result is not kept.
+ */
+IRConstantEvaluator::Entry IRConstantEvaluator::evaluateSizeof(IRExprPtr expr, IRTypePtr type)
+{
+    Entry entry{Result{CONSTANT, IRConstant(), nullptr}, ALWAYS, symbolTable->getGeneration()};
+
+    uint64_t size = layoutEngine->getSize(type);
+    if( size == 0 ) {
+        entry.result = Result{INCOMPLETE_TYPE, IRConstant(), expr};
+        entry.validity = NEVER;
+        return entry;
+    }
+
+    entry.result.value = makeIntConstant(IRTypeTable::getUnsignedLongType(), size);
+    return entry;
+}
@@ -0,0 +1,112 @@
+// IRConstantEvaluator.hpp
+//
+// Author: Marco Jacques
+//
+// Evaluation of the integer constant expressions
+//
+
+#pragma once
+
+#include "IR.hpp"
+#include "IRConstantFolder.hpp"
+#include "IRLayout.hpp"
+#include "SymbolTable.hpp"
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Evaluation of the integer constant expressions (C90 6.4): array bounds, enum
+ * values, case labels, bit-field widths, #if.  The operators are evaluated by
+ * IRConstantFolder, with its promotion and conversion rules.
+ *
+ * Results are cached per node, so an expression shared by hash-consing is only
+ * evaluated once; the nodes must outlive the evaluator.  A result that depends
+ * on identifiers is only valid until the declarations change
+ * (SymbolTable::getGeneration()); a result depending on an incomplete type is
+ * not kept.  Enumerators defined in terms of the previous ones cost one symbol
+ * lookup per reference: evaluating them is linear.
+ *
+ * The operands that are not evaluated (right of a decided && or ||) are not
+ * checked.  The evaluation uses an explicit stack, so deep expressions don't
+ * overflow the call stack.
+ */
+class IRConstantEvaluator {
+public:
+    enum Status {
+        CONSTANT,
+        NOT_CONSTANT,           // Operator not allowed: assignment, call, comma, ++, &, [], ...
+        NOT_INTEGER,            // Floating operand that is not the immediate operand of a cast
+        NOT_ENUM_CONSTANT,      // Identifier that is not an enumeration constant
+        UNKNOWN_TYPE,           // sizeof of an expression of unknown type
+        INCOMPLETE_TYPE,        // sizeof of a type without a size
+        UNDEFINED               // Division by zero, overflow, too large shift
+    };
+
+    struct Result {
+        Status status;
+        IRConstant value;       // When the status is CONSTANT
+        IRExprPtr culprit;      // Else, the sub-expression that is not constant
+    };
+
+    /**
+     * Constructor
+     */
+    IRConstantEvaluator(
+        const std::shared_ptr<SymbolTable>& symbolTable_,
+        const std::shared_ptr<IRLayoutEngine>& layoutEngine_
+        );
+
+    IRConstantEvaluator(const IRConstantEvaluator&) = delete;
+    IRConstantEvaluator& operator=(const IRConstantEvaluator&) = delete;
+
+    /**
+     * Evaluate an integer constant expression
+     */
+    Result evaluate(IRExprPtr expr);
+
+    /**
+     * Number of nodes evaluated, not taken from the cache
+     */
+    size_t getNbEvaluatedExprs() const { return nbEvaluatedExprs; }
+
+private:
+    /**
+     * How long a result stays valid
+     */
+    enum Validity {
+        ALWAYS,
+        SAME_GENERATION,
+        NEVER
+    };
+
+    struct Entry {
+        Result result;
+        Validity validity;
+        uint64_t generation;
+    };
+
+    /**
+     * Node being evaluated, and how many of its operands were evaluated
+     */
+    struct Frame {
+        IRExprPtr expr;
+        unsigned nbEvaluated;
+    };
+
+    const Entry* findValidEntry(IRExprPtr expr) const;
+    const Entry& getEntry(IRExprPtr expr) const { return cache.find(expr)->second; }
+
+    IRExprPtr getNextOperand(const Frame& frame) const;
+    Entry evaluateNode(const Frame& frame);
+    Entry evaluateLeaf(IRExprPtr expr);
+    Entry evaluateSizeof(IRExprPtr expr, IRTypePtr type);
+
+    std::shared_ptr<SymbolTable> symbolTable;
+    std::shared_ptr<IRLayoutEngine> layoutEngine;
+    IRConstantFolder folder;
+
+    std::unordered_map<IRExprPtr, Entry> cache;
+    std::vector<Frame> stack;
+    size_t nbEvaluatedExprs;
+};
@@ -0,0 +1,530 @@
+// IRConstantFolder.cpp
+//
+// Author: Marco Jacques
+//
+// Folding of the constant expressions, while the IR is built
+//
+
+#include "IRConstantFolder.hpp"
+#include <cmath>
+
+namespace {
+
+    bool isIntegerKind(IRType::Kind kind)
+    {
+        return kind >= IRType::CHAR && kind <= IRType::UNSIGNED_LONG;
+    }
+
+    /**
+     * Long double is not folded: its values don't fit in the double of a constant
+     */
+    bool isArithmeticKind(IRType::Kind kind)
+    {
+        return isIntegerKind(kind) || kind == IRType::FLOAT || kind == IRType::DOUBLE;
+    }
+
+    bool isSignedKind(IRType::Kind kind)
+    {
+        return kind == IRType::CHAR || kind == IRType::SIGNED_CHAR || kind == IRType::SHORT ||
+            kind == IRType::INT || kind == IRType::LONG;
+    }
+
+    unsigned getWidth(IRType::Kind kind)
+    {
+        switch( kind ) {
+            case IRType::CHAR:
+            case IRType::SIGNED_CHAR:
+            case IRType::UNSIGNED_CHAR:
+                return 8;
+
+            case IRType::SHORT:
+            case IRType::UNSIGNED_SHORT:
+                return 16;
+
+            case IRType::INT:
+            case IRType::UNSIGNED:
+                return 32;
+
+            default:
+                return 64;
+        }
+    }
+
+    /**
+     * Integral promotions: all the values of char and short fit in an int
+     */
+    IRType::Kind promote(IRType::Kind kind)
+    {
+        return kind < IRType::INT ? IRType::INT : kind;
+    }
+
+    /**
+     * Usual arithmetic conversions.  A long can represent all the values of an
+     * unsigned int, so long with unsigned int gives long.
+     */
+    IRType::Kind getCommonKind(IRType::Kind kind1, IRType::Kind kind2)
+    {
+        if( kind1 == IRType::DOUBLE || kind2 == IRType::DOUBLE ) {
+            return IRType::DOUBLE;
+        }
+
+        if( kind1 == IRType::FLOAT || kind2 == IRType::FLOAT ) {
+            return IRType::FLOAT;
+        }
+
+        kind1 = promote(kind1);
+        kind2 = promote(kind2);
+        if( kind1 == IRType::UNSIGNED_LONG || kind2 == IRType::UNSIGNED_LONG ) {
+            return IRType::UNSIGNED_LONG;
+        }
+        if( kind1 == IRType::LONG || kind2 == IRType::LONG ) {
+            return IRType::LONG;
+        }
+        if( kind1 == IRType::UNSIGNED || kind2 == IRType::UNSIGNED ) {
+            return IRType::UNSIGNED;
+        }
+
+        return IRType::INT;
+    }
+
+    /**
+     * Truncate a value to the width of its type, and sign extend it
+     */
+    uint64_t normalize(uint64_t value, IRType::Kind kind)
+    {
+        unsigned width = getWidth(kind);
+        if( width == 64 ) {
+            return value;
+        }
+
+        value &= (UINT64_C(1) << width) - 1;
+        if( isSignedKind(kind) && (value >> (width - 1)) != 0 ) {
+            value |= ~UINT64_C(0) << width;
+        }
+
+        return value;
+    }
+
+    bool fitsIn(int64_t value, IRType::Kind kind)
+    {
+        unsigned width = getWidth(kind);
+        if( width == 64 ) {
+            return true;
+        }
+
+        int64_t limit = INT64_C(1) << (width - 1);
+        return value >= -limit && value < limit;
+    }
+
+    IRConstant makeInt(IRType::Kind kind, uint64_t value)
+    {
+        IRConstant result;
+        result.type = IRTypeTable::getBuiltinType(kind);
+        result.intValue = normalize(value, kind);
+
+        return result;
+    }
+
+    IRConstant makeFloat(IRType::Kind kind, double value)
+    {
+        IRConstant result;
+        result.type = IRTypeTable::getBuiltinType(kind);
+        result.floatValue = kind == IRType::FLOAT ? static_cast<float>(value) : value;
+
+        return result;
+    }
+
+    bool isTrue(const IRConstant& constant)
+    {
+        return constant.isFloating() ? constant.floatValue != 0.0 : constant.intValue != 0;
+    }
+
+    /**
+     * Convert a constant to an arithmetic type.  Fails if a floating value doesn't
+     * fit in the integer type.
+     */
+    bool convert(const IRConstant& operand, IRType::Kind kind, IRConstant& result)
+    {
+        if( !isIntegerKind(kind) ) {
+            double value = operand.isFloating() ? operand.floatValue :
+                isSignedKind(operand.type->getKind()) ? static_cast<double>(operand.getSignedValue()) : static_cast<double>(operand.intValue);
+            result = makeFloat(kind, value);
+            return true;
+        }
+
+        if( !operand.isFloating() ) {
+            result = makeInt(kind, operand.intValue);
+            return true;
+        }
+
+        double value = std::trunc(operand.floatValue);
+        unsigned width = getWidth(kind);
+        if( isSignedKind(kind) ) {
+            double limit = std::ldexp(1.0, width - 1);
+            if( !(value >= -limit && value < limit) ) {
+                return false;
+            }
+            result = makeInt(kind, static_cast<uint64_t>(static_cast<int64_t>(value)));
+        }
+        else {
+            if( !(value >= 0.0 && value < std::ldexp(1.0, width)) ) {
+                return false;
+            }
+            result = makeInt(kind, static_cast<uint64_t>(value));
+        }
+
+        return true;
+    }
+
+    bool foldFloating(IRExpr::Kind kind, IRType::Kind resultKind, double left, double right, IRConstant& result)
+    {
+        switch( kind ) {
+            case IRExpr::MUL:           result = makeFloat(resultKind, left * right); return true;
+            case IRExpr::ADD:           result = makeFloat(resultKind, left + right); return true;
+            case IRExpr::SUB:           result = makeFloat(resultKind, left - right); return true;
+            case IRExpr::LESS_THAN:     result = makeInt(IRType::INT, left < right); return true;
+            case IRExpr::GREATER_THAN:  result = makeInt(IRType::INT, left > right); return true;
+            case IRExpr::LESS_EQUAL:    result = makeInt(IRType::INT, left <= right); return true;
+            case IRExpr::GREATER_EQUAL: result = makeInt(IRType::INT, left >= right); return true;
+            case IRExpr::EQUAL:         result = makeInt(IRType::INT, left == right); return true;
+            case IRExpr::NOT_EQUAL:     result = makeInt(IRType::INT, left != right); return true;
+
+            case IRExpr::DIV:
+                if( right == 0.0 ) {
+                    return false;
+                }
+                result = makeFloat(resultKind, left / right);
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    bool foldSigned(IRExpr::Kind kind, IRType::Kind resultKind, int64_t left, int64_t right, IRConstant& result)
+    {
+        int64_t value;
+        switch( kind ) {
+            case IRExpr::MUL:
+                if( __builtin_mul_overflow(left, right, &value) ) {
+                    return false;
+                }
+                break;
+
+            case IRExpr::ADD:
+                if( __builtin_add_overflow(left, right, &value) ) {
+                    return false;
+                }
+                break;
+
+            case IRExpr::SUB:
+                if( __builtin_sub_overflow(left, right, &value) ) {
+                    return false;
+                }
+                break;
+
+            case IRExpr::DIV:
+            case IRExpr::MOD:
+                if( right == 0 || (left == INT64_MIN && right == -1) ) {
+                    return false;
+                }
+                value = kind == IRExpr::DIV ? left / right : left % right;
+                break;
+
+            case IRExpr::LESS_THAN:     result = makeInt(IRType::INT, left < right); return true;
+            case IRExpr::GREATER_THAN:  result = makeInt(IRType::INT, left > right); return true;
+            case IRExpr::LESS_EQUAL:    result = makeInt(IRType::INT, left <= right); return true;
+            case IRExpr::GREATER_EQUAL: result = makeInt(IRType::INT, left >= right); return true;
+            case IRExpr::EQUAL:         result = makeInt(IRType::INT, left == right); return true;
+            case IRExpr::NOT_EQUAL:     result = makeInt(IRType::INT, left != right); return true;
+
+            case IRExpr::BIT_AND:       value = left & right; break;
+            case IRExpr::BIT_XOR:       value = left ^ right; break;
+            case IRExpr::BIT_IOR:       value = left | right; break;
+
+            default:
+                return false;
+        }
+
+        if( !fitsIn(value, resultKind) ) {
+            return false;
+        }
+
+        result = makeInt(resultKind, static_cast<uint64_t>(value));
+        return true;
+    }
+
+    bool foldUnsigned(IRExpr::Kind kind, IRType::Kind resultKind, uint64_t left, uint64_t right, IRConstant& result)
+    {
+        switch( kind ) {
+            case IRExpr::MUL:           result = makeInt(resultKind, left * right); return true;
+            case IRExpr::ADD:           result = makeInt(resultKind, left + right); return true;
+            case IRExpr::SUB:           result = makeInt(resultKind, left - right); return true;
+            case IRExpr::LESS_THAN:     result = makeInt(IRType::INT, left < right); return true;
+            case IRExpr::GREATER_THAN:  result = makeInt(IRType::INT, left > right); return true;
+            case IRExpr::LESS_EQUAL:    result = makeInt(IRType::INT, left <= right); return true;
+            case IRExpr::GREATER_EQUAL: result = makeInt(IRType::INT, left >= right); return true;
+            case IRExpr::EQUAL:         result = makeInt(IRType::INT, left == right); return true;
+            case IRExpr::NOT_EQUAL:     result = makeInt(IRType::INT, left != right); return true;
+            case IRExpr::BIT_AND:       result = makeInt(resultKind, left & right); return true;
+            case IRExpr::BIT_XOR:       result = makeInt(resultKind, left ^ right); return true;
+            case IRExpr::BIT_IOR:       result = makeInt(resultKind, left | right); return true;
+
+            case IRExpr::DIV:
+            case IRExpr::MOD:
+                if( right == 0 ) {
+                    return false;
+                }
+                result = makeInt(resultKind, kind == IRExpr::DIV ? left / right : left % right);
+                return true;
+
+            default:
+                return false;
+        }
+    }
+
+    bool foldShift(IRExpr::Kind kind, const IRConstant& leftOperand, const IRConstant& rightOperand, IRConstant& result)
+    {
+        IRType::Kind resultKind = promote(leftOperand.type->getKind());
+        IRType::Kind countKind = promote(rightOperand.type->getKind());
+        unsigned width = getWidth(resultKind);
+
+        if( isSignedKind(countKind) && rightOperand.getSignedValue() < 0 ) {
+            return false;
+        }
+        if( rightOperand.intValue >= width ) {
+            return false;
+        }
+
+        unsigned shiftCount = static_cast<unsigned>(rightOperand.intValue);
+        if( !isSignedKind(resultKind) ) {
+            uint64_t value = normalize(leftOperand.intValue, resultKind);
+            result = makeInt(resultKind, kind == IRExpr::SHIFT_LEFT ? value << shiftCount : value >> shiftCount);
+            return true;
+        }
+
+        int64_t value = leftOperand.getSignedValue();
+        if( kind == IRExpr::SHIFT_RIGHT ) {
+            result = makeInt(resultKind, static_cast<uint64_t>(value >> shiftCount));
+            return true;
+        }
+
+        // Left shift of a signed value: the result must be representable
+        //
+        if( value < 0 || (static_cast<uint64_t>(value) >> (width - 1 - shiftCount)) != 0 ) {
+            return false;
+        }
+
+        result = makeInt(resultKind, static_cast<uint64_t>(value) << shiftCount);
+        return true;
+    }
+}
+
+bool IRConstant::isInteger() const
+{
+    return isIntegerKind(type->getKind());
+}
+
+bool IRConstant::fromExpr(IRExprPtr expr, IRConstant& constant)
+{
+    if( expr == nullptr ) {
+        return false;
+    }
+
+    switch( expr->getKind() ) {
+        case IRExpr::INT_LITERAL: {
+            const IRIntLitExpr* intLit = static_cast<const IRIntLitExpr *>(expr);
+            constant.type = intLit->getType();
+            constant.intValue = intLit->getValue();
+            return true;
+        }
+
+        case IRExpr::FLOAT_LITERAL: {
+            // Long double literals are left unfolded
+            //
+            const IRFloatLitExpr* floatLit = static_cast<const IRFloatLitExpr *>(expr);
+            if( !isArithmeticKind(floatLit->getType()->getKind()) ) {
+                return false;
+            }
+
+            constant.type = floatLit->getType();
+            constant.floatValue = floatLit->getValue();
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+/**
+ * Count a folding attempt on constant operands
+ */
+bool IRConstantFolder::count(bool isFolded)
+{
+    if( isFolded ) {
+        ++statistics.nbFoldedExprs;
+    }
+    else {
+        ++statistics.nbUnfoldedExprs;
+    }
+
+    return isFolded;
+}
+
+bool IRConstantFolder::foldUnary(IRExpr::Kind kind, const IRConstant& operand, IRConstant& result)
+{
+    IRType::Kind operandKind = operand.type->getKind();
+
+    switch( kind ) {
+        case IRExpr::UNARY_PLUS:
+            return count(convert(operand, promote(operandKind), result));
+
+        case IRExpr::UNARY_MINUS: {
+            if( operand.isFloating() ) {
+                result = makeFloat(operandKind, -operand.floatValue);
+                return count(true);
+            }
+
+            IRType::Kind resultKind = promote(operandKind);
+            if( !isSignedKind(resultKind) ) {
+                result = makeInt(resultKind, 0 - normalize(operand.intValue, resultKind));
+                return count(true);
+            }
+
+            int64_t value = operand.getSignedValue();
+            if( value == INT64_MIN || !fitsIn(-value, resultKind) ) {
+                return count(false);
+            }
+
+            result = makeInt(resultKind, static_cast<uint64_t>(-value));
+            return count(true);
+        }
+
+        case IRExpr::BIT_NOT:
+            if( !operand.isInteger() ) {
+                return false;
+            }
+            result = makeInt(promote(operandKind), ~operand.intValue);
+            return count(true);
+
+        case IRExpr::BOOL_NOT:
+            result = makeInt(IRType::INT, !isTrue(operand));
+            return count(true);
+
+        default:
+            return false;
+    }
+}
+
+bool IRConstantFolder::foldBinary(IRExpr::Kind kind, const IRConstant& leftOperand, const IRConstant& rightOperand, IRConstant& result)
+{
+    switch( kind ) {
+        case IRExpr::SHIFT_LEFT:
+        case IRExpr::SHIFT_RIGHT:
+            if( !leftOperand.isInteger() || !rightOperand.isInteger() ) {
+                return false;
+            }
+            return count(foldShift(kind, leftOperand, rightOperand, result));
+
+        case IRExpr::BOOL_AND:
+            result = makeInt(IRType::INT, isTrue(leftOperand) && isTrue(rightOperand));
+            return count(true);
+
+        case IRExpr::BOOL_OR:
+            result = makeInt(IRType::INT, isTrue(leftOperand) || isTrue(rightOperand));
+            return count(true);
+
+        case IRExpr::MOD:
+        case IRExpr::BIT_AND:
+        case IRExpr::BIT_XOR:
+        case IRExpr::BIT_IOR:
+            if( !leftOperand.isInteger() || !rightOperand.isInteger() ) {
+                return false;
+            }
+            break;
+
+        case IRExpr::MUL:
+        case IRExpr::DIV:
+        case IRExpr::ADD:
+        case IRExpr::SUB:
+        case IRExpr::LESS_THAN:
+        case IRExpr::GREATER_THAN:
+        case IRExpr::LESS_EQUAL:
+        case IRExpr::GREATER_EQUAL:
+        case IRExpr::EQUAL:
+        case IRExpr::NOT_EQUAL:
+            break;
+
+        default:
+            return false;
+    }
+
+    IRType::Kind commonKind = getCommonKind(leftOperand.type->getKind(), rightOperand.type->getKind());
+    IRConstant left;
+    IRConstant right;
+    convert(leftOperand, commonKind, left);
+    convert(rightOperand, commonKind, right);
+
+    if( left.isFloating() ) {
+        return count(foldFloating(kind, commonKind, left.floatValue, right.floatValue, result));
+    }
+    else if( isSignedKind(commonKind) ) {
+        return count(foldSigned(kind, commonKind, left.getSignedValue(), right.getSignedValue(), result));
+    }
+    else {
+        return count(foldUnsigned(kind, commonKind, left.intValue, right.intValue, result));
+    }
+}
+
+bool IRConstantFolder::foldCast(IRTypePtr type, const IRConstant& operand, IRConstant& result)
+{
+    if( type == nullptr || !isArithmeticKind(type->getKind()) ) {
+        return false;
+    }
+
+    return count(convert(operand, type->getKind(), result));
+}
+
+bool IRConstantFolder::foldCond(const IRConstant& cond, const IRConstant& thenOperand, const IRConstant& elseOperand, IRConstant& result)
+{
+    IRType::Kind commonKind = getCommonKind(thenOperand.type->getKind(), elseOperand.type->getKind());
+    return count(convert(isTrue(cond) ? thenOperand : elseOperand, commonKind, result));
+}
+
+/**
+ * The type of an integer constant is the first of its list that can represent
+ * its value:
+ *   - decimal, no suffix: int, long, unsigned long
+ *   - octal or hexadecimal, no suffix: int, unsigned, long, unsigned long
+ *   - suffix u: unsigned, unsigned long
+ *   - suffix l: long, unsigned long
+ *   - suffixes u and l: unsigned long
+ */
+IRTypePtr IRConstantFolder::getIntLiteralType(uint64_t value, bool isUnsigned, bool isLong, bool isDecimal)
+{
+    if( !isUnsigned && !isLong && value <= INT32_MAX ) {
+        return IRTypeTable::getIntType();
+    }
+    if( !isLong && (isUnsigned || !isDecimal) && value <= UINT32_MAX ) {
+        return IRTypeTable::getUnsignedType();
+    }
+    if( !isUnsigned && value <= INT64_MAX ) {
+        return IRTypeTable::getLongType();
+    }
+
+    return IRTypeTable::getUnsignedLongType();
+}
+
+/**
+ * Type of a floating literal (C90 6.1.3.1): float with the suffix f, long double
+ * with the suffix l, double otherwise
+ */
+IRTypePtr IRConstantFolder::getFloatLiteralType(FloatLiteralToken::Suffix suffix)
+{
+    switch( suffix ) {
+        case FloatLiteralToken::FLOAT_SUFFIX:   return IRTypeTable::getFloatType();
+        case FloatLiteralToken::LONG_SUFFIX:    return IRTypeTable::getLongDoubleType();
+        default:                                return IRTypeTable::getDoubleType();
+    }
+}
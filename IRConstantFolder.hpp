@@ -0,0 +1,77 @@
+// IRConstantFolder.hpp
+//
+// Author: Marco Jacques
+//
+// Folding of the constant expressions, while the IR is built
+//
+
+#pragma once
+
+#include "IR.hpp"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Value of an arithmetic constant.  Integer values are kept normalized for their
+ * type: truncated to its width, and sign extended if the type is signed.
+ */
+struct IRConstant {
+    IRTypePtr type;
+    union {
+        uint64_t intValue;
+        double floatValue;
+    };
+
+    IRConstant() : type(nullptr), intValue(0) { }
+
+    bool isInteger() const;
+    bool isFloating() const { return type->getKind() == IRType::FLOAT || type->getKind() == IRType::DOUBLE; }
+    int64_t getSignedValue() const { return static_cast<int64_t>(intValue); }
+
+    /**
+     * Constant value of a literal expression
+     */
+    static bool fromExpr(IRExprPtr expr, IRConstant& constant);
+};
+
+
+/**
+ * Evaluation of the operators on constants, with the C90 semantics: integral
+ * promotions and usual arithmetic conversions, unsigned wraparound.  The
+ * evaluations that would be undefined (division by zero, signed overflow, too
+ * large shifts) are not folded: the expression is left for the later passes to
+ * diagnose.
+ *
+ * The target is LP64: int is 32 bits, long is 64 bits and plain char is signed.
+ */
+class IRConstantFolder {
+public:
+    struct Statistics {
+        size_t nbFoldedExprs;       // Expressions replaced by a literal
+        size_t nbUnfoldedExprs;     // Expressions with constant operands, left unfolded
+    };
+
+    IRConstantFolder() : statistics{0, 0} { }
+
+    bool foldUnary(IRExpr::Kind kind, const IRConstant& operand, IRConstant& result);
+    bool foldBinary(IRExpr::Kind kind, const IRConstant& leftOperand, const IRConstant& rightOperand, IRConstant& result);
+    bool foldCast(IRTypePtr type, const IRConstant& operand, IRConstant& result);
+    bool foldCond(const IRConstant& cond, const IRConstant& thenOperand, const IRConstant& elseOperand, IRConstant& result);
+
+    const Statistics& getStatistics() const { return statistics; }
+
+    /**
+     * Type of an integer constant, from its value, suffixes and base
+     */
+    static IRTypePtr getIntLiteralType(uint64_t value, bool isUnsigned, bool isLong, bool isDecimal);
+
+    /**
+     * Type of a floating constant
+     */
+    static IRTypePtr getFloatLiteralType(FloatLiteralToken::Suffix suffix);
+
+private:
+    bool count(bool isFolded);
+
+    Statistics statistics;
+};
@@ -0,0 +1,472 @@
+// IRImage.cpp
+//
+// Author: Marco Jacques
+//
+// Binary image of the flat IR, used in place after mapping it in memory
+//
+
+#include "IRImage.hpp"
+#include "Hashing.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+    const char MAGIC[8] = { 'M', 'Y', 'C', 'C', '-', 'I', 'R', '\0' };
+
+    // Written in the native byte order: an image from a machine of the other
+    // byte order doesn't match
+    //
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    enum Section {
+        KINDS,
+        TYPE_IDS,
+        LEFT_OPERANDS,
+        RIGHT_OPERANDS,
+        DATA,
+        LOCATIONS,
+        INT_VALUES,
+        STRING_OFFSETS,
+        STRING_CHARS,
+        EXTRA_OPERANDS,
+        TYPES,
+        TYPE_NAMES,
+
+        NB_SECTIONS
+    };
+
+    /**
+     * Header of the image.  The sections are 8 bytes aligned, their offsets are
+     * from the start of the image.
+     */
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t imageSize;
+        uint64_t checksum;                      // Of everything after the header
+        uint64_t sourcesHash;
+        uint64_t sectionOffsets[NB_SECTIONS];
+        uint64_t sectionSizes[NB_SECTIONS];     // In bytes
+    };
+
+    bool isNameKind(IRExpr::Kind kind)
+    {
+        return kind == IRExpr::ID || kind == IRExpr::STRING_LITERAL ||
+            kind == IRExpr::FIELD_DIRECT_ACCESS || kind == IRExpr::FIELD_INDIRECT_ACCESS;
+    }
+}
+
+const uint32_t IRTypeSection::NO_NAME;
+
+/**
+ * A record is described before its member types: a member can point to the
+ * record itself
+ */
+void IRTypeSection::addType(IRTypePtr type)
+{
+    if( type == nullptr || type->getId() <= IRType::NB_BUILTIN_TYPES || !describedTypes.insert(type->getId()).second ) {
+        return;
+    }
+
+    switch( type->getKind() ) {
+        case IRType::POINTER: {
+            const IRPointerType* pointerType = static_cast<const IRPointerType *>(type);
+            addType(pointerType->getTargetType());
+            words.insert(words.end(), { IRType::POINTER, type->getId(), pointerType->getTargetType()->getId() });
+            break;
+        }
+
+        case IRType::ARRAY: {
+            const IRArrayType* arrayType = static_cast<const IRArrayType *>(type);
+            addType(arrayType->getElementType());
+            words.insert(words.end(), {
+                IRType::ARRAY, type->getId(), arrayType->getElementType()->getId(),
+                static_cast<uint32_t>(arrayType->getNbElements()), static_cast<uint32_t>(arrayType->getNbElements() >> 32)
+            });
+            break;
+        }
+
+        case IRType::FUNCTION: {
+            const IRFunctionType* functionType = static_cast<const IRFunctionType *>(type);
+            addType(functionType->getReturnType());
+            for( unsigned i = 0; i < functionType->getNbArgs(); ++i ) {
+                addType(functionType->getArgType(i));
+            }
+
+            uint32_t flags = (functionType->isKandRFunction() ? 2 : 0) + (functionType->hasVariableArgs() ? 1 : 0);
+            words.insert(words.end(), {
+                IRType::FUNCTION, type->getId(), functionType->getReturnType()->getId(), flags, functionType->getNbArgs()
+            });
+            for( unsigned i = 0; i < functionType->getNbArgs(); ++i ) {
+                words.push_back(functionType->getArgType(i)->getId());
+            }
+            break;
+        }
+
+        case IRType::STRUCT:
+        case IRType::UNION: {
+            const IRRecordType* recordType = static_cast<const IRRecordType *>(type);
+            words.insert(words.end(), {
+                static_cast<uint32_t>(type->getKind()), type->getId(), addName(recordType->getTag()),
+                recordType->isComplete() ? 1u : 0u, recordType->getNbFields()
+            });
+            for( unsigned i = 0; i < recordType->getNbFields(); ++i ) {
+                const IRField& field = recordType->getField(i);
+                words.insert(words.end(), {
+                    addName(field.name != nullptr ? field.name->getName() : nullptr), field.type->getId(), field.bitWidth
+                });
+            }
+
+            for( unsigned i = 0; i < recordType->getNbFields(); ++i ) {
+                addType(recordType->getField(i).type);
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+uint32_t IRTypeSection::addName(const char* name)
+{
+    if( name == nullptr ) {
+        return NO_NAME;
+    }
+
+    auto inserted = nameOffsets.insert(std::make_pair(std::string(name), static_cast<uint32_t>(names.size())));
+    if( inserted.second ) {
+        names.append(name);
+        names.push_back('\0');
+    }
+    return inserted.first->second;
+}
+
+/**
+ * The components of a type are described before it.  The records are created
+ * first, and given their members once all the types are there.
+ */
+bool IRTypeSection::importTypes(const uint32_t* words, size_t nbWords, const char* names, size_t namesSize,
+                                IRTypeTable& typeTable, SymbolTable& symbolTable, std::vector<IRTypePtr>& typesById)
+{
+    typesById.assign(IRType::NB_BUILTIN_TYPES + 1, nullptr);
+    for( uint32_t id = 1; id <= IRType::NB_BUILTIN_TYPES; ++id ) {
+        typesById[id] = typeTable.getType(id);
+    }
+
+    auto getType = [&](uint32_t id) -> IRTypePtr {
+        return id < typesById.size() ? typesById[id] : nullptr;
+    };
+
+    // A name must end in the name section
+    //
+    auto isValidName = [&](uint32_t name) -> bool {
+        return name == NO_NAME || (name < namesSize && std::memchr(names + name, '\0', namesSize - name) != nullptr);
+    };
+
+    std::vector<size_t> recordWords;
+    size_t i = 0;
+    while( i + 3 <= nbWords ) {
+        uint32_t kind = words[i];
+        uint32_t id = words[i + 1];
+        IRTypePtr type = nullptr;
+
+        if( kind == IRType::POINTER ) {
+            IRTypePtr targetType = getType(words[i + 2]);
+            type = targetType != nullptr ? typeTable.getPointerType(targetType) : nullptr;
+            i += 3;
+        }
+        else if( kind == IRType::ARRAY && i + 5 <= nbWords ) {
+            IRTypePtr elementType = getType(words[i + 2]);
+            uint64_t nbElements = words[i + 3] | (static_cast<uint64_t>(words[i + 4]) << 32);
+            type = elementType != nullptr ? typeTable.getArrayType(elementType, nbElements) : nullptr;
+            i += 5;
+        }
+        else if( kind == IRType::FUNCTION && i + 5 <= nbWords && i + 5 + words[i + 4] <= nbWords ) {
+            IRTypePtr returnType = getType(words[i + 2]);
+            uint32_t flags = words[i + 3];
+            std::vector<IRTypePtr> argsType;
+            for( uint32_t arg = 0; arg < words[i + 4]; ++arg ) {
+                argsType.push_back(getType(words[i + 5 + arg]));
+                returnType = argsType.back() != nullptr ? returnType : nullptr;
+            }
+            type = returnType != nullptr ? typeTable.getFunctionType(returnType, argsType, (flags & 2) != 0, (flags & 1) != 0) : nullptr;
+            i += 5 + words[i + 4];
+        }
+        else if( (kind == IRType::STRUCT || kind == IRType::UNION) && i + 5 <= nbWords && i + 5 + 3 * size_t(words[i + 4]) <= nbWords &&
+                 isValidName(words[i + 2]) ) {
+            uint32_t tag = words[i + 2];
+            type = typeTable.createRecordType(static_cast<IRType::Kind>(kind), tag != NO_NAME ? names + tag : nullptr);
+            recordWords.push_back(i);
+            i += 5 + 3 * size_t(words[i + 4]);
+        }
+
+        if( type == nullptr ) {
+            return false;
+        }
+
+        if( id >= typesById.size() ) {
+            typesById.resize(id + 1, nullptr);
+        }
+        typesById[id] = type;
+    }
+
+    std::vector<IRField> fields;
+    for( size_t start : recordWords ) {
+        if( words[start + 3] == 0 ) {
+            continue;
+        }
+
+        fields.clear();
+        for( uint32_t field = 0; field < words[start + 4]; ++field ) {
+            const uint32_t* fieldWords = words + start + 5 + 3 * field;
+            IRTypePtr fieldType = getType(fieldWords[1]);
+            if( fieldType == nullptr || !isValidName(fieldWords[0]) ) {
+                return false;
+            }
+
+            const char* name = fieldWords[0] != NO_NAME ? names + fieldWords[0] : nullptr;
+            fields.push_back(IRField{name != nullptr ? symbolTable.getIdentifier(name, std::strlen(name)) : nullptr, fieldType, fieldWords[2]});
+        }
+        typeTable.completeRecordType(static_cast<const IRRecordType *>(typesById[words[start + 1]]), fields);
+    }
+
+    return i == nbWords;
+}
+
+const uint32_t IRImage::VERSION;
+const uint64_t IRImage::ANY_SOURCES;
+
+/**
+ * Write the image: the header is filled last, with the checksum
+ */
+void IRImage::write(const FlatIR& ir, IRTypeTable& typeTable, uint64_t sourcesHash, std::vector<char>& image)
+{
+    size_t nbNodes = ir.getNbNodes();
+
+    // Intern the strings: the nodes naming a string get the index of its interned copy
+    //
+    std::vector<uint32_t> nodeData(ir.data);
+    std::unordered_map<std::string, uint32_t> stringIndexes;
+    std::vector<uint32_t> stringOffsets;
+    std::string stringChars;
+    for( size_t i = 0; i < nbNodes; ++i ) {
+        if( isNameKind(ir.getKind(i)) ) {
+            const std::string& value = ir.strings[ir.data[i]];
+            auto inserted = stringIndexes.insert(std::make_pair(value, static_cast<uint32_t>(stringOffsets.size())));
+            if( inserted.second ) {
+                stringOffsets.push_back(static_cast<uint32_t>(stringChars.size()));
+                stringChars.append(value);
+                stringChars.push_back('\0');
+            }
+            nodeData[i] = inserted.first->second;
+        }
+    }
+    stringOffsets.push_back(static_cast<uint32_t>(stringChars.size()));
+
+    // The derived types used by the nodes
+    //
+    IRTypeSection types;
+    for( size_t i = 0; i < nbNodes; ++i ) {
+        types.addType(typeTable.getType(ir.typeIds[i]));
+        if( ir.getKind(i) == IRExpr::SIZEOF_TYPE || ir.getKind(i) == IRExpr::CAST ) {
+            types.addType(typeTable.getType(ir.data[i]));
+        }
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.sourcesHash = sourcesHash;
+
+    image.assign(sizeof(Header), 0);
+    auto addSection = [&](Section section, const void* bytes, size_t size) {
+        image.resize((image.size() + 7) & ~size_t(7), 0);
+        header.sectionOffsets[section] = image.size();
+        header.sectionSizes[section] = size;
+        image.insert(image.end(), static_cast<const char *>(bytes), static_cast<const char *>(bytes) + size);
+    };
+
+    addSection(KINDS, ir.kinds.data(), nbNodes * sizeof(uint8_t));
+    addSection(TYPE_IDS, ir.typeIds.data(), nbNodes * sizeof(uint32_t));
+    addSection(LEFT_OPERANDS, ir.leftOperands.data(), nbNodes * sizeof(NodeIndex));
+    addSection(RIGHT_OPERANDS, ir.rightOperands.data(), nbNodes * sizeof(NodeIndex));
+    addSection(DATA, nodeData.data(), nbNodes * sizeof(uint32_t));
+    addSection(LOCATIONS, ir.locations.data(), nbNodes * sizeof(uint32_t));
+    addSection(INT_VALUES, ir.intValues.data(), ir.intValues.size() * sizeof(uint64_t));
+    addSection(STRING_OFFSETS, stringOffsets.data(), stringOffsets.size() * sizeof(uint32_t));
+    addSection(STRING_CHARS, stringChars.data(), stringChars.size());
+    addSection(EXTRA_OPERANDS, ir.extraOperands.data(), ir.extraOperands.size() * sizeof(NodeIndex));
+    addSection(TYPES, types.getWords().data(), types.getWords().size() * sizeof(uint32_t));
+    addSection(TYPE_NAMES, types.getNames().data(), types.getNames().size());
+    image.resize((image.size() + 7) & ~size_t(7), 0);
+
+    header.imageSize = image.size();
+    header.checksum = Hashing::hashBytes(image.data() + sizeof(Header), image.size() - sizeof(Header));
+    std::memcpy(image.data(), &header, sizeof(Header));
+}
+
+IRImage::Status IRImage::writeFile(const FlatIR& ir, IRTypeTable& typeTable, uint64_t sourcesHash, const std::string& fileName)
+{
+    std::vector<char> image;
+    write(ir, typeTable, sourcesHash, image);
+
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if( !file ) {
+        return CANNOT_OPEN;
+    }
+
+    file.write(image.data(), image.size());
+    file.close();
+    return file ? OK : CANNOT_WRITE;
+}
+
+std::shared_ptr<IRImage> IRImage::mapFile(const std::string& fileName, uint64_t sourcesHash, Status& status)
+{
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if( fd < 0 ) {
+        status = CANNOT_OPEN;
+        return nullptr;
+    }
+
+    struct stat fileStat;
+    if( ::fstat(fd, &fileStat) != 0 ) {
+        ::close(fd);
+        status = CANNOT_OPEN;
+        return nullptr;
+    }
+
+    size_t size = static_cast<size_t>(fileStat.st_size);
+    if( size < sizeof(Header) ) {
+        ::close(fd);
+        status = TOO_SMALL;
+        return nullptr;
+    }
+
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if( mapping == MAP_FAILED ) {
+        status = CANNOT_OPEN;
+        return nullptr;
+    }
+
+    std::shared_ptr<IRImage> result(new IRImage());
+    result->mapping = mapping;
+    result->mappingSize = size;
+
+    status = result->load(static_cast<const char *>(mapping), size, sourcesHash);
+    return status == OK ? result : nullptr;
+}
+
+std::shared_ptr<IRImage> IRImage::useMemory(const void* image, size_t size, uint64_t sourcesHash, Status& status)
+{
+    std::shared_ptr<IRImage> result(new IRImage());
+    status = result->load(static_cast<const char *>(image), size, sourcesHash);
+    return status == OK ? result : nullptr;
+}
+
+IRImage::~IRImage()
+{
+    if( mapping != nullptr ) {
+        ::munmap(mapping, mappingSize);
+    }
+}
+
+/**
+ * Check the header and the layout of the sections, and point to the sections.
+ * Once the checksum matches, the content is trusted: the image was written by
+ * write().
+ */
+IRImage::Status IRImage::load(const char* image, size_t size, uint64_t sourcesHash)
+{
+    if( size < sizeof(Header) ) {
+        return TOO_SMALL;
+    }
+
+    Header header;
+    std::memcpy(&header, image, sizeof(Header));
+    if( std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.byteOrder != BYTE_ORDER_MARK ) {
+        return BAD_MAGIC;
+    }
+
+    if( header.version != VERSION ) {
+        return BAD_VERSION;
+    }
+
+    if( header.imageSize != size ) {
+        return TOO_SMALL;
+    }
+
+    if( sourcesHash != ANY_SOURCES && header.sourcesHash != sourcesHash ) {
+        return STALE;
+    }
+
+    if( Hashing::hashBytes(image + sizeof(Header), size - sizeof(Header)) != header.checksum ) {
+        return BAD_CHECKSUM;
+    }
+
+    if( reinterpret_cast<uintptr_t>(image) % 8 != 0 ) {
+        return BAD_LAYOUT;
+    }
+
+    for( int section = 0; section < NB_SECTIONS; ++section ) {
+        uint64_t offset = header.sectionOffsets[section];
+        if( offset % 8 != 0 || offset < sizeof(Header) || offset > size || header.sectionSizes[section] > size - offset ) {
+            return BAD_LAYOUT;
+        }
+    }
+
+    nbNodes = header.sectionSizes[KINDS];
+    nbStrings = header.sectionSizes[STRING_OFFSETS] / sizeof(uint32_t) - 1;
+    nbTypeWords = header.sectionSizes[TYPES] / sizeof(uint32_t);
+    for( Section section : { TYPE_IDS, LEFT_OPERANDS, RIGHT_OPERANDS, DATA, LOCATIONS } ) {
+        if( header.sectionSizes[section] != nbNodes * sizeof(uint32_t) ) {
+            return BAD_LAYOUT;
+        }
+    }
+
+    if( header.sectionSizes[STRING_OFFSETS] < sizeof(uint32_t) ) {
+        return BAD_LAYOUT;
+    }
+
+    kinds = reinterpret_cast<const uint8_t *>(image + header.sectionOffsets[KINDS]);
+    typeIds = reinterpret_cast<const uint32_t *>(image + header.sectionOffsets[TYPE_IDS]);
+    leftOperands = reinterpret_cast<const NodeIndex *>(image + header.sectionOffsets[LEFT_OPERANDS]);
+    rightOperands = reinterpret_cast<const NodeIndex *>(image + header.sectionOffsets[RIGHT_OPERANDS]);
+    data = reinterpret_cast<const uint32_t *>(image + header.sectionOffsets[DATA]);
+    locations = reinterpret_cast<const uint32_t *>(image + header.sectionOffsets[LOCATIONS]);
+    intValues = reinterpret_cast<const uint64_t *>(image + header.sectionOffsets[INT_VALUES]);
+    stringOffsets = reinterpret_cast<const uint32_t *>(image + header.sectionOffsets[STRING_OFFSETS]);
+    stringChars = image + header.sectionOffsets[STRING_CHARS];
+    extraOperands = reinterpret_cast<const NodeIndex *>(image + header.sectionOffsets[EXTRA_OPERANDS]);
+    typeWords = reinterpret_cast<const uint32_t *>(image + header.sectionOffsets[TYPES]);
+    typeNames = image + header.sectionOffsets[TYPE_NAMES];
+    typeNamesSize = header.sectionSizes[TYPE_NAMES];
+
+    if( stringOffsets[nbStrings] != header.sectionSizes[STRING_CHARS] ) {
+        return BAD_LAYOUT;
+    }
+
+    return OK;
+}
+
+double IRImage::getFloatValue(NodeIndex index) const
+{
+    double value;
+    std::memcpy(&value, &intValues[data[index]], sizeof(value));
+    return value;
+}
+
+bool IRImage::importTypes(IRTypeTable& typeTable, SymbolTable& symbolTable, std::vector<IRTypePtr>& typesById) const
+{
+    return IRTypeSection::importTypes(typeWords, nbTypeWords, typeNames, typeNamesSize, typeTable, symbolTable, typesById);
+}
@@ -0,0 +1,195 @@
+// IRImage.hpp
+//
+// Author: Marco Jacques
+//
+// Binary image of the flat IR, used in place after mapping it in memory
+//
+
+#pragma once
+
+#include "FlatIR.hpp"
+#include "SymbolTable.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Description of derived types in an image, shared by the IRImage and the
+ * PCHImage.  A type is described after its components, except the members of
+ * the records, which may come after the record.  Each type is: kind, id, then
+ *   - POINTER: target type id
+ *   - ARRAY: element type id, number of elements (low then high 32 bits)
+ *   - FUNCTION: return type id, flags (K&R, varargs), number of args, arg type ids
+ *   - STRUCT, UNION: tag, complete, number of members, then for each member its
+ *     name, type id and bit width
+ *
+ * The tags and the member names are offsets in a section of null terminated
+ * names, NO_NAME if there is none.
+ */
+class IRTypeSection {
+public:
+    static const uint32_t NO_NAME = UINT32_MAX;
+
+    /**
+     * Describe a type and its components, unless they are already described
+     */
+    void addType(IRTypePtr type);
+
+    const std::vector<uint32_t>& getWords() const { return words; }
+    const std::string& getNames() const { return names; }
+
+    /**
+     * Create the described types in a type table, the member names in a symbol
+     * table.  typesById gives the type of each type id.  Returns false if the
+     * description is invalid.
+     */
+    static bool importTypes(const uint32_t* words, size_t nbWords, const char* names, size_t namesSize,
+                            IRTypeTable& typeTable, SymbolTable& symbolTable, std::vector<IRTypePtr>& typesById);
+
+private:
+    uint32_t addName(const char* name);
+
+    std::vector<uint32_t> words;
+    std::unordered_set<uint32_t> describedTypes;
+    std::unordered_map<std::string, uint32_t> nameOffsets;
+    std::string names;
+};
+
+/**
+ * Binary image of a FlatIR.  The image is position independent: the arrays of the
+ * FlatIR are sections found by their offset from the start of the image, nodes
+ * refer to each other by index, and the strings are interned in a string section.
+ * A loaded image is used in place, without deserialization: it has the same
+ * accessors as the FlatIR.
+ *
+ * The image starts with a header holding a magic number, the format version, the
+ * byte order, a hash of the sources it was built from and a checksum of the rest
+ * of the image.  An image that is not for this version, not for these sources or
+ * damaged is rejected.
+ *
+ * The types are not in the nodes, only their ids; the derived types used by the
+ * nodes are described in a type section, to be imported in a type table.  The
+ * records come with their members, whose names go to a symbol table.
+ */
+class IRImage {
+public:
+    using NodeIndex = FlatIR::NodeIndex;
+
+    enum Status {
+        OK,
+        CANNOT_OPEN,
+        CANNOT_WRITE,
+        TOO_SMALL,
+        BAD_MAGIC,
+        BAD_VERSION,
+        BAD_CHECKSUM,
+        BAD_LAYOUT,
+        STALE
+    };
+
+    static const uint32_t VERSION = 3;
+
+    /**
+     * Sources hash meaning "don't check the sources"
+     */
+    static const uint64_t ANY_SOURCES = 0;
+
+    /**
+     * Write the image of an IR, whose type ids are in the type table
+     */
+    static void write(const FlatIR& ir, IRTypeTable& typeTable, uint64_t sourcesHash, std::vector<char>& image);
+    static Status writeFile(const FlatIR& ir, IRTypeTable& typeTable, uint64_t sourcesHash, const std::string& fileName);
+
+    /**
+     * Map an image file in memory.  Returns nullptr, and the reason in status, if
+     * the file can't be used.
+     */
+    static std::shared_ptr<IRImage> mapFile(const std::string& fileName, uint64_t sourcesHash, Status& status);
+
+    /**
+     * Use an image already in memory (8 bytes aligned), which must outlive the IRImage
+     */
+    static std::shared_ptr<IRImage> useMemory(const void* image, size_t size, uint64_t sourcesHash, Status& status);
+
+    ~IRImage();
+
+    IRImage(const IRImage&) = delete;
+    IRImage& operator=(const IRImage&) = delete;
+
+    size_t getNbNodes() const { return nbNodes; }
+
+    IRExpr::Kind getKind(NodeIndex index) const { return static_cast<IRExpr::Kind>(kinds[index]); }
+    uint32_t getTypeId(NodeIndex index) const { return typeIds[index]; }
+    uint32_t getLocation(NodeIndex index) const { return locations[index]; }
+    NodeIndex getOperand(NodeIndex index) const { return leftOperands[index]; }
+    NodeIndex getLeftOperand(NodeIndex index) const { return leftOperands[index]; }
+    NodeIndex getRightOperand(NodeIndex index) const { return rightOperands[index]; }
+    NodeIndex getElseOperand(NodeIndex index) const { return data[index]; }
+    uint32_t getTypeOperandId(NodeIndex index) const { return data[index]; }
+
+    uint64_t getIntValue(NodeIndex index) const { return intValues[data[index]]; }
+    double getFloatValue(NodeIndex index) const;
+
+    /**
+     * Strings are null terminated, string literals can also contain null characters
+     */
+    const char* getString(NodeIndex index) const { return stringChars + stringOffsets[data[index]]; }
+    size_t getStringLength(NodeIndex index) const { return stringOffsets[data[index] + 1] - stringOffsets[data[index]] - 1; }
+
+    unsigned getNbArgs(NodeIndex index) const { return extraOperands[data[index]]; }
+    NodeIndex getArg(NodeIndex index, unsigned argIndex) const { return extraOperands[data[index] + 1 + argIndex]; }
+
+    IRExpr::Kind getChainOperatorKind(NodeIndex index) const { return static_cast<IRExpr::Kind>(extraOperands[data[index]]); }
+    unsigned getNbChainOperands(NodeIndex index) const { return extraOperands[data[index] + 1]; }
+    NodeIndex getChainOperand(NodeIndex index, unsigned operandIndex) const { return extraOperands[data[index] + 2 + operandIndex]; }
+
+    /**
+     * Raw arrays, for passes streaming over all the nodes
+     */
+    const uint8_t* getKinds() const { return kinds; }
+    const uint32_t* getTypeIds() const { return typeIds; }
+    const NodeIndex* getLeftOperands() const { return leftOperands; }
+    const NodeIndex* getRightOperands() const { return rightOperands; }
+
+    size_t getNbStrings() const { return nbStrings; }
+
+    /**
+     * Create the types of the image in a type table, and the names of the record
+     * members in a symbol table.  typesById gives the type of each type id of the
+     * image.  Returns false if the type section is invalid.
+     */
+    bool importTypes(IRTypeTable& typeTable, SymbolTable& symbolTable, std::vector<IRTypePtr>& typesById) const;
+
+private:
+    IRImage() : mapping(nullptr), mappingSize(0) { }
+
+    Status load(const char* image, size_t size, uint64_t sourcesHash);
+
+    // Memory to unmap, if the image was mapped from a file
+    //
+    void* mapping;
+    size_t mappingSize;
+
+    size_t nbNodes;
+    const uint8_t* kinds;
+    const uint32_t* typeIds;
+    const NodeIndex* leftOperands;
+    const NodeIndex* rightOperands;
+    const uint32_t* data;
+    const uint32_t* locations;
+
+    const uint64_t* intValues;
+    size_t nbStrings;
+    const uint32_t* stringOffsets;
+    const char* stringChars;
+    const NodeIndex* extraOperands;
+
+    const uint32_t* typeWords;
+    size_t nbTypeWords;
+    const char* typeNames;
+    size_t typeNamesSize;
+};
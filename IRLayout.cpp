@@ -0,0 +1,226 @@
+// IRLayout.cpp
+//
+// Author: Marco Jacques
+//
+// Layout of the types in memory
+//
+
+#include "IRLayout.hpp"
+#include "Hashing.hpp"
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+    //                         void char schar uchar short ushort int uint long ulong float double ldouble
+    const TargetABI lp64Abi = {
+        {                       0,   1,   1,    1,    2,    2,     4,  4,   8,   8,    4,    8,     16 },
+        {                       1,   1,   1,    1,    2,    2,     4,  4,   8,   8,    4,    8,     16 },
+        8, 8
+    };
+
+    const TargetABI ilp32Abi = {
+        {                       0,   1,   1,    1,    2,    2,     4,  4,   4,   4,    4,    8,     12 },
+        {                       1,   1,   1,    1,    2,    2,     4,  4,   4,   4,    4,    4,     4 },
+        4, 4
+    };
+
+    uint64_t roundUp(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    size_t hashName(const Identifier* name)
+    {
+        return static_cast<size_t>(Hashing::mix(reinterpret_cast<uintptr_t>(name)));
+    }
+}
+
+const TargetABI& TargetABI::getLP64()
+{
+    return lp64Abi;
+}
+
+const TargetABI& TargetABI::getILP32()
+{
+    return ilp32Abi;
+}
+
+const unsigned IRRecordLayout::NO_FIELD;
+
+/**
+ * Index of the member with the given (interned) name, NO_FIELD if none
+ */
+unsigned IRRecordLayout::findField(const Identifier* name) const
+{
+    for( size_t bucket = hashName(name) & fieldIndexMask; fieldIndexes[bucket] != NO_FIELD; bucket = (bucket + 1) & fieldIndexMask ) {
+        unsigned index = fieldIndexes[bucket];
+        if( recordType->getField(index).name == name ) {
+            return index;
+        }
+    }
+
+    return NO_FIELD;
+}
+
+/**
+ * Constructor
+ */
+IRLayoutEngine::IRLayoutEngine(const TargetABI& abi_) :
+    abi(abi_),
+    arena(),
+    arrayLayouts(),
+    recordLayouts()
+{
+    // Nothing else to do
+}
+
+/**
+ * Size and alignment of a type.  Only the arrays and records need to be cached.
+ */
+IRLayoutEngine::TypeLayout IRLayoutEngine::getLayout(IRTypePtr type)
+{
+    switch( type->getKind() ) {
+        case IRType::POINTER:
+            return TypeLayout{abi.pointerSize, abi.pointerAlignment};
+
+        case IRType::ARRAY: {
+            auto found = arrayLayouts.find(type);
+            if( found != arrayLayouts.end() ) {
+                return found->second;
+            }
+
+            const IRArrayType* arrayType = static_cast<const IRArrayType *>(type);
+            TypeLayout elementLayout = getLayout(arrayType->getElementType());
+            TypeLayout layout{elementLayout.size * arrayType->getNbElements(), elementLayout.alignment};
+            arrayLayouts.insert(std::make_pair(type, layout));
+            return layout;
+        }
+
+        case IRType::FUNCTION:
+            return TypeLayout{0, 1};
+
+        case IRType::STRUCT:
+        case IRType::UNION: {
+            const IRRecordLayout* recordLayout = getRecordLayout(static_cast<const IRRecordType *>(type));
+            return recordLayout != nullptr ? TypeLayout{recordLayout->size, recordLayout->alignment} : TypeLayout{0, 1};
+        }
+
+        default:
+            return TypeLayout{abi.sizes[type->getKind()], abi.alignments[type->getKind()]};
+    }
+}
+
+/**
+ * Layout of a record, nullptr if it is incomplete.  An incomplete record is not
+ * cached: it can be completed later.
+ */
+const IRRecordLayout* IRLayoutEngine::getRecordLayout(const IRRecordType* recordType)
+{
+    auto found = recordLayouts.find(recordType);
+    if( found != recordLayouts.end() ) {
+        return found->second;
+    }
+
+    if( !recordType->isComplete() ) {
+        return nullptr;
+    }
+
+    const IRRecordLayout* recordLayout = layoutRecord(recordType);
+    recordLayouts.insert(std::make_pair(recordType, recordLayout));
+    return recordLayout;
+}
+
+/**
+ * Place the members, following the System V rules:
+ *   - a member is aligned on the alignment of its type
+ *   - a bit-field is put in the current storage unit of its type if it fits,
+ *     else at the start of the next one.  A bit-field of width 0 ends the
+ *     current storage unit.
+ *   - unnamed bit-fields don't change the alignment of the record
+ *   - the size is rounded up to the alignment of the record
+ * All the members of a union are at offset 0.
+ */
+const IRRecordLayout* IRLayoutEngine::layoutRecord(const IRRecordType* recordType)
+{
+    unsigned nbFields = recordType->getNbFields();
+    IRFieldLayout* fieldLayouts = static_cast<IRFieldLayout *>(arena.allocate(sizeof(IRFieldLayout) * nbFields, alignof(IRFieldLayout)));
+
+    uint64_t bitPosition = 0;
+    uint64_t nbBits = 0;
+    uint32_t alignment = 1;
+    unsigned nbNamedFields = 0;
+
+    for( unsigned i = 0; i < nbFields; ++i ) {
+        const IRField& field = recordType->getField(i);
+        TypeLayout fieldLayout = getLayout(field.type);
+        uint64_t alignmentBits = fieldLayout.alignment * 8ull;
+
+        if( recordType->isUnion() ) {
+            bitPosition = 0;
+        }
+
+        if( !field.isBitField() ) {
+            bitPosition = roundUp(bitPosition, alignmentBits);
+            fieldLayouts[i] = IRFieldLayout{bitPosition / 8, 0};
+            bitPosition += fieldLayout.size * 8;
+            alignment = std::max(alignment, fieldLayout.alignment);
+        }
+        else if( field.bitWidth == 0 ) {
+            bitPosition = roundUp(bitPosition, alignmentBits);
+            fieldLayouts[i] = IRFieldLayout{bitPosition / 8, 0};
+        }
+        else {
+            uint64_t unitStart = bitPosition / alignmentBits * alignmentBits;
+            if( bitPosition + field.bitWidth > unitStart + fieldLayout.size * 8 ) {
+                bitPosition = roundUp(bitPosition, alignmentBits);
+                unitStart = bitPosition;
+            }
+
+            fieldLayouts[i] = IRFieldLayout{unitStart / 8, static_cast<uint32_t>(bitPosition - unitStart)};
+            bitPosition += field.bitWidth;
+            if( field.name != nullptr ) {
+                alignment = std::max(alignment, fieldLayout.alignment);
+            }
+        }
+
+        nbBits = std::max(nbBits, bitPosition);
+        if( field.name != nullptr ) {
+            ++nbNamedFields;
+        }
+    }
+
+    // Index of the named members, at most half full
+    //
+    size_t nbBuckets = 2;
+    while( nbBuckets < nbNamedFields * 2 ) {
+        nbBuckets *= 2;
+    }
+
+    unsigned* fieldIndexes = static_cast<unsigned *>(arena.allocate(sizeof(unsigned) * nbBuckets, alignof(unsigned)));
+    std::fill(fieldIndexes, fieldIndexes + nbBuckets, IRRecordLayout::NO_FIELD);
+
+    size_t mask = nbBuckets - 1;
+    for( unsigned i = 0; i < nbFields; ++i ) {
+        const Identifier* name = recordType->getField(i).name;
+        if( name == nullptr ) {
+            continue;
+        }
+
+        size_t bucket = hashName(name) & mask;
+        while( fieldIndexes[bucket] != IRRecordLayout::NO_FIELD ) {
+            bucket = (bucket + 1) & mask;
+        }
+        fieldIndexes[bucket] = i;
+    }
+
+    IRRecordLayout* recordLayout = arena.create<IRRecordLayout>();
+    recordLayout->recordType = recordType;
+    recordLayout->size = roundUp(roundUp(nbBits, 8) / 8, alignment);
+    recordLayout->alignment = alignment;
+    recordLayout->fieldLayouts = fieldLayouts;
+    recordLayout->fieldIndexes = fieldIndexes;
+    recordLayout->fieldIndexMask = mask;
+
+    return recordLayout;
+}
@@ -0,0 +1,120 @@
+// IRLayout.hpp
+//
+// Author: Marco Jacques
+//
+// Layout of the types in memory
+//
+
+#pragma once
+
+#include "Arena.hpp"
+#include "IRType.hpp"
+#include <climits>
+#include <cstdint>
+#include <unordered_map>
+
+/**
+ * Sizes and alignments of the builtin types and of the pointers, in bytes
+ */
+struct TargetABI {
+    uint32_t sizes[IRType::NB_BUILTIN_TYPES];
+    uint32_t alignments[IRType::NB_BUILTIN_TYPES];
+    uint32_t pointerSize;
+    uint32_t pointerAlignment;
+
+    /**
+     * 64 bits Unix (x86-64 System V): long and pointers are 8 bytes
+     */
+    static const TargetABI& getLP64();
+
+    /**
+     * 32 bits Unix (i386 System V): double and long double are aligned on 4 bytes
+     */
+    static const TargetABI& getILP32();
+};
+
+/**
+ * Place of a member in its record.  A bit-field is in a storage unit of its
+ * declared type: offset is the storage unit, bitOffset the first bit in it.
+ */
+struct IRFieldLayout {
+    uint64_t offset;
+    uint32_t bitOffset;
+};
+
+/**
+ * Layout of a struct or union, with an index of its members by name
+ */
+class IRRecordLayout {
+public:
+    static const unsigned NO_FIELD = UINT_MAX;
+
+    uint64_t getSize() const { return size; }
+    uint32_t getAlignment() const { return alignment; }
+
+    unsigned getNbFields() const { return recordType->getNbFields(); }
+    const IRFieldLayout& getFieldLayout(unsigned index) const { return fieldLayouts[index]; }
+
+    /**
+     * Index of the member with the given (interned) name, NO_FIELD if none
+     */
+    unsigned findField(const Identifier* name) const;
+
+private:
+    friend class IRLayoutEngine;
+
+    const IRRecordType* recordType;
+    uint64_t size;
+    uint32_t alignment;
+    const IRFieldLayout* fieldLayouts;
+
+    // Open addressing hash table of the named member indexes, NO_FIELD for the
+    // empty buckets.  The size is a power of 2.
+    //
+    const unsigned* fieldIndexes;
+    size_t fieldIndexMask;
+};
+
+/**
+ * Computes the size and alignment of the types for a target ABI.  The layouts of
+ * the arrays and records are computed the first time they are asked for, then
+ * cached: a struct with thousands of members is laid out once, and its members
+ * are then found in O(1).
+ *
+ * Types without a size (void, functions, incomplete records) have a size of 0.
+ * The engine is not thread safe: use one per thread.
+ */
+class IRLayoutEngine {
+public:
+    /**
+     * Constructor
+     */
+    IRLayoutEngine(const TargetABI& abi_ = TargetABI::getLP64());
+
+    IRLayoutEngine(const IRLayoutEngine&) = delete;
+    IRLayoutEngine& operator=(const IRLayoutEngine&) = delete;
+
+    const TargetABI& getABI() const { return abi; }
+
+    uint64_t getSize(IRTypePtr type) { return getLayout(type).size; }
+    uint32_t getAlignment(IRTypePtr type) { return getLayout(type).alignment; }
+
+    /**
+     * Layout of a record, nullptr if it is incomplete
+     */
+    const IRRecordLayout* getRecordLayout(const IRRecordType* recordType);
+
+private:
+    struct TypeLayout {
+        uint64_t size;
+        uint32_t alignment;
+    };
+
+    TypeLayout getLayout(IRTypePtr type);
+    const IRRecordLayout* layoutRecord(const IRRecordType* recordType);
+
+    TargetABI abi;
+    Arena arena;
+    std::unordered_map<IRTypePtr, TypeLayout> arrayLayouts;
+    std::unordered_map<IRTypePtr, const IRRecordLayout*> recordLayouts;
+};
@@ -0,0 +1,246 @@
+// IRType.cpp
+//
+// Author: Marco Jacques
+//
+// Types of the intermediate representation
+//
+
+#include "IRType.hpp"
+#include "Hashing.hpp"
+#include <cstring>
+
+namespace {
+
+    /**
+     * Builtin types: constant initialized, so available without any synchronization
+     */
+    const IRBuiltinType voidType(IRType::VOID);
+    const IRBuiltinType charType(IRType::CHAR);
+    const IRBuiltinType signedCharType(IRType::SIGNED_CHAR);
+    const IRBuiltinType unsignedCharType(IRType::UNSIGNED_CHAR);
+    const IRBuiltinType shortType(IRType::SHORT);
+    const IRBuiltinType unsignedShortType(IRType::UNSIGNED_SHORT);
+    const IRBuiltinType intType(IRType::INT);
+    const IRBuiltinType unsignedType(IRType::UNSIGNED);
+    const IRBuiltinType longType(IRType::LONG);
+    const IRBuiltinType unsignedLongType(IRType::UNSIGNED_LONG);
+    const IRBuiltinType floatType(IRType::FLOAT);
+    const IRBuiltinType doubleType(IRType::DOUBLE);
+    const IRBuiltinType longDoubleType(IRType::LONG_DOUBLE);
+
+    const IRBuiltinType* const builtinTypes[IRType::NB_BUILTIN_TYPES] = {
+        &voidType,
+        &charType, &signedCharType, &unsignedCharType,
+        &shortType, &unsignedShortType,
+        &intType, &unsignedType,
+        &longType, &unsignedLongType,
+        &floatType, &doubleType, &longDoubleType
+    };
+}
+
+
+/**
+ * Constructor.  Ids 1 to NB_BUILTIN_TYPES are the builtin types, id 0 is never used.
+ */
+IRTypeTable::IRTypeTable() :
+    mutex(),
+    arena(),
+    types(),
+    typesById(1, nullptr)
+{
+    for( const IRBuiltinType* builtinType : builtinTypes ) {
+        typesById.push_back(builtinType);
+        builtinPointerTypes[builtinType->getKind()].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Return a builtin type
+ */
+IRTypePtr IRTypeTable::getBuiltinType(IRType::Kind kind)
+{
+    return builtinTypes[kind];
+}
+
+/**
+ * Find a type with its hash and the equal predicate, or create it (with the table
+ * locked).
+ */
+template<typename Equal, typename Create>
+IRTypePtr IRTypeTable::findOrCreate(uint64_t hash, Equal equal, Create create)
+{
+    auto range = types.equal_range(hash);
+    for( auto iter = range.first; iter != range.second; ++iter ) {
+        if( equal(iter->second) ) {
+            return iter->second;
+        }
+    }
+
+    IRType* newType = create(static_cast<uint32_t>(typesById.size()));
+    newType->table = this;
+    types.insert(std::make_pair(hash, newType));
+    typesById.push_back(newType);
+
+    return newType;
+}
+
+/**
+ * Where the pointer type to a type is cached.  The builtin types are shared by
+ * all the tables, so the pointers to them are cached in the table.  The types of
+ * another table have no cache: the pointer type would belong to this table, and
+ * dangle in the other one once this table is destroyed.
+ */
+std::atomic<const IRPointerType*>* IRTypeTable::getPointerTypeCache(IRTypePtr targetType)
+{
+    if( IRBuiltinType::classof(targetType) ) {
+        return &builtinPointerTypes[targetType->getKind()];
+    }
+
+    return targetType->table == this ? &targetType->pointerType : nullptr;
+}
+
+/**
+ * Pointer types are cached, the table is only looked at the first time.  The
+ * pointers to the types of another table are looked up like the other types.
+ */
+IRTypePtr IRTypeTable::getPointerType(IRTypePtr targetType)
+{
+    std::atomic<const IRPointerType*>* cache = getPointerTypeCache(targetType);
+    if( cache == nullptr ) {
+        std::lock_guard<std::mutex> lock(mutex);
+        return findOrCreate(
+            Hashing::combine(IRType::POINTER, targetType),
+            [&](IRTypePtr type) {
+                return type->getKind() == IRType::POINTER &&
+                       static_cast<const IRPointerType *>(type)->getTargetType() == targetType;
+            },
+            [&](uint32_t id) {
+                return arena.create<IRPointerType>(id, targetType);
+            }
+        );
+    }
+
+    const IRPointerType* pointerType = cache->load(std::memory_order_acquire);
+    if( pointerType != nullptr ) {
+        return pointerType;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Might have been created by another thread while waiting for the lock
+    //
+    pointerType = cache->load(std::memory_order_relaxed);
+    if( pointerType == nullptr ) {
+        IRPointerType* newType = arena.create<IRPointerType>(static_cast<uint32_t>(typesById.size()), targetType);
+        newType->table = this;
+        typesById.push_back(newType);
+        cache->store(newType, std::memory_order_release);
+        pointerType = newType;
+    }
+
+    return pointerType;
+}
+
+IRTypePtr IRTypeTable::getArrayType(IRTypePtr elementType, uint64_t nbElements)
+{
+    uint64_t hash = Hashing::combine(Hashing::combine(IRType::ARRAY, elementType), nbElements);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return findOrCreate(
+        hash,
+        [&](IRTypePtr type) {
+            if( type->getKind() != IRType::ARRAY ) {
+                return false;
+            }
+
+            const IRArrayType* arrayType = static_cast<const IRArrayType *>(type);
+            return arrayType->getElementType() == elementType && arrayType->getNbElements() == nbElements;
+        },
+        [&](uint32_t id) {
+            return arena.create<IRArrayType>(id, elementType, nbElements);
+        }
+    );
+}
+
+IRTypePtr IRTypeTable::getFunctionType(IRTypePtr returnType, const std::vector<IRTypePtr>& argsType, bool isKandR, bool hasVarArgs)
+{
+    uint64_t hash = Hashing::combine(IRType::FUNCTION, returnType);
+    for( IRTypePtr argType : argsType ) {
+        hash = Hashing::combine(hash, argType);
+    }
+    hash = Hashing::combine(hash, (isKandR ? 2 : 0) + (hasVarArgs ? 1 : 0));
+
+    std::lock_guard<std::mutex> lock(mutex);
+    return findOrCreate(
+        hash,
+        [&](IRTypePtr type) {
+            if( type->getKind() != IRType::FUNCTION ) {
+                return false;
+            }
+
+            const IRFunctionType* functionType = static_cast<const IRFunctionType *>(type);
+            if( functionType->getReturnType() != returnType ||
+                functionType->getNbArgs() != argsType.size() ||
+                functionType->isKandRFunction() != isKandR ||
+                functionType->hasVariableArgs() != hasVarArgs ) {
+                return false;
+            }
+
+            for( unsigned i = 0; i < argsType.size(); ++i ) {
+                if( functionType->getArgType(i) != argsType[i] ) {
+                    return false;
+                }
+            }
+
+            return true;
+        },
+        [&](uint32_t id) {
+            const IRTypePtr* argsCopy = arena.copyArray(argsType.data(), argsType.size());
+            return arena.create<IRFunctionType>(id, returnType, argsCopy, argsType.size(), isKandR, hasVarArgs);
+        }
+    );
+}
+
+/**
+ * Records are not looked up: each one is a new type
+ */
+const IRRecordType* IRTypeTable::createRecordType(IRType::Kind kind, const char* tag)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    const char* tagCopy = tag != nullptr ? arena.copyString(tag, std::strlen(tag)) : nullptr;
+    IRRecordType* recordType = arena.create<IRRecordType>(kind, static_cast<uint32_t>(typesById.size()), tagCopy);
+    recordType->table = this;
+    typesById.push_back(recordType);
+
+    return recordType;
+}
+
+/**
+ * The record was created by this table, in its arena: it can be modified
+ */
+void IRTypeTable::completeRecordType(const IRRecordType* recordType, const std::vector<IRField>& fields)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    IRRecordType* record = const_cast<IRRecordType *>(recordType);
+    record->fields = arena.copyArray(fields.data(), fields.size());
+    record->nbFields = static_cast<unsigned>(fields.size());
+    record->complete = true;
+}
+
+/**
+ * Return the type with the given id, or nullptr
+ */
+IRTypePtr IRTypeTable::getType(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return id < typesById.size() ? typesById[id] : nullptr;
+}
+
+/**
+ * Number of types in the table, including the builtin ones
+ */
+size_t IRTypeTable::getNbTypes()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return typesById.size() - 1;
+}
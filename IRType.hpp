@@ -0,0 +1,249 @@
+// IRType.hpp
+//
+// Author: Marco Jacques
+//
+// Types of the intermediate representation
+//
+
+#pragma once
+
+#include "Arena.hpp"
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+class Identifier;
+class IRPointerType;
+class IRTypeTable;
+
+/**
+ * Types are uniqued: there is only one node for each distinct type, so two types
+ * are the same if and only if they are the same pointer.
+ */
+class IRType {
+public:
+    enum Kind {
+        VOID,
+        CHAR, SIGNED_CHAR, UNSIGNED_CHAR,
+        SHORT, UNSIGNED_SHORT,
+        INT, UNSIGNED,
+        LONG, UNSIGNED_LONG,
+        FLOAT, DOUBLE, LONG_DOUBLE,
+        POINTER,
+        ARRAY,
+        FUNCTION,
+        STRUCT,
+        UNION,
+
+        NB_KINDS,
+
+        NB_BUILTIN_TYPES = POINTER
+    };
+
+    Kind getKind() const { return kind; }
+
+    /**
+     * Unique number of the type in its type table.  The builtin types have the same
+     * number in all tables.
+     */
+    uint32_t getId() const { return id; }
+
+protected:
+    constexpr IRType(Kind kind_, uint32_t id_) : kind(kind_), id(id_), table(nullptr), pointerType(nullptr) { }
+
+    // Not virtual: the types live in their table arena, or are static, and are
+    // never destroyed one by one
+    //
+    ~IRType() = default;
+
+private:
+    friend class IRTypeTable;
+
+    Kind kind;
+    uint32_t id;
+
+    // Table that created the type, nullptr for the builtin types.  Set before the
+    // type is published, never changed after.
+    //
+    const IRTypeTable* table;
+
+    // Pointer to this type, once created: getPointerType() doesn't need the table lock.
+    // Only used by the table that created the type: the builtin types are shared by
+    // all the tables, and the pointer of another table could outlive it.
+    //
+    mutable std::atomic<const IRPointerType*> pointerType;
+};
+
+using IRTypePtr = const IRType*;
+
+class IRBuiltinType : public IRType {
+public:
+    constexpr IRBuiltinType(Kind kind_) : IRType(kind_, kind_ + 1) { }
+
+    static bool classof(const IRType* type) { return type->getKind() < POINTER; }
+};
+
+class IRPointerType : public IRType {
+public:
+    IRPointerType(uint32_t id_, IRTypePtr targetType_) : IRType(POINTER, id_), targetType(targetType_) { }
+
+    IRTypePtr getTargetType() const { return targetType; }
+
+    static bool classof(const IRType* type) { return type->getKind() == POINTER; }
+
+private:
+    IRTypePtr targetType;
+};
+
+class IRArrayType : public IRType {
+public:
+    IRArrayType(uint32_t id_, IRTypePtr elementType_, uint64_t nbElements_) :
+        IRType(ARRAY, id_), elementType(elementType_), nbElements(nbElements_) { }
+
+    IRTypePtr getElementType() const { return elementType; }
+    uint64_t getNbElements() const { return nbElements; }
+
+    static bool classof(const IRType* type) { return type->getKind() == ARRAY; }
+
+private:
+    IRTypePtr elementType;
+    uint64_t nbElements;
+};
+
+class IRFunctionType : public IRType {
+public:
+    IRFunctionType(uint32_t id_, IRTypePtr returnType_, const IRTypePtr* argsType_, unsigned nbArgs_, bool isKandR_, bool hasVarArgs_) :
+        IRType(FUNCTION, id_), returnType(returnType_), argsType(argsType_), nbArgs(nbArgs_),
+        isKandR(isKandR_), hasVarArgs(hasVarArgs_) { }
+
+    IRTypePtr getReturnType() const { return returnType; }
+    unsigned getNbArgs() const { return nbArgs; }
+    IRTypePtr getArgType(unsigned index) const { return argsType[index]; }
+    bool isKandRFunction() const { return isKandR; }
+    bool hasVariableArgs() const { return hasVarArgs; }
+
+    static bool classof(const IRType* type) { return type->getKind() == FUNCTION; }
+
+private:
+    IRTypePtr returnType;
+    const IRTypePtr* argsType;
+    unsigned nbArgs;
+    bool isKandR;
+    bool hasVarArgs;
+};
+
+/**
+ * Member of a struct or union
+ */
+struct IRField {
+    static const uint32_t NOT_BIT_FIELD = UINT32_MAX;
+
+    const Identifier* name;     // nullptr for an unnamed bit-field
+    IRTypePtr type;
+    uint32_t bitWidth;          // NOT_BIT_FIELD for the members that are not bit-fields
+
+    bool isBitField() const { return bitWidth != NOT_BIT_FIELD; }
+};
+
+/**
+ * Struct or union.  Records are not uniqued by their members: each declaration
+ * is a distinct type.  A record is incomplete until its members are given, which
+ * must be done before the record is used by another thread.
+ */
+class IRRecordType : public IRType {
+public:
+    IRRecordType(Kind kind_, uint32_t id_, const char* tag_) :
+        IRType(kind_, id_), tag(tag_), fields(nullptr), nbFields(0), complete(false) { }
+
+    /**
+     * Tag of the record, nullptr if it has none
+     */
+    const char* getTag() const { return tag; }
+
+    bool isUnion() const { return getKind() == UNION; }
+    bool isComplete() const { return complete; }
+
+    unsigned getNbFields() const { return nbFields; }
+    const IRField& getField(unsigned index) const { return fields[index]; }
+
+    static bool classof(const IRType* type) { return type->getKind() == STRUCT || type->getKind() == UNION; }
+
+private:
+    friend class IRTypeTable;
+
+    const char* tag;
+    const IRField* fields;
+    unsigned nbFields;
+    bool complete;
+};
+
+
+/**
+ * Table of the uniqued types.  Derived types are hash-consed: they are looked
+ * up by their components (which are canonical, so compared by pointer) before
+ * being created.
+ *
+ * The table may be shared by translation units parsed on different threads.
+ * Builtin types are static singletons, and a pointer type is cached in its
+ * target type (in the table for the builtin types): both are read without
+ * taking the table lock.  The types of another table can be used as components,
+ * the pointers to them are then looked up, not cached in them.
+ */
+class IRTypeTable {
+public:
+    IRTypeTable();
+
+    IRTypeTable(const IRTypeTable&) = delete;
+    IRTypeTable& operator=(const IRTypeTable&) = delete;
+
+    static IRTypePtr getBuiltinType(IRType::Kind kind);
+
+    static IRTypePtr getCharType()          { return getBuiltinType(IRType::CHAR); }
+    static IRTypePtr getSignedCharType()    { return getBuiltinType(IRType::SIGNED_CHAR); }
+    static IRTypePtr getUnsignedCharType()  { return getBuiltinType(IRType::UNSIGNED_CHAR); }
+    static IRTypePtr getShortType()         { return getBuiltinType(IRType::SHORT); }
+    static IRTypePtr getUnsignedShortType() { return getBuiltinType(IRType::UNSIGNED_SHORT); }
+    static IRTypePtr getIntType()           { return getBuiltinType(IRType::INT); }
+    static IRTypePtr getUnsignedType()      { return getBuiltinType(IRType::UNSIGNED); }
+    static IRTypePtr getLongType()          { return getBuiltinType(IRType::LONG); }
+    static IRTypePtr getUnsignedLongType()  { return getBuiltinType(IRType::UNSIGNED_LONG); }
+    static IRTypePtr getVoidType()          { return getBuiltinType(IRType::VOID); }
+    static IRTypePtr getFloatType()         { return getBuiltinType(IRType::FLOAT); }
+    static IRTypePtr getDoubleType()        { return getBuiltinType(IRType::DOUBLE); }
+    static IRTypePtr getLongDoubleType()    { return getBuiltinType(IRType::LONG_DOUBLE); }
+
+    IRTypePtr getPointerType(IRTypePtr targetType);
+    IRTypePtr getArrayType(IRTypePtr elementType, uint64_t nbElements);
+    IRTypePtr getFunctionType(IRTypePtr returnType, const std::vector<IRTypePtr>& argsType, bool isKandR, bool hasVarArgs);
+
+    /**
+     * Create a new incomplete struct (kind STRUCT) or union (kind UNION), then
+     * give its members
+     */
+    const IRRecordType* createRecordType(IRType::Kind kind, const char* tag);
+    void completeRecordType(const IRRecordType* recordType, const std::vector<IRField>& fields);
+
+    /**
+     * Return the type with the given id, or nullptr
+     */
+    IRTypePtr getType(uint32_t id);
+
+    /**
+     * Number of types in the table, including the builtin ones
+     */
+    size_t getNbTypes();
+
+private:
+    template<typename Equal, typename Create>
+    IRTypePtr findOrCreate(uint64_t hash, Equal equal, Create create);
+
+    std::atomic<const IRPointerType*>* getPointerTypeCache(IRTypePtr targetType);
+
+    std::mutex mutex;
+    Arena arena;
+    std::atomic<const IRPointerType*> builtinPointerTypes[IRType::NB_BUILTIN_TYPES];
+    std::unordered_multimap<uint64_t, IRTypePtr> types;
+    std::vector<IRTypePtr> typesById;
+};
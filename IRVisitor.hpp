@@ -0,0 +1,190 @@
+// IRVisitor.hpp
+//
+// Author: Marco Jacques
+//
+// Visitors of the IR expressions and types
+//
+
+#pragma once
+
+#include "IR.hpp"
+#include "IRType.hpp"
+#include <type_traits>
+
+namespace IRVisitorDetail {
+
+    template<typename T>
+    struct AlwaysFalse : std::false_type { };
+}
+
+/**
+ * Visitor of the expressions, dispatching on the kind of the node.  The calls to
+ * the visit methods are static (CRTP): they can be inlined, there are no virtual
+ * calls and no RTTI.
+ *
+ * A pass derives from IRExprVisitor<Pass, Result> and defines the visit methods of
+ * the node classes it handles.  The ones it doesn't define go to visitExpr: a pass
+ * that doesn't define visitExpr must handle all the node classes, else it doesn't
+ * compile.
+ *
+ *     class NodeCounter : public IRExprVisitor<NodeCounter, int> {
+ *     public:
+ *         int visitBinaryExpr(const IRBinaryExpr* expr) { return 1 + visit(expr->getLeftExpr()) + visit(expr->getRightExpr()); }
+ *         int visitExpr(IRExprPtr expr) { return 1; }
+ *     };
+ */
+template<typename Derived, typename Result = void>
+class IRExprVisitor {
+public:
+    Result visit(IRExprPtr expr)
+    {
+        static_assert(IRExpr::NB_KINDS == IRExpr::CHAIN + 1, "New expression kinds must be dispatched by IRExprVisitor");
+
+        Derived* derived = static_cast<Derived *>(this);
+        switch( expr->getKind() ) {
+            case IRExpr::ID:                    return derived->visitIdExpr(static_cast<const IRIdExpr *>(expr));
+            case IRExpr::INT_LITERAL:           return derived->visitIntLitExpr(static_cast<const IRIntLitExpr *>(expr));
+            case IRExpr::FLOAT_LITERAL:         return derived->visitFloatLitExpr(static_cast<const IRFloatLitExpr *>(expr));
+            case IRExpr::STRING_LITERAL:        return derived->visitStringLitExpr(static_cast<const IRStringLitExpr *>(expr));
+
+            case IRExpr::CALL:                  return derived->visitCallExpr(static_cast<const IRCallExpr *>(expr));
+
+            case IRExpr::FIELD_DIRECT_ACCESS:
+            case IRExpr::FIELD_INDIRECT_ACCESS: return derived->visitFieldAccessExpr(static_cast<const IRFieldAccessExpr *>(expr));
+
+            case IRExpr::POST_INCR:
+            case IRExpr::POST_DECR:
+            case IRExpr::PRE_INCR:
+            case IRExpr::PRE_DECR:
+            case IRExpr::ADDRESS_OF:
+            case IRExpr::DEREFERENCE:
+            case IRExpr::UNARY_PLUS:
+            case IRExpr::UNARY_MINUS:
+            case IRExpr::BIT_NOT:
+            case IRExpr::BOOL_NOT:
+            case IRExpr::SIZEOF_EXPR:           return derived->visitUnaryExpr(static_cast<const IRUnaryExpr *>(expr));
+
+            case IRExpr::SIZEOF_TYPE:           return derived->visitSizeofTypeExpr(static_cast<const IRSizeofTypeExpr *>(expr));
+            case IRExpr::CAST:                  return derived->visitCastExpr(static_cast<const IRCastExpr *>(expr));
+
+            case IRExpr::ARRAY_SUBSCRIPT:
+            case IRExpr::MUL:
+            case IRExpr::DIV:
+            case IRExpr::MOD:
+            case IRExpr::ADD:
+            case IRExpr::SUB:
+            case IRExpr::SHIFT_LEFT:
+            case IRExpr::SHIFT_RIGHT:
+            case IRExpr::LESS_THAN:
+            case IRExpr::GREATER_THAN:
+            case IRExpr::LESS_EQUAL:
+            case IRExpr::GREATER_EQUAL:
+            case IRExpr::EQUAL:
+            case IRExpr::NOT_EQUAL:
+            case IRExpr::BIT_AND:
+            case IRExpr::BIT_XOR:
+            case IRExpr::BIT_IOR:
+            case IRExpr::BOOL_AND:
+            case IRExpr::BOOL_OR:
+            case IRExpr::ASSIGN:
+            case IRExpr::MUL_ASSIGN:
+            case IRExpr::DIV_ASSIGN:
+            case IRExpr::MOD_ASSIGN:
+            case IRExpr::ADD_ASSIGN:
+            case IRExpr::SUB_ASSIGN:
+            case IRExpr::SHIFT_LEFT_ASSIGN:
+            case IRExpr::SHIFT_RIGHT_ASSIGN:
+            case IRExpr::BIT_AND_ASSIGN:
+            case IRExpr::BIT_XOR_ASSIGN:
+            case IRExpr::BIT_IOR_ASSIGN:
+            case IRExpr::COMMA:                 return derived->visitBinaryExpr(static_cast<const IRBinaryExpr *>(expr));
+
+            case IRExpr::COND:                  return derived->visitCondExpr(static_cast<const IRCondExpr *>(expr));
+            case IRExpr::CHAIN:                 return derived->visitChainExpr(static_cast<const IRChainExpr *>(expr));
+
+            case IRExpr::NB_KINDS:              break;
+        }
+
+        // Not reached: all the kinds are dispatched
+        //
+        return Result();
+    }
+
+    Result visitIdExpr(const IRIdExpr* expr)                   { return static_cast<Derived *>(this)->visitExpr(expr); }
+    Result visitIntLitExpr(const IRIntLitExpr* expr)           { return static_cast<Derived *>(this)->visitExpr(expr); }
+    Result visitFloatLitExpr(const IRFloatLitExpr* expr)       { return static_cast<Derived *>(this)->visitExpr(expr); }
+    Result visitStringLitExpr(const IRStringLitExpr* expr)     { return static_cast<Derived *>(this)->visitExpr(expr); }
+    Result visitCallExpr(const IRCallExpr* expr)               { return static_cast<Derived *>(this)->visitExpr(expr); }
+    Result visitFieldAccessExpr(const IRFieldAccessExpr* expr) { return static_cast<Derived *>(this)->visitExpr(expr); }
+    Result visitUnaryExpr(const IRUnaryExpr* expr)             { return static_cast<Derived *>(this)->visitExpr(expr); }
+    Result visitSizeofTypeExpr(const IRSizeofTypeExpr* expr)   { return static_cast<Derived *>(this)->visitExpr(expr); }
+    Result visitCastExpr(const IRCastExpr* expr)               { return static_cast<Derived *>(this)->visitExpr(expr); }
+    Result visitBinaryExpr(const IRBinaryExpr* expr)           { return static_cast<Derived *>(this)->visitExpr(expr); }
+    Result visitCondExpr(const IRCondExpr* expr)               { return static_cast<Derived *>(this)->visitExpr(expr); }
+    Result visitChainExpr(const IRChainExpr* expr)             { return static_cast<Derived *>(this)->visitExpr(expr); }
+
+    /**
+     * Fallback of the node classes the pass doesn't handle
+     */
+    Result visitExpr(IRExprPtr)
+    {
+        static_assert(IRVisitorDetail::AlwaysFalse<Derived>::value, "The visitor must handle every node class, or define visitExpr");
+    }
+};
+
+
+/**
+ * Visitor of the types, the same way
+ */
+template<typename Derived, typename Result = void>
+class IRTypeVisitor {
+public:
+    Result visit(IRTypePtr type)
+    {
+        static_assert(IRType::NB_KINDS == IRType::UNION + 1, "New type kinds must be dispatched by IRTypeVisitor");
+
+        Derived* derived = static_cast<Derived *>(this);
+        switch( type->getKind() ) {
+            case IRType::VOID:
+            case IRType::CHAR:
+            case IRType::SIGNED_CHAR:
+            case IRType::UNSIGNED_CHAR:
+            case IRType::SHORT:
+            case IRType::UNSIGNED_SHORT:
+            case IRType::INT:
+            case IRType::UNSIGNED:
+            case IRType::LONG:
+            case IRType::UNSIGNED_LONG:
+            case IRType::FLOAT:
+            case IRType::DOUBLE:
+            case IRType::LONG_DOUBLE: return derived->visitBuiltinType(static_cast<const IRBuiltinType *>(type));
+
+            case IRType::POINTER:     return derived->visitPointerType(static_cast<const IRPointerType *>(type));
+            case IRType::ARRAY:       return derived->visitArrayType(static_cast<const IRArrayType *>(type));
+            case IRType::FUNCTION:    return derived->visitFunctionType(static_cast<const IRFunctionType *>(type));
+
+            case IRType::STRUCT:
+            case IRType::UNION:       return derived->visitRecordType(static_cast<const IRRecordType *>(type));
+
+            case IRType::NB_KINDS:    break;
+        }
+
+        // Not reached: all the kinds are dispatched
+        //
+        return Result();
+    }
+
+    Result visitBuiltinType(const IRBuiltinType* type)     { return static_cast<Derived *>(this)->visitType(type); }
+    Result visitPointerType(const IRPointerType* type)     { return static_cast<Derived *>(this)->visitType(type); }
+    Result visitArrayType(const IRArrayType* type)         { return static_cast<Derived *>(this)->visitType(type); }
+    Result visitFunctionType(const IRFunctionType* type)   { return static_cast<Derived *>(this)->visitType(type); }
+    Result visitRecordType(const IRRecordType* type)       { return static_cast<Derived *>(this)->visitType(type); }
+
+    /**
+     * Fallback of the type classes the pass doesn't handle
+     */
+    Result visitType(IRTypePtr)
+    {
+        static_assert(IRVisitorDetail::AlwaysFalse<Derived>::value, "The visitor must handle every type class, or define visitType");
+    }
+};
@@ -6,6 +6,7 @@
 //
 #include "Lexer.hpp"
 #include <cctype>
+#include <cstdlib>
 #include <string>
 
 /**
@@ -113,11 +114,135 @@ std::shared_ptr<LexerToken> C90Lexer::readIdOrKeyword()
 }
 
 /**
- * Read a number (TO IMPLEMEMT)
+ * Read the digits of a number in the given base.  Octal numbers are read with all
+ * the decimal digits, to report 8 and 9 as errors.
  */
-std::shared_ptr<LexerToken> C90Lexer::readNumber()
+void C90Lexer::readDigits(std::string& numberString, bool isHex)
 {
-    return nullptr;
+    int nextChar = charReader->peekNextChar();
+    while( isHex ? std::isxdigit(nextChar) : std::isdigit(nextChar) ) {
+        numberString.push_back(nextChar);
+        charReader->getNextChar();
+        nextChar = charReader->peekNextChar();
+    }
+}
+
+/**
+ * Read a number: an integer constant (decimal, octal or hexadecimal, with the u and
+ * l suffixes) or a floating constant.  afterDot is set when the '.' starting a
+ * floating constant (ex: .5) is already read.
+ */
+std::shared_ptr<LexerToken> C90Lexer::readNumber(bool afterDot)
+{
+    // TODO: need to handle source position somehow...
+    //
+    SourcePosition dummyPosition(std::make_shared<std::string>("dummy"), 1, 1);
+
+    std::string numberString;
+    bool isHex = false;
+    bool isFloat = false;
+
+    if( afterDot ) {
+        isFloat = true;
+        numberString.push_back('.');
+    }
+    else if( charReader->peekNextChar() == '0' ) {
+        numberString.push_back(charReader->getNextChar());
+        int nextChar = charReader->peekNextChar();
+        if( nextChar == 'x' || nextChar == 'X' ) {
+            charReader->getNextChar();
+            isHex = true;
+            numberString.clear();
+        }
+    }
+
+    readDigits(numberString, isHex);
+    if( isHex && numberString.empty() ) {
+        msg->issueMessage(dummyPosition, Message::ERROR_INVALID_NUMBER, {"0x"});
+        return std::make_shared<IntLiteralToken>(0);
+    }
+
+    // Fraction and exponent of a floating constant
+    //
+    if( !isHex && !afterDot && charReader->peekNextChar() == '.' ) {
+        isFloat = true;
+        numberString.push_back(charReader->getNextChar());
+        readDigits(numberString, false);
+    }
+
+    int nextChar = charReader->peekNextChar();
+    if( !isHex && (nextChar == 'e' || nextChar == 'E') ) {
+        isFloat = true;
+        numberString.push_back(charReader->getNextChar());
+
+        nextChar = charReader->peekNextChar();
+        if( nextChar == '+' || nextChar == '-' ) {
+            numberString.push_back(charReader->getNextChar());
+        }
+
+        size_t exponentStart = numberString.size();
+        readDigits(numberString, false);
+        if( numberString.size() == exponentStart ) {
+            msg->issueMessage(dummyPosition, Message::ERROR_INVALID_NUMBER, {numberString});
+            return std::make_shared<FloatLiteralToken>(0.0);
+        }
+    }
+
+    // Suffixes
+    //
+    std::string suffix;
+    nextChar = charReader->peekNextChar();
+    while( std::isalnum(nextChar) || nextChar == '_' ) {
+        suffix.push_back(nextChar);
+        charReader->getNextChar();
+        nextChar = charReader->peekNextChar();
+    }
+
+    if( isFloat ) {
+        FloatLiteralToken::Suffix floatSuffix = FloatLiteralToken::NO_SUFFIX;
+        if( suffix == "f" || suffix == "F" ) {
+            floatSuffix = FloatLiteralToken::FLOAT_SUFFIX;
+        }
+        else if( suffix == "l" || suffix == "L" ) {
+            floatSuffix = FloatLiteralToken::LONG_SUFFIX;
+        }
+        else if( !suffix.empty() ) {
+            msg->issueMessage(dummyPosition, Message::ERROR_INVALID_NUMBER, {numberString + suffix});
+        }
+
+        return std::make_shared<FloatLiteralToken>(std::strtod(numberString.c_str(), nullptr), floatSuffix);
+    }
+
+    bool hasUnsignedSuffix = false;
+    bool hasLongSuffix = false;
+    for( char suffixChar : suffix ) {
+        bool& hasSuffix = (suffixChar == 'u' || suffixChar == 'U') ? hasUnsignedSuffix : hasLongSuffix;
+        if( hasSuffix || std::string("uUlL").find(suffixChar) == std::string::npos ) {
+            msg->issueMessage(dummyPosition, Message::ERROR_INVALID_NUMBER, {numberString + suffix});
+            break;
+        }
+        hasSuffix = true;
+    }
+
+    // Value, checking the overflow
+    //
+    unsigned base = isHex ? 16 : (numberString.size() > 1 && numberString[0] == '0' ? 8 : 10);
+    uint64_t value = 0;
+    for( char digitChar : numberString ) {
+        unsigned digit = std::isdigit(digitChar) ? digitChar - '0' : std::tolower(digitChar) - 'a' + 10;
+        if( digit >= base ) {
+            msg->issueMessage(dummyPosition, Message::ERROR_INVALID_NUMBER, {numberString});
+            break;
+        }
+
+        if( value > (UINT64_MAX - digit) / base ) {
+            msg->issueMessage(dummyPosition, Message::ERROR_INTEGER_TOO_LARGE, {numberString});
+            break;
+        }
+        value = value * base + digit;
+    }
+
+    return std::make_shared<IntLiteralToken>(value, hasUnsignedSuffix, hasLongSuffix, base == 10);
 }
 
 /**
@@ -258,10 +383,17 @@ std::shared_ptr<LexerToken> C90Lexer::readOtherToken()
                         return nullptr;
                     }
 
-                    return operators["..."];
+                    return acceptAndReturn("...");
                 }
             
-                default: return operators["."];
+                default:
+                    // Floating constant without integer part
+                    //
+                    if( std::isdigit(nextChar1) ) {
+                        return readNumber(true);
+                    }
+
+                    return operators["."];
             }
             return operators["."];
         }
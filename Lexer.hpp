@@ -42,7 +42,8 @@ public:
 protected:
  
     LexerTokenPtr readIdOrKeyword();
-    LexerTokenPtr readNumber();
+    LexerTokenPtr readNumber(bool afterDot = false);
+    void readDigits(std::string& numberString, bool isHex);
     LexerTokenPtr readOtherToken();
     void addC90KeywordsAndOperators();
     void skipWhiteSpaces();
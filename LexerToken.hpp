@@ -8,6 +8,8 @@
 #pragma once
 
 #include "SourcePosition.hpp"
+#include <cstdint>
+#include <memory>
 #include <string>
 
 
@@ -57,6 +59,8 @@ public:
         MUL_ASSIGN, DIV_ASSIGN, MOD_ASSIGN, ADD_ASSIGN, SUB_ASSIGN,
         SHIFT_LEFT_ASSIGN, SHIFT_RIGHT_ASSIGN,
         BIT_AND_ASSIGN, BIT_XOR_ASSIGN, BIT_IOR_ASSIGN,
+        LEFT_BRACE, RIGHT_BRACE, SEMICOLON,
+        HASH, HASH_HASH,        /* only in preprocessing */
         END_TOKEN_OP,
 
         UNKNOWN,
@@ -92,27 +96,71 @@ public:
  * Class for tokens representing identifiers
  */
 class IdToken : public LexerToken {
+    std::string name;
+
 public:
-    IdToken(const std::string&) : LexerToken(LexerToken::IDENTIFIER) { }
+    IdToken(const std::string& name_) : LexerToken(LexerToken::IDENTIFIER), name(name_) { }
     virtual ~IdToken() = default;
+
+    const std::string& getName() const { return name; }
 };
 
 /**
- * Class for tokens representing integer values
+ * Class for tokens representing integer values.  The suffixes and the base are
+ * kept, as they decide the type of the constant.
  */
 class IntLiteralToken : public LexerToken {
+    uint64_t value;
+    bool hasUnsignedSuffix;
+    bool hasLongSuffix;
+    bool decimal;
+
 public:
-    IntLiteralToken() : LexerToken(LexerToken::INTEGER_LITERAL) { }
+    IntLiteralToken(uint64_t value_ = 0, bool hasUnsignedSuffix_ = false, bool hasLongSuffix_ = false, bool decimal_ = true) :
+        LexerToken(LexerToken::INTEGER_LITERAL), value(value_),
+        hasUnsignedSuffix(hasUnsignedSuffix_), hasLongSuffix(hasLongSuffix_), decimal(decimal_) { }
     ~IntLiteralToken() = default;
+
+    uint64_t getValue() const { return value; }
+    bool isUnsigned() const { return hasUnsignedSuffix; }
+    bool isLong() const { return hasLongSuffix; }
+    bool isDecimal() const { return decimal; }
+};
+
+/**
+ * Class for tokens representing floating values
+ */
+class FloatLiteralToken : public LexerToken {
+public:
+    enum Suffix {
+        NO_SUFFIX,
+        FLOAT_SUFFIX,
+        LONG_SUFFIX
+    };
+
+    FloatLiteralToken(double value_ = 0.0, Suffix suffix_ = NO_SUFFIX) :
+        LexerToken(LexerToken::FLOAT_LITERAL), value(value_), suffix(suffix_) { }
+    ~FloatLiteralToken() = default;
+
+    double getValue() const { return value; }
+    Suffix getSuffix() const { return suffix; }
+
+private:
+    double value;
+    Suffix suffix;
 };
 
 /**
  * Class for tokens representing string literals
  */
 class StringLiteralToken : public LexerToken {
+    std::string value;
+
 public:
-    StringLiteralToken() : LexerToken(LexerToken::STRING_LITERAL) { }
+    StringLiteralToken(const std::string& value_ = "") : LexerToken(LexerToken::STRING_LITERAL), value(value_) { }
     ~StringLiteralToken() = default;
+
+    const std::string& getValue() const { return value; }
 };
 
 /**
@@ -19,7 +19,25 @@ public:
         ERROR_INVALID_TYPE_COMBO,
         ERROR_EXPECTED_TOKEN,
         WARNING_TRIGRAPH_REPLACED,
-        ERROR_UNKNOWN_CHARACTER
+        ERROR_UNKNOWN_CHARACTER,
+        ERROR_INVALID_NUMBER,
+        ERROR_INTEGER_TOO_LARGE,
+        ERROR_UNTERMINATED_COMMENT,
+        ERROR_UNTERMINATED_LITERAL,
+        ERROR_INVALID_DIRECTIVE,
+        ERROR_MACRO_REDEFINED,
+        ERROR_MACRO_ARG_COUNT,
+        ERROR_UNTERMINATED_MACRO_CALL,
+        ERROR_INVALID_PASTE,
+        ERROR_INCLUDE_NOT_FOUND,
+        ERROR_INCLUDE_TOO_DEEP,
+        ERROR_UNTERMINATED_CONDITIONAL,
+        ERROR_UNMATCHED_CONDITIONAL,
+        ERROR_INVALID_CONDITION,
+        ERROR_DIVISION_BY_ZERO,
+        ERROR_ARRAY_BOUND_NOT_CONSTANT,
+        ERROR_INVALID_ARRAY_BOUND,
+        ERROR_UNSUPPORTED_TYPE_SPECIFIER
     };
 
     virtual void issueMessage(const SourcePosition& sourcePosition, Msg msg, std::initializer_list<std::string> args) = 0;
@@ -0,0 +1,89 @@
+// NullIRBuilder.hpp
+//
+// Author: Marco Jacques
+//
+// Builder of the parser that builds nothing
+//
+
+#pragma once
+
+#include "IR.hpp"
+#include <vector>
+
+/**
+ * Builder with the interface of IRFactory that creates no node: all the
+ * expressions are nullptr.  Parsing with it only checks the syntax, without
+ * allocating the IR.  Everything is inline, so the calls compile away.
+ */
+class NullIRBuilder {
+public:
+    using ExprPtr = IRExprPtr;
+
+    ExprPtr createIdExpr(const LexerTokenPtr&)                                { return nullptr; }
+    ExprPtr createIntLitExpr(const LexerTokenPtr&)                            { return nullptr; }
+    ExprPtr createFloatLitExpr(const LexerTokenPtr&)                          { return nullptr; }
+    ExprPtr createStringLitExpr(const LexerTokenPtr&)                         { return nullptr; }
+
+    ExprPtr createArraySubscripting(ExprPtr, ExprPtr)                         { return nullptr; }
+    ExprPtr createCallExpr(ExprPtr, const std::vector<ExprPtr>&)              { return nullptr; }
+    ExprPtr createStructFieldDirectAccess(ExprPtr, const LexerTokenPtr&)      { return nullptr; }
+    ExprPtr createStructFieldIndirectAccess(ExprPtr, const LexerTokenPtr&)    { return nullptr; }
+    ExprPtr createPostIncrExpr(ExprPtr)                                       { return nullptr; }
+    ExprPtr createPostDecrExpr(ExprPtr)                                       { return nullptr; }
+
+    ExprPtr createPreIncrExpr(ExprPtr)                                        { return nullptr; }
+    ExprPtr createPreDecrExpr(ExprPtr)                                        { return nullptr; }
+    ExprPtr createAddressOfExpr(ExprPtr)                                      { return nullptr; }
+    ExprPtr createDereferenceExpr(ExprPtr)                                    { return nullptr; }
+    ExprPtr createUnaryPlusExpr(ExprPtr)                                      { return nullptr; }
+    ExprPtr createUnaryMinusExpr(ExprPtr)                                     { return nullptr; }
+    ExprPtr createBitNotExpr(ExprPtr)                                         { return nullptr; }
+    ExprPtr createBoolNotExpr(ExprPtr)                                        { return nullptr; }
+    ExprPtr createSizeofExpr(ExprPtr)                                         { return nullptr; }
+    ExprPtr createSizeofTypeExpr(IRTypePtr)                                   { return nullptr; }
+
+    ExprPtr createCastExpr(IRTypePtr, ExprPtr)                                { return nullptr; }
+
+    ExprPtr createMulExpr(ExprPtr, ExprPtr)                                   { return nullptr; }
+    ExprPtr createDivExpr(ExprPtr, ExprPtr)                                   { return nullptr; }
+    ExprPtr createModExpr(ExprPtr, ExprPtr)                                   { return nullptr; }
+
+    ExprPtr createAddExpr(ExprPtr, ExprPtr)                                   { return nullptr; }
+    ExprPtr createSubExpr(ExprPtr, ExprPtr)                                   { return nullptr; }
+
+    ExprPtr createShiftLeftExpr(ExprPtr, ExprPtr)                             { return nullptr; }
+    ExprPtr createShiftRightExpr(ExprPtr, ExprPtr)                            { return nullptr; }
+
+    ExprPtr createLessThanExpr(ExprPtr, ExprPtr)                              { return nullptr; }
+    ExprPtr createGreaterThanExpr(ExprPtr, ExprPtr)                           { return nullptr; }
+    ExprPtr createLessEqualExpr(ExprPtr, ExprPtr)                             { return nullptr; }
+    ExprPtr createGreaterEqualExpr(ExprPtr, ExprPtr)                          { return nullptr; }
+
+    ExprPtr createEqualExpr(ExprPtr, ExprPtr)                                 { return nullptr; }
+    ExprPtr createNotEqualExpr(ExprPtr, ExprPtr)                              { return nullptr; }
+
+    ExprPtr createBitAndExpr(ExprPtr, ExprPtr)                                { return nullptr; }
+    ExprPtr createBitXorExpr(ExprPtr, ExprPtr)                                { return nullptr; }
+    ExprPtr createBitIorExpr(ExprPtr, ExprPtr)                                { return nullptr; }
+
+    ExprPtr createBoolAndExpr(ExprPtr, ExprPtr)                               { return nullptr; }
+    ExprPtr createBoolOrExpr(ExprPtr, ExprPtr)                                { return nullptr; }
+
+    ExprPtr createCondExpr(ExprPtr, ExprPtr, ExprPtr)                         { return nullptr; }
+
+    ExprPtr createAssignExpr(ExprPtr, ExprPtr)                                { return nullptr; }
+    ExprPtr createMulAssignExpr(ExprPtr, ExprPtr)                             { return nullptr; }
+    ExprPtr createDivAssignExpr(ExprPtr, ExprPtr)                             { return nullptr; }
+    ExprPtr createModAssignExpr(ExprPtr, ExprPtr)                             { return nullptr; }
+    ExprPtr createAddAssignExpr(ExprPtr, ExprPtr)                             { return nullptr; }
+    ExprPtr createSubAssignExpr(ExprPtr, ExprPtr)                             { return nullptr; }
+    ExprPtr createShiftLeftAssignExpr(ExprPtr, ExprPtr)                       { return nullptr; }
+    ExprPtr createShiftRightAssignExpr(ExprPtr, ExprPtr)                      { return nullptr; }
+    ExprPtr createBitAndAssignExpr(ExprPtr, ExprPtr)                          { return nullptr; }
+    ExprPtr createBitXorAssignExpr(ExprPtr, ExprPtr)                          { return nullptr; }
+    ExprPtr createBitIorAssignExpr(ExprPtr, ExprPtr)                          { return nullptr; }
+
+    ExprPtr createCommaExpr(ExprPtr, ExprPtr)                                 { return nullptr; }
+
+    ExprPtr createAssociativeChain(IRExpr::Kind, const std::vector<ExprPtr>&) { return nullptr; }
+};
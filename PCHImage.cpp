@@ -0,0 +1,470 @@
+// PCHImage.cpp
+//
+// Author: Marco Jacques
+//
+// Precompiled header: the state of a compilation after its prefix header
+//
+
+#include "PCHImage.hpp"
+#include "Hashing.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace {
+
+    const char MAGIC[8] = { 'M', 'Y', 'C', 'C', '-', 'P', 'H', '\0' };
+
+    // Written in the native byte order: an image from a machine of the other
+    // byte order doesn't match
+    //
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    // String that is not there: file without include guard
+    //
+    const uint32_t NO_INDEX = UINT32_MAX;
+
+    enum Section {
+        STRINGS,
+        DEPENDENCIES,
+        MACROS,
+        MACRO_TOKENS,
+        IDENTIFIERS,
+        SYMBOLS,
+        TYPES,
+        TYPE_NAMES,
+        IR,
+
+        NB_SECTIONS
+    };
+
+    /**
+     * Header of the image.  The sections are 8 bytes aligned, their offsets are
+     * from the start of the image.
+     */
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t imageSize;
+        uint64_t checksum;                      // Of everything after the header
+        uint64_t configurationHash;
+        uint64_t sectionOffsets[NB_SECTIONS];
+        uint64_t sectionSizes[NB_SECTIONS];     // In bytes
+    };
+
+    enum GuardFlags {
+        HAS_GUARD = 1 << 0,
+        PRAGMA_ONCE = 1 << 1
+    };
+
+    /**
+     * Strings of the image, each stored once and null terminated
+     */
+    class StringSection {
+    public:
+        uint32_t add(const char* value, size_t length)
+        {
+            auto inserted = offsets.insert(std::make_pair(std::string(value, length), static_cast<uint32_t>(chars.size())));
+            if( inserted.second ) {
+                chars.append(value, length);
+                chars.push_back('\0');
+            }
+            return inserted.first->second;
+        }
+
+        uint32_t add(const std::string& value) { return add(value.data(), value.size()); }
+
+        const std::string& getChars() const { return chars; }
+
+    private:
+        std::unordered_map<std::string, uint32_t> offsets;
+        std::string chars;
+    };
+}
+
+/**
+ * File read by the compilation, and its include guard
+ */
+struct PCHImage::Dependency {
+    uint64_t contentHash;
+    uint32_t path;
+    uint32_t guardMacro;
+    uint32_t guardFlags;
+    uint32_t unused;
+};
+
+/**
+ * Macro definition, its replacement list being in the macro tokens
+ */
+struct PCHImage::Macro {
+    uint32_t name;
+    uint32_t nameLength;
+    uint32_t firstToken;
+    uint32_t nbTokens;
+    uint32_t nbParams;
+    uint32_t functionLike;
+};
+
+struct PCHImage::MacroToken {
+    uint32_t spelling;
+    uint32_t length;
+    uint32_t paramIndex;
+    uint8_t kind;
+    uint8_t punctuator;
+    uint8_t flags;
+    uint8_t unused;
+};
+
+struct PCHImage::IdentifierName {
+    uint32_t name;
+    uint32_t length;
+};
+
+struct PCHImage::FileScopeSymbol {
+    uint32_t identifier;
+    uint32_t kind;
+    uint32_t typeId;
+    uint32_t unused;
+    int64_t value;
+};
+
+const uint32_t PCHImage::VERSION;
+
+uint64_t PCHImage::hashConfiguration(const std::vector<std::string>& includePaths, const TargetABI& abi, uint64_t optionsHash)
+{
+    uint64_t hash = Hashing::hashBytes(&abi, sizeof(abi), optionsHash);
+    for( const std::string& includePath : includePaths ) {
+        hash = Hashing::combine(hash, Hashing::hashBytes(includePath.data(), includePath.size()));
+    }
+
+    return hash;
+}
+
+/**
+ * Write the image: the header is filled last, with the checksum
+ */
+void PCHImage::write(
+    const C90Preprocessor& preprocessor,
+    const SymbolTable& symbolTable,
+    IRTypeTable& typeTable,
+    const FlatIR* ir,
+    uint64_t configurationHash,
+    std::vector<char>& image
+    )
+{
+    StringSection strings;
+
+    // The files read, the main file included, with the hash of their content when
+    // the preprocessor read them
+    //
+    std::vector<Dependency> dependencies;
+    for( size_t i = 0; i < preprocessor.getDependencies().size(); ++i ) {
+        const std::string& path = preprocessor.getDependencies()[i];
+        Dependency dependency{preprocessor.getDependencyHashes()[i], strings.add(path), NO_INDEX, 0, 0};
+        PPFileId fileId;
+        bool pragmaOnce = false;
+        std::string guardMacro;
+        if( getFileId(path, fileId) && preprocessor.getIncludeGuards().findGuard(fileId, pragmaOnce, guardMacro) ) {
+            dependency.guardFlags = HAS_GUARD | (pragmaOnce ? PRAGMA_ONCE : 0);
+            dependency.guardMacro = strings.add(guardMacro);
+        }
+        dependencies.push_back(dependency);
+    }
+
+    std::vector<const PPMacro *> definedMacros;
+    preprocessor.getMacroTable()->getMacros(definedMacros);
+    std::vector<Macro> macros;
+    std::vector<MacroToken> macroTokens;
+    for( const PPMacro* macro : definedMacros ) {
+        std::string name = macro->getName();
+        macros.push_back(Macro{strings.add(name), static_cast<uint32_t>(name.size()), static_cast<uint32_t>(macroTokens.size()),
+            macro->getBodySize(), macro->getNbParams(), macro->isFunctionLike() ? 1u : 0u});
+        for( unsigned i = 0; i < macro->getBodySize(); ++i ) {
+            const PPExpandedToken& token = macro->getBodyToken(i);
+            macroTokens.push_back(MacroToken{strings.add(token.spelling, token.length), token.length, macro->getParamIndex(i),
+                static_cast<uint8_t>(token.kind), token.punctuator, token.flags, 0});
+        }
+    }
+
+    std::vector<Identifier *> tableIdentifiers;
+    symbolTable.getIdentifiers(tableIdentifiers);
+    std::vector<IdentifierName> identifiers;
+    for( const Identifier* identifier : tableIdentifiers ) {
+        identifiers.push_back(IdentifierName{strings.add(identifier->getName(), identifier->getLength()), static_cast<uint32_t>(identifier->getLength())});
+    }
+
+    // The declarations of the file scope, the ones of the open blocks are not kept
+    //
+    std::vector<FileScopeSymbol> symbols;
+    for( size_t i = 0; i < tableIdentifiers.size(); ++i ) {
+        Symbol* symbol = tableIdentifiers[i]->getSymbol();
+        while( symbol != nullptr && symbol->getScopeDepth() > 0 ) {
+            symbol = symbol->getShadowed();
+        }
+        if( symbol != nullptr ) {
+            symbols.push_back(FileScopeSymbol{static_cast<uint32_t>(i), static_cast<uint32_t>(symbol->getKind()),
+                symbol->getType() != nullptr ? symbol->getType()->getId() : 0, 0, symbol->getValue()});
+        }
+    }
+
+    // All the types of the table, the member names going with them
+    //
+    IRTypeSection types;
+    size_t nbTypes = typeTable.getNbTypes();
+    for( uint32_t id = IRType::NB_BUILTIN_TYPES + 1; id <= nbTypes; ++id ) {
+        types.addType(typeTable.getType(id));
+    }
+
+    std::vector<char> irImage;
+    if( ir != nullptr ) {
+        IRImage::write(*ir, typeTable, IRImage::ANY_SOURCES, irImage);
+    }
+
+    Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.configurationHash = configurationHash;
+
+    image.assign(sizeof(Header), 0);
+    auto addSection = [&](Section section, const void* bytes, size_t size) {
+        image.resize((image.size() + 7) & ~size_t(7), 0);
+        header.sectionOffsets[section] = image.size();
+        header.sectionSizes[section] = size;
+        image.insert(image.end(), static_cast<const char *>(bytes), static_cast<const char *>(bytes) + size);
+    };
+
+    addSection(STRINGS, strings.getChars().data(), strings.getChars().size());
+    addSection(DEPENDENCIES, dependencies.data(), dependencies.size() * sizeof(Dependency));
+    addSection(MACROS, macros.data(), macros.size() * sizeof(Macro));
+    addSection(MACRO_TOKENS, macroTokens.data(), macroTokens.size() * sizeof(MacroToken));
+    addSection(IDENTIFIERS, identifiers.data(), identifiers.size() * sizeof(IdentifierName));
+    addSection(SYMBOLS, symbols.data(), symbols.size() * sizeof(FileScopeSymbol));
+    addSection(TYPES, types.getWords().data(), types.getWords().size() * sizeof(uint32_t));
+    addSection(TYPE_NAMES, types.getNames().data(), types.getNames().size());
+    addSection(IR, irImage.data(), irImage.size());
+    image.resize((image.size() + 7) & ~size_t(7), 0);
+
+    header.imageSize = image.size();
+    header.checksum = Hashing::hashBytes(image.data() + sizeof(Header), image.size() - sizeof(Header));
+    std::memcpy(image.data(), &header, sizeof(Header));
+}
+
+PCHImage::Status PCHImage::writeFile(
+    const C90Preprocessor& preprocessor,
+    const SymbolTable& symbolTable,
+    IRTypeTable& typeTable,
+    const FlatIR* ir,
+    uint64_t configurationHash,
+    const std::string& fileName
+    )
+{
+    std::vector<char> image;
+    write(preprocessor, symbolTable, typeTable, ir, configurationHash, image);
+
+    std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+    if( !file ) {
+        return CANNOT_OPEN;
+    }
+
+    file.write(image.data(), image.size());
+    file.close();
+    return file ? OK : CANNOT_WRITE;
+}
+
+std::shared_ptr<PCHImage> PCHImage::mapFile(const std::string& fileName, uint64_t configurationHash, Status& status)
+{
+    int fd = ::open(fileName.c_str(), O_RDONLY);
+    if( fd < 0 ) {
+        status = CANNOT_OPEN;
+        return nullptr;
+    }
+
+    struct stat fileStat;
+    if( ::fstat(fd, &fileStat) != 0 ) {
+        ::close(fd);
+        status = CANNOT_OPEN;
+        return nullptr;
+    }
+
+    size_t size = static_cast<size_t>(fileStat.st_size);
+    if( size < sizeof(Header) ) {
+        ::close(fd);
+        status = TOO_SMALL;
+        return nullptr;
+    }
+
+    void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if( mapping == MAP_FAILED ) {
+        status = CANNOT_OPEN;
+        return nullptr;
+    }
+
+    std::shared_ptr<PCHImage> result(new PCHImage());
+    result->mapping = mapping;
+    result->mappingSize = size;
+
+    status = result->load(static_cast<const char *>(mapping), size, configurationHash);
+    return status == OK ? result : nullptr;
+}
+
+PCHImage::~PCHImage()
+{
+    // The IR is in the mapping
+    //
+    ir.reset();
+    if( mapping != nullptr ) {
+        ::munmap(mapping, mappingSize);
+    }
+}
+
+/**
+ * Check the header and the layout of the sections, point to the sections, then
+ * check that the files read have the same content.  Once the checksum matches,
+ * the content is trusted: the image was written by write().
+ */
+PCHImage::Status PCHImage::load(const char* image, size_t size, uint64_t configurationHash)
+{
+    Header header;
+    std::memcpy(&header, image, sizeof(Header));
+    if( std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.byteOrder != BYTE_ORDER_MARK ) {
+        return BAD_MAGIC;
+    }
+
+    if( header.version != VERSION ) {
+        return BAD_VERSION;
+    }
+
+    if( header.imageSize != size ) {
+        return TOO_SMALL;
+    }
+
+    if( header.configurationHash != configurationHash ) {
+        return BAD_CONFIGURATION;
+    }
+
+    if( Hashing::hashBytes(image + sizeof(Header), size - sizeof(Header)) != header.checksum ) {
+        return BAD_CHECKSUM;
+    }
+
+    for( int section = 0; section < NB_SECTIONS; ++section ) {
+        uint64_t offset = header.sectionOffsets[section];
+        if( offset % 8 != 0 || offset < sizeof(Header) || offset > size || header.sectionSizes[section] > size - offset ) {
+            return BAD_LAYOUT;
+        }
+    }
+
+    strings = image + header.sectionOffsets[STRINGS];
+    nbDependencies = header.sectionSizes[DEPENDENCIES] / sizeof(Dependency);
+    dependencies = reinterpret_cast<const Dependency *>(image + header.sectionOffsets[DEPENDENCIES]);
+    nbMacros = header.sectionSizes[MACROS] / sizeof(Macro);
+    macros = reinterpret_cast<const Macro *>(image + header.sectionOffsets[MACROS]);
+    nbMacroTokens = header.sectionSizes[MACRO_TOKENS] / sizeof(MacroToken);
+    macroTokens = reinterpret_cast<const MacroToken *>(image + header.sectionOffsets[MACRO_TOKENS]);
+    nbIdentifiers = header.sectionSizes[IDENTIFIERS] / sizeof(IdentifierName);
+    identifiers = reinterpret_cast<const IdentifierName *>(image + header.sectionOffsets[IDENTIFIERS]);
+    nbSymbols = header.sectionSizes[SYMBOLS] / sizeof(FileScopeSymbol);
+    symbols = reinterpret_cast<const FileScopeSymbol *>(image + header.sectionOffsets[SYMBOLS]);
+    nbTypeWords = header.sectionSizes[TYPES] / sizeof(uint32_t);
+    typeWords = reinterpret_cast<const uint32_t *>(image + header.sectionOffsets[TYPES]);
+    typeNames = image + header.sectionOffsets[TYPE_NAMES];
+    typeNamesSize = header.sectionSizes[TYPE_NAMES];
+
+    if( header.sectionSizes[IR] > 0 ) {
+        IRImage::Status irStatus;
+        ir = IRImage::useMemory(image + header.sectionOffsets[IR], header.sectionSizes[IR], IRImage::ANY_SOURCES, irStatus);
+        if( ir == nullptr ) {
+            return BAD_LAYOUT;
+        }
+    }
+
+    for( size_t i = 0; i < nbMacros; ++i ) {
+        if( macros[i].firstToken > nbMacroTokens || macros[i].nbTokens > nbMacroTokens - macros[i].firstToken ) {
+            return BAD_LAYOUT;
+        }
+    }
+
+    for( size_t i = 0; i < nbSymbols; ++i ) {
+        if( symbols[i].identifier >= nbIdentifiers ) {
+            return BAD_LAYOUT;
+        }
+    }
+
+    // A file changed since the image was written: the compilation would not be
+    // the same
+    //
+    std::string text;
+    for( size_t i = 0; i < nbDependencies; ++i ) {
+        text.clear();
+        if( !readSourceFile(strings + dependencies[i].path, text) ||
+            PPHeaderCache::hashContent(text) != dependencies[i].contentHash ) {
+            return STALE;
+        }
+    }
+
+    return OK;
+}
+
+bool PCHImage::restore(C90Preprocessor& preprocessor, SymbolTable& symbolTable, IRTypeTable& typeTable,
+                       std::vector<IRTypePtr>& typesById) const
+{
+    for( size_t i = 0; i < nbDependencies; ++i ) {
+        const Dependency& dependency = dependencies[i];
+        PPFileId fileId;
+        if( getFileId(strings + dependency.path, fileId) ) {
+            preprocessor.addDependency(strings + dependency.path, fileId, dependency.contentHash);
+            if( (dependency.guardFlags & PRAGMA_ONCE) != 0 ) {
+                preprocessor.getIncludeGuards().setPragmaOnce(fileId);
+            }
+            else if( (dependency.guardFlags & HAS_GUARD) != 0 ) {
+                preprocessor.getIncludeGuards().setGuardMacro(fileId, strings + dependency.guardMacro);
+            }
+        }
+    }
+
+    // The macros are defined in the order of their indexes, so they get the same
+    // indexes in a new table
+    //
+    PPMacroTable& macroTable = *preprocessor.getMacroTable();
+    PPExpandedTokenList body;
+    std::vector<uint32_t> paramIndexes;
+    for( size_t i = 0; i < nbMacros; ++i ) {
+        const Macro& macro = macros[i];
+        body.clear();
+        paramIndexes.clear();
+        for( uint32_t j = macro.firstToken; j < macro.firstToken + macro.nbTokens; ++j ) {
+            const MacroToken& token = macroTokens[j];
+            body.push_back(PPExpandedToken{strings + token.spelling, token.length, PPHidesetTable::EMPTY,
+                static_cast<PPToken::Kind>(token.kind), token.punctuator, token.flags});
+            paramIndexes.push_back(token.paramIndex);
+        }
+        macroTable.define(strings + macro.name, macro.nameLength, macro.functionLike != 0, macro.nbParams,
+            body.data(), paramIndexes.data(), macro.nbTokens);
+    }
+
+    std::vector<Identifier *> identifiersByIndex;
+    for( size_t i = 0; i < nbIdentifiers; ++i ) {
+        identifiersByIndex.push_back(symbolTable.getIdentifier(strings + identifiers[i].name, identifiers[i].length));
+    }
+
+    if( !IRTypeSection::importTypes(typeWords, nbTypeWords, typeNames, typeNamesSize, typeTable, symbolTable, typesById) ) {
+        return false;
+    }
+
+    for( size_t i = 0; i < nbSymbols; ++i ) {
+        const FileScopeSymbol& symbol = symbols[i];
+        IRTypePtr type = symbol.typeId < typesById.size() ? typesById[symbol.typeId] : nullptr;
+        if( symbolTable.declare(identifiersByIndex[symbol.identifier], static_cast<Symbol::Kind>(symbol.kind), type, symbol.value) == nullptr ) {
+            return false;
+        }
+    }
+
+    return true;
+}
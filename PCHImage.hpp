@@ -0,0 +1,147 @@
+// PCHImage.hpp
+//
+// Author: Marco Jacques
+//
+// Precompiled header: the state of a compilation after its prefix header
+//
+
+#pragma once
+
+#include "C90Preprocess.hpp"
+#include "IRImage.hpp"
+#include "IRLayout.hpp"
+#include "SymbolTable.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Binary image of the state of a compilation after a prefix header, so that the
+ * next compilations resume from it instead of preprocessing and parsing the header
+ * again.  It has:
+ *   - the files read, with the hash of their content and their include guard;
+ *   - the macros defined;
+ *   - the identifiers and the file scope symbols;
+ *   - the types of the type table, records included;
+ *   - the IR of the declarations, as an IRImage used in place.
+ *
+ * Like the IRImage, the image is position independent: the sections are found by
+ * their offset, the strings, identifiers and types by their index.
+ *
+ * The image starts with a header holding a magic number, the format version, the
+ * byte order, the hash of the configuration of the compiler and a checksum of the
+ * rest of the image.  An image for another configuration, or whose files changed
+ * since, is rejected.
+ */
+class PCHImage {
+public:
+    enum Status {
+        OK,
+        CANNOT_OPEN,
+        CANNOT_WRITE,
+        TOO_SMALL,
+        BAD_MAGIC,
+        BAD_VERSION,
+        BAD_CHECKSUM,
+        BAD_LAYOUT,
+        BAD_CONFIGURATION,
+        STALE
+    };
+
+    static const uint32_t VERSION = 2;
+
+    /**
+     * Hash of what changes the result of a compilation besides the files: the
+     * include paths, the target and the options
+     */
+    static uint64_t hashConfiguration(const std::vector<std::string>& includePaths, const TargetABI& abi, uint64_t optionsHash);
+
+    /**
+     * Write the image of the state of a compilation, after a preprocessor has
+     * read the header, with preprocessMainFile() for example.  The files are
+     * checked with the hashes of their content when the preprocessor read them.
+     * The ir may be nullptr; its type ids are in the type table.
+     */
+    static void write(
+        const C90Preprocessor& preprocessor,
+        const SymbolTable& symbolTable,
+        IRTypeTable& typeTable,
+        const FlatIR* ir,
+        uint64_t configurationHash,
+        std::vector<char>& image
+        );
+
+    static Status writeFile(
+        const C90Preprocessor& preprocessor,
+        const SymbolTable& symbolTable,
+        IRTypeTable& typeTable,
+        const FlatIR* ir,
+        uint64_t configurationHash,
+        const std::string& fileName
+        );
+
+    /**
+     * Map an image file in memory.  Returns nullptr, and the reason in status, if
+     * the file can't be used: STALE if one of the files read changed.
+     */
+    static std::shared_ptr<PCHImage> mapFile(const std::string& fileName, uint64_t configurationHash, Status& status);
+
+    ~PCHImage();
+
+    PCHImage(const PCHImage&) = delete;
+    PCHImage& operator=(const PCHImage&) = delete;
+
+    /**
+     * Resume the compilation: add the files read, the include guards and the
+     * macros to a preprocessor, the identifiers and the symbols to a symbol table
+     * at file scope, and the types to a type table.  typesById gives the type of
+     * each type id of the image.  Returns false if a symbol is already declared.
+     */
+    bool restore(C90Preprocessor& preprocessor, SymbolTable& symbolTable, IRTypeTable& typeTable,
+                 std::vector<IRTypePtr>& typesById) const;
+
+    /**
+     * IR of the declarations, nullptr if there is none.  It is in the image, and
+     * can't be used once the PCHImage is destroyed.
+     */
+    const std::shared_ptr<IRImage>& getIR() const { return ir; }
+
+    size_t getNbDependencies() const { return nbDependencies; }
+    size_t getNbMacros() const { return nbMacros; }
+    size_t getNbSymbols() const { return nbSymbols; }
+
+private:
+    struct Dependency;
+    struct Macro;
+    struct MacroToken;
+    struct IdentifierName;
+    struct FileScopeSymbol;
+
+    PCHImage() : mapping(nullptr), mappingSize(0) { }
+
+    Status load(const char* image, size_t size, uint64_t configurationHash);
+
+    // Memory to unmap
+    //
+    void* mapping;
+    size_t mappingSize;
+
+    const char* strings;
+    size_t nbDependencies;
+    const Dependency* dependencies;
+    size_t nbMacros;
+    const Macro* macros;
+    size_t nbMacroTokens;
+    const MacroToken* macroTokens;
+    size_t nbIdentifiers;
+    const IdentifierName* identifiers;
+    size_t nbSymbols;
+    const FileScopeSymbol* symbols;
+    size_t nbTypeWords;
+    const uint32_t* typeWords;
+    const char* typeNames;
+    size_t typeNamesSize;
+    std::shared_ptr<IRImage> ir;
+};
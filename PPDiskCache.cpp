@@ -0,0 +1,330 @@
+// PPDiskCache.cpp
+//
+// Author: Marco Jacques
+//
+// Headers lexed once for all the compilations, kept in files
+//
+
+#include "PPDiskCache.hpp"
+#include "Hashing.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+    const char MAGIC[8] = { 'M', 'Y', 'C', 'C', '-', 'P', 'P', '\0' };
+
+    // Written in the native byte order: an image from a machine of the other
+    // byte order doesn't match
+    //
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    const char IMAGE_SUFFIX[] = ".ppc";
+    const char TEMPORARY_SUFFIX[] = ".tmp";
+
+    // Age after which a temporary file is left by a store that didn't finish,
+    // the process having crashed or been killed
+    //
+    const int64_t TEMPORARY_FILE_AGE = 60 * 60;
+
+    enum Section {
+        TEXT,
+        SEGMENTS,
+        TOKENS,
+        ERRORS,
+
+        NB_SECTIONS
+    };
+
+    /**
+     * Header of the image.  The sections are 8 bytes aligned, their offsets are
+     * from the start of the image.
+     */
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        uint64_t imageSize;
+        uint64_t checksum;                      // Of everything after the header
+        uint64_t contentHash;
+        uint64_t configurationHash;
+        uint64_t sectionOffsets[NB_SECTIONS];
+        uint64_t sectionSizes[NB_SECTIONS];     // In bytes
+    };
+
+    static_assert(std::is_trivially_copyable<PPToken>::value, "The tokens are written as they are");
+
+    /**
+     * Check if a file name has a suffix
+     */
+    bool hasSuffix(const char* name, const char* suffix)
+    {
+        size_t length = std::strlen(name);
+        size_t suffixLength = std::strlen(suffix);
+        return length > suffixLength && std::strcmp(name + length - suffixLength, suffix) == 0;
+    }
+
+    /**
+     * Write all the bytes of a buffer
+     */
+    bool writeAll(int fd, const char* bytes, size_t size)
+    {
+        while( size > 0 ) {
+            ssize_t nbWritten = ::write(fd, bytes, size);
+            if( nbWritten <= 0 ) {
+                return false;
+            }
+            bytes += nbWritten;
+            size -= static_cast<size_t>(nbWritten);
+        }
+
+        return true;
+    }
+}
+
+const uint32_t PPDiskCache::VERSION;
+
+PPDiskCache::PPDiskCache(const std::string& directory_, uint64_t maxSize_, uint64_t configurationHash_) :
+    directory(directory_.empty() || directory_.back() == '/' ? directory_ : directory_ + "/"),
+    maxSize(maxSize_),
+    configurationHash(configurationHash_),
+    knownSize(false),
+    totalSize(0),
+    nbTemporaryFiles(0),
+    statistics()
+{
+    // Nothing else to do
+}
+
+std::string PPDiskCache::getImagePath(uint64_t contentHash) const
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(Hashing::combine(contentHash, configurationHash)));
+    return directory + name + IMAGE_SUFFIX;
+}
+
+/**
+ * Map the image, check it, then build the header from its sections.  Once the
+ * checksum matches, the content is trusted: the image was written by store().
+ * The tokens are used in place, the mapping is kept as long as the header.
+ */
+std::shared_ptr<const PPCachedHeader> PPDiskCache::load(uint64_t contentHash, const std::string& path, Status& status)
+{
+    ++statistics.nbLookups;
+    std::string imagePath = getImagePath(contentHash);
+    int fd = ::open(imagePath.c_str(), O_RDONLY);
+    if( fd < 0 ) {
+        status = NOT_FOUND;
+        return nullptr;
+    }
+
+    struct stat fileStat;
+    void* mapping = MAP_FAILED;
+    size_t size = 0;
+    if( ::fstat(fd, &fileStat) == 0 && static_cast<size_t>(fileStat.st_size) >= sizeof(Header) ) {
+        size = static_cast<size_t>(fileStat.st_size);
+        mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd);
+
+    if( mapping == MAP_FAILED ) {
+        ++statistics.nbRejected;
+        status = BAD_FORMAT;
+        return nullptr;
+    }
+
+    const char* image = static_cast<const char *>(mapping);
+    Header header;
+    std::memcpy(&header, image, sizeof(Header));
+
+    status = OK;
+    if( std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.byteOrder != BYTE_ORDER_MARK || header.imageSize != size ) {
+        status = BAD_FORMAT;
+    }
+    else if( header.version != VERSION ) {
+        status = BAD_VERSION;
+    }
+    else if( header.contentHash != contentHash || header.configurationHash != configurationHash ) {
+        status = STALE;
+    }
+    else if( Hashing::hashBytes(image + sizeof(Header), size - sizeof(Header)) != header.checksum ) {
+        status = BAD_CHECKSUM;
+    }
+
+    for( int section = 0; section < NB_SECTIONS && status == OK; ++section ) {
+        uint64_t offset = header.sectionOffsets[section];
+        if( offset % 8 != 0 || offset < sizeof(Header) || offset > size || header.sectionSizes[section] > size - offset ) {
+            status = BAD_FORMAT;
+        }
+    }
+
+    // The text ends with a NUL, the tokens with END_OF_FILE
+    //
+    std::shared_ptr<const PPCachedHeader> result;
+    if( status == OK ) {
+        const char* text = image + header.sectionOffsets[TEXT];
+        const PPToken* tokens = reinterpret_cast<const PPToken *>(image + header.sectionOffsets[TOKENS]);
+        size_t nbTokens = header.sectionSizes[TOKENS] / sizeof(PPToken);
+        if( header.sectionSizes[TEXT] == 0 || text[header.sectionSizes[TEXT] - 1] != '\0' ||
+            nbTokens == 0 || tokens[nbTokens - 1].getKind() != PPToken::END_OF_FILE ) {
+            status = BAD_FORMAT;
+        }
+    }
+
+    if( status == OK ) {
+        const char* text = image + header.sectionOffsets[TEXT];
+        const PPToken* tokens = reinterpret_cast<const PPToken *>(image + header.sectionOffsets[TOKENS]);
+        size_t nbTokens = header.sectionSizes[TOKENS] / sizeof(PPToken);
+        const PPSource::SegmentPosition* positions = reinterpret_cast<const PPSource::SegmentPosition *>(image + header.sectionOffsets[SEGMENTS]);
+        const PPLexer::Error* errors = reinterpret_cast<const PPLexer::Error *>(image + header.sectionOffsets[ERRORS]);
+        auto source = std::make_shared<PPSource>(text, static_cast<uint32_t>(header.sectionSizes[TEXT] - 1), positions,
+            header.sectionSizes[SEGMENTS] / sizeof(PPSource::SegmentPosition), std::make_shared<std::string>(path));
+
+        // An image is replaced by a rename, never modified: the mapping keeps
+        // the image that was opened
+        //
+        std::shared_ptr<const void> storage(mapping, [size](const void* address) { ::munmap(const_cast<void *>(address), size); });
+        result = std::make_shared<PPCachedHeader>(source, tokens, nbTokens,
+            std::vector<PPLexer::Error>(errors, errors + header.sectionSizes[ERRORS] / sizeof(PPLexer::Error)), storage);
+
+        // Used now, for the eviction
+        //
+        ::utimensat(AT_FDCWD, imagePath.c_str(), nullptr, 0);
+        ++statistics.nbHits;
+    }
+    else {
+        ++statistics.nbRejected;
+        ::munmap(mapping, size);
+    }
+
+    return result;
+}
+
+/**
+ * Write the image in a temporary file of the directory, then rename it: the
+ * rename replaces the image atomically, and the last writer wins
+ */
+PPDiskCache::Status PPDiskCache::store(uint64_t contentHash, const PPCachedHeader& header)
+{
+    const PPSource& source = *header.getSource();
+    std::vector<PPSource::SegmentPosition> positions;
+    source.getSegmentPositions(positions);
+
+    Header imageHeader;
+    std::memset(&imageHeader, 0, sizeof(imageHeader));
+    std::memcpy(imageHeader.magic, MAGIC, sizeof(MAGIC));
+    imageHeader.version = VERSION;
+    imageHeader.byteOrder = BYTE_ORDER_MARK;
+    imageHeader.contentHash = contentHash;
+    imageHeader.configurationHash = configurationHash;
+
+    std::vector<char> image(sizeof(Header), 0);
+    auto addSection = [&](Section section, const void* bytes, size_t size) {
+        image.resize((image.size() + 7) & ~size_t(7), 0);
+        imageHeader.sectionOffsets[section] = image.size();
+        imageHeader.sectionSizes[section] = size;
+        image.insert(image.end(), static_cast<const char *>(bytes), static_cast<const char *>(bytes) + size);
+    };
+
+    addSection(TEXT, source.getText(), source.getSize() + 1);
+    addSection(SEGMENTS, positions.data(), positions.size() * sizeof(PPSource::SegmentPosition));
+    addSection(TOKENS, header.getTokens(), header.getNbTokens() * sizeof(PPToken));
+    addSection(ERRORS, header.getErrors().data(), header.getErrors().size() * sizeof(PPLexer::Error));
+    image.resize((image.size() + 7) & ~size_t(7), 0);
+
+    imageHeader.imageSize = image.size();
+    imageHeader.checksum = Hashing::hashBytes(image.data() + sizeof(Header), image.size() - sizeof(Header));
+    std::memcpy(image.data(), &imageHeader, sizeof(Header));
+
+    // The temporary file is unique to this process and this store
+    //
+    std::string imagePath = getImagePath(contentHash);
+    std::string temporaryPath = imagePath + "." + std::to_string(::getpid()) + "." + std::to_string(nbTemporaryFiles++) + TEMPORARY_SUFFIX;
+    int fd = ::open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if( fd < 0 ) {
+        return CANNOT_WRITE;
+    }
+
+    bool written = writeAll(fd, image.data(), image.size());
+    written = ::close(fd) == 0 && written;
+    if( !written || ::rename(temporaryPath.c_str(), imagePath.c_str()) != 0 ) {
+        ::unlink(temporaryPath.c_str());
+        return CANNOT_WRITE;
+    }
+    ++statistics.nbStores;
+
+    // The size of the directory is only known after a scan
+    //
+    totalSize += image.size();
+    if( !knownSize || totalSize > maxSize ) {
+        evict();
+    }
+
+    return OK;
+}
+
+/**
+ * Scan the images of the directory, and remove the oldest ones while they take
+ * too much space.  Another process may remove an image first: it is then
+ * skipped.  The temporary files of the stores that never finished are removed
+ * too, once old enough not to be the ones of a store in progress.
+ */
+void PPDiskCache::evict()
+{
+    struct Image {
+        int64_t modifiedSeconds;
+        int64_t modifiedNanoseconds;
+        uint64_t size;
+        std::string path;
+    };
+
+    std::vector<Image> images;
+    totalSize = 0;
+    int64_t now = static_cast<int64_t>(::time(nullptr));
+    DIR* dir = ::opendir(directory.empty() ? "." : directory.c_str());
+    if( dir != nullptr ) {
+        while( struct dirent* entry = ::readdir(dir) ) {
+            struct stat imageStat;
+            std::string path = directory + entry->d_name;
+            bool isImage = hasSuffix(entry->d_name, IMAGE_SUFFIX);
+            bool isTemporary = hasSuffix(entry->d_name, TEMPORARY_SUFFIX);
+            if( (!isImage && !isTemporary) || ::stat(path.c_str(), &imageStat) != 0 ) {
+                continue;
+            }
+
+            if( isTemporary ) {
+                if( now - static_cast<int64_t>(imageStat.st_mtim.tv_sec) > TEMPORARY_FILE_AGE && ::unlink(path.c_str()) == 0 ) {
+                    ++statistics.nbTemporaryFilesRemoved;
+                }
+                continue;
+            }
+
+            images.push_back(Image{static_cast<int64_t>(imageStat.st_mtim.tv_sec), static_cast<int64_t>(imageStat.st_mtim.tv_nsec),
+                static_cast<uint64_t>(imageStat.st_size), path});
+            totalSize += static_cast<uint64_t>(imageStat.st_size);
+        }
+        ::closedir(dir);
+    }
+    knownSize = true;
+
+    std::sort(images.begin(), images.end(), [](const Image& left, const Image& right) {
+        return left.modifiedSeconds != right.modifiedSeconds ? left.modifiedSeconds < right.modifiedSeconds
+                                                             : left.modifiedNanoseconds < right.modifiedNanoseconds;
+    });
+
+    for( size_t i = 0; i < images.size() && totalSize > maxSize; ++i ) {
+        if( ::unlink(images[i].path.c_str()) == 0 ) {
+            ++statistics.nbEvictions;
+        }
+        totalSize -= images[i].size;
+    }
+}
@@ -0,0 +1,106 @@
+// PPDiskCache.hpp
+//
+// Author: Marco Jacques
+//
+// Headers lexed once for all the compilations, kept in files
+//
+
+#pragma once
+
+#include "PPHeaderCache.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * Cache of the lexed headers in a directory, reused from one compilation to the
+ * next.  An entry is the image of a PPCachedHeader, found by the hash of the
+ * content of the header and the hash of the configuration of the preprocessor;
+ * the images are mapped in memory to be read.
+ *
+ * The image starts with a header holding a magic number, the format version, the
+ * byte order, both hashes and a checksum of the rest of the image.  An image for
+ * another content or configuration is stale, it is not used.
+ *
+ * Several compilations can use the cache at the same time: an image is written in
+ * a temporary file, then renamed, so an image is never seen partly written.  When
+ * the images take more than the maximum size, the least recently used ones are
+ * removed; an image is marked as used by its modification time.  The temporary
+ * files left by the compilations that stopped during a store are removed then,
+ * after an hour.  An object is used by one thread.
+ *
+ * The tokens of a loaded header are used in place, in the mapped image.
+ */
+class PPDiskCache {
+public:
+    enum Status {
+        OK,
+        NOT_FOUND,
+        CANNOT_WRITE,
+        BAD_FORMAT,
+        BAD_VERSION,
+        BAD_CHECKSUM,
+        STALE
+    };
+
+    static const uint32_t VERSION = 1;
+
+    /**
+     * Counters of the cache, for this process
+     */
+    struct Statistics {
+        size_t nbLookups;
+        size_t nbHits;
+        size_t nbRejected;          // Found, but stale or damaged
+        size_t nbStores;
+        size_t nbEvictions;
+        size_t nbTemporaryFilesRemoved;     // Left by the stores that didn't finish
+    };
+
+    /**
+     * Constructor: the directory must exist
+     */
+    PPDiskCache(const std::string& directory_, uint64_t maxSize_, uint64_t configurationHash_);
+
+    PPDiskCache(const PPDiskCache&) = delete;
+    PPDiskCache& operator=(const PPDiskCache&) = delete;
+
+    /**
+     * Header with a content, for the file at a path.  Returns nullptr, and the
+     * reason in status, if there is no usable image.
+     */
+    std::shared_ptr<const PPCachedHeader> load(uint64_t contentHash, const std::string& path, Status& status);
+
+    /**
+     * Write the image of a header, then remove the least recently used images if
+     * the cache is too big
+     */
+    Status store(uint64_t contentHash, const PPCachedHeader& header);
+
+    /**
+     * Remove the least recently used images, down to the maximum size
+     */
+    void evict();
+
+    /**
+     * File of the image of a content
+     */
+    std::string getImagePath(uint64_t contentHash) const;
+
+    const Statistics& getStatistics() const { return statistics; }
+
+private:
+    std::string directory;
+    uint64_t maxSize;
+    uint64_t configurationHash;
+
+    // Size of the images, from the last scan of the directory and the images
+    // written since; unknown before the first store
+    //
+    bool knownSize;
+    uint64_t totalSize;
+    unsigned nbTemporaryFiles;
+
+    Statistics statistics;
+};
@@ -0,0 +1,421 @@
+// PPExpression.cpp
+//
+// Author: Marco Jacques
+//
+// Evaluation of the conditions of #if and #elif
+//
+
+#include "PPExpression.hpp"
+#include <cstring>
+
+namespace {
+
+    const int64_t LONG_MIN_VALUE = INT64_MIN;
+
+    PPExpressionEvaluator::Value makeSigned(int64_t value)
+    {
+        return PPExpressionEvaluator::Value{static_cast<uint64_t>(value), false};
+    }
+
+    PPExpressionEvaluator::Value makeBool(bool value)
+    {
+        return PPExpressionEvaluator::Value{value ? 1u : 0u, false};
+    }
+
+    bool isSpelled(const PPExpandedToken& token, const char* spelling)
+    {
+        return token.length == std::strlen(spelling) && std::memcmp(token.spelling, spelling, token.length) == 0;
+    }
+
+    int getDigitValue(char c)
+    {
+        if( c >= '0' && c <= '9' ) {
+            return c - '0';
+        }
+        if( c >= 'a' && c <= 'f' ) {
+            return c - 'a' + 10;
+        }
+        if( c >= 'A' && c <= 'F' ) {
+            return c - 'A' + 10;
+        }
+        return 16;
+    }
+}
+
+/**
+ * Constructor
+ */
+PPExpressionEvaluator::PPExpressionEvaluator(const std::shared_ptr<PPMacroTable>& macroTable_, const std::shared_ptr<Message>& msg_) :
+    macroTable(macroTable_),
+    msg(msg_),
+    tokens(nullptr),
+    nbTokens(0),
+    position(0),
+    sourcePosition(nullptr, 0, 0),
+    evaluated(true),
+    depth(0),
+    failed(false)
+{
+    // Nothing else to do
+}
+
+/**
+ * Evaluate an expression
+ */
+bool PPExpressionEvaluator::evaluate(const PPExpandedToken* tokens_, size_t nbTokens_, const SourcePosition& sourcePosition_, Value& result)
+{
+    tokens = tokens_;
+    nbTokens = nbTokens_;
+    position = 0;
+    sourcePosition = sourcePosition_;
+    evaluated = true;
+    depth = 0;
+    failed = false;
+
+    result = parseBinary(C90ExpressionBase::PREC_COMMA);
+    if( !failed && position != nbTokens ) {
+        reportError(Message::ERROR_INVALID_CONDITION);
+    }
+
+    return !failed;
+}
+
+/**
+ * Precedence climbing, like the expression parser: parse a unary expression, then
+ * all the binary operators binding at least as tight as minPrecedence
+ */
+PPExpressionEvaluator::Value PPExpressionEvaluator::parseBinary(C90ExpressionBase::Precedence minPrecedence)
+{
+    Value left = parseUnary();
+    while( !failed && position < nbTokens && tokens[position].kind == PPToken::PUNCTUATOR ) {
+        LexerToken::Kind kind = static_cast<LexerToken::Kind>(tokens[position].punctuator);
+        C90ExpressionBase::Precedence precedence = C90ExpressionBase::getBinaryPrecedence(kind);
+        if( precedence == C90ExpressionBase::NOT_BINARY_OPERATOR || precedence < minPrecedence ) {
+            break;
+        }
+
+        if( precedence == C90ExpressionBase::PREC_ASSIGNMENT || precedence == C90ExpressionBase::PREC_COMMA ) {
+            return reportError(Message::ERROR_INVALID_CONDITION);
+        }
+        ++position;
+
+        // The operands not selected by ?:, && and || are parsed, not evaluated.
+        // The operands of ?: nest without bound, like the parentheses: their
+        // depth is limited too.
+        //
+        bool wasEvaluated = evaluated;
+        if( kind == LexerToken::QUESTION_MARK ) {
+            if( ++depth > MAX_DEPTH ) {
+                return reportError(Message::ERROR_INVALID_CONDITION);
+            }
+
+            evaluated = wasEvaluated && left.isTrue();
+            Value thenValue = parseBinary(C90ExpressionBase::PREC_COMMA);
+            if( !acceptPunctuator(LexerToken::COLON) ) {
+                evaluated = wasEvaluated;
+                return reportError(Message::ERROR_INVALID_CONDITION);
+            }
+
+            evaluated = wasEvaluated && !left.isTrue();
+            Value elseValue = parseBinary(C90ExpressionBase::PREC_CONDITIONAL);
+            evaluated = wasEvaluated;
+            --depth;
+
+            left = left.isTrue() ? thenValue : elseValue;
+            left.isUnsigned = thenValue.isUnsigned || elseValue.isUnsigned;
+            continue;
+        }
+
+        if( kind == LexerToken::BOOL_AND || kind == LexerToken::BOOL_OR ) {
+            evaluated = wasEvaluated && left.isTrue() == (kind == LexerToken::BOOL_AND);
+        }
+
+        C90ExpressionBase::Precedence rightPrecedence = static_cast<C90ExpressionBase::Precedence>(precedence + 1);
+        Value right = parseBinary(rightPrecedence);
+        evaluated = wasEvaluated;
+
+        left = applyBinary(kind, left, right);
+    }
+
+    return left;
+}
+
+/**
+ * Unary operators
+ */
+PPExpressionEvaluator::Value PPExpressionEvaluator::parseUnary()
+{
+    if( position >= nbTokens || tokens[position].kind != PPToken::PUNCTUATOR ) {
+        return parsePrimary();
+    }
+
+    LexerToken::Kind kind = static_cast<LexerToken::Kind>(tokens[position].punctuator);
+    if( kind != LexerToken::ADD && kind != LexerToken::SUB && kind != LexerToken::BIT_NOT && kind != LexerToken::BOOL_NOT ) {
+        return parsePrimary();
+    }
+
+    if( ++depth > MAX_DEPTH ) {
+        return reportError(Message::ERROR_INVALID_CONDITION);
+    }
+    ++position;
+    Value operand = parseUnary();
+    --depth;
+
+    switch( kind ) {
+        case LexerToken::SUB:       return Value{0 - operand.bits, operand.isUnsigned};
+        case LexerToken::BIT_NOT:   return Value{~operand.bits, operand.isUnsigned};
+        case LexerToken::BOOL_NOT:  return makeBool(!operand.isTrue());
+        default:                    return operand;
+    }
+}
+
+/**
+ * Constants, identifiers, defined and parenthesized expressions
+ */
+PPExpressionEvaluator::Value PPExpressionEvaluator::parsePrimary()
+{
+    if( position >= nbTokens ) {
+        return reportError(Message::ERROR_INVALID_CONDITION);
+    }
+
+    const PPExpandedToken& token = tokens[position++];
+    switch( token.kind ) {
+        case PPToken::PP_NUMBER:
+            return parseNumber(token);
+
+        case PPToken::CHAR_CONSTANT:
+            return parseCharConstant(token);
+
+        case PPToken::IDENTIFIER: {
+            if( !isSpelled(token, "defined") ) {
+                return makeSigned(0);
+            }
+
+            bool parens = acceptPunctuator(LexerToken::LEFT_PARAR);
+            if( position >= nbTokens || tokens[position].kind != PPToken::IDENTIFIER ) {
+                return reportError(Message::ERROR_INVALID_CONDITION);
+            }
+
+            const PPExpandedToken& name = tokens[position++];
+            if( parens && !acceptPunctuator(LexerToken::RIGHT_PARAR) ) {
+                return reportError(Message::ERROR_INVALID_CONDITION);
+            }
+            return makeBool(macroTable->find(name.spelling, name.length) != nullptr);
+        }
+
+        case PPToken::PUNCTUATOR:
+            if( token.isPunctuator(LexerToken::LEFT_PARAR) ) {
+                if( ++depth > MAX_DEPTH ) {
+                    return reportError(Message::ERROR_INVALID_CONDITION);
+                }
+
+                Value value = parseBinary(C90ExpressionBase::PREC_COMMA);
+                --depth;
+                if( !acceptPunctuator(LexerToken::RIGHT_PARAR) ) {
+                    return reportError(Message::ERROR_INVALID_CONDITION);
+                }
+                return value;
+            }
+            return reportError(Message::ERROR_INVALID_CONDITION);
+
+        default:
+            return reportError(Message::ERROR_INVALID_CONDITION);
+    }
+}
+
+/**
+ * Integer constant (C90 6.1.3.2): a constant without suffix is a long, or an
+ * unsigned long if it is too large for a long
+ */
+PPExpressionEvaluator::Value PPExpressionEvaluator::parseNumber(const PPExpandedToken& token)
+{
+    const char* currChar = token.spelling;
+    const char* endChar = token.spelling + token.length;
+
+    unsigned base = 10;
+    if( currChar[0] == '0' && endChar - currChar > 2 && (currChar[1] == 'x' || currChar[1] == 'X') ) {
+        base = 16;
+        currChar += 2;
+    }
+    else if( currChar[0] == '0' ) {
+        base = 8;
+    }
+
+    uint64_t value = 0;
+    bool overflow = false;
+    const char* startDigits = currChar;
+    for( ; currChar < endChar && getDigitValue(*currChar) < static_cast<int>(base); ++currChar ) {
+        uint64_t newValue = value * base + getDigitValue(*currChar);
+        overflow = overflow || value > (UINT64_MAX - getDigitValue(*currChar)) / base;
+        value = newValue;
+    }
+
+    // Suffixes u and l, in any order
+    //
+    bool hasUnsigned = false;
+    bool hasLong = false;
+    for( ; currChar < endChar; ++currChar ) {
+        if( (*currChar == 'u' || *currChar == 'U') && !hasUnsigned ) {
+            hasUnsigned = true;
+        }
+        else if( (*currChar == 'l' || *currChar == 'L') && !hasLong ) {
+            hasLong = true;
+        }
+        else {
+            break;
+        }
+    }
+
+    if( currChar != endChar || startDigits == currChar - hasUnsigned - hasLong ) {
+        return reportError(Message::ERROR_INVALID_NUMBER);
+    }
+    if( overflow ) {
+        return reportError(Message::ERROR_INTEGER_TOO_LARGE);
+    }
+
+    return Value{value, hasUnsigned || value > static_cast<uint64_t>(INT64_MAX)};
+}
+
+/**
+ * Character constant, with its escape sequences.  A char is signed; the
+ * characters of a constant with several of them are combined like gcc does.
+ */
+PPExpressionEvaluator::Value PPExpressionEvaluator::parseCharConstant(const PPExpandedToken& token)
+{
+    const char* currChar = token.spelling;
+    bool wide = *currChar == 'L';
+    currChar += wide ? 2 : 1;
+    const char* endChar = token.spelling + token.length - 1;
+
+    uint64_t value = 0;
+    unsigned nbChars = 0;
+    while( currChar < endChar ) {
+        uint64_t c = static_cast<unsigned char>(*currChar++);
+        if( c == '\\' && currChar < endChar ) {
+            char escape = *currChar++;
+            switch( escape ) {
+                case 'n':   c = '\n'; break;
+                case 't':   c = '\t'; break;
+                case 'v':   c = '\v'; break;
+                case 'b':   c = '\b'; break;
+                case 'r':   c = '\r'; break;
+                case 'f':   c = '\f'; break;
+                case 'a':   c = '\a'; break;
+                case 'x':
+                    for( c = 0; currChar < endChar && getDigitValue(*currChar) < 16; ++currChar ) {
+                        c = c * 16 + getDigitValue(*currChar);
+                    }
+                    break;
+                default:
+                    if( escape >= '0' && escape <= '7' ) {
+                        c = escape - '0';
+                        for( int i = 0; i < 2 && currChar < endChar && *currChar >= '0' && *currChar <= '7'; ++i ) {
+                            c = c * 8 + (*currChar++ - '0');
+                        }
+                    }
+                    else {
+                        c = static_cast<unsigned char>(escape);
+                    }
+                    break;
+            }
+        }
+
+        value = wide ? c : (value << 8) | (c & 0xff);
+        ++nbChars;
+    }
+
+    if( nbChars == 0 ) {
+        return reportError(Message::ERROR_INVALID_CONDITION);
+    }
+
+    // A single char is sign extended
+    //
+    if( !wide && nbChars == 1 ) {
+        return makeSigned(static_cast<signed char>(value));
+    }
+    return Value{value, false};
+}
+
+/**
+ * Binary operator, after the usual arithmetic conversions: unsigned long if an
+ * operand is unsigned.  The overflows wrap around, instead of being undefined.
+ */
+PPExpressionEvaluator::Value PPExpressionEvaluator::applyBinary(LexerToken::Kind kind, Value left, Value right)
+{
+    bool isUnsigned = left.isUnsigned || right.isUnsigned;
+    uint64_t leftBits = left.bits;
+    uint64_t rightBits = right.bits;
+
+    switch( kind ) {
+        case LexerToken::MUL:       return Value{leftBits * rightBits, isUnsigned};
+        case LexerToken::ADD:       return Value{leftBits + rightBits, isUnsigned};
+        case LexerToken::SUB:       return Value{leftBits - rightBits, isUnsigned};
+        case LexerToken::BIT_AND:   return Value{leftBits & rightBits, isUnsigned};
+        case LexerToken::BIT_XOR:   return Value{leftBits ^ rightBits, isUnsigned};
+        case LexerToken::BIT_IOR:   return Value{leftBits | rightBits, isUnsigned};
+        case LexerToken::BOOL_AND:  return makeBool(left.isTrue() && right.isTrue());
+        case LexerToken::BOOL_OR:   return makeBool(left.isTrue() || right.isTrue());
+        case LexerToken::EQUAL:     return makeBool(leftBits == rightBits);
+        case LexerToken::NOT_EQUAL: return makeBool(leftBits != rightBits);
+
+        case LexerToken::DIV:
+        case LexerToken::MOD:
+            if( rightBits == 0 ) {
+                return evaluated ? reportError(Message::ERROR_DIVISION_BY_ZERO) : Value{0, isUnsigned};
+            }
+            if( isUnsigned ) {
+                return Value{kind == LexerToken::DIV ? leftBits / rightBits : leftBits % rightBits, true};
+            }
+            if( left.getSigned() == LONG_MIN_VALUE && right.getSigned() == -1 ) {
+                return kind == LexerToken::DIV ? left : makeSigned(0);
+            }
+            return makeSigned(kind == LexerToken::DIV ? left.getSigned() / right.getSigned() : left.getSigned() % right.getSigned());
+
+        case LexerToken::LT:        return makeBool(isUnsigned ? leftBits < rightBits : left.getSigned() < right.getSigned());
+        case LexerToken::GT:        return makeBool(isUnsigned ? leftBits > rightBits : left.getSigned() > right.getSigned());
+        case LexerToken::LE:        return makeBool(isUnsigned ? leftBits <= rightBits : left.getSigned() <= right.getSigned());
+        case LexerToken::GE:        return makeBool(isUnsigned ? leftBits >= rightBits : left.getSigned() >= right.getSigned());
+
+        // The type is the type of the left operand; a count out of range gives 0,
+        // or -1 for a negative value shifted right
+        //
+        case LexerToken::SHIFT_LEFT:
+        case LexerToken::SHIFT_RIGHT: {
+            bool outOfRange = right.isUnsigned ? rightBits >= 64 : (right.getSigned() < 0 || right.getSigned() >= 64);
+            bool negative = !left.isUnsigned && left.getSigned() < 0;
+            if( outOfRange ) {
+                return Value{kind == LexerToken::SHIFT_RIGHT && negative ? UINT64_MAX : 0, left.isUnsigned};
+            }
+            if( kind == LexerToken::SHIFT_LEFT ) {
+                return Value{leftBits << rightBits, left.isUnsigned};
+            }
+            return Value{negative ? ~(~leftBits >> rightBits) : leftBits >> rightBits, left.isUnsigned};
+        }
+
+        default:
+            return reportError(Message::ERROR_INVALID_CONDITION);
+    }
+}
+
+bool PPExpressionEvaluator::acceptPunctuator(LexerToken::Kind kind)
+{
+    if( position < nbTokens && tokens[position].isPunctuator(kind) ) {
+        ++position;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Report the first error of the expression, the value is then meaningless
+ */
+PPExpressionEvaluator::Value PPExpressionEvaluator::reportError(Message::Msg message)
+{
+    if( !failed ) {
+        failed = true;
+        std::string spelling = position < nbTokens ? tokens[position].getSpelling() : std::string();
+        msg->issueMessage(sourcePosition, message, {spelling});
+    }
+
+    return makeSigned(0);
+}
@@ -0,0 +1,81 @@
+// PPExpression.hpp
+//
+// Author: Marco Jacques
+//
+// Evaluation of the conditions of #if and #elif
+//
+
+#pragma once
+
+#include "C90ExpressionBase.hpp"
+#include "Message.hpp"
+#include "PPMacro.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Evaluator of the controlling expression of #if and #elif (C90 6.8.1), on the
+ * pp-tokens after macro expansion.  The expression is evaluated while it is
+ * parsed: no tree is built, and nothing is allocated unless an error is reported.
+ *
+ * The arithmetic is done in long and unsigned long, both 64 bits; the identifiers
+ * that are not macros are 0.  defined NAME is also recognized here, for the
+ * expansions producing it.  The operators have the precedences of the expression
+ * parser; the assignments and the comma are not allowed in a constant expression.
+ */
+class PPExpressionEvaluator {
+public:
+    /**
+     * Value of an expression: the bits of a long or an unsigned long
+     */
+    struct Value {
+        uint64_t bits;
+        bool isUnsigned;
+
+        bool isTrue() const { return bits != 0; }
+        int64_t getSigned() const { return static_cast<int64_t>(bits); }
+    };
+
+    /**
+     * Constructor
+     */
+    PPExpressionEvaluator(const std::shared_ptr<PPMacroTable>& macroTable_, const std::shared_ptr<Message>& msg_);
+
+    PPExpressionEvaluator(const PPExpressionEvaluator&) = delete;
+    PPExpressionEvaluator& operator=(const PPExpressionEvaluator&) = delete;
+
+    /**
+     * Evaluate an expression.  Returns false after reporting an error if it is not
+     * a valid constant expression.
+     */
+    bool evaluate(const PPExpandedToken* tokens_, size_t nbTokens_, const SourcePosition& sourcePosition_, Value& result);
+
+private:
+    static const unsigned MAX_DEPTH = 512;
+
+    Value parseBinary(C90ExpressionBase::Precedence minPrecedence);
+    Value parseUnary();
+    Value parsePrimary();
+    Value parseNumber(const PPExpandedToken& token);
+    Value parseCharConstant(const PPExpandedToken& token);
+    Value applyBinary(LexerToken::Kind kind, Value left, Value right);
+
+    bool acceptPunctuator(LexerToken::Kind kind);
+    Value reportError(Message::Msg message);
+
+    std::shared_ptr<PPMacroTable> macroTable;
+    std::shared_ptr<Message> msg;
+
+    const PPExpandedToken* tokens;
+    size_t nbTokens;
+    size_t position;
+    SourcePosition sourcePosition;
+
+    // False in the operands not evaluated (C90 6.3.13 to 6.3.15), where
+    // division by zero is not an error
+    //
+    bool evaluated;
+    unsigned depth;
+    bool failed;
+};
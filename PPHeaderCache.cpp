@@ -0,0 +1,100 @@
+// PPHeaderCache.cpp
+//
+// Author: Marco Jacques
+//
+// Headers lexed once for all the translation units of a process
+//
+
+#include "PPHeaderCache.hpp"
+#include "Hashing.hpp"
+
+PPCachedHeader::PPCachedHeader(const std::shared_ptr<const PPSource>& source_, PPTokenList&& tokens_, std::vector<PPLexer::Error>&& errors_) :
+    source(source_),
+    ownedTokens(std::move(tokens_)),
+    storage(),
+    tokens(nullptr),
+    nbTokens(0),
+    errors(std::move(errors_))
+{
+    ownedTokens.shrink_to_fit();
+    tokens = ownedTokens.data();
+    nbTokens = ownedTokens.size();
+}
+
+PPCachedHeader::PPCachedHeader(const std::shared_ptr<const PPSource>& source_, const PPToken* tokens_, size_t nbTokens_,
+                               std::vector<PPLexer::Error>&& errors_, const std::shared_ptr<const void>& storage_) :
+    source(source_),
+    ownedTokens(),
+    storage(storage_),
+    tokens(tokens_),
+    nbTokens(nbTokens_),
+    errors(std::move(errors_))
+{
+    // Nothing else to do
+}
+
+size_t PPCachedHeader::getMemorySize() const
+{
+    return sizeof(*this) + source->getMemorySize() + ownedTokens.capacity() * sizeof(PPToken) + errors.capacity() * sizeof(PPLexer::Error);
+}
+
+PPHeaderCache::PPHeaderCache() :
+    mutex(),
+    entries(),
+    nbLookups(0),
+    nbHits(0),
+    memorySize(0)
+{
+    // Nothing else to do
+}
+
+const std::shared_ptr<PPHeaderCache>& PPHeaderCache::getProcessCache()
+{
+    static const std::shared_ptr<PPHeaderCache> processCache = std::make_shared<PPHeaderCache>();
+    return processCache;
+}
+
+std::shared_ptr<const PPCachedHeader> PPHeaderCache::find(const PPFileId& fileId, uint64_t contentHash)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ++nbLookups;
+
+    auto found = entries.find(fileId);
+    if( found == entries.end() || found->second.contentHash != contentHash ) {
+        return nullptr;
+    }
+
+    ++nbHits;
+    return found->second.header;
+}
+
+std::shared_ptr<const PPCachedHeader> PPHeaderCache::insert(const PPFileId& fileId, uint64_t contentHash,
+                                                            const std::shared_ptr<const PPCachedHeader>& header)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Entry& entry = entries[fileId];
+    if( entry.header != nullptr ) {
+        if( entry.contentHash == contentHash ) {
+            return entry.header;
+        }
+        memorySize -= entry.header->getMemorySize();
+    }
+
+    // The translation units using the old content keep it until they are done
+    //
+    entry.contentHash = contentHash;
+    entry.header = header;
+    memorySize += header->getMemorySize();
+    return header;
+}
+
+PPHeaderCache::Statistics PPHeaderCache::getStatistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return Statistics{nbLookups, nbHits, entries.size(), memorySize};
+}
+
+uint64_t PPHeaderCache::hashContent(const std::string& text)
+{
+    return Hashing::hashBytes(text.data(), text.size());
+}
@@ -0,0 +1,122 @@
+// PPHeaderCache.hpp
+//
+// Author: Marco Jacques
+//
+// Headers lexed once for all the translation units of a process
+//
+
+#pragma once
+
+#include "PPInclude.hpp"
+#include "PPParser.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Header after phases 1 to 3: its source and all its pp-tokens.  It is never
+ * modified once built, so the translation units share it without copying it.
+ */
+class PPCachedHeader {
+public:
+    /**
+     * Constructor: the tokens end with END_OF_FILE, the errors are the ones noted
+     * by the lexer
+     */
+    PPCachedHeader(const std::shared_ptr<const PPSource>& source_, PPTokenList&& tokens_, std::vector<PPLexer::Error>&& errors_);
+
+    /**
+     * Constructor with the tokens used in place, in a storage kept as long as the
+     * header: a mapped image for example
+     */
+    PPCachedHeader(const std::shared_ptr<const PPSource>& source_, const PPToken* tokens_, size_t nbTokens_,
+                   std::vector<PPLexer::Error>&& errors_, const std::shared_ptr<const void>& storage_);
+
+    const std::shared_ptr<const PPSource>& getSource() const { return source; }
+    const PPToken* getTokens() const { return tokens; }
+    size_t getNbTokens() const { return nbTokens; }
+    const std::vector<PPLexer::Error>& getErrors() const { return errors; }
+
+    /**
+     * Bytes used by the source and the tokens, except the tokens used in place
+     */
+    size_t getMemorySize() const;
+
+private:
+    std::shared_ptr<const PPSource> source;
+    PPTokenList ownedTokens;
+    std::shared_ptr<const void> storage;
+    const PPToken* tokens;
+    size_t nbTokens;
+    std::vector<PPLexer::Error> errors;
+};
+
+/**
+ * Cache of the lexed headers, by file identity and hash of the content.  A file
+ * whose content changed is a miss, and its new content replaces the old one.
+ *
+ * The cache is thread-safe: it can be shared by the preprocessors of all the
+ * translation units of a process, getProcessCache() being the one of the process.
+ */
+class PPHeaderCache {
+public:
+    /**
+     * Counters of the cache, at one point in time
+     */
+    struct Statistics {
+        size_t nbLookups;
+        size_t nbHits;
+        size_t nbHeaders;
+        size_t memorySize;          // Bytes used by the headers
+
+        double getHitRate() const { return nbLookups == 0 ? 0.0 : static_cast<double>(nbHits) / nbLookups; }
+    };
+
+    /**
+     * Constructor
+     */
+    PPHeaderCache();
+
+    PPHeaderCache(const PPHeaderCache&) = delete;
+    PPHeaderCache& operator=(const PPHeaderCache&) = delete;
+
+    /**
+     * Cache shared by the whole process
+     */
+    static const std::shared_ptr<PPHeaderCache>& getProcessCache();
+
+    /**
+     * Header of a file with a content, nullptr if it is not cached
+     */
+    std::shared_ptr<const PPCachedHeader> find(const PPFileId& fileId, uint64_t contentHash);
+
+    /**
+     * Add a header.  Returns the header cached for the same content by another
+     * thread in the meantime, if any, else the header added.
+     */
+    std::shared_ptr<const PPCachedHeader> insert(const PPFileId& fileId, uint64_t contentHash,
+                                                 const std::shared_ptr<const PPCachedHeader>& header);
+
+    Statistics getStatistics() const;
+
+    /**
+     * Hash of the content of a file, as read
+     */
+    static uint64_t hashContent(const std::string& text);
+
+private:
+    struct Entry {
+        uint64_t contentHash;
+        std::shared_ptr<const PPCachedHeader> header;
+    };
+
+    mutable std::mutex mutex;
+    std::unordered_map<PPFileId, Entry, PPFileIdHash> entries;
+    size_t nbLookups;
+    size_t nbHits;
+    size_t memorySize;
+};
@@ -0,0 +1,236 @@
+// PPInclude.cpp
+//
+// Author: Marco Jacques
+//
+// Files included by the preprocessor
+//
+
+#include "PPInclude.hpp"
+#include "C90Preprocess.hpp"
+#include "Hashing.hpp"
+#include <dirent.h>
+#include <fcntl.h>
+#include <iterator>
+#include <memory>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+    /**
+     * Path as a word of a makefile: the spaces and the # are escaped with \, the $
+     * is doubled
+     */
+    void appendMakeWord(const std::string& path, std::string& rule)
+    {
+        for( char c : path ) {
+            if( c == ' ' || c == '\t' || c == '#' ) {
+                rule += '\\';
+            }
+            else if( c == '$' ) {
+                rule += '$';
+            }
+            rule += c;
+        }
+    }
+}
+
+size_t PPFileIdHash::operator()(const PPFileId& fileId) const
+{
+    return static_cast<size_t>(Hashing::combine(Hashing::mix(fileId.device), fileId.inode));
+}
+
+bool getFileId(const std::string& path, PPFileId& fileId)
+{
+    struct stat fileStat;
+    if( ::stat(path.c_str(), &fileStat) != 0 || !S_ISREG(fileStat.st_mode) ) {
+        return false;
+    }
+
+    fileId = PPFileId{static_cast<uint64_t>(fileStat.st_dev), static_cast<uint64_t>(fileStat.st_ino)};
+    return true;
+}
+
+bool readSourceFile(const std::string& path, std::string& text)
+{
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if( fd < 0 ) {
+        return false;
+    }
+
+    struct stat fileStat;
+    if( ::fstat(fd, &fileStat) == 0 ) {
+        text.reserve(static_cast<size_t>(fileStat.st_size));
+    }
+
+    char block[16384];
+    ssize_t nbRead;
+    while( (nbRead = ::read(fd, block, sizeof(block))) > 0 ) {
+        text.append(block, static_cast<size_t>(nbRead));
+    }
+    ::close(fd);
+
+    return nbRead == 0;
+}
+
+void splitSourceLines(const std::string& text, const std::shared_ptr<std::string>& filename, CharacterStreamList& streams)
+{
+    size_t lineStart = 0;
+    int lineNumber = 1;
+    while( lineStart < text.size() ) {
+        size_t lineEnd = text.find('\n', lineStart);
+        lineEnd = lineEnd == std::string::npos ? text.size() : lineEnd + 1;
+        streams.push_back(CharacterStream(text.substr(lineStart, lineEnd - lineStart), SourcePosition(filename, lineNumber, 1)));
+        lineStart = lineEnd;
+        ++lineNumber;
+    }
+}
+
+std::string makeDependencyRule(const std::string& target, const std::vector<std::string>& prerequisites)
+{
+    std::string rule;
+    appendMakeWord(target, rule);
+    rule += ':';
+    for( const std::string& prerequisite : prerequisites ) {
+        rule += " \\\n  ";
+        appendMakeWord(prerequisite, rule);
+    }
+    rule += '\n';
+
+    return rule;
+}
+
+void PPIncludeGuardTable::setGuardMacro(const PPFileId& fileId, const std::string& macroName)
+{
+    Guard& guard = guards[fileId];
+    guard.macroName = macroName;
+}
+
+void PPIncludeGuardTable::setPragmaOnce(const PPFileId& fileId)
+{
+    guards[fileId].pragmaOnce = true;
+}
+
+bool PPIncludeGuardTable::canSkip(const PPFileId& fileId, const PPMacroTable& macroTable) const
+{
+    auto found = guards.find(fileId);
+    if( found == guards.end() ) {
+        return false;
+    }
+
+    const Guard& guard = found->second;
+    return guard.pragmaOnce || (!guard.macroName.empty() && macroTable.find(guard.macroName) != nullptr);
+}
+
+bool PPIncludeGuardTable::findGuard(const PPFileId& fileId, bool& pragmaOnce, std::string& macroName) const
+{
+    auto found = guards.find(fileId);
+    if( found == guards.end() ) {
+        return false;
+    }
+
+    pragmaOnce = found->second.pragmaOnce;
+    macroName = found->second.macroName;
+    return true;
+}
+
+PPHeaderSearch::PPHeaderSearch() :
+    mutex(),
+    listings(),
+    lookups(),
+    nbSystemCalls(0),
+    nbLookups(0),
+    nbHits(0)
+{
+    // Nothing else to do
+}
+
+bool PPHeaderSearch::find(const std::string& directory, const std::string& name, std::string& path, PPFileId& fileId)
+{
+    path = directory.empty() || directory.back() == '/' ? directory + name : directory + "/" + name;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ++nbLookups;
+
+    auto cached = lookups.find(path);
+    if( cached != lookups.end() ) {
+        ++nbHits;
+        fileId = cached->second.fileId;
+        return cached->second.found;
+    }
+
+    // The name may have directories: the listing is the one of the last directory
+    //
+    size_t slash = path.rfind('/');
+    std::string fileDirectory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    const Listing& listing = getListing(fileDirectory);
+
+    Lookup lookup{false, PPFileId{0, 0}, fileDirectory};
+    if( listing.names.count(path.substr(fileDirectory.size())) != 0 ) {
+        ++nbSystemCalls;
+        lookup.found = getFileId(path, lookup.fileId);
+    }
+
+    lookups.emplace(path, lookup);
+    fileId = lookup.fileId;
+    return lookup.found;
+}
+
+void PPHeaderSearch::revalidate()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for( auto listing = listings.begin(); listing != listings.end(); ) {
+        Listing current;
+        readModifiedTime(listing->first, current);
+        if( current.exists == listing->second.exists && current.modifiedSeconds == listing->second.modifiedSeconds &&
+            current.modifiedNanoseconds == listing->second.modifiedNanoseconds ) {
+            ++listing;
+            continue;
+        }
+
+        for( auto lookup = lookups.begin(); lookup != lookups.end(); ) {
+            lookup = lookup->second.directory == listing->first ? lookups.erase(lookup) : std::next(lookup);
+        }
+        listing = listings.erase(listing);
+    }
+}
+
+/**
+ * Listing of a directory, read the first time it is needed.  A directory that
+ * doesn't exist has no names.
+ */
+const PPHeaderSearch::Listing& PPHeaderSearch::getListing(const std::string& directory)
+{
+    auto cached = listings.find(directory);
+    if( cached != listings.end() ) {
+        return cached->second;
+    }
+
+    Listing& listing = listings[directory];
+    if( readModifiedTime(directory, listing) ) {
+        ++nbSystemCalls;
+        DIR* dir = ::opendir(directory.empty() ? "." : directory.c_str());
+        if( dir != nullptr ) {
+            while( struct dirent* entry = ::readdir(dir) ) {
+                listing.names.insert(entry->d_name);
+            }
+            ::closedir(dir);
+        }
+    }
+
+    return listing;
+}
+
+/**
+ * Modification time of a directory.  Returns false if there is no directory.
+ */
+bool PPHeaderSearch::readModifiedTime(const std::string& directory, Listing& listing)
+{
+    ++nbSystemCalls;
+    struct stat dirStat;
+    listing.exists = ::stat(directory.empty() ? "." : directory.c_str(), &dirStat) == 0 && S_ISDIR(dirStat.st_mode);
+    listing.modifiedSeconds = listing.exists ? static_cast<int64_t>(dirStat.st_mtim.tv_sec) : 0;
+    listing.modifiedNanoseconds = listing.exists ? static_cast<int64_t>(dirStat.st_mtim.tv_nsec) : 0;
+
+    return listing.exists;
+}
@@ -0,0 +1,163 @@
+// PPInclude.hpp
+//
+// Author: Marco Jacques
+//
+// Files included by the preprocessor
+//
+
+#pragma once
+
+#include "PPMacro.hpp"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/**
+ * Identity of a file: the same file reached by different paths (links, ./, ../)
+ * has the same identity
+ */
+struct PPFileId {
+    uint64_t device;
+    uint64_t inode;
+
+    bool operator==(const PPFileId& other) const { return device == other.device && inode == other.inode; }
+};
+
+struct PPFileIdHash {
+    size_t operator()(const PPFileId& fileId) const;
+};
+
+/**
+ * Identity of an existing regular file.  Returns false if there is none.
+ */
+bool getFileId(const std::string& path, PPFileId& fileId);
+
+/**
+ * Read a file in one block.  Returns false if the file can't be read.
+ */
+bool readSourceFile(const std::string& path, std::string& text);
+
+/**
+ * Cut the text of a file in lines, the streams of phase 1
+ */
+void splitSourceLines(const std::string& text, const std::shared_ptr<std::string>& filename, CharacterStreamList& streams);
+
+/**
+ * Search of the included files in directories.  The results are cached by path,
+ * the files not found too, and a file is only looked for in a directory whose
+ * listing has its name; so a lookup costs no system call once its directory is
+ * listed.
+ *
+ * A search can be shared by the preprocessors of several translation units, in
+ * several threads: its cache is guarded by a mutex.  Each preprocessor calls
+ * revalidate() when it starts a translation unit: it checks the modification
+ * times of the directories listed, a directory changed is listed again and its
+ * lookups, the files not found included, are forgotten.  So a unit costs a stat
+ * per directory listed, and a header added since the last unit is found.
+ */
+class PPHeaderSearch {
+public:
+    /**
+     * Constructor
+     */
+    PPHeaderSearch();
+
+    PPHeaderSearch(const PPHeaderSearch&) = delete;
+    PPHeaderSearch& operator=(const PPHeaderSearch&) = delete;
+
+    /**
+     * Look for a file in a directory, empty for the current directory; the name
+     * may have directories.  Returns false if it is not there.
+     */
+    bool find(const std::string& directory, const std::string& name, std::string& path, PPFileId& fileId);
+
+    /**
+     * Forget what was cached for the directories modified since they were listed
+     */
+    void revalidate();
+
+    /**
+     * stat and directory reads done, lookups, and lookups answered from the cache.
+     * Read them once the other threads are done with the search.
+     */
+    size_t getNbSystemCalls() const { return nbSystemCalls; }
+    size_t getNbLookups() const { return nbLookups; }
+    size_t getNbHits() const { return nbHits; }
+
+private:
+    /**
+     * Names in a directory, when it was last modified
+     */
+    struct Listing {
+        bool exists;
+        int64_t modifiedSeconds;
+        int64_t modifiedNanoseconds;
+        std::unordered_set<std::string> names;
+    };
+
+    /**
+     * Result of a lookup, with the directory of the file
+     */
+    struct Lookup {
+        bool found;
+        PPFileId fileId;
+        std::string directory;
+    };
+
+    const Listing& getListing(const std::string& directory);
+    bool readModifiedTime(const std::string& directory, Listing& listing);
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Listing> listings;
+    std::unordered_map<std::string, Lookup> lookups;
+    size_t nbSystemCalls;
+    size_t nbLookups;
+    size_t nbHits;
+};
+
+/**
+ * Rule of a makefile with the prerequisites of a target, like cc -M: a
+ * prerequisite per line, the special characters of make escaped
+ */
+std::string makeDependencyRule(const std::string& target, const std::vector<std::string>& prerequisites);
+
+/**
+ * Files that don't need to be included again (multiple-include optimization):
+ * the files with #pragma once, and the files whose content is all in a group
+ *
+ *     #ifndef GUARD   (or #if !defined GUARD)
+ *     ...
+ *     #endif
+ *
+ * which is empty while GUARD is defined.
+ */
+class PPIncludeGuardTable {
+public:
+    void setGuardMacro(const PPFileId& fileId, const std::string& macroName);
+    void setPragmaOnce(const PPFileId& fileId);
+
+    /**
+     * Check if including a file again would produce nothing
+     */
+    bool canSkip(const PPFileId& fileId, const PPMacroTable& macroTable) const;
+
+    /**
+     * Guard of a file: #pragma once, or the name of its guard macro.  Returns false
+     * if the file has none.
+     */
+    bool findGuard(const PPFileId& fileId, bool& pragmaOnce, std::string& macroName) const;
+
+    size_t getNbGuardedFiles() const { return guards.size(); }
+
+private:
+    struct Guard {
+        bool pragmaOnce;
+        std::string macroName;
+    };
+
+    std::unordered_map<PPFileId, Guard, PPFileIdHash> guards;
+};
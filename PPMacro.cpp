@@ -0,0 +1,876 @@
+// PPMacro.cpp
+//
+// Author: Marco Jacques
+//
+// Macro definitions and macro expansion
+//
+
+#include "PPMacro.hpp"
+#include "Hashing.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+    const size_t INITIAL_NB_HIDESET_BUCKETS = 64;
+    const size_t INITIAL_NB_NAMES = 256;
+
+    uint64_t makeKey(uint32_t value1, uint32_t value2)
+    {
+        return (static_cast<uint64_t>(value1) << 32) | value2;
+    }
+
+    uint64_t hashElements(const std::vector<uint32_t>& elements)
+    {
+        return Hashing::hashBytes(elements.data(), elements.size() * sizeof(uint32_t));
+    }
+
+    bool isSameSpelling(const PPExpandedToken& token1, const PPExpandedToken& token2)
+    {
+        return token1.length == token2.length && std::memcmp(token1.spelling, token2.spelling, token1.length) == 0;
+    }
+
+    const uint8_t POSITION_FLAGS = PPToken::LEADING_SPACE | PPToken::START_OF_LINE;
+}
+
+const PPHideset PPHidesetTable::EMPTY;
+
+/**
+ * Constructor: only the empty set exists
+ */
+PPHidesetTable::PPHidesetTable() :
+    hidesets(1, Hideset{0, 0, 0}),
+    elements(),
+    buckets(INITIAL_NB_HIDESET_BUCKETS, EMPTY),
+    addResults(),
+    uniteResults(),
+    intersectResults(),
+    scratch()
+{
+    // Nothing else to do
+}
+
+bool PPHidesetTable::contains(PPHideset hideset, uint32_t macroIndex) const
+{
+    const Hideset& set = hidesets[hideset];
+    const uint32_t* start = elements.data() + set.start;
+    return std::binary_search(start, start + set.size, macroIndex);
+}
+
+/**
+ * Add a macro to a set
+ */
+PPHideset PPHidesetTable::add(PPHideset hideset, uint32_t macroIndex)
+{
+    if( contains(hideset, macroIndex) ) {
+        return hideset;
+    }
+
+    uint64_t key = makeKey(hideset, macroIndex);
+    auto found = addResults.find(key);
+    if( found != addResults.end() ) {
+        return found->second;
+    }
+
+    const Hideset& set = hidesets[hideset];
+    scratch.assign(elements.begin() + set.start, elements.begin() + set.start + set.size);
+    scratch.insert(std::upper_bound(scratch.begin(), scratch.end(), macroIndex), macroIndex);
+
+    PPHideset result = intern(scratch);
+    addResults.insert(std::make_pair(key, result));
+    return result;
+}
+
+/**
+ * Union of two sets
+ */
+PPHideset PPHidesetTable::unite(PPHideset hideset1, PPHideset hideset2)
+{
+    if( hideset1 == hideset2 || hideset2 == EMPTY ) {
+        return hideset1;
+    }
+    if( hideset1 == EMPTY ) {
+        return hideset2;
+    }
+
+    uint64_t key = makeKey(std::min(hideset1, hideset2), std::max(hideset1, hideset2));
+    auto found = uniteResults.find(key);
+    if( found != uniteResults.end() ) {
+        return found->second;
+    }
+
+    const Hideset& set1 = hidesets[hideset1];
+    const Hideset& set2 = hidesets[hideset2];
+    scratch.clear();
+    std::set_union(elements.begin() + set1.start, elements.begin() + set1.start + set1.size,
+        elements.begin() + set2.start, elements.begin() + set2.start + set2.size, std::back_inserter(scratch));
+
+    PPHideset result = intern(scratch);
+    uniteResults.insert(std::make_pair(key, result));
+    return result;
+}
+
+/**
+ * Intersection of two sets
+ */
+PPHideset PPHidesetTable::intersect(PPHideset hideset1, PPHideset hideset2)
+{
+    if( hideset1 == hideset2 ) {
+        return hideset1;
+    }
+    if( hideset1 == EMPTY || hideset2 == EMPTY ) {
+        return EMPTY;
+    }
+
+    uint64_t key = makeKey(std::min(hideset1, hideset2), std::max(hideset1, hideset2));
+    auto found = intersectResults.find(key);
+    if( found != intersectResults.end() ) {
+        return found->second;
+    }
+
+    const Hideset& set1 = hidesets[hideset1];
+    const Hideset& set2 = hidesets[hideset2];
+    scratch.clear();
+    std::set_intersection(elements.begin() + set1.start, elements.begin() + set1.start + set1.size,
+        elements.begin() + set2.start, elements.begin() + set2.start + set2.size, std::back_inserter(scratch));
+
+    PPHideset result = intern(scratch);
+    intersectResults.insert(std::make_pair(key, result));
+    return result;
+}
+
+/**
+ * Number of a set, creating it the first time
+ */
+PPHideset PPHidesetTable::intern(const std::vector<uint32_t>& setElements)
+{
+    if( setElements.empty() ) {
+        return EMPTY;
+    }
+
+    uint64_t hash = hashElements(setElements);
+    size_t mask = buckets.size() - 1;
+
+    size_t bucket = hash & mask;
+    while( buckets[bucket] != EMPTY ) {
+        const Hideset& set = hidesets[buckets[bucket]];
+        if( set.hash == hash && set.size == setElements.size() &&
+            std::equal(setElements.begin(), setElements.end(), elements.begin() + set.start) ) {
+            return buckets[bucket];
+        }
+
+        bucket = (bucket + 1) & mask;
+    }
+
+    PPHideset result = static_cast<PPHideset>(hidesets.size());
+    hidesets.push_back(Hideset{static_cast<uint32_t>(elements.size()), static_cast<uint32_t>(setElements.size()), hash});
+    elements.insert(elements.end(), setElements.begin(), setElements.end());
+    buckets[bucket] = result;
+
+    // Keep the table at most half full
+    //
+    if( hidesets.size() * 2 > buckets.size() ) {
+        growBuckets();
+    }
+
+    return result;
+}
+
+/**
+ * Double the size of the hash table
+ */
+void PPHidesetTable::growBuckets()
+{
+    std::vector<PPHideset> newBuckets(buckets.size() * 2, EMPTY);
+    size_t mask = newBuckets.size() - 1;
+
+    for( PPHideset hideset = 1; hideset < hidesets.size(); ++hideset ) {
+        size_t bucket = hidesets[hideset].hash & mask;
+        while( newBuckets[bucket] != EMPTY ) {
+            bucket = (bucket + 1) & mask;
+        }
+        newBuckets[bucket] = hideset;
+    }
+
+    buckets.swap(newBuckets);
+}
+
+const uint32_t PPMacro::NOT_PARAM;
+
+/**
+ * Check if two definitions are the same
+ */
+bool PPMacro::isSameDefinition(const PPMacro& other) const
+{
+    if( functionLike != other.functionLike || nbParams != other.nbParams || bodySize != other.bodySize ) {
+        return false;
+    }
+
+    for( unsigned i = 0; i < bodySize; ++i ) {
+        const PPExpandedToken& token = body[i];
+        const PPExpandedToken& otherToken = other.body[i];
+        if( token.kind != otherToken.kind || paramIndexes[i] != other.paramIndexes[i] ) {
+            return false;
+        }
+        if( !isSameSpelling(token, otherToken) ) {
+            return false;
+        }
+        if( i > 0 && token.hasLeadingSpace() != otherToken.hasLeadingSpace() ) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Constructor
+ */
+PPMacroTable::PPMacroTable() :
+    arena(),
+    names(INITIAL_NB_NAMES, nullptr),
+    nbNames(0),
+    nbMacros(0)
+{
+    // Nothing else to do
+}
+
+/**
+ * Entry of a name, nullptr if it was never seen
+ */
+PPMacroTable::Name* PPMacroTable::findName(const char* name, uint32_t length, uint64_t hash) const
+{
+    size_t mask = names.size() - 1;
+    for( size_t bucket = hash & mask; names[bucket] != nullptr; bucket = (bucket + 1) & mask ) {
+        Name* entry = names[bucket];
+        if( entry->hash == hash && entry->length == length && std::memcmp(entry->name, name, length) == 0 ) {
+            return entry;
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * Entry of a name, creating it the first time
+ */
+PPMacroTable::Name* PPMacroTable::getName(const char* name, uint32_t length)
+{
+    uint64_t hash = Hashing::hashBytes(name, length);
+    Name* entry = findName(name, length, hash);
+    if( entry != nullptr ) {
+        return entry;
+    }
+
+    entry = arena.create<Name>(Name{arena.copyString(name, length), length, nbNames, hash, nullptr});
+    size_t mask = names.size() - 1;
+    size_t bucket = hash & mask;
+    while( names[bucket] != nullptr ) {
+        bucket = (bucket + 1) & mask;
+    }
+    names[bucket] = entry;
+
+    if( ++nbNames * 2 > names.size() ) {
+        growNames();
+    }
+
+    return entry;
+}
+
+void PPMacroTable::getMacros(std::vector<const PPMacro *>& macros) const
+{
+    macros.clear();
+    for( Name* entry : names ) {
+        if( entry != nullptr && entry->macro != nullptr ) {
+            macros.push_back(entry->macro);
+        }
+    }
+
+    std::sort(macros.begin(), macros.end(), [](const PPMacro* left, const PPMacro* right) {
+        return left->getIndex() < right->getIndex();
+    });
+}
+
+/**
+ * Double the size of the name hash table
+ */
+void PPMacroTable::growNames()
+{
+    std::vector<Name *> newNames(names.size() * 2, nullptr);
+    size_t mask = newNames.size() - 1;
+
+    for( Name* entry : names ) {
+        if( entry != nullptr ) {
+            size_t bucket = entry->hash & mask;
+            while( newNames[bucket] != nullptr ) {
+                bucket = (bucket + 1) & mask;
+            }
+            newNames[bucket] = entry;
+        }
+    }
+
+    names.swap(newNames);
+}
+
+/**
+ * Define a macro.  The spellings of the replacement list are copied in one block.
+ */
+const PPMacro* PPMacroTable::define(
+    const char* name,
+    uint32_t nameLength,
+    bool functionLike,
+    unsigned nbParams,
+    const PPExpandedToken* body,
+    const uint32_t* paramIndexes,
+    unsigned bodySize
+    )
+{
+    Name* entry = getName(name, nameLength);
+
+    size_t spellingsSize = 0;
+    for( unsigned i = 0; i < bodySize; ++i ) {
+        spellingsSize += body[i].length;
+    }
+
+    char* spellings = static_cast<char *>(arena.allocate(spellingsSize + 1, 1));
+    PPExpandedToken* bodyCopy = arena.copyArray(body, bodySize);
+    for( unsigned i = 0; i < bodySize; ++i ) {
+        std::memcpy(spellings, body[i].spelling, body[i].length);
+        bodyCopy[i].spelling = spellings;
+        bodyCopy[i].hideset = PPHidesetTable::EMPTY;
+        bodyCopy[i].flags &= PPToken::LEADING_SPACE;
+        spellings += body[i].length;
+    }
+
+    PPMacro* macro = arena.create<PPMacro>();
+    macro->index = entry->index;
+    macro->name = entry->name;
+    macro->nameLength = nameLength;
+    macro->functionLike = functionLike;
+    macro->nbParams = nbParams;
+    macro->bodySize = bodySize;
+    macro->body = bodyCopy;
+    macro->paramIndexes = arena.copyArray(paramIndexes, bodySize);
+
+    const PPMacro* previous = entry->macro;
+    entry->macro = macro;
+    if( previous == nullptr ) {
+        ++nbMacros;
+    }
+
+    return previous;
+}
+
+/**
+ * Remove a definition.  The definition stays in the arena, the tokens being
+ * expanded may still refer to its spellings.
+ */
+void PPMacroTable::undefine(const char* name, uint32_t nameLength)
+{
+    Name* entry = findName(name, nameLength, Hashing::hashBytes(name, nameLength));
+    if( entry != nullptr && entry->macro != nullptr ) {
+        entry->macro = nullptr;
+        --nbMacros;
+    }
+}
+
+/**
+ * Current definition of a name
+ */
+const PPMacro* PPMacroTable::find(const char* name, uint32_t nameLength) const
+{
+    Name* entry = findName(name, nameLength, Hashing::hashBytes(name, nameLength));
+    return entry != nullptr ? entry->macro : nullptr;
+}
+
+/**
+ * Constructor
+ */
+PPMacroExpander::PPMacroExpander(const std::shared_ptr<PPMacroTable>& macroTable_, const std::shared_ptr<Message>& msg_) :
+    macroTable(macroTable_),
+    msg(msg_),
+    hidesetTable(),
+    sourcePosition(nullptr, 0, 0),
+    inputs(),
+    buffers(),
+    freeBuffers(),
+    invocations(),
+    invocationDepth(0),
+    parenDistances(),
+    openParens(),
+    scratch(),
+    spelling(),
+    statistics{0, 0, 0, 0}
+{
+    // Nothing else to do
+}
+
+/**
+ * Expand a sequence of tokens
+ */
+void PPMacroExpander::expand(
+    const PPExpandedToken* tokens,
+    size_t nbTokens,
+    const SourcePosition& sourcePosition_,
+    PPExpandedTokenList& output
+    )
+{
+    sourcePosition = sourcePosition_;
+    computeParenDistances(tokens, nbTokens);
+    expandInput(Input{tokens, 0, nbTokens, parenDistances.data(), nullptr}, output);
+}
+
+/**
+ * Distance from each ( to its matching ), 0 if it has none
+ */
+void PPMacroExpander::computeParenDistances(const PPExpandedToken* tokens, size_t nbTokens)
+{
+    parenDistances.assign(nbTokens, 0);
+    openParens.clear();
+
+    for( size_t i = 0; i < nbTokens; ++i ) {
+        if( tokens[i].isPunctuator(LexerToken::LEFT_PARAR) ) {
+            openParens.push_back(i);
+        }
+        else if( tokens[i].isPunctuator(LexerToken::RIGHT_PARAR) && !openParens.empty() ) {
+            parenDistances[openParens.back()] = static_cast<uint32_t>(i - openParens.back());
+            openParens.pop_back();
+        }
+    }
+}
+
+/**
+ * Expand all the tokens of an input: a macro invocation is replaced, and its
+ * replacement is pushed to be rescanned with the rest of the input
+ */
+void PPMacroExpander::expandInput(const Input& input, Buffer& output)
+{
+    size_t baseDepth = inputs.size();
+    inputs.push_back(input);
+
+    PPExpandedToken token;
+    while( nextToken(baseDepth, token) ) {
+        if( token.kind != PPToken::IDENTIFIER || (token.flags & PPToken::NO_EXPAND) != 0 ) {
+            output.push_back(token);
+            continue;
+        }
+
+        const PPMacro* macro = macroTable->find(token.spelling, token.length);
+        if( macro == nullptr ) {
+            output.push_back(token);
+            continue;
+        }
+
+        // A hidden macro name is never expanded, even in a later rescan
+        //
+        if( hidesetTable.contains(token.hideset, macro->getIndex()) ) {
+            token.flags |= PPToken::NO_EXPAND;
+            output.push_back(token);
+            continue;
+        }
+
+        Buffer* replacement = acquireBuffer();
+        if( !macro->isFunctionLike() ) {
+            substitute(macro, nullptr, hidesetTable.add(token.hideset, macro->getIndex()), *replacement);
+        }
+        else {
+            // A function-like macro name not followed by ( is not an invocation
+            //
+            const PPExpandedToken* nextParen = peekToken(baseDepth);
+            if( nextParen == nullptr || !nextParen->isPunctuator(LexerToken::LEFT_PARAR) ) {
+                releaseBuffer(replacement);
+                output.push_back(token);
+                continue;
+            }
+
+            Invocation& invocation = acquireInvocation();
+            PPHideset rightParenHideset = PPHidesetTable::EMPTY;
+            if( !collectArguments(macro, baseDepth, invocation, rightParenHideset) ) {
+                releaseInvocation(invocation);
+                releaseBuffer(replacement);
+                output.push_back(token);
+                continue;
+            }
+
+            PPHideset hideset = hidesetTable.add(hidesetTable.intersect(token.hideset, rightParenHideset), macro->getIndex());
+            substitute(macro, &invocation, hideset, *replacement);
+            releaseInvocation(invocation);
+        }
+
+        ++statistics.nbExpansions;
+        if( replacement->empty() ) {
+            releaseBuffer(replacement);
+            continue;
+        }
+
+        // The replacement takes the place of the macro name
+        //
+        PPExpandedToken& first = replacement->front();
+        first.flags = (first.flags & ~POSITION_FLAGS) | (token.flags & POSITION_FLAGS);
+        inputs.push_back(Input{replacement->data(), 0, replacement->size(), nullptr, replacement});
+    }
+
+    inputs.pop_back();
+}
+
+/**
+ * Next token of the inputs above the base, false at the end of the base input
+ */
+bool PPMacroExpander::nextToken(size_t baseDepth, PPExpandedToken& token)
+{
+    const PPExpandedToken* next = peekToken(baseDepth);
+    if( next == nullptr ) {
+        return false;
+    }
+
+    token = *next;
+    ++inputs.back().position;
+    ++statistics.nbTokensRead;
+    return true;
+}
+
+/**
+ * Next token without reading it.  The inputs read completely are removed.
+ */
+const PPExpandedToken* PPMacroExpander::peekToken(size_t baseDepth)
+{
+    for( ;; ) {
+        Input& input = inputs.back();
+        if( input.position < input.size ) {
+            return &input.tokens[input.position];
+        }
+        if( inputs.size() == baseDepth + 1 ) {
+            return nullptr;
+        }
+
+        releaseBuffer(input.ownedBuffer);
+        inputs.pop_back();
+    }
+}
+
+/**
+ * Collect the arguments of an invocation, from the ( to the ).  Returns false
+ * after reporting an error if the invocation is not valid.
+ */
+bool PPMacroExpander::collectArguments(const PPMacro* macro, size_t baseDepth, Invocation& invocation, PPHideset& rightParenHideset)
+{
+    PPExpandedToken token;
+    nextToken(baseDepth, token);
+
+    Input& top = inputs.back();
+    if( top.parenDistances != nullptr ) {
+        if( top.parenDistances[top.position - 1] == 0 ) {
+            msg->issueMessage(sourcePosition, Message::ERROR_UNTERMINATED_MACRO_CALL, {macro->getName()});
+            top.position = top.size;
+            return false;
+        }
+
+        collectSpanArguments(top, invocation, rightParenHideset);
+    }
+    else {
+        // The invocation may end in the inputs below: the arguments are copied
+        //
+        invocation.copiedTokens = acquireBuffer();
+        Buffer& copiedTokens = *invocation.copiedTokens;
+        invocation.argumentStarts.assign(1, 0);
+
+        unsigned depth = 0;
+        for( ;; ) {
+            if( !nextToken(baseDepth, token) ) {
+                msg->issueMessage(sourcePosition, Message::ERROR_UNTERMINATED_MACRO_CALL, {macro->getName()});
+                return false;
+            }
+
+            if( token.isPunctuator(LexerToken::LEFT_PARAR) ) {
+                ++depth;
+            }
+            else if( token.isPunctuator(LexerToken::RIGHT_PARAR) ) {
+                if( depth == 0 ) {
+                    break;
+                }
+                --depth;
+            }
+            else if( token.isPunctuator(LexerToken::COMMA) && depth == 0 ) {
+                invocation.argumentStarts.push_back(copiedTokens.size());
+                continue;
+            }
+
+            copiedTokens.push_back(token);
+        }
+
+        rightParenHideset = token.hideset;
+        invocation.argumentStarts.push_back(copiedTokens.size());
+        for( size_t i = 0; i + 1 < invocation.argumentStarts.size(); ++i ) {
+            size_t start = invocation.argumentStarts[i];
+            invocation.arguments.push_back(Argument{copiedTokens.data() + start, invocation.argumentStarts[i + 1] - start, nullptr, nullptr});
+        }
+    }
+
+    // F() is an invocation without arguments
+    //
+    if( macro->getNbParams() == 0 && invocation.arguments.size() == 1 && invocation.arguments[0].size == 0 ) {
+        invocation.arguments.clear();
+    }
+
+    if( invocation.arguments.size() != macro->getNbParams() ) {
+        msg->issueMessage(sourcePosition, Message::ERROR_MACRO_ARG_COUNT, {macro->getName()});
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Collect the arguments of an invocation in a single input, jumping over the
+ * nested parentheses
+ */
+bool PPMacroExpander::collectSpanArguments(Input& input, Invocation& invocation, PPHideset& rightParenHideset)
+{
+    size_t position = input.position;
+    size_t rightParen = position - 1 + input.parenDistances[position - 1];
+    size_t argumentStart = position;
+
+    while( position < rightParen ) {
+        const PPExpandedToken& token = input.tokens[position];
+        ++statistics.nbTokensRead;
+
+        if( token.isPunctuator(LexerToken::LEFT_PARAR) ) {
+            position += input.parenDistances[position] + 1;
+            continue;
+        }
+
+        if( token.isPunctuator(LexerToken::COMMA) ) {
+            invocation.arguments.push_back(Argument{input.tokens + argumentStart, position - argumentStart, input.parenDistances + argumentStart, nullptr});
+            argumentStart = position + 1;
+        }
+        ++position;
+    }
+
+    invocation.arguments.push_back(Argument{input.tokens + argumentStart, rightParen - argumentStart, input.parenDistances + argumentStart, nullptr});
+    rightParenHideset = input.tokens[rightParen].hideset;
+    input.position = rightParen + 1;
+    return true;
+}
+
+/**
+ * Replacement of an invocation: the replacement list, with the parameters
+ * replaced by the arguments, expanded unless they are operands of # or ##
+ */
+void PPMacroExpander::substitute(const PPMacro* macro, Invocation* invocation, PPHideset hideset, Buffer& output)
+{
+    unsigned bodySize = macro->getBodySize();
+
+    // Start of the tokens of the last operand, which ## extends with its right
+    // operand: the left operand of a ## emitted no token if there are none
+    //
+    size_t operandStart = output.size();
+    uint8_t operandFlags = 0;
+
+    for( unsigned i = 0; i < bodySize; ++i ) {
+        const PPExpandedToken& bodyToken = macro->getBodyToken(i);
+        if( !bodyToken.isPunctuator(LexerToken::HASH_HASH) ) {
+            operandStart = output.size();
+            operandFlags = bodyToken.flags;
+        }
+
+        // #parameter, checked by the definition
+        //
+        if( invocation != nullptr && bodyToken.isPunctuator(LexerToken::HASH) ) {
+            PPExpandedToken string = stringize(invocation->arguments[macro->getParamIndex(++i)], hideset);
+            string.flags = bodyToken.flags;
+            output.push_back(string);
+            continue;
+        }
+
+        // Right operand of ##, the definition checks that it is not the first or
+        // last token.  When the left operand is an empty argument, the right
+        // operand is kept as is, at the place of the left operand.
+        //
+        if( bodyToken.isPunctuator(LexerToken::HASH_HASH) ) {
+            const PPExpandedToken& rightToken = macro->getBodyToken(++i);
+            uint32_t rightParam = macro->getParamIndex(i);
+
+            const PPExpandedToken* rightTokens = &rightToken;
+            size_t nbRightTokens = 1;
+            if( rightParam != PPMacro::NOT_PARAM ) {
+                rightTokens = invocation->arguments[rightParam].tokens;
+                nbRightTokens = invocation->arguments[rightParam].size;
+            }
+            if( nbRightTokens == 0 ) {
+                continue;
+            }
+
+            size_t nextRight = 0;
+            bool leftEmpty = output.size() == operandStart;
+            PPExpandedToken pasted;
+            if( !leftEmpty && paste(output.back(), rightTokens[0], pasted) ) {
+                pasted.hideset = hidesetTable.unite(pasted.hideset, hideset);
+                output.back() = pasted;
+                nextRight = 1;
+            }
+
+            for( size_t j = nextRight; j < nbRightTokens; ++j ) {
+                PPExpandedToken token = rightTokens[j];
+                token.hideset = hidesetTable.unite(token.hideset, hideset);
+                token.flags &= ~PPToken::START_OF_LINE;
+                if( leftEmpty && j == 0 ) {
+                    token.flags = (token.flags & ~POSITION_FLAGS) | (operandFlags & PPToken::LEADING_SPACE);
+                }
+                output.push_back(token);
+            }
+            continue;
+        }
+
+        uint32_t param = macro->getParamIndex(i);
+        if( param != PPMacro::NOT_PARAM ) {
+            bool pasted = i + 1 < bodySize && macro->getBodyToken(i + 1).isPunctuator(LexerToken::HASH_HASH);
+            appendArgument(invocation->arguments[param], !pasted, hideset, bodyToken.flags, output);
+            continue;
+        }
+
+        PPExpandedToken token = bodyToken;
+        token.hideset = hideset;
+        output.push_back(token);
+    }
+}
+
+/**
+ * Add the tokens of an argument to a replacement, expanded or not
+ */
+void PPMacroExpander::appendArgument(Argument& argument, bool expanded, PPHideset hideset, uint8_t firstFlags, Buffer& output)
+{
+    const PPExpandedToken* tokens = argument.tokens;
+    size_t nbTokens = argument.size;
+    if( expanded ) {
+        const Buffer& expansion = getExpandedArgument(argument);
+        tokens = expansion.data();
+        nbTokens = expansion.size();
+    }
+
+    for( size_t i = 0; i < nbTokens; ++i ) {
+        PPExpandedToken token = tokens[i];
+        token.hideset = hidesetTable.unite(token.hideset, hideset);
+        token.flags = (token.flags & ~POSITION_FLAGS) | (i == 0 ? (firstFlags & PPToken::LEADING_SPACE) : (token.flags & PPToken::LEADING_SPACE));
+        output.push_back(token);
+    }
+}
+
+/**
+ * Expansion of an argument, computed the first time it is needed
+ */
+const PPMacroExpander::Buffer& PPMacroExpander::getExpandedArgument(Argument& argument)
+{
+    if( argument.expansion == nullptr ) {
+        argument.expansion = acquireBuffer();
+        ++statistics.nbArgExpansions;
+        expandInput(Input{argument.tokens, 0, argument.size, argument.parenDistances, nullptr}, *argument.expansion);
+    }
+
+    return *argument.expansion;
+}
+
+/**
+ * String literal spelling an argument (C90 6.8.3.2): the white space between
+ * tokens becomes one space, and the " and \ of the literals are escaped
+ */
+PPExpandedToken PPMacroExpander::stringize(const Argument& argument, PPHideset hideset)
+{
+    spelling.assign(1, '"');
+    for( size_t i = 0; i < argument.size; ++i ) {
+        const PPExpandedToken& token = argument.tokens[i];
+        if( i > 0 && (token.flags & POSITION_FLAGS) != 0 ) {
+            spelling += ' ';
+        }
+
+        if( token.kind == PPToken::STRING_LITERAL || token.kind == PPToken::CHAR_CONSTANT ) {
+            for( uint32_t j = 0; j < token.length; ++j ) {
+                char c = token.spelling[j];
+                if( c == '"' || c == '\\' ) {
+                    spelling += '\\';
+                }
+                spelling += c;
+            }
+        }
+        else {
+            spelling.append(token.spelling, token.length);
+        }
+    }
+    spelling += '"';
+
+    const char* text = scratch.copyString(spelling.data(), spelling.size());
+    return PPExpandedToken{text, static_cast<uint32_t>(spelling.size()), hideset, PPToken::STRING_LITERAL,
+        static_cast<uint8_t>(LexerToken::UNKNOWN), 0};
+}
+
+/**
+ * Paste two tokens (C90 6.8.3.3).  The result must be a single token, else an
+ * error is reported and the tokens are kept.
+ */
+bool PPMacroExpander::paste(const PPExpandedToken& left, const PPExpandedToken& right, PPExpandedToken& result)
+{
+    spelling.assign(left.spelling, left.length);
+    spelling.append(right.spelling, right.length);
+
+    const char* text = scratch.copyString(spelling.data(), spelling.size());
+    uint32_t length = static_cast<uint32_t>(spelling.size());
+    PPLexer lexer(text, length);
+    PPToken token = lexer.nextToken();
+
+    if( lexer.anyError() || token.getLength() != length ) {
+        msg->issueMessage(sourcePosition, Message::ERROR_INVALID_PASTE, {spelling});
+        return false;
+    }
+
+    result = PPExpandedToken{text, length, hidesetTable.unite(left.hideset, right.hideset), token.getKind(),
+        static_cast<uint8_t>(token.getPunctuator()), left.flags};
+    return true;
+}
+
+/**
+ * Buffer from the pool, empty but keeping its capacity
+ */
+PPMacroExpander::Buffer* PPMacroExpander::acquireBuffer()
+{
+    if( freeBuffers.empty() ) {
+        buffers.push_back(std::unique_ptr<Buffer>(new Buffer()));
+        ++statistics.nbBuffersCreated;
+        return buffers.back().get();
+    }
+
+    Buffer* buffer = freeBuffers.back();
+    freeBuffers.pop_back();
+    buffer->clear();
+    return buffer;
+}
+
+void PPMacroExpander::releaseBuffer(Buffer* buffer)
+{
+    if( buffer != nullptr ) {
+        freeBuffers.push_back(buffer);
+    }
+}
+
+/**
+ * Invocation for the current nesting of argument expansions
+ */
+PPMacroExpander::Invocation& PPMacroExpander::acquireInvocation()
+{
+    if( invocationDepth == invocations.size() ) {
+        invocations.push_back(std::unique_ptr<Invocation>(new Invocation()));
+    }
+
+    Invocation& invocation = *invocations[invocationDepth++];
+    invocation.arguments.clear();
+    invocation.copiedTokens = nullptr;
+    return invocation;
+}
+
+void PPMacroExpander::releaseInvocation(Invocation& invocation)
+{
+    for( const Argument& argument : invocation.arguments ) {
+        releaseBuffer(argument.expansion);
+    }
+    releaseBuffer(invocation.copiedTokens);
+    --invocationDepth;
+}
@@ -0,0 +1,339 @@
+// PPMacro.hpp
+//
+// Author: Marco Jacques
+//
+// Macro definitions and macro expansion
+//
+
+#pragma once
+
+#include "Arena.hpp"
+#include "Message.hpp"
+#include "PPParser.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Interned set of macros, by index
+ */
+using PPHideset = uint32_t;
+
+/**
+ * Token of a macro expansion.  Unlike a PPToken, its spelling is a pointer: it
+ * may be in a source, in a macro definition, or in the scratch space of the
+ * tokens made by # and ##.  The hideset is the set of the macros that must not be
+ * expanded from this token (C90 6.8.3.4).
+ */
+struct PPExpandedToken {
+    const char* spelling;
+    uint32_t length;
+    PPHideset hideset;
+    PPToken::Kind kind;
+    uint8_t punctuator;
+    uint8_t flags;
+
+    bool isPunctuator(LexerToken::Kind kind_) const { return kind == PPToken::PUNCTUATOR && punctuator == kind_; }
+    bool hasLeadingSpace() const { return (flags & PPToken::LEADING_SPACE) != 0; }
+    bool isStartOfLine() const { return (flags & PPToken::START_OF_LINE) != 0; }
+    std::string getSpelling() const { return std::string(spelling, length); }
+
+    /**
+     * Token of a source
+     */
+    static PPExpandedToken fromToken(const PPToken& token, const PPSource& source)
+    {
+        return PPExpandedToken{source.getText() + token.getOffset(), token.getLength(), 0, token.getKind(),
+            static_cast<uint8_t>(token.getPunctuator()), token.getFlags()};
+    }
+};
+
+using PPExpandedTokenList = std::vector<PPExpandedToken>;
+
+/**
+ * Table of the interned hidesets.  A hideset is a sorted array of macro indexes,
+ * stored once: tokens only keep its number, and the results of the operations
+ * are cached, so marking the tokens of an expansion costs a lookup per token.
+ * The empty hideset is 0.
+ */
+class PPHidesetTable {
+public:
+    static const PPHideset EMPTY = 0;
+
+    /**
+     * Constructor
+     */
+    PPHidesetTable();
+
+    PPHidesetTable(const PPHidesetTable&) = delete;
+    PPHidesetTable& operator=(const PPHidesetTable&) = delete;
+
+    bool contains(PPHideset hideset, uint32_t macroIndex) const;
+
+    /**
+     * Operations on the sets
+     */
+    PPHideset add(PPHideset hideset, uint32_t macroIndex);
+    PPHideset unite(PPHideset hideset1, PPHideset hideset2);
+    PPHideset intersect(PPHideset hideset1, PPHideset hideset2);
+
+    size_t getNbHidesets() const { return hidesets.size(); }
+
+private:
+    struct Hideset {
+        uint32_t start;
+        uint32_t size;
+        uint64_t hash;
+    };
+
+    PPHideset intern(const std::vector<uint32_t>& elements);
+    void growBuckets();
+
+    std::vector<Hideset> hidesets;
+    std::vector<uint32_t> elements;
+
+    // Open addressing hash table of the hidesets, the size is a power of 2
+    //
+    std::vector<PPHideset> buckets;
+
+    // Results of the operations, by operands
+    //
+    std::unordered_map<uint64_t, PPHideset> addResults;
+    std::unordered_map<uint64_t, PPHideset> uniteResults;
+    std::unordered_map<uint64_t, PPHideset> intersectResults;
+    std::vector<uint32_t> scratch;
+};
+
+/**
+ * Macro definition.  The replacement list is copied in the arena of the macro
+ * table, so it doesn't depend on the source defining it.
+ */
+class PPMacro {
+public:
+    static const uint32_t NOT_PARAM = UINT32_MAX;
+
+    /**
+     * Index of the macro name, the same for all the definitions of a name
+     */
+    uint32_t getIndex() const { return index; }
+    std::string getName() const { return std::string(name, nameLength); }
+
+    bool isFunctionLike() const { return functionLike; }
+    unsigned getNbParams() const { return nbParams; }
+
+    unsigned getBodySize() const { return bodySize; }
+    const PPExpandedToken& getBodyToken(unsigned i) const { return body[i]; }
+
+    /**
+     * Parameter replaced by a token of the replacement list, NOT_PARAM if none
+     */
+    uint32_t getParamIndex(unsigned i) const { return paramIndexes[i]; }
+
+    /**
+     * Check if two definitions are the same (C90 6.8.3): same parameters, same
+     * replacement list and same white space separations
+     */
+    bool isSameDefinition(const PPMacro& other) const;
+
+private:
+    friend class PPMacroTable;
+
+    uint32_t index;
+    const char* name;
+    uint32_t nameLength;
+    bool functionLike;
+    unsigned nbParams;
+    unsigned bodySize;
+    const PPExpandedToken* body;
+    const uint32_t* paramIndexes;
+};
+
+/**
+ * Macros visible at a point of the preprocessing, by name.  The names are
+ * interned in an open addressing table; each name has an index, used in the
+ * hidesets, and its current definition.
+ */
+class PPMacroTable {
+public:
+    /**
+     * Constructor
+     */
+    PPMacroTable();
+
+    PPMacroTable(const PPMacroTable&) = delete;
+    PPMacroTable& operator=(const PPMacroTable&) = delete;
+
+    /**
+     * Define a macro, replacing the previous definition.  The parameters are
+     * numbered from 0 in paramIndexes.  Returns the previous definition, nullptr
+     * if there was none.
+     */
+    const PPMacro* define(
+        const char* name,
+        uint32_t nameLength,
+        bool functionLike,
+        unsigned nbParams,
+        const PPExpandedToken* body,
+        const uint32_t* paramIndexes,
+        unsigned bodySize
+        );
+
+    /**
+     * Remove a definition
+     */
+    void undefine(const char* name, uint32_t nameLength);
+
+    /**
+     * Current definition of a name, nullptr if none
+     */
+    const PPMacro* find(const char* name, uint32_t nameLength) const;
+    const PPMacro* find(const std::string& name) const { return find(name.data(), static_cast<uint32_t>(name.size())); }
+
+    size_t getNbMacros() const { return nbMacros; }
+
+    /**
+     * Current definitions, in the order of the indexes of their names
+     */
+    void getMacros(std::vector<const PPMacro *>& macros) const;
+
+private:
+    struct Name {
+        const char* name;
+        uint32_t length;
+        uint32_t index;
+        uint64_t hash;
+        const PPMacro* macro;
+    };
+
+    Name* findName(const char* name, uint32_t length, uint64_t hash) const;
+    Name* getName(const char* name, uint32_t length);
+    void growNames();
+
+    Arena arena;
+    std::vector<Name *> names;
+    uint32_t nbNames;
+    size_t nbMacros;
+};
+
+/**
+ * Macro expansion (C90 6.8.3), with the hidesets of Prosser's algorithm: a token
+ * produced by the expansion of a macro can't expand the macro again.
+ *
+ * The tokens are read from a stack of inputs: the tokens to expand, then the
+ * results of the expansions being rescanned.  The arguments of an invocation are
+ * spans of its input when the whole invocation is in a single input, else
+ * copies.  An argument is expanded when first used, and its expansion is kept
+ * for the other uses in the same invocation.
+ *
+ * For the tokens to expand, the distance from each ( to its ) is computed once:
+ * collecting the arguments of nested invocations jumps over the parentheses, so
+ * the arguments of X(X(X(...))) are collected in linear time, instead of reading
+ * the inner invocations again at each level.  The rescans still read the result
+ * of each expansion.  The token buffers come from a pool and are reused by the
+ * following expansions.
+ */
+class PPMacroExpander {
+public:
+    struct Statistics {
+        size_t nbExpansions;            // Macro invocations replaced
+        size_t nbTokensRead;            // Tokens read from the inputs, including the rescans
+        size_t nbArgExpansions;         // Arguments expanded
+        size_t nbBuffersCreated;        // Buffers allocated by the pool, the others are reused
+    };
+
+    /**
+     * Constructor
+     */
+    PPMacroExpander(const std::shared_ptr<PPMacroTable>& macroTable_, const std::shared_ptr<Message>& msg_);
+
+    PPMacroExpander(const PPMacroExpander&) = delete;
+    PPMacroExpander& operator=(const PPMacroExpander&) = delete;
+
+    /**
+     * Expand a sequence of tokens, adding the result to the output.  The position
+     * is used for the messages.
+     */
+    void expand(
+        const PPExpandedToken* tokens,
+        size_t nbTokens,
+        const SourcePosition& sourcePosition,
+        PPExpandedTokenList& output
+        );
+
+    const Statistics& getStatistics() const { return statistics; }
+    size_t getNbHidesets() const { return hidesetTable.getNbHidesets(); }
+
+private:
+    using Buffer = PPExpandedTokenList;
+
+    /**
+     * Tokens being read.  The distances to the matching parentheses are known
+     * for the tokens to expand, not for the results of the expansions.
+     */
+    struct Input {
+        const PPExpandedToken* tokens;
+        size_t position;
+        size_t size;
+        const uint32_t* parenDistances;
+        Buffer* ownedBuffer;
+    };
+
+    /**
+     * Argument of an invocation, and its expansion once done
+     */
+    struct Argument {
+        const PPExpandedToken* tokens;
+        size_t size;
+        const uint32_t* parenDistances;
+        Buffer* expansion;
+    };
+
+    /**
+     * Arguments of an invocation, reused by the invocations at the same depth
+     */
+    struct Invocation {
+        std::vector<Argument> arguments;
+        std::vector<size_t> argumentStarts;
+        Buffer* copiedTokens;
+    };
+
+    void expandInput(const Input& input, Buffer& output);
+    bool nextToken(size_t baseDepth, PPExpandedToken& token);
+    const PPExpandedToken* peekToken(size_t baseDepth);
+    bool collectArguments(const PPMacro* macro, size_t baseDepth, Invocation& invocation, PPHideset& rightParenHideset);
+    bool collectSpanArguments(Input& input, Invocation& invocation, PPHideset& rightParenHideset);
+    void substitute(const PPMacro* macro, Invocation* invocation, PPHideset hideset, Buffer& output);
+    void appendArgument(Argument& argument, bool expanded, PPHideset hideset, uint8_t firstFlags, Buffer& output);
+    const Buffer& getExpandedArgument(Argument& argument);
+    PPExpandedToken stringize(const Argument& argument, PPHideset hideset);
+    bool paste(const PPExpandedToken& left, const PPExpandedToken& right, PPExpandedToken& result);
+    void computeParenDistances(const PPExpandedToken* tokens, size_t nbTokens);
+
+    Buffer* acquireBuffer();
+    void releaseBuffer(Buffer* buffer);
+    Invocation& acquireInvocation();
+    void releaseInvocation(Invocation& invocation);
+
+    std::shared_ptr<PPMacroTable> macroTable;
+    std::shared_ptr<Message> msg;
+    PPHidesetTable hidesetTable;
+    SourcePosition sourcePosition;
+
+    std::vector<Input> inputs;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+    std::vector<Buffer *> freeBuffers;
+    std::vector<std::unique_ptr<Invocation>> invocations;
+    size_t invocationDepth;
+    std::vector<uint32_t> parenDistances;
+    std::vector<size_t> openParens;
+
+    // Spellings of the tokens made by # and ##
+    //
+    Arena scratch;
+    std::string spelling;
+
+    Statistics statistics;
+};
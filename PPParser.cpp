@@ -1,18 +1,565 @@
+// PPParser.cpp
+//
+// Author: Marco Jacques
+//
+// Preprocessing tokens (phase 3 of translation)
+//
 
 #include "PPParser.hpp"
+#include "C90Preprocess.hpp"
+#include <algorithm>
+#include <cstring>
 
+namespace {
 
+    enum CharClass : uint8_t {
+        IDENTIFIER_START = 1 << 0,      // Letter or _
+        DIGIT = 1 << 1,
+        SPACE = 1 << 2,                 // White space other than newline
+        LINE_STOP = 1 << 3              // Ends a run of characters skipped in a line
+    };
 
-static void readProprocessLine()
+    /**
+     * Class of each character
+     */
+    struct CharClassTable {
+        uint8_t classes[256];
+
+        CharClassTable() : classes()
+        {
+            for( int c = 'a'; c <= 'z'; ++c ) {
+                classes[c] = IDENTIFIER_START;
+                classes[c - 'a' + 'A'] = IDENTIFIER_START;
+            }
+            classes['_'] = IDENTIFIER_START;
+
+            for( int c = '0'; c <= '9'; ++c ) {
+                classes[c] = DIGIT;
+            }
+
+            for( char c : {' ', '\t', '\v', '\f', '\r'} ) {
+                classes[static_cast<uint8_t>(c)] = SPACE;
+            }
+
+            for( char c : {'\n', '/', '"', '\'', '\0'} ) {
+                classes[static_cast<uint8_t>(c)] = LINE_STOP;
+            }
+        }
+    };
+
+    const CharClassTable charClassTable;
+
+    inline bool hasClass(char c, uint8_t charClass)
+    {
+        return (charClassTable.classes[static_cast<uint8_t>(c)] & charClass) != 0;
+    }
+
+    inline bool isIdentifierChar(char c)
+    {
+        return hasClass(c, IDENTIFIER_START | DIGIT);
+    }
+
+    // Expected number of characters per token, to size the token list
+    //
+    const uint32_t NB_CHARS_PER_TOKEN = 6;
+}
+
+/**
+ * Constructor: concatenate the streams of phase 2
+ */
+PPSource::PPSource(const CharacterStreamList& streams) :
+    text(),
+    segments()
 {
-    
+    size_t size = 0;
+    for( const CharacterStream& stream : streams ) {
+        size += stream.getStream().size();
+    }
+
+    text.reserve(size);
+    segments.reserve(streams.size());
+    for( const CharacterStream& stream : streams ) {
+        segments.push_back(Segment{static_cast<uint32_t>(text.size()), stream.getSourcePosition()});
+        text += stream.getStream();
+    }
+}
+
+/**
+ * Constructor from a text, all on the same file.  There is a segment per line, so
+ * the positions are found without reading the text from its start.
+ */
+PPSource::PPSource(const std::string& text_, const std::shared_ptr<std::string>& filename) :
+    text(text_),
+    segments(1, Segment{0, SourcePosition(filename, 1, 1)})
+{
+    int lineNumber = 1;
+    for( size_t newline = text.find('\n'); newline != std::string::npos; newline = text.find('\n', newline + 1) ) {
+        segments.push_back(Segment{static_cast<uint32_t>(newline + 1), SourcePosition(filename, ++lineNumber, 1)});
+    }
+}
+
+PPSource::PPSource(const char* text_, uint32_t size, const SegmentPosition* positions, size_t nbPositions,
+                   const std::shared_ptr<std::string>& filename) :
+    text(text_, size),
+    segments()
+{
+    segments.reserve(nbPositions);
+    for( size_t i = 0; i < nbPositions; ++i ) {
+        segments.push_back(Segment{positions[i].offset, SourcePosition(filename, positions[i].lineNumber, positions[i].columnNumber)});
+    }
+}
+
+void PPSource::getSegmentPositions(std::vector<SegmentPosition>& positions) const
+{
+    positions.clear();
+    for( const Segment& segment : segments ) {
+        const SourcePosition& position = segment.sourcePosition;
+        positions.push_back(SegmentPosition{segment.offset, position.getLineNumber(), position.getColumnNumber()});
+    }
+}
+
+/**
+ * Source position of a character: the position of its stream, moved by the
+ * characters before it in the stream
+ */
+SourcePosition PPSource::getSourcePosition(uint32_t offset) const
+{
+    auto segment = std::upper_bound(segments.begin(), segments.end(), offset,
+        [](uint32_t value, const Segment& segment) { return value < segment.offset; });
+    if( segment == segments.begin() ) {
+        return SourcePosition(nullptr, 0, 0);
+    }
+    --segment;
+
+    const SourcePosition& position = segment->sourcePosition;
+    int lineNumber = position.getLineNumber();
+    int columnNumber = position.getColumnNumber() + static_cast<int>(offset - segment->offset);
+    for( uint32_t i = segment->offset; i < offset; ++i ) {
+        if( text[i] == '\n' ) {
+            ++lineNumber;
+            columnNumber = static_cast<int>(offset - i);
+        }
+    }
+
+    return SourcePosition(position.getFilename(), lineNumber, columnNumber);
+}
+
+/**
+ * Constructor
+ */
+PPLexer::PPLexer(const PPSource& source_, const std::shared_ptr<Message>& msg_) :
+    source(&source_),
+    msg(msg_),
+    startChar(source_.getText()),
+    currChar(source_.getText()),
+    endChar(source_.getText() + source_.getSize()),
+    flags(PPToken::START_OF_LINE),
+    error(false),
+    errors()
+{
+    // Nothing else to do
+}
+
+/**
+ * Constructor for a text outside of a source
+ */
+PPLexer::PPLexer(const char* text, uint32_t size) :
+    source(nullptr),
+    msg(),
+    startChar(text),
+    currChar(text),
+    endChar(text + size),
+    flags(PPToken::START_OF_LINE),
+    error(false),
+    errors()
+{
+    // Nothing else to do
+}
+
+/**
+ * Report an error at a character, if the text is in a source
+ */
+void PPLexer::reportError(const char* position, Message::Msg message)
+{
+    error = true;
+    if( msg == nullptr ) {
+        errors.push_back(Error{getOffset(position), message});
+    }
+    else if( source != nullptr ) {
+        msg->issueMessage(source->getSourcePosition(getOffset(position)), message, {});
+    }
+}
+
+/**
+ * Next token
+ */
+PPToken PPLexer::nextToken()
+{
+    skipWhiteSpaces();
+
+    const char* tokenStart = currChar;
+    uint8_t tokenFlags = flags;
+    flags = 0;
+
+    if( currChar == endChar ) {
+        flags = tokenFlags;
+        return PPToken(PPToken::END_OF_FILE, LexerToken::END_OF_FILE, tokenFlags | PPToken::START_OF_LINE, getOffset(currChar), 0);
+    }
+
+    PPToken::Kind kind = PPToken::PUNCTUATOR;
+    LexerToken::Kind punctuator = LexerToken::UNKNOWN;
+    char firstChar = *currChar;
+
+    // Identifier, or wide literal
+    //
+    if( hasClass(firstChar, IDENTIFIER_START) ) {
+        if( firstChar == 'L' && (currChar[1] == '"' || currChar[1] == '\'') ) {
+            ++currChar;
+            kind = *currChar == '"' ? PPToken::STRING_LITERAL : PPToken::CHAR_CONSTANT;
+            readLiteral(*currChar);
+        }
+        else {
+            do {
+                ++currChar;
+            } while( isIdentifierChar(*currChar) );
+            kind = PPToken::IDENTIFIER;
+        }
+    }
+    else if( hasClass(firstChar, DIGIT) || (firstChar == '.' && hasClass(currChar[1], DIGIT)) ) {
+        readPPNumber();
+        kind = PPToken::PP_NUMBER;
+    }
+    else if( firstChar == '"' || firstChar == '\'' ) {
+        kind = firstChar == '"' ? PPToken::STRING_LITERAL : PPToken::CHAR_CONSTANT;
+        readLiteral(firstChar);
+    }
+    else {
+        punctuator = readPunctuator();
+        kind = punctuator != LexerToken::UNKNOWN ? PPToken::PUNCTUATOR : PPToken::OTHER;
+    }
+
+    return PPToken(kind, punctuator, tokenFlags, getOffset(tokenStart), static_cast<uint32_t>(currChar - tokenStart));
+}
+
+/**
+ * Check if the next token starts a line
+ */
+bool PPLexer::isAtEndOfLine()
+{
+    skipWhiteSpaces();
+    return (flags & PPToken::START_OF_LINE) != 0 || currChar >= endChar;
+}
+
+/**
+ * Skip the lines of a skipped group, a line at a time up to a line starting with #
+ */
+PPToken PPLexer::skipGroup()
+{
+    // At the start of a line, the # of a directive may follow white spaces and
+    // comments
+    //
+    skipWhiteSpaces();
+    while( *currChar != '#' && currChar < endChar ) {
+        currChar = skipLine(currChar);
+        skipWhiteSpaces();
+    }
+
+    flags = PPToken::START_OF_LINE;
+    return nextToken();
 }
 
+/**
+ * Skip the text up to the next directive
+ */
+PPToken PPLexer::skipText()
+{
+    currChar = skipLine(currChar);
+    return skipGroup();
+}
+
+/**
+ * End of the line of a position, after the comments.  A line without / is found
+ * with memchr; else the literals are skipped too, as they may contain the start
+ * of a comment.  A literal ends at the end of the line if it is not terminated:
+ * the error is left to the lexing of the lines that are not skipped.
+ */
+const char* PPLexer::skipLine(const char* position)
+{
+    for( ;; ) {
+        const char* lineEnd = static_cast<const char *>(std::memchr(position, '\n', endChar - position));
+        if( lineEnd == nullptr ) {
+            lineEnd = endChar;
+        }
+        if( std::memchr(position, '/', lineEnd - position) == nullptr ) {
+            return lineEnd;
+        }
+
+        while( position <= lineEnd ) {
+            while( !hasClass(*position, LINE_STOP) ) {
+                ++position;
+            }
+
+            char c = *position;
+            if( c == '\n' || position >= endChar ) {
+                return position;
+            }
+
+            if( c == '/' ) {
+                if( position[1] != '*' ) {
+                    ++position;
+                    continue;
+                }
+
+                // The comment may hide the newline, then its end is in another line
+                //
+                const char* endComment = std::strstr(position + 2, "*/");
+                if( endComment == nullptr ) {
+                    reportError(position, Message::ERROR_UNTERMINATED_COMMENT);
+                    return endChar;
+                }
+                position = endComment + 2;
+            }
+            else if( c == '"' || c == '\'' ) {
+                ++position;
+                while( *position != c && *position != '\n' && position < endChar ) {
+                    position += *position == '\\' && position[1] != '\n' && position + 1 < endChar ? 2 : 1;
+                }
+                if( *position == c ) {
+                    ++position;
+                }
+            }
+            else {
+                // NUL in the text
+                //
+                ++position;
+            }
+        }
+    }
+}
+
+/**
+ * Skip the white spaces and the comments, noting them in the flags of the next
+ * token
+ */
+void PPLexer::skipWhiteSpaces()
+{
+    for( ;; ) {
+        char c = *currChar;
+        if( hasClass(c, SPACE) ) {
+            flags |= PPToken::LEADING_SPACE;
+            ++currChar;
+        }
+        else if( c == '\n' ) {
+            flags = PPToken::START_OF_LINE;
+            ++currChar;
+        }
+        else if( c == '/' && currChar[1] == '*' ) {
+            const char* endComment = std::strstr(currChar + 2, "*/");
+            if( endComment == nullptr ) {
+                reportError(currChar, Message::ERROR_UNTERMINATED_COMMENT);
+                currChar = endChar;
+            }
+            else {
+                currChar = endComment + 2;
+            }
+            flags |= PPToken::LEADING_SPACE;
+        }
+        else {
+            return;
+        }
+    }
+}
+
+/**
+ * pp-number (C90 6.1.8): a digit, or . and a digit, followed by letters, digits,
+ * _, ., and the signs after e or E
+ */
+void PPLexer::readPPNumber()
+{
+    ++currChar;
+    for( ;; ) {
+        char c = *currChar;
+        if( (c == '+' || c == '-') && (currChar[-1] == 'e' || currChar[-1] == 'E') ) {
+            ++currChar;
+        }
+        else if( isIdentifierChar(c) || c == '.' ) {
+            ++currChar;
+        }
+        else {
+            return;
+        }
+    }
+}
+
+/**
+ * Character constant or string literal, the escape sequences are kept.  A
+ * literal ends at the end of the line if it is not terminated.
+ */
+void PPLexer::readLiteral(char quote)
+{
+    const char* literalStart = currChar++;
+    for( ;; ) {
+        char c = *currChar;
+        if( c == quote ) {
+            ++currChar;
+            return;
+        }
+
+        if( c == '\n' || currChar == endChar ) {
+            reportError(literalStart, Message::ERROR_UNTERMINATED_LITERAL);
+            return;
+        }
+
+        currChar += (c == '\\' && currChar[1] != '\n' && currChar + 1 != endChar) ? 2 : 1;
+    }
+}
+
+/**
+ * Punctuator, the longest one.  Returns UNKNOWN for a character that starts no
+ * token, after skipping it.
+ */
+LexerToken::Kind PPLexer::readPunctuator()
+{
+    auto accept = [&](unsigned length, LexerToken::Kind punctuator) {
+        currChar += length;
+        return punctuator;
+    };
+
+    char nextChar1 = currChar[1];
+    char nextChar2 = nextChar1 != '\0' ? currChar[2] : '\0';
+
+    switch( *currChar ) {
+        case '[':   return accept(1, LexerToken::LEFT_BRACKET);
+        case ']':   return accept(1, LexerToken::RIGHT_BRACKET);
+        case '(':   return accept(1, LexerToken::LEFT_PARAR);
+        case ')':   return accept(1, LexerToken::RIGHT_PARAR);
+        case '{':   return accept(1, LexerToken::LEFT_BRACE);
+        case '}':   return accept(1, LexerToken::RIGHT_BRACE);
+        case ';':   return accept(1, LexerToken::SEMICOLON);
+        case ',':   return accept(1, LexerToken::COMMA);
+        case '~':   return accept(1, LexerToken::BIT_NOT);
+        case '?':   return accept(1, LexerToken::QUESTION_MARK);
+        case ':':   return accept(1, LexerToken::COLON);
+
+        case '.':
+            return nextChar1 == '.' && nextChar2 == '.' ? accept(3, LexerToken::DOT_DOT_DOT) : accept(1, LexerToken::DOT);
+
+        case '-':
+            switch( nextChar1 ) {
+                case '-':   return accept(2, LexerToken::DECR);
+                case '=':   return accept(2, LexerToken::SUB_ASSIGN);
+                case '>':   return accept(2, LexerToken::LEFT_ARROW);
+                default:    return accept(1, LexerToken::SUB);
+            }
+
+        case '+':
+            switch( nextChar1 ) {
+                case '+':   return accept(2, LexerToken::INCR);
+                case '=':   return accept(2, LexerToken::ADD_ASSIGN);
+                default:    return accept(1, LexerToken::ADD);
+            }
+
+        case '&':
+            switch( nextChar1 ) {
+                case '&':   return accept(2, LexerToken::BOOL_AND);
+                case '=':   return accept(2, LexerToken::BIT_AND_ASSIGN);
+                default:    return accept(1, LexerToken::BIT_AND);
+            }
+
+        case '|':
+            switch( nextChar1 ) {
+                case '|':   return accept(2, LexerToken::BOOL_OR);
+                case '=':   return accept(2, LexerToken::BIT_IOR_ASSIGN);
+                default:    return accept(1, LexerToken::BIT_IOR);
+            }
+
+        case '*':   return nextChar1 == '=' ? accept(2, LexerToken::MUL_ASSIGN) : accept(1, LexerToken::MUL);
+        case '/':   return nextChar1 == '=' ? accept(2, LexerToken::DIV_ASSIGN) : accept(1, LexerToken::DIV);
+        case '%':   return nextChar1 == '=' ? accept(2, LexerToken::MOD_ASSIGN) : accept(1, LexerToken::MOD);
+        case '^':   return nextChar1 == '=' ? accept(2, LexerToken::BIT_XOR_ASSIGN) : accept(1, LexerToken::BIT_XOR);
+        case '!':   return nextChar1 == '=' ? accept(2, LexerToken::NOT_EQUAL) : accept(1, LexerToken::BOOL_NOT);
+        case '=':   return nextChar1 == '=' ? accept(2, LexerToken::EQUAL) : accept(1, LexerToken::ASSIGN);
+        case '#':   return nextChar1 == '#' ? accept(2, LexerToken::HASH_HASH) : accept(1, LexerToken::HASH);
+
+        case '<':
+            switch( nextChar1 ) {
+                case '<':   return nextChar2 == '=' ? accept(3, LexerToken::SHIFT_LEFT_ASSIGN) : accept(2, LexerToken::SHIFT_LEFT);
+                case '=':   return accept(2, LexerToken::LE);
+                default:    return accept(1, LexerToken::LT);
+            }
+
+        case '>':
+            switch( nextChar1 ) {
+                case '>':   return nextChar2 == '=' ? accept(3, LexerToken::SHIFT_RIGHT_ASSIGN) : accept(2, LexerToken::SHIFT_RIGHT);
+                case '=':   return accept(2, LexerToken::GE);
+                default:    return accept(1, LexerToken::GT);
+            }
+
+        default:
+            return accept(1, LexerToken::UNKNOWN);
+    }
+}
+
+PPTokenReader::PPTokenReader(const PPSource& source_, const PPToken* tokens_, const std::vector<PPLexer::Error>& errors_,
+                             const std::shared_ptr<Message>& msg_) :
+    source(source_),
+    tokens(tokens_),
+    position(0),
+    errors(errors_),
+    nextError(0),
+    msg(msg_)
+{
+    // Nothing else to do
+}
+
+/**
+ * Next token, with the errors found before its end
+ */
+PPToken PPTokenReader::nextToken()
+{
+    const PPToken& token = tokens[position];
+    uint32_t tokenEnd = token.getOffset() + token.getLength();
+    for( ; nextError < errors.size() && errors[nextError].offset < tokenEnd; ++nextError ) {
+        msg->issueMessage(source.getSourcePosition(errors[nextError].offset), errors[nextError].message, {});
+    }
+
+    position += token.getKind() != PPToken::END_OF_FILE ? 1 : 0;
+    return token;
+}
+
+PPToken PPTokenReader::skipGroup()
+{
+    for( ;; ) {
+        const PPToken& token = tokens[position];
+        bool directive = token.getKind() == PPToken::PUNCTUATOR && token.getPunctuator() == LexerToken::HASH;
+        if( token.isStartOfLine() && (directive || token.getKind() == PPToken::END_OF_FILE) ) {
+            break;
+        }
+        ++position;
+    }
+
+    for( ; nextError < errors.size() && errors[nextError].offset < tokens[position].getOffset(); ++nextError ) {
+        if( errors[nextError].message == Message::ERROR_UNTERMINATED_COMMENT ) {
+            msg->issueMessage(source.getSourcePosition(errors[nextError].offset), errors[nextError].message, {});
+        }
+    }
+
+    return nextToken();
+}
+
+/**
+ * Phase 3 of translation: decompose the source in preprocessing tokens
+ */
 void preprocessorParser(
-    const PPLexer& pplexer,
-    const Message& msg,
+    const PPSource& source,
+    const std::shared_ptr<Message>& msg,
     PPTokenList& tokenList
 )
 {
-    // Get all the spaces out first
+    PPLexer lexer(source, msg);
+    tokenList.reserve(tokenList.size() + source.getSize() / NB_CHARS_PER_TOKEN + 1);
+
+    do {
+        tokenList.push_back(lexer.nextToken());
+    } while( tokenList.back().getKind() != PPToken::END_OF_FILE );
 }
@@ -1,25 +1,251 @@
+// PPParser.hpp
+//
+// Author: Marco Jacques
+//
+// Preprocessing tokens (phase 3 of translation)
+//
 
 #pragma once
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
+#include "LexerToken.hpp"
 #include "Message.hpp"
 
+class CharacterStream;
+using CharacterStreamList = std::vector<CharacterStream>;
+
+/**
+ * Source of one file after phases 1 and 2, as a single buffer ending with a NUL.
+ * The pp-tokens refer to their spelling by offset in this buffer; the source
+ * positions are only computed for the messages.
+ */
+class PPSource {
+public:
+    /**
+     * Position of the start of a stream, without its file
+     */
+    struct SegmentPosition {
+        uint32_t offset;
+        int32_t lineNumber;
+        int32_t columnNumber;
+    };
+
+    /**
+     * Constructor: concatenate the streams of phase 2
+     */
+    PPSource(const CharacterStreamList& streams);
+
+    /**
+     * Constructor from a text, all on the same file
+     */
+    PPSource(const std::string& text_, const std::shared_ptr<std::string>& filename);
+
+    /**
+     * Constructor from a text and the positions of its streams, all on the same file
+     */
+    PPSource(const char* text_, uint32_t size, const SegmentPosition* positions, size_t nbPositions,
+             const std::shared_ptr<std::string>& filename);
+
+    const char* getText() const { return text.c_str(); }
+    uint32_t getSize() const { return static_cast<uint32_t>(text.size()); }
+
+    /**
+     * Source position of a character of the buffer
+     */
+    SourcePosition getSourcePosition(uint32_t offset) const;
+
+    /**
+     * Bytes used by the buffer and the positions
+     */
+    size_t getMemorySize() const { return text.capacity() + segments.capacity() * sizeof(Segment); }
+
+    /**
+     * Positions of the streams, to build the source again
+     */
+    void getSegmentPositions(std::vector<SegmentPosition>& positions) const;
+
+private:
+    /**
+     * Start of a stream in the buffer
+     */
+    struct Segment {
+        uint32_t offset;
+        SourcePosition sourcePosition;
+    };
+
+    std::string text;
+    std::vector<Segment> segments;
+};
+
+/**
+ * Preprocessing token (C90 6.1).  A token is a small value: its spelling is a
+ * range of the source buffer, and the white space before it is kept as flags.
+ * Tokens are stored by value in a PPTokenList.
+ */
 class PPToken {
+public:
+    enum Kind : uint8_t {
+        IDENTIFIER,
+        PP_NUMBER,
+        CHAR_CONSTANT,
+        STRING_LITERAL,
+        PUNCTUATOR,
+        OTHER,              // Non white space character that is not part of another token
+        END_OF_FILE
+    };
+
+    enum Flags : uint8_t {
+        LEADING_SPACE = 1 << 0,     // White space or comment before the token
+        START_OF_LINE = 1 << 1,     // First token of a line
+        NO_EXPAND = 1 << 2          // Macro name that can't be expanded anymore, set by the macro expansion
+    };
+
+    PPToken() = default;
+    PPToken(Kind kind_, LexerToken::Kind punctuator_, uint8_t flags_, uint32_t offset_, uint32_t length_) :
+        offset(offset_), length(length_), kind(kind_), punctuator(static_cast<uint8_t>(punctuator_)), flags(flags_) { }
+
+    Kind getKind() const { return static_cast<Kind>(kind); }
+
+    /**
+     * Operator of a PUNCTUATOR token
+     */
+    LexerToken::Kind getPunctuator() const { return static_cast<LexerToken::Kind>(punctuator); }
+
+    bool hasLeadingSpace() const { return (flags & LEADING_SPACE) != 0; }
+    bool isStartOfLine() const { return (flags & START_OF_LINE) != 0; }
+    uint8_t getFlags() const { return flags; }
 
+    uint32_t getOffset() const { return offset; }
+    uint32_t getLength() const { return length; }
+
+    std::string getSpelling(const PPSource& source) const { return std::string(source.getText() + offset, length); }
+
+private:
+    uint32_t offset;
+    uint32_t length;
+    uint8_t kind;
+    uint8_t punctuator;
+    uint8_t flags;
 };
 
-using PPTokenPtr = std::shared_ptr<PPToken>;
-using PPTokenList = std::vector<PPTokenPtr>;
+using PPTokenList = std::vector<PPToken>;
 
+/**
+ * Lexer of preprocessing tokens.  Comments are white space; a comment with
+ * newlines doesn't start a line.  The characters are classified with a table, and
+ * the source is read through a pointer: the NUL at the end of the buffer stops
+ * every scanning loop.
+ */
 class PPLexer {
+public:
+    /**
+     * Error noted, not reported
+     */
+    struct Error {
+        uint32_t offset;
+        Message::Msg message;
+    };
+
+    /**
+     * Constructor.  Without a Message, the errors are only noted, in getErrors().
+     */
+    PPLexer(const PPSource& source_, const std::shared_ptr<Message>& msg_);
+
+    /**
+     * Constructor for a text outside of a source, ending with a NUL, like the
+     * result of ##.  The errors are not reported, only noted.
+     */
+    PPLexer(const char* text, uint32_t size);
+
+    /**
+     * Next token.  The END_OF_FILE token is returned at the end, and starts a line.
+     */
+    PPToken nextToken();
+
+    /**
+     * Check if the next token starts a line, without lexing it
+     */
+    bool isAtEndOfLine();
+
+    /**
+     * Skip the lines of a skipped group (C90 6.8.1), from the start of a line, and
+     * return the # of the next directive or END_OF_FILE.  Only the newlines, the
+     * comments and the quotes are looked for, nothing else is lexed.
+     */
+    PPToken skipGroup();
+
+    /**
+     * Skip the rest of the line, then the lines up to the next directive, like
+     * skipGroup.  For a scan of the directives only.
+     */
+    PPToken skipText();
+
+    /**
+     * Check if an unterminated comment or literal was found
+     */
+    bool anyError() const { return error; }
+    const std::vector<Error>& getErrors() const { return errors; }
 
+private:
+    void skipWhiteSpaces();
+    const char* skipLine(const char* position);
+    void readPPNumber();
+    void readLiteral(char quote);
+    LexerToken::Kind readPunctuator();
+    void reportError(const char* position, Message::Msg message);
+    uint32_t getOffset(const char* position) const { return static_cast<uint32_t>(position - startChar); }
+
+    const PPSource* source;
+    std::shared_ptr<Message> msg;
+    const char* startChar;
+    const char* currChar;
+    const char* endChar;
+    uint8_t flags;
+    bool error;
+    std::vector<Error> errors;
+};
+
+/**
+ * Reader of the pp-tokens of a source already lexed, with the interface of the
+ * lexer: the preprocessor reads either one.  The errors noted by the lexer are
+ * reported as the lexer would: with their token, not in the skipped groups,
+ * except for the unterminated comments.
+ */
+class PPTokenReader {
+public:
+    /**
+     * Constructor: the tokens end with END_OF_FILE, the errors are sorted by offset
+     */
+    PPTokenReader(const PPSource& source_, const PPToken* tokens_, const std::vector<PPLexer::Error>& errors_,
+                  const std::shared_ptr<Message>& msg_);
+
+    PPToken nextToken();
+    bool isAtEndOfLine() const { return tokens[position].isStartOfLine(); }
+
+    /**
+     * Skip to the next line starting with #, like the lexer
+     */
+    PPToken skipGroup();
+    PPToken skipText() { return skipGroup(); }
+
+private:
+    const PPSource& source;
+    const PPToken* tokens;
+    size_t position;
+    const std::vector<PPLexer::Error>& errors;
+    size_t nextError;
+    std::shared_ptr<Message> msg;
 };
 
+/**
+ * Phase 3 of translation: decompose the source in preprocessing tokens.  The list
+ * ends with an END_OF_FILE token.
+ */
 void preprocessorParser(
-    const PPLexer& pplexer,
-    const Message& msg,
+    const PPSource& source,
+    const std::shared_ptr<Message>& msg,
     PPTokenList& tokenList
 );
-
-
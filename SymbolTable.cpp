@@ -0,0 +1,206 @@
+// SymbolTable.cpp
+//
+// Author: Marco Jacques
+//
+// Scoped symbol table implementation
+//
+
+#include "SymbolTable.hpp"
+#include "Hashing.hpp"
+#include <cassert>
+#include <cstring>
+
+namespace {
+
+    const size_t INITIAL_NB_BUCKETS = 1024;
+
+    bool isSameName(const Identifier* identifier, const char* name, size_t length)
+    {
+        return identifier->getLength() == length && std::memcmp(identifier->getName(), name, length) == 0;
+    }
+}
+
+/**
+ * Constructor
+ */
+SymbolTable::SymbolTable() :
+    arena(),
+    identifiers(INITIAL_NB_BUCKETS, nullptr),
+    nbIdentifiers(0),
+    currScope(nullptr),
+    scopeDepth(0),
+    nbSymbols(0),
+    generation(0),
+    freeScopes(nullptr),
+    freeSymbols(nullptr)
+{
+    currScope = arena.create<Scope>(Scope{nullptr, nullptr});
+}
+
+/**
+ * Intern a name, creating its identifier the first time
+ */
+Identifier* SymbolTable::getIdentifier(const char* name, size_t length)
+{
+    uint64_t hash = Hashing::hashBytes(name, length);
+    size_t mask = identifiers.size() - 1;
+
+    size_t bucket = hash & mask;
+    while( identifiers[bucket] != nullptr ) {
+        Identifier* identifier = identifiers[bucket];
+        if( identifier->hash == hash && isSameName(identifier, name, length) ) {
+            return identifier;
+        }
+
+        bucket = (bucket + 1) & mask;
+    }
+
+    const char* nameCopy = arena.copyString(name, length);
+    Identifier* identifier = new (arena.allocate(sizeof(Identifier), alignof(Identifier))) Identifier(nameCopy, length, hash);
+    identifiers[bucket] = identifier;
+
+    // Keep the table at most half full, for short probe sequences
+    //
+    if( ++nbIdentifiers * 2 > identifiers.size() ) {
+        growIdentifiers();
+    }
+
+    return identifier;
+}
+
+/**
+ * Find the identifier of a name, nullptr if it was never interned
+ */
+Identifier* SymbolTable::findIdentifier(const char* name, size_t length) const
+{
+    uint64_t hash = Hashing::hashBytes(name, length);
+    size_t mask = identifiers.size() - 1;
+
+    for( size_t bucket = hash & mask; identifiers[bucket] != nullptr; bucket = (bucket + 1) & mask ) {
+        Identifier* identifier = identifiers[bucket];
+        if( identifier->hash == hash && isSameName(identifier, name, length) ) {
+            return identifier;
+        }
+    }
+
+    return nullptr;
+}
+
+void SymbolTable::getIdentifiers(std::vector<Identifier *>& result) const
+{
+    result.clear();
+    for( Identifier* identifier : identifiers ) {
+        if( identifier != nullptr ) {
+            result.push_back(identifier);
+        }
+    }
+}
+
+/**
+ * Double the size of the identifier hash table
+ */
+void SymbolTable::growIdentifiers()
+{
+    std::vector<Identifier *> newIdentifiers(identifiers.size() * 2, nullptr);
+    size_t mask = newIdentifiers.size() - 1;
+
+    for( Identifier* identifier : identifiers ) {
+        if( identifier != nullptr ) {
+            size_t bucket = identifier->hash & mask;
+            while( newIdentifiers[bucket] != nullptr ) {
+                bucket = (bucket + 1) & mask;
+            }
+
+            newIdentifiers[bucket] = identifier;
+        }
+    }
+
+    identifiers.swap(newIdentifiers);
+}
+
+/**
+ * Enter a new scope
+ */
+void SymbolTable::pushScope()
+{
+    Scope* scope = freeScopes;
+    if( scope != nullptr ) {
+        freeScopes = scope->enclosing;
+    }
+    else {
+        scope = arena.create<Scope>();
+    }
+
+    scope->enclosing = currScope;
+    scope->symbols = nullptr;
+    currScope = scope;
+    ++scopeDepth;
+}
+
+/**
+ * Leave the current scope: its declarations are unlinked from their shadow
+ * chains, making the declarations they hid visible again
+ */
+void SymbolTable::popScope()
+{
+    assert(scopeDepth > 0);
+
+    Symbol* symbol = currScope->symbols;
+    if( symbol != nullptr ) {
+        ++generation;
+    }
+
+    while( symbol != nullptr ) {
+        Symbol* nextSymbol = symbol->nextInScope;
+
+        Identifier* identifier = symbol->identifier;
+        identifier->symbol = symbol->shadowed;
+        identifier->typedefName = symbol->shadowed != nullptr && symbol->shadowed->kind == Symbol::TYPEDEF;
+
+        symbol->nextInScope = freeSymbols;
+        freeSymbols = symbol;
+        --nbSymbols;
+
+        symbol = nextSymbol;
+    }
+
+    Scope* scope = currScope;
+    currScope = scope->enclosing;
+    scope->enclosing = freeScopes;
+    freeScopes = scope;
+    --scopeDepth;
+}
+
+/**
+ * Declare an identifier in the current scope.  Returns nullptr if it is already
+ * declared in this scope.
+ */
+Symbol* SymbolTable::declare(Identifier* identifier, Symbol::Kind kind, IRTypePtr type, int64_t value)
+{
+    if( identifier->symbol != nullptr && identifier->symbol->scopeDepth == scopeDepth ) {
+        return nullptr;
+    }
+
+    Symbol* symbol = freeSymbols;
+    if( symbol != nullptr ) {
+        freeSymbols = symbol->nextInScope;
+    }
+    else {
+        symbol = arena.create<Symbol>();
+    }
+
+    symbol->identifier = identifier;
+    symbol->kind = kind;
+    symbol->type = type;
+    symbol->scopeDepth = scopeDepth;
+    symbol->value = value;
+    symbol->shadowed = identifier->symbol;
+    symbol->nextInScope = currScope->symbols;
+    currScope->symbols = symbol;
+    ++nbSymbols;
+
+    identifier->symbol = symbol;
+    identifier->typedefName = kind == Symbol::TYPEDEF;
+    ++generation;
+    return symbol;
+}
@@ -0,0 +1,187 @@
+// SymbolTable.hpp
+//
+// Author: Marco Jacques
+//
+// Scoped symbol table
+//
+
+#pragma once
+
+#include "Arena.hpp"
+#include "IRType.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Symbol;
+
+/**
+ * Interned identifier: there is a single Identifier per name, so identifiers are
+ * compared by pointer.  The identifier points to its innermost visible
+ * declaration, making a lookup a single load, and knows if that declaration is a
+ * typedef: the parser tests this bit to tell a type-name from an expression.
+ */
+class Identifier {
+public:
+    const char* getName() const { return name; }
+    size_t getLength() const { return length; }
+
+    Symbol* getSymbol() const { return symbol; }
+    bool isTypedefName() const { return typedefName; }
+
+private:
+    friend class SymbolTable;
+
+    Identifier(const char* name_, size_t length_, uint64_t hash_) :
+        name(name_), length(length_), hash(hash_), symbol(nullptr), typedefName(false) { }
+
+    const char* name;
+    size_t length;
+    uint64_t hash;
+    Symbol* symbol;
+    bool typedefName;
+};
+
+/**
+ * Declaration of an identifier in a scope
+ */
+class Symbol {
+public:
+    enum Kind {
+        OBJECT,
+        FUNCTION,
+        TYPEDEF,
+        ENUM_CONSTANT
+    };
+
+    Identifier* getIdentifier() const { return identifier; }
+    Kind getKind() const { return kind; }
+    IRTypePtr getType() const { return type; }
+    unsigned getScopeDepth() const { return scopeDepth; }
+
+    /**
+     * Value of an enumeration constant
+     */
+    int64_t getValue() const { return value; }
+
+    /**
+     * Declaration of the same identifier in an enclosing scope, hidden by this one
+     */
+    Symbol* getShadowed() const { return shadowed; }
+
+private:
+    friend class SymbolTable;
+
+    Identifier* identifier;
+    Kind kind;
+    IRTypePtr type;
+    unsigned scopeDepth;
+    int64_t value;
+    Symbol* shadowed;
+    Symbol* nextInScope;
+};
+
+/**
+ * Symbol table of the ordinary identifiers.  Identifiers, scopes and symbols all
+ * live in an arena owned by the table.
+ *
+ * Each identifier has a shadow chain: its visible declaration, then the ones it
+ * hides.  Each scope links the symbols declared in it.  Pushing a scope is O(1),
+ * popping it unlinks its symbols from their shadow chains, so each declaration
+ * costs O(1) over its lifetime.  Popped scopes and symbols are reused, so parsing
+ * many blocks doesn't grow the arena.
+ */
+class SymbolTable {
+public:
+    /**
+     * Constructor: the table starts at file scope (depth 0)
+     */
+    SymbolTable();
+
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    /**
+     * Intern a name, creating its identifier the first time
+     */
+    Identifier* getIdentifier(const char* name, size_t length);
+    Identifier* getIdentifier(const std::string& name) { return getIdentifier(name.data(), name.size()); }
+
+    /**
+     * Find the identifier of a name, nullptr if it was never interned
+     */
+    Identifier* findIdentifier(const char* name, size_t length) const;
+    Identifier* findIdentifier(const std::string& name) const { return findIdentifier(name.data(), name.size()); }
+
+    /**
+     * All the interned identifiers, in no particular order
+     */
+    void getIdentifiers(std::vector<Identifier *>& result) const;
+
+    /**
+     * Scopes: blocks, function prototypes...  The file scope is never popped.
+     */
+    void pushScope();
+    void popScope();
+    unsigned getScopeDepth() const { return scopeDepth; }
+
+    /**
+     * Changes each time the visible declarations change, for the caches of
+     * results depending on them
+     */
+    uint64_t getGeneration() const { return generation; }
+
+    /**
+     * Declare an identifier in the current scope, hiding its declarations in the
+     * enclosing scopes.  Returns nullptr if it is already declared in this scope:
+     * the caller decides if the redeclaration is valid.
+     */
+    Symbol* declare(Identifier* identifier, Symbol::Kind kind, IRTypePtr type, int64_t value = 0);
+
+    /**
+     * Visible declaration of an identifier, nullptr if there is none
+     */
+    Symbol* lookup(const Identifier* identifier) const { return identifier->symbol; }
+
+    /**
+     * Check if a name is currently a typedef name
+     */
+    bool isTypedefName(const std::string& name) const
+    {
+        Identifier* identifier = findIdentifier(name);
+        return identifier != nullptr && identifier->typedefName;
+    }
+
+    /**
+     * Statistics
+     */
+    size_t getNbIdentifiers() const { return nbIdentifiers; }
+    size_t getNbSymbols() const { return nbSymbols; }
+    size_t getBytesAllocated() const { return arena.getBytesAllocated(); }
+
+private:
+    struct Scope {
+        Scope* enclosing;
+        Symbol* symbols;
+    };
+
+    void growIdentifiers();
+
+    Arena arena;
+
+    // Open addressing hash table of the identifiers, the size is a power of 2
+    //
+    std::vector<Identifier *> identifiers;
+    size_t nbIdentifiers;
+
+    Scope* currScope;
+    unsigned scopeDepth;
+    size_t nbSymbols;
+    uint64_t generation;
+
+    // Popped scopes and symbols, to reuse
+    //
+    Scope* freeScopes;
+    Symbol* freeSymbols;
+};
@@ -6,6 +6,7 @@
 //
 
 #include "TypeParser.hpp"
+#include "C90Expression.hpp"
 #include <cassert>
 
 /**
@@ -13,82 +14,508 @@
  */
 TypeParser::~TypeParser() = default;
 
+namespace {
+
+    const char* const nameFlags[TypeNameResolver::NB_FLAGS] = {
+        "void",
+        "char", "short", "int", "long",
+        "float", "double",
+        "signed", "unsigned",
+        "const", "volatile",
+        "typedef", "extern", "static", "auto", "register"
+    };
+
+    constexpr uint32_t bit(TypeNameResolver::Flag flag)
+    {
+        return 1u << flag;
+    }
+
+    /**
+     * Type of a set of type specifiers (C90 6.5.2), NB_KINDS if they can't be
+     * combined.  No type specifier is an implicit int.
+     */
+    constexpr IRType::Kind resolveTypeSpecifiers(uint32_t specifiers)
+    {
+        using T = TypeNameResolver;
+        return
+            specifiers == bit(T::VOID) ? IRType::VOID :
+            specifiers == bit(T::CHAR) ? IRType::CHAR :
+            specifiers == (bit(T::SIGNED) | bit(T::CHAR)) ? IRType::SIGNED_CHAR :
+            specifiers == (bit(T::UNSIGNED) | bit(T::CHAR)) ? IRType::UNSIGNED_CHAR :
+            (specifiers & ~(bit(T::SIGNED) | bit(T::INT))) == bit(T::SHORT) ? IRType::SHORT :
+            (specifiers & ~bit(T::INT)) == (bit(T::UNSIGNED) | bit(T::SHORT)) ? IRType::UNSIGNED_SHORT :
+            (specifiers & ~(bit(T::SIGNED) | bit(T::INT))) == 0 ? IRType::INT :
+            (specifiers & ~bit(T::INT)) == bit(T::UNSIGNED) ? IRType::UNSIGNED :
+            (specifiers & ~(bit(T::SIGNED) | bit(T::INT))) == bit(T::LONG) ? IRType::LONG :
+            (specifiers & ~bit(T::INT)) == (bit(T::UNSIGNED) | bit(T::LONG)) ? IRType::UNSIGNED_LONG :
+            specifiers == bit(T::FLOAT) ? IRType::FLOAT :
+            specifiers == bit(T::DOUBLE) ? IRType::DOUBLE :
+            specifiers == (bit(T::LONG) | bit(T::DOUBLE)) ? IRType::LONG_DOUBLE :
+            IRType::NB_KINDS;
+    }
+
+    /**
+     * Table of the types of all the type specifier sets, built at compile time
+     */
+    const size_t NB_TYPE_SPECIFIER_SETS = TypeNameResolver::TYPE_SPECIFIER_MASK + 1;
+
+    struct TypeSpecifierTable {
+        uint8_t kinds[NB_TYPE_SPECIFIER_SETS];
+    };
+
+    template<size_t... Indexes>
+    struct IndexList { };
+
+    template<size_t N, size_t... Indexes>
+    struct MakeIndexList : MakeIndexList<N - 1, N - 1, Indexes...> { };
+
+    template<size_t... Indexes>
+    struct MakeIndexList<0, Indexes...> {
+        using Type = IndexList<Indexes...>;
+    };
+
+    template<size_t... Specifiers>
+    constexpr TypeSpecifierTable makeTypeSpecifierTable(IndexList<Specifiers...>)
+    {
+        return TypeSpecifierTable{{ static_cast<uint8_t>(resolveTypeSpecifiers(Specifiers))... }};
+    }
+
+    constexpr TypeSpecifierTable typeSpecifierTable = makeTypeSpecifierTable(MakeIndexList<NB_TYPE_SPECIFIER_SETS>::Type());
+
+    static_assert(IRType::NB_KINDS <= UINT8_MAX, "The type kinds must fit in the type table");
+    static_assert(typeSpecifierTable.kinds[bit(TypeNameResolver::UNSIGNED) | bit(TypeNameResolver::LONG) | bit(TypeNameResolver::INT)] == IRType::UNSIGNED_LONG,
+        "The type table must be computed at compile time");
+}
+
+const uint32_t TypeNameResolver::TYPE_SPECIFIER_MASK;
+const uint32_t TypeNameResolver::STORAGE_CLASS_MASK;
+
 /**
  * Constructor
  */
 TypeNameResolver::TypeNameResolver(const std::shared_ptr<Message>& message_) :
         message(message_),
-        typeFlags()
+        flags(0)
         {
             // Nothing else to do
         }
 
 /**
- * This sets the corresponding flag.  If the flag was set already, we issue
- * en error. 
- * 
- * Returns true if no error was issued.
+ * Flag of a token, NB_FLAGS if the token is not a declaration specifier
  */
-bool TypeNameResolver::checkAndSetFlag(Flag flag)
+TypeNameResolver::Flag TypeNameResolver::getFlag(LexerToken::Kind kind)
 {
-    if( typeFlags[flag] ) {
-        message->error(Message::ERROR_DUPLICATE_TYPE, {nameFlags[flag]});
-        return false;
+    switch( kind ) {
+        case LexerToken::VOID:      return VOID;
+        case LexerToken::CHAR:      return CHAR;
+        case LexerToken::SHORT:     return SHORT;
+        case LexerToken::INT:       return INT;
+        case LexerToken::LONG:      return LONG;
+        case LexerToken::FLOAT:     return FLOAT;
+        case LexerToken::DOUBLE:    return DOUBLE;
+        case LexerToken::SIGNED:    return SIGNED;
+        case LexerToken::UNSIGNED:  return UNSIGNED;
+        case LexerToken::CONST:     return CONST;
+        case LexerToken::VOLATILE:  return VOLATILE;
+        case LexerToken::TYPEDEF:   return TYPEDEF;
+        case LexerToken::EXTERN:    return EXTERN;
+        case LexerToken::STATIC:    return STATIC;
+        case LexerToken::AUTO:      return AUTO;
+        case LexerToken::REGISTER:  return REGISTER;
+        default:                    return NB_FLAGS;
+    }
+}
+
+/**
+ * Error of a flag that can't be set: set already, or a second storage class
+ *
+ * Returns false
+ */
+bool TypeNameResolver::issueFlagError(Flag flag)
+{
+    // TODO: need to handle source position somehow...
+    //
+    SourcePosition dummyPosition(std::make_shared<std::string>("dummy"), 1, 1);
+    if( isSet(flag) ) {
+        message->issueMessage(dummyPosition, Message::ERROR_DUPLICATE_TYPE, {nameFlags[flag]});
+    }
+    else {
+        message->issueMessage(dummyPosition, Message::ERROR_INVALID_TYPE_COMBO, {nameFlags[getStorageClass()], nameFlags[flag]});
     }
 
-    typeFlags[flag] = true;
-    return true;
+    return false;
 }
 
 /**
- * Check if the flags is compatible with other set already.  If not, issue an
- * error (ex: void is not compatible with int)
- * 
- * Returns true if no error was issued
- */ 
-bool TypeNameResolver::checkInvalidCombinations(Flag flag, std::initializer_list<Flag> flagsToCheck)
+ * Type of the type specifiers set, nullptr after issuing an error if they are
+ * not a valid combination
+ */
+IRTypePtr TypeNameResolver::resolve()
 {
-    assert(typeFlags[flag] == true);
-    bool err = false;
+    uint32_t specifiers = flags & TYPE_SPECIFIER_MASK;
+    IRType::Kind kind = static_cast<IRType::Kind>(typeSpecifierTable.kinds[specifiers]);
+    if( kind != IRType::NB_KINDS ) {
+        return IRTypeTable::getBuiltinType(kind);
+    }
 
-    using Iter = std::initializer_list<Flag>::iterator;
-    for( Iter currFlagToCheck = flagsToCheck.begin();
-            currFlagToCheck != flagsToCheck.end();
-            ++currFlagToCheck )
-    {
-        Flag flagToCheck = *currFlagToCheck;
-        if( typeFlags[flagToCheck] == true ) {
-            message->error(Message::ERROR_INVALID_TYPE_COMBO, {nameFlags[flag], nameFlags[flagToCheck]});
-            err = true;
+    // Report the first two specifiers that can't be combined: every invalid set
+    // has such a pair
+    //
+    for( unsigned flag1 = 0; flag1 < NB_TYPE_SPECIFIERS; ++flag1 ) {
+        for( unsigned flag2 = flag1 + 1; flag2 < NB_TYPE_SPECIFIERS; ++flag2 ) {
+            uint32_t pair = (1u << flag1) | (1u << flag2);
+            if( (specifiers & pair) == pair && typeSpecifierTable.kinds[pair] == IRType::NB_KINDS ) {
+                SourcePosition dummyPosition(std::make_shared<std::string>("dummy"), 1, 1);
+                message->issueMessage(dummyPosition, Message::ERROR_INVALID_TYPE_COMBO, {nameFlags[flag1], nameFlags[flag2]});
+                return nullptr;
+            }
         }
     }
 
-    return !err;
+    assert(0);
+    return nullptr;
 }
 
 /**
- * Set a flag and check for errors
- * 
- * Return true if no erros were issued
+ * Storage class specified, NB_FLAGS if none
  */
-bool TypeNameResolver::setFlag(Flag flag) 
+TypeNameResolver::Flag TypeNameResolver::getStorageClass() const
 {
-    switch(flag) {
-        case VOID:
-            return checkAndSetFlag(VOID) && 
-                checkInvalidCombinations(VOID, {CHAR, SHORT, INT, LONG, FLOAT, DOUBLE});
-
-        default:
-            assert(0);
+    uint32_t storageClass = flags & STORAGE_CLASS_MASK;
+    for( unsigned flag = TYPEDEF; flag < NB_FLAGS; ++flag ) {
+        if( storageClass == (1u << flag) ) {
+            return static_cast<Flag>(flag);
+        }
     }
 
-    return false;
+    return NB_FLAGS;
 }
 
 
+/**
+ * Constructor
+ */
+C90TypeParser::C90TypeParser(
+    const std::shared_ptr<Lexer>& lexer_,
+    const std::shared_ptr<Message>& message_,
+    const std::shared_ptr<SymbolTable>& symbolTable_,
+    const std::shared_ptr<IRTypeTable>& typeTable_,
+    const std::shared_ptr<IRLayoutEngine>& layoutEngine_
+    ) :
+    lexer(lexer_),
+    message(message_),
+    symbolTable(symbolTable_),
+    typeTable(typeTable_),
+    layoutEngine(layoutEngine_),
+    boundFactory(),
+    evaluator()
+{
+    // Nothing else to do
+}
+
+/*
+
+          type-name:
+                  specifier-qualifier-list  abstract-declarator(opt)
+
+          specifier-qualifier-list:
+                  type-specifier  specifier-qualifier-list(opt)
+                  type-qualifier  specifier-qualifier-list(opt)
+
+*/
+
+/**
+ * Parse a type-name, or return nullptr without consuming anything if the next
+ * token doesn't start one.  An identifier starts a type-name only if it is
+ * currently a typedef name: the parser knows which one it is with a single
+ * token of lookahead.  The qualifiers are checked, but not part of the types.
+ * The struct, union and enum specifiers are not supported: they are reported,
+ * skipped with their tag, and the type name goes on with int.
+ */
 IRTypePtr C90TypeParser::typeName()
 {
-    return nullptr;
+    TypeNameResolver resolver(message);
+    IRTypePtr typedefType = nullptr;
+    std::string typedefName;
+    bool anySpecifier = false;
+
+    for(;;) {
+        LexerTokenPtr nextToken = lexer->peekToken();
+        TypeNameResolver::Flag flag = TypeNameResolver::getFlag(nextToken->getKind());
+
+        // Type specifiers and qualifiers only: no storage class in a type-name
+        //
+        if( flag < TypeNameResolver::TYPEDEF ) {
+            lexer->acceptToken(nextToken->getKind());
+            anySpecifier = true;
+            if( typedefType != nullptr && flag < TypeNameResolver::NB_TYPE_SPECIFIERS ) {
+                // TODO: need to handle source position somehow...
+                //
+                SourcePosition dummyPosition(std::make_shared<std::string>("dummy"), 1, 1);
+                message->issueMessage(dummyPosition, Message::ERROR_INVALID_TYPE_COMBO, {typedefName, nameFlags[flag]});
+                continue;
+            }
+
+            resolver.setFlag(flag);
+            continue;
+        }
+
+        LexerToken::Kind kind = nextToken->getKind();
+        if( kind == LexerToken::STRUCT || kind == LexerToken::UNION || kind == LexerToken::ENUM ) {
+            SourcePosition dummyPosition(std::make_shared<std::string>("dummy"), 1, 1);
+            message->issueMessage(dummyPosition, Message::ERROR_UNSUPPORTED_TYPE_SPECIFIER,
+                {kind == LexerToken::STRUCT ? "struct" : kind == LexerToken::UNION ? "union" : "enum"});
+            lexer->acceptToken(kind);
+            if( lexer->peekToken()->getKind() == LexerToken::IDENTIFIER ) {
+                lexer->acceptToken(LexerToken::IDENTIFIER);
+            }
+            anySpecifier = true;
+            continue;
+        }
+
+        // A typedef name is the only type specifier
+        //
+        if( nextToken->getKind() == LexerToken::IDENTIFIER && typedefType == nullptr && !resolver.hasTypeSpecifier() ) {
+            const std::string& name = static_cast<const IdToken *>(nextToken.get())->getName();
+            Identifier* identifier = symbolTable->findIdentifier(name);
+            if( identifier != nullptr && identifier->isTypedefName() ) {
+                lexer->acceptToken(LexerToken::IDENTIFIER);
+                typedefType = identifier->getSymbol()->getType();
+                typedefName = name;
+                anySpecifier = true;
+                continue;
+            }
+        }
+
+        break;
+    }
+
+    if( !anySpecifier ) {
+        return nullptr;
+    }
+
+    // After an invalid combination of specifiers, go on with int
+    //
+    IRTypePtr type = typedefType;
+    if( type == nullptr ) {
+        type = resolver.resolve();
+        if( type == nullptr ) {
+            type = IRTypeTable::getIntType();
+        }
+    }
+
+    std::vector<Derivation> derivations;
+    abstractDeclarator(derivations);
+
+    return derive(type, derivations);
+}
+
+/*
+
+          abstract-declarator:
+                  pointer
+                  pointer(opt)  direct-abstract-declarator
+
+          pointer:
+                  *  type-qualifier-list(opt)
+                  *  type-qualifier-list(opt)  pointer
+
+          direct-abstract-declarator:
+                  (  abstract-declarator  )
+                  direct-abstract-declarator(opt)  [  constant-expression(opt)  ]
+                  direct-abstract-declarator(opt)  (  parameter-type-list(opt)  )
+
+*/
+
+/**
+ * Parse an abstract declarator, possibly empty, and add its derivations in the
+ * order they apply to the type of the specifiers: the pointers, then the array
+ * and function suffixes from right to left, then the parenthesized declarator.
+ * For example, in int (*)[3], the [3] applies before the *.
+ */
+void C90TypeParser::abstractDeclarator(std::vector<Derivation>& derivations)
+{
+    while( lexer->peekToken()->getKind() == LexerToken::MUL ) {
+        lexer->acceptToken(LexerToken::MUL);
+
+        TypeNameResolver qualifiers(message);
+        for(;;) {
+            TypeNameResolver::Flag flag = TypeNameResolver::getFlag(lexer->peekToken()->getKind());
+            if( flag != TypeNameResolver::CONST && flag != TypeNameResolver::VOLATILE ) {
+                break;
+            }
+
+            lexer->acceptToken(lexer->peekToken()->getKind());
+            qualifiers.setFlag(flag);
+        }
+
+        derivations.push_back(Derivation{IRType::POINTER, 0, {}, false, false});
+    }
+
+    std::vector<Derivation> nested;
+    std::vector<Derivation> suffixes;
+
+    // A ( is a parenthesized declarator if an abstract declarator starts after it,
+    // otherwise a function suffix
+    //
+    if( lexer->peekToken()->getKind() == LexerToken::LEFT_PARAR ) {
+        lexer->acceptToken(LexerToken::LEFT_PARAR);
+
+        LexerToken::Kind kind = lexer->peekToken()->getKind();
+        if( kind == LexerToken::MUL || kind == LexerToken::LEFT_PARAR || kind == LexerToken::LEFT_BRACKET ) {
+            abstractDeclarator(nested);
+            lexer->acceptToken(LexerToken::RIGHT_PARAR);
+        }
+        else {
+            suffixes.push_back(Derivation{IRType::FUNCTION, 0, {}, false, false});
+            parameterTypeList(suffixes.back());
+        }
+    }
+
+    for(;;) {
+        LexerToken::Kind kind = lexer->peekToken()->getKind();
+        if( kind == LexerToken::LEFT_BRACKET ) {
+            lexer->acceptToken(LexerToken::LEFT_BRACKET);
+
+            uint64_t nbElements = 0;
+            if( lexer->peekToken()->getKind() != LexerToken::RIGHT_BRACKET ) {
+                nbElements = arrayBound();
+            }
+
+            lexer->acceptToken(LexerToken::RIGHT_BRACKET);
+            suffixes.push_back(Derivation{IRType::ARRAY, nbElements, {}, false, false});
+        }
+        else if( kind == LexerToken::LEFT_PARAR ) {
+            lexer->acceptToken(LexerToken::LEFT_PARAR);
+            suffixes.push_back(Derivation{IRType::FUNCTION, 0, {}, false, false});
+            parameterTypeList(suffixes.back());
+        }
+        else {
+            break;
+        }
+    }
+
+    derivations.insert(derivations.end(), suffixes.rbegin(), suffixes.rend());
+    derivations.insert(derivations.end(), nested.begin(), nested.end());
+}
+
+/**
+ * Parse and evaluate the constant expression of an array bound, after its [.  A
+ * bound that is not an integer constant greater than 0 (C90 6.5.4.2) is
+ * reported, and the array is left without a size.
+ */
+uint64_t C90TypeParser::arrayBound()
+{
+    if( boundFactory == nullptr ) {
+        boundFactory = std::make_shared<IRFactory>(std::make_shared<IRContext>(typeTable));
+        evaluator = std::make_shared<IRConstantEvaluator>(symbolTable, layoutEngine);
+    }
+
+    C90Expression parser(lexer, std::make_shared<C90TypeParser>(lexer, message, symbolTable, typeTable, layoutEngine), boundFactory);
+    IRExprPtr bound = parser.constantExpression();
+    if( bound == nullptr ) {
+        return 0;
+    }
+
+    SourcePosition dummyPosition(std::make_shared<std::string>("dummy"), 1, 1);
+    IRConstantEvaluator::Result result = evaluator->evaluate(bound);
+    if( result.status != IRConstantEvaluator::CONSTANT ) {
+        message->issueMessage(dummyPosition, Message::ERROR_ARRAY_BOUND_NOT_CONSTANT, {});
+        return 0;
+    }
+
+    IRType::Kind kind = result.value.type->getKind();
+    bool isUnsigned = kind == IRType::UNSIGNED_CHAR || kind == IRType::UNSIGNED_SHORT || kind == IRType::UNSIGNED || kind == IRType::UNSIGNED_LONG;
+    if( isUnsigned ? result.value.intValue == 0 : result.value.getSignedValue() <= 0 ) {
+        message->issueMessage(dummyPosition, Message::ERROR_INVALID_ARRAY_BOUND, {std::to_string(result.value.getSignedValue())});
+        return 0;
+    }
+
+    return result.value.intValue;
+}
+
+/*
+
+          parameter-type-list:
+                  parameter-list
+                  parameter-list  ,  ...
+
+*/
+
+/**
+ * Parse the parameters of a function suffix, after its (.  An empty list is a
+ * K&R function, (void) a function without parameters.  The parameters are type
+ * names: arrays and functions are adjusted to pointers (C90 6.7.1).
+ */
+void C90TypeParser::parameterTypeList(Derivation& function)
+{
+    if( lexer->peekToken()->getKind() == LexerToken::RIGHT_PARAR ) {
+        lexer->acceptToken(LexerToken::RIGHT_PARAR);
+        function.isKandR = true;
+        return;
+    }
+
+    for(;;) {
+        if( lexer->peekToken()->getKind() == LexerToken::DOT_DOT_DOT && !function.argsType.empty() ) {
+            lexer->acceptToken(LexerToken::DOT_DOT_DOT);
+            function.hasVarArgs = true;
+            break;
+        }
+
+        IRTypePtr argType = typeName();
+        if( argType == nullptr ) {
+            // TODO: need to handle source position somehow...
+            //
+            SourcePosition dummyPosition(std::make_shared<std::string>("dummy"), 1, 1);
+            message->issueMessage(dummyPosition, Message::ERROR_EXPECTED_TOKEN, {"type-name"});
+            break;
+        }
+
+        if( argType->getKind() == IRType::ARRAY ) {
+            argType = typeTable->getPointerType(static_cast<const IRArrayType *>(argType)->getElementType());
+        }
+        else if( argType->getKind() == IRType::FUNCTION ) {
+            argType = typeTable->getPointerType(argType);
+        }
+        function.argsType.push_back(argType);
+
+        if( lexer->peekToken()->getKind() != LexerToken::COMMA ) {
+            break;
+        }
+        lexer->acceptToken(LexerToken::COMMA);
+    }
+
+    // (void): no parameters
+    //
+    if( function.argsType.size() == 1 && function.argsType[0] == IRTypeTable::getVoidType() && !function.hasVarArgs ) {
+        function.argsType.clear();
+    }
+
+    lexer->acceptToken(LexerToken::RIGHT_PARAR);
+}
+
+/**
+ * Apply the derivations of a declarator to a type
+ */
+IRTypePtr C90TypeParser::derive(IRTypePtr type, const std::vector<Derivation>& derivations)
+{
+    for( const Derivation& derivation : derivations ) {
+        switch( derivation.kind ) {
+            case IRType::POINTER:
+                type = typeTable->getPointerType(type);
+                break;
+
+            case IRType::ARRAY:
+                type = typeTable->getArrayType(type, derivation.nbElements);
+                break;
+
+            default:
+                type = typeTable->getFunctionType(type, derivation.argsType, derivation.isKandR, derivation.hasVarArgs);
+                break;
+        }
+    }
+
+    return type;
 }
 
 IRTypePtr C90TypeParser::typeSpecifier()
@@ -7,8 +7,11 @@
 #pragma once
 
 #include "IR.hpp"
+#include "IRConstantEvaluator.hpp"
+#include "IRLayout.hpp"
 #include "Message.hpp"
 #include "Lexer.hpp"
+#include "SymbolTable.hpp"
 
 class TypeParser {
 public:
@@ -18,54 +21,89 @@ public:
 };
 
 
+/**
+ * Resolution of the declaration specifiers.  The specifiers seen are bits of a
+ * mask: setting one is a test and an or.  The type is then found by indexing a
+ * table, computed at compile time, with the type specifier bits.
+ */
 class TypeNameResolver {
 public:
     enum Flag {
-        CHAR, SHORT, INT, LONG,
+        // Type specifiers, indexing the type table
+        //
         VOID,
+        CHAR, SHORT, INT, LONG,
         FLOAT, DOUBLE,
+        SIGNED, UNSIGNED,
+
+        // Type qualifiers
+        //
         CONST, VOLATILE,
-        NB_FLAGS
+
+        // Storage class specifiers, at most one
+        //
+        TYPEDEF, EXTERN, STATIC, AUTO, REGISTER,
+
+        NB_FLAGS,
+
+        NB_TYPE_SPECIFIERS = CONST
     };
 
+    static const uint32_t TYPE_SPECIFIER_MASK = (1u << NB_TYPE_SPECIFIERS) - 1;
+    static const uint32_t STORAGE_CLASS_MASK = (1u << NB_FLAGS) - (1u << TYPEDEF);
+
     /**
      * Constructor
      */
     TypeNameResolver(const std::shared_ptr<Message>& message_);
 
     /**
-     * This sets the corresponding flag.  If the flag was set already, we issue
-     * en error. 
-     * 
-     * Returns true if no error was issued.
+     * Flag of a token, NB_FLAGS if the token is not a declaration specifier
      */
-    bool checkAndSetFlag(Flag flag);
+    static Flag getFlag(LexerToken::Kind kind);
 
     /**
-     * Check if the flags is compatible with other set already.  If not, issue an
-     * error (ex: void is not compatible with int)
+     * Set a flag.  A flag set twice, or a second storage class, is an error.
      * 
      * Returns true if no error was issued
-     */ 
-    bool checkInvalidCombinations(Flag flag, std::initializer_list<Flag> flagsToCheck);
+     */
+    bool setFlag(Flag flag)
+    {
+        uint32_t bit = 1u << flag;
+        if( (flags & bit) != 0 || ((flags & STORAGE_CLASS_MASK) != 0 && (bit & STORAGE_CLASS_MASK) != 0) ) {
+            return issueFlagError(flag);
+        }
+
+        flags |= bit;
+        return true;
+    }
 
     /**
-     * Set a flag.  
-     * 
-     * Returns true if no error was issued
+     * Type of the type specifiers set (int if there is none), nullptr after
+     * issuing an error if they are not a valid combination (ex: void int)
+     */
+    IRTypePtr resolve();
+
+    bool isSet(Flag flag) const { return (flags & (1u << flag)) != 0; }
+    bool hasTypeSpecifier() const { return (flags & TYPE_SPECIFIER_MASK) != 0; }
+    bool isConst() const { return isSet(CONST); }
+    bool isVolatile() const { return isSet(VOLATILE); }
+
+    /**
+     * Storage class specified, NB_FLAGS if none
      */
-    bool setFlag(Flag flag);
+    Flag getStorageClass() const;
+
+    /**
+     * Start the specifiers of another declaration
+     */
+    void reset() { flags = 0; }
 
 private:
-    std::shared_ptr<Message> message;
-    bool typeFlags[NB_FLAGS];
-    const char *const nameFlags[NB_FLAGS] = {
-        "char", "short", "int", "long", 
-        "void", 
-        "float", "double", 
-        "const", "volatile"
-        };
+    bool issueFlagError(Flag flag);
 
+    std::shared_ptr<Message> message;
+    uint32_t flags;
 };
 
 
@@ -73,8 +111,44 @@ class C90TypeParser : public TypeParser {
 protected:
     std::shared_ptr<Lexer> lexer;
     std::shared_ptr<Message> message;
+    std::shared_ptr<SymbolTable> symbolTable;
+    std::shared_ptr<IRTypeTable> typeTable;
+    std::shared_ptr<IRLayoutEngine> layoutEngine;
+
+    // The array bounds are parsed in their own context, and evaluated with the
+    // symbol table and the layout engine.  Created at the first bound.
+    //
+    std::shared_ptr<IRFactory> boundFactory;
+    std::shared_ptr<IRConstantEvaluator> evaluator;
+
+    /**
+     * Pointer, array or function derivation of an abstract declarator
+     */
+    struct Derivation {
+        IRType::Kind kind;
+        uint64_t nbElements;
+        std::vector<IRTypePtr> argsType;
+        bool isKandR;
+        bool hasVarArgs;
+    };
+
+    void abstractDeclarator(std::vector<Derivation>& derivations);
+    uint64_t arrayBound();
+    void parameterTypeList(Derivation& function);
+    IRTypePtr derive(IRTypePtr type, const std::vector<Derivation>& derivations);
 
 public:
+    /**
+     * Constructor
+     */
+    C90TypeParser(
+        const std::shared_ptr<Lexer>& lexer_,
+        const std::shared_ptr<Message>& message_,
+        const std::shared_ptr<SymbolTable>& symbolTable_,
+        const std::shared_ptr<IRTypeTable>& typeTable_,
+        const std::shared_ptr<IRLayoutEngine>& layoutEngine_
+        );
+
     IRTypePtr typeName();
     
     IRTypePtr typeSpecifier();
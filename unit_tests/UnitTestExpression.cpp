@@ -0,0 +1,1815 @@
+// UnitTestExpression.cpp
+//
+// Author: Marco Jacques
+//
+// Unit tests for expression parsing and IR construction
+//
+
+#include "C90Expression.hpp"
+#include "FlatIR.hpp"
+#include "IRConstantEvaluator.hpp"
+#include "IRConstantFolder.hpp"
+#include "IRImage.hpp"
+#include "IRLayout.hpp"
+#include "IRVisitor.hpp"
+#include "PCHImage.hpp"
+#include "SymbolTable.hpp"
+#include "TypeParser.hpp"
+#include "UnitTest.hpp"
+#include "UnitTestMessage.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <fstream>
+#include <initializer_list>
+#include <pthread.h>
+#include <sstream>
+
+/**
+ * My own char reader with a string
+ */
+class MyCharReader : public CharReader {
+    std::string theString;
+    std::string::iterator currChar;
+
+public:
+    MyCharReader(const std::string& theString_) : theString(theString_)
+    {
+        currChar = theString.begin();
+    }
+
+    virtual int getNextChar()
+    {
+        int result = peekNextChar();
+        ++currChar;
+
+        return result;
+    }
+
+    virtual int peekNextChar()
+    {
+        if( currChar != theString.end() )
+        {
+            return *currChar;
+        }
+        else
+        {
+            return EOF;
+        }
+    }
+};
+
+/**
+ * Type parser recognizing only 'int', enough for testing casts
+ */
+class IntTypeParser : public TypeParser {
+    std::shared_ptr<Lexer> lexer;
+    std::shared_ptr<IRFactory> irFactory;
+
+public:
+    IntTypeParser(const std::shared_ptr<Lexer>& lexer_, const std::shared_ptr<IRFactory>& irFactory_) :
+        lexer(lexer_), irFactory(irFactory_)
+    {
+    }
+
+    virtual IRTypePtr typeName()
+    {
+        if( lexer->peekToken()->getKind() == LexerToken::INT ) {
+            lexer->acceptToken(LexerToken::INT);
+            return irFactory->getIntType();
+        }
+
+        return nullptr;
+    }
+};
+
+/**
+ * Everything needed to parse one expression
+ */
+struct ExpressionParser {
+    std::shared_ptr<UnitTestMessage> message;
+    std::shared_ptr<Lexer> lexer;
+    std::shared_ptr<IRContext> context;
+    std::shared_ptr<IRFactory> irFactory;
+    C90Expression parser;
+
+    ExpressionParser(const std::string& source, C90Expression::ParseMode parseMode) :
+        message(std::make_shared<UnitTestMessage>()),
+        lexer(std::make_shared<C90Lexer>(std::make_shared<MyCharReader>(source), message)),
+        context(std::make_shared<IRContext>()),
+        irFactory(std::make_shared<IRFactory>(context)),
+        parser(lexer, std::make_shared<IntTypeParser>(lexer, irFactory), irFactory)
+    {
+        message->resetError();
+        parser.setParseMode(parseMode);
+    }
+};
+
+/**
+ * Names of the kinds, for printing
+ */
+static const char* const kindNames[IRExpr::NB_KINDS] = {
+    "id", "int", "float", "string",
+    "call", ".", "->",
+    "post++", "post--", "++", "--", "&", "*", "+", "-", "~", "!", "sizeof",
+    "sizeof-type", "cast",
+    "[]", "*", "/", "%", "+", "-", "<<", ">>", "<", ">", "<=", ">=", "==", "!=",
+    "&", "^", "|", "&&", "||",
+    "=", "*=", "/=", "%=", "+=", "-=", "<<=", ">>=", "&=", "^=", "|=",
+    ",",
+    "?:",
+    "chain"
+};
+
+/**
+ * Print a literal value, with a suffix giving its type
+ */
+std::string literalToString(uint64_t value, IRTypePtr type)
+{
+    std::ostringstream result;
+    switch( type->getKind() ) {
+        case IRType::INT:           result << static_cast<int64_t>(value); break;
+        case IRType::UNSIGNED:      result << value << "u"; break;
+        case IRType::LONG:          result << static_cast<int64_t>(value) << "l"; break;
+        case IRType::UNSIGNED_LONG: result << value << "ul"; break;
+        default:                    result << value << "?"; break;
+    }
+
+    return result.str();
+}
+
+std::string literalToString(double value, IRTypePtr type)
+{
+    std::ostringstream result;
+    result << value << (type->getKind() == IRType::FLOAT ? "f" : (type->getKind() == IRType::LONG_DOUBLE ? "l" : ""));
+
+    return result.str();
+}
+
+/**
+ * Print an expression as a s-expression, for comparing trees
+ */
+std::string toString(IRExprPtr expr)
+{
+    if( expr == nullptr ) {
+        return "null";
+    }
+
+    std::string result = std::string("(") + kindNames[expr->getKind()];
+    switch( expr->getKind() ) {
+        case IRExpr::ID:
+            result += std::string(" ") + static_cast<const IRIdExpr *>(expr)->getName();
+            break;
+
+        case IRExpr::INT_LITERAL: {
+            const IRIntLitExpr* intLit = static_cast<const IRIntLitExpr *>(expr);
+            result += " " + literalToString(intLit->getValue(), intLit->getType());
+            break;
+        }
+
+        case IRExpr::FLOAT_LITERAL: {
+            const IRFloatLitExpr* floatLit = static_cast<const IRFloatLitExpr *>(expr);
+            result += " " + literalToString(floatLit->getValue(), floatLit->getType());
+            break;
+        }
+
+        case IRExpr::CALL: {
+            const IRCallExpr* call = static_cast<const IRCallExpr *>(expr);
+            result += " " + toString(call->getFunctor());
+            for( unsigned i = 0; i < call->getNbArgs(); ++i ) {
+                result += " " + toString(call->getArg(i));
+            }
+            break;
+        }
+
+        case IRExpr::FIELD_DIRECT_ACCESS:
+        case IRExpr::FIELD_INDIRECT_ACCESS: {
+            const IRFieldAccessExpr* access = static_cast<const IRFieldAccessExpr *>(expr);
+            result += " " + toString(access->getStructExpr()) + " " + access->getFieldName();
+            break;
+        }
+
+        case IRExpr::CAST:
+            result += " " + toString(static_cast<const IRCastExpr *>(expr)->getOperand());
+            break;
+
+        case IRExpr::COND: {
+            const IRCondExpr* cond = static_cast<const IRCondExpr *>(expr);
+            result += " " + toString(cond->getCond()) + " " + toString(cond->getThenExpr()) + " " + toString(cond->getElseExpr());
+            break;
+        }
+
+        case IRExpr::CHAIN: {
+            const IRChainExpr* chain = static_cast<const IRChainExpr *>(expr);
+            result += std::string(" ") + kindNames[chain->getOperatorKind()];
+            for( unsigned i = 0; i < chain->getNbOperands(); ++i ) {
+                result += " " + toString(chain->getOperand(i));
+            }
+            break;
+        }
+
+        default:
+            if( IRUnaryExpr::classof(expr) ) {
+                result += " " + toString(static_cast<const IRUnaryExpr *>(expr)->getOperand());
+            }
+            else if( IRBinaryExpr::classof(expr) ) {
+                const IRBinaryExpr* binary = static_cast<const IRBinaryExpr *>(expr);
+                result += " " + toString(binary->getLeftExpr()) + " " + toString(binary->getRightExpr());
+            }
+            break;
+    }
+
+    return result + ")";
+}
+
+/**
+ * Print a flat expression the same way
+ */
+std::string toString(const FlatIR& ir, IRTypeTable& typeTable, FlatIR::NodeIndex index)
+{
+    if( index == FlatIR::INVALID_INDEX ) {
+        return "null";
+    }
+
+    FlatIR::Node node = ir.getNode(index);
+    std::string result = std::string("(") + kindNames[node.getKind()];
+    switch( node.getKind() ) {
+        case IRExpr::ID:
+            result += " " + node.getString();
+            break;
+
+        case IRExpr::INT_LITERAL:
+            result += " " + literalToString(node.getIntValue(), typeTable.getType(node.getTypeId()));
+            break;
+
+        case IRExpr::FLOAT_LITERAL:
+            result += " " + literalToString(node.getFloatValue(), typeTable.getType(node.getTypeId()));
+            break;
+
+        case IRExpr::STRING_LITERAL:
+        case IRExpr::SIZEOF_TYPE:
+            break;
+
+        case IRExpr::CALL:
+            result += " " + toString(ir, typeTable, node.getOperand());
+            for( unsigned i = 0; i < node.getNbArgs(); ++i ) {
+                result += " " + toString(ir, typeTable, node.getArg(i));
+            }
+            break;
+
+        case IRExpr::FIELD_DIRECT_ACCESS:
+        case IRExpr::FIELD_INDIRECT_ACCESS:
+            result += " " + toString(ir, typeTable, node.getOperand()) + " " + node.getString();
+            break;
+
+        case IRExpr::COND:
+            result += " " + toString(ir, typeTable, node.getOperand()) + " " + toString(ir, typeTable, node.getRightOperand()) + " " + toString(ir, typeTable, node.getElseOperand());
+            break;
+
+        case IRExpr::CHAIN:
+            result += std::string(" ") + kindNames[node.getChainOperatorKind()];
+            for( unsigned i = 0; i < node.getNbChainOperands(); ++i ) {
+                result += " " + toString(ir, typeTable, node.getChainOperand(i));
+            }
+            break;
+
+        default:
+            result += " " + toString(ir, typeTable, node.getLeftOperand());
+            if( node.getKind() >= IRExpr::FIRST_BINARY && node.getKind() <= IRExpr::LAST_BINARY ) {
+                result += " " + toString(ir, typeTable, node.getRightOperand());
+            }
+            break;
+    }
+
+    return result + ")";
+}
+
+/**
+ * Print an expression through its binary view: chains print as binary trees
+ */
+std::string toString(const IRExprView& view)
+{
+    if( !view.isBinary() ) {
+        return toString(view.getExpr());
+    }
+
+    return std::string("(") + kindNames[view.getKind()] + " " + toString(view.getLeftExpr()) + " " + toString(view.getRightExpr()) + ")";
+}
+
+/**
+ * Make a unit test parsing an expression in both parse modes, and checking the tree
+ */
+UnitTest::TestPtr makeExpressionTest(const char* testName, const std::string& source, const std::string& expected)
+{
+    auto theFunc = [=]() {
+        ExpressionParser recursive(source, C90Expression::RECURSIVE_DESCENT);
+        UnitTest::assertEquals("Check recursive descent", toString(recursive.parser.expression()), expected);
+        UnitTest::assertFalse("Check recursive descent errors", recursive.message->anyError());
+        UnitTest::assertEquals("Check recursive descent end", recursive.lexer->peekToken()->getKind(), LexerToken::END_OF_FILE);
+
+        ExpressionParser explicitStack(source, C90Expression::EXPLICIT_STACK);
+        UnitTest::assertEquals("Check explicit stack", toString(explicitStack.parser.expression()), expected);
+        UnitTest::assertFalse("Check explicit stack errors", explicitStack.message->anyError());
+        UnitTest::assertEquals("Check explicit stack end", explicitStack.lexer->peekToken()->getKind(), LexerToken::END_OF_FILE);
+    };
+
+    return UnitTest::makeSimpleTest(testName, theFunc);
+}
+
+/**
+ * Each entry point of a level parses its level and the tighter ones, and stops at
+ * the first operator binding looser
+ */
+void testLevelEntryPoints()
+{
+    typedef IRExprPtr (C90Expression::*EntryPoint)();
+    struct {
+        EntryPoint entryPoint;
+        const char* source;
+        const char* expected;
+        LexerToken::Kind next;
+    } levels[] = {
+        {&C90Expression::castExpression,           "(int)a * b",    "(cast (id a))",                 LexerToken::MUL},
+        {&C90Expression::multiplicativeExpression, "a * b + c",     "(* (id a) (id b))",             LexerToken::ADD},
+        {&C90Expression::additiveExpression,       "a - b << c",    "(- (id a) (id b))",             LexerToken::SHIFT_LEFT},
+        {&C90Expression::shiftExpression,          "a >> b < c",    "(>> (id a) (id b))",            LexerToken::LT},
+        {&C90Expression::relationalExpression,     "a >= b == c",   "(>= (id a) (id b))",            LexerToken::EQUAL},
+        {&C90Expression::equalityExpression,       "a != b & c",    "(!= (id a) (id b))",            LexerToken::BIT_AND},
+        {&C90Expression::bitAndExpression,         "a & b ^ c",     "(& (id a) (id b))",             LexerToken::BIT_XOR},
+        {&C90Expression::bitXorExpression,         "a ^ b | c",     "(^ (id a) (id b))",             LexerToken::BIT_IOR},
+        {&C90Expression::bitIorExpression,         "a | b && c",    "(| (id a) (id b))",             LexerToken::BOOL_AND},
+        {&C90Expression::logicalAndExpression,     "a && b || c",   "(&& (id a) (id b))",            LexerToken::BOOL_OR},
+        {&C90Expression::logicalOrExpression,      "a || b ? c : d", "(|| (id a) (id b))",           LexerToken::QUESTION_MARK},
+        {&C90Expression::conditionalExpression,    "a ? b : c = d", "(?: (id a) (id b) (id c))",     LexerToken::ASSIGN},
+        {&C90Expression::constantExpression,       "a ? b : c, d",  "(?: (id a) (id b) (id c))",     LexerToken::COMMA},
+        {&C90Expression::assignmentExpression,     "a = b, c",      "(= (id a) (id b))",             LexerToken::COMMA},
+        {&C90Expression::expression,               "a, b = c )",    "(, (id a) (= (id b) (id c)))",  LexerToken::RIGHT_PARAR}
+    };
+
+    for( C90Expression::ParseMode parseMode : {C90Expression::RECURSIVE_DESCENT, C90Expression::EXPLICIT_STACK} ) {
+        for( const auto& level : levels ) {
+            ExpressionParser parser(level.source, parseMode);
+            UnitTest::assertEquals(std::string("Check tree of ") + level.source, toString((parser.parser.*level.entryPoint)()), level.expected);
+            UnitTest::assertFalse(std::string("Check errors of ") + level.source, parser.message->anyError());
+            UnitTest::assertEquals(std::string("Check next token of ") + level.source, parser.lexer->peekToken()->getKind(), level.next);
+        }
+    }
+}
+
+/**
+ * Make a unit test parsing an expression with constant folding, in both parse modes
+ */
+UnitTest::TestPtr makeFoldingTest(const char* testName, const std::string& source, const std::string& expected)
+{
+    auto theFunc = [=]() {
+        for( C90Expression::ParseMode parseMode : {C90Expression::RECURSIVE_DESCENT, C90Expression::EXPLICIT_STACK} ) {
+            ExpressionParser parser(source, parseMode);
+            parser.irFactory->setConstantFolder(std::make_shared<IRConstantFolder>());
+            UnitTest::assertEquals("Check folded tree", toString(parser.parser.expression()), expected);
+            UnitTest::assertFalse("Check errors", parser.message->anyError());
+        }
+    };
+
+    return UnitTest::makeSimpleTest(testName, theFunc);
+}
+
+/**
+ * The folding statistics count the folded expressions, and the ones left unfolded
+ */
+void testFoldingStatistics()
+{
+    ExpressionParser parser("(1 + 2) * 3 + x + 1 / 0 + (2 < 3.0)", C90Expression::RECURSIVE_DESCENT);
+    std::shared_ptr<IRConstantFolder> constantFolder = std::make_shared<IRConstantFolder>();
+    parser.irFactory->setConstantFolder(constantFolder);
+
+    UnitTest::assertEquals("Check tree", toString(parser.parser.expression()),
+        "(+ (+ (+ (int 9) (id x)) (/ (int 1) (int 0))) (int 1))");
+    UnitTest::assertEquals("Check nb folded", constantFolder->getStatistics().nbFoldedExprs, 3u);
+    UnitTest::assertEquals("Check nb unfolded", constantFolder->getStatistics().nbUnfoldedExprs, 1u);
+}
+
+/**
+ * Conversions to the narrow types truncate, and the promotions sign extend
+ */
+void testFoldNarrowTypes()
+{
+    IRConstantFolder constantFolder;
+    IRConstant value;
+    value.type = IRTypeTable::getIntType();
+    value.intValue = 300;
+
+    IRConstant unsignedChar;
+    UnitTest::assertTrue("Check cast unsigned char", constantFolder.foldCast(IRTypeTable::getUnsignedCharType(), value, unsignedChar));
+    UnitTest::assertEquals("Check unsigned char", unsignedChar.intValue, 44u);
+
+    value.intValue = 200;
+    IRConstant signedChar;
+    UnitTest::assertTrue("Check cast char", constantFolder.foldCast(IRTypeTable::getCharType(), value, signedChar));
+    UnitTest::assertEquals("Check char", signedChar.getSignedValue(), -56);
+
+    IRConstant sum;
+    UnitTest::assertTrue("Check add", constantFolder.foldBinary(IRExpr::ADD, signedChar, unsignedChar, sum));
+    UnitTest::assertEquals("Check add type", sum.type, IRTypeTable::getIntType());
+    UnitTest::assertEquals("Check add value", sum.getSignedValue(), -12);
+
+    IRConstant negated;
+    UnitTest::assertTrue("Check negate unsigned", constantFolder.foldUnary(IRExpr::UNARY_MINUS, unsignedChar, negated));
+    UnitTest::assertEquals("Check negate type", negated.type, IRTypeTable::getIntType());
+    UnitTest::assertEquals("Check negate value", negated.getSignedValue(), -44);
+}
+
+/**
+ * Deeply nested expressions can be parsed with the explicit stack
+ */
+void testDeepNesting()
+{
+    const int depth = 100000;
+    std::string source = std::string(depth, '(') + "a" + std::string(depth, ')') + " + " + std::string(depth, '!') + "b";
+
+    ExpressionParser explicitStack(source, C90Expression::EXPLICIT_STACK);
+    IRExprPtr expr = explicitStack.parser.expression();
+    UnitTest::assertFalse("Check errors", explicitStack.message->anyError());
+    UnitTest::assertEquals("Check add", expr->getKind(), IRExpr::ADD);
+
+    const IRBinaryExpr* add = static_cast<const IRBinaryExpr *>(expr);
+    UnitTest::assertEquals("Check left", add->getLeftExpr()->getKind(), IRExpr::ID);
+
+    IRExprPtr currExpr = add->getRightExpr();
+    int nbNots = 0;
+    while( currExpr->getKind() == IRExpr::BOOL_NOT ) {
+        currExpr = static_cast<const IRUnaryExpr *>(currExpr)->getOperand();
+        ++nbNots;
+    }
+
+    UnitTest::assertEquals("Check nb nots", nbNots, depth);
+    UnitTest::assertEquals("Check nb nodes", explicitStack.context->getNbNodes(), (size_t)depth + 3);
+
+    std::shared_ptr<FlatIR> ir = std::make_shared<FlatIR>();
+    FlatIRBuilder(ir, explicitStack.context->getTypeTable()).copyExpr(expr);
+    UnitTest::assertEquals("Check nb flat nodes", ir->getNbNodes(), (size_t)depth + 3);
+}
+
+/**
+ * Both parse modes build the same tree for nested unary operators, casts, sizeof
+ * and parentheses followed by postfix operators
+ */
+void testExplicitStackSameTree()
+{
+    std::string source;
+    for( int i = 0; i < 200; ++i ) {
+        source += i % 2 == 0 ? "-(int)!sizeof (" : "*&(";
+    }
+    source += "a";
+    for( int i = 0; i < 200; ++i ) {
+        source += i % 3 == 0 ? ")[b]" : (i % 3 == 1 ? ")(c, d)" : ")++");
+    }
+
+    ExpressionParser recursive(source, C90Expression::RECURSIVE_DESCENT);
+    std::string expected = toString(recursive.parser.expression());
+    UnitTest::assertFalse("Check recursive descent errors", recursive.message->anyError());
+
+    ExpressionParser explicitStack(source, C90Expression::EXPLICIT_STACK);
+    UnitTest::assertEquals("Check explicit stack tree", toString(explicitStack.parser.expression()), expected);
+    UnitTest::assertFalse("Check explicit stack errors", explicitStack.message->anyError());
+    UnitTest::assertEquals("Check end", explicitStack.lexer->peekToken()->getKind(), LexerToken::END_OF_FILE);
+}
+
+/**
+ * Parse a deeply nested expression with the explicit stack, on a thread
+ */
+struct SmallStackParse {
+    std::string source;
+    bool anyError;
+    size_t nbOperators;
+    IRExpr::Kind innerKind;
+
+    static void* run(void* arg)
+    {
+        SmallStackParse* parse = static_cast<SmallStackParse *>(arg);
+        ExpressionParser explicitStack(parse->source, C90Expression::EXPLICIT_STACK);
+        IRExprPtr currExpr = explicitStack.parser.expression();
+        parse->anyError = explicitStack.message->anyError();
+
+        // The tree goes away with the context: only its shape is kept
+        //
+        parse->nbOperators = 0;
+        while( currExpr->getKind() == IRExpr::UNARY_MINUS || currExpr->getKind() == IRExpr::BOOL_NOT ) {
+            currExpr = static_cast<const IRUnaryExpr *>(currExpr)->getOperand();
+            ++parse->nbOperators;
+        }
+
+        parse->innerKind = currExpr->getKind();
+        return nullptr;
+    }
+};
+
+/**
+ * The explicit stack parses pathological nesting on a worker thread with a small
+ * stack, where the recursive descent would overflow it
+ */
+void testExplicitStackSmallThread()
+{
+    const int depth = 100000;
+    SmallStackParse parse;
+    for( int i = 0; i < depth; ++i ) {
+        parse.source += i % 2 == 0 ? "-(" : "!(";
+    }
+    parse.source += "x" + std::string(depth, ')');
+
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    UnitTest::assertEquals("Check stack size", pthread_attr_setstacksize(&attributes, 256 * 1024), 0);
+
+    pthread_t thread;
+    UnitTest::assertEquals("Check thread", pthread_create(&thread, &attributes, &SmallStackParse::run, &parse), 0);
+    pthread_join(thread, nullptr);
+    pthread_attr_destroy(&attributes);
+
+    UnitTest::assertFalse("Check errors", parse.anyError);
+    UnitTest::assertEquals("Check nb operators", parse.nbOperators, (size_t)depth);
+    UnitTest::assertEquals("Check operand", parse.innerKind, IRExpr::ID);
+}
+
+/**
+ * Nodes are allocated in the context arena
+ */
+void testContextArena()
+{
+    IRContext context;
+    Arena& arena = context.getArena();
+
+    const char* name = arena.copyString("name", 4);
+    UnitTest::assertEquals("Check copied string", std::string(name), "name");
+
+    // Large allocations get their own slab, without breaking the current one
+    //
+    void* large = arena.allocate(Arena::DEFAULT_SLAB_SIZE * 2, 8);
+    UnitTest::assertTrue("Check large allocation", large != nullptr);
+
+    for( int i = 0; i < 10000; ++i ) {
+        const IRIntLitExpr* lit = context.create<IRIntLitExpr>(i, IRTypeTable::getIntType());
+        UnitTest::assertEquals("Check alignment", reinterpret_cast<uintptr_t>(lit) % alignof(IRIntLitExpr), 0u);
+        UnitTest::assertEquals("Check value", lit->getValue(), (uint64_t)i);
+    }
+
+    UnitTest::assertEquals("Check nb nodes", context.getNbNodes(), 10000u);
+    UnitTest::assertTrue("Check bytes allocated", context.getBytesAllocated() >= 10000 * sizeof(IRIntLitExpr));
+}
+
+/**
+ * Types are uniqued, and can be compared by pointer
+ */
+void testTypeUniquing()
+{
+    std::shared_ptr<IRTypeTable> typeTable = std::make_shared<IRTypeTable>();
+    IRFactory factory1(std::make_shared<IRContext>(typeTable));
+    IRFactory factory2(std::make_shared<IRContext>(typeTable));
+
+    UnitTest::assertEquals("Check builtin", factory1.getIntType(), factory2.getIntType());
+    UnitTest::assertTrue("Check distinct builtins", factory1.getIntType() != factory1.getUnsignedType());
+
+    IRTypePtr intPtr = factory1.getPointerType(factory1.getIntType());
+    UnitTest::assertEquals("Check pointer", intPtr, factory2.getPointerType(factory2.getIntType()));
+    UnitTest::assertEquals("Check pointer to pointer", factory1.getPointerType(intPtr), factory2.getPointerType(intPtr));
+
+    IRTypePtr array = factory1.getArrayType(intPtr, 10);
+    UnitTest::assertEquals("Check array", array, factory2.getArrayType(intPtr, 10));
+    UnitTest::assertTrue("Check array size", array != factory2.getArrayType(intPtr, 11));
+
+    IRTypePtr function = factory1.getFunctionType(factory1.getVoidType(), {intPtr, array}, false, true);
+    UnitTest::assertEquals("Check function", function, factory2.getFunctionType(factory2.getVoidType(), {intPtr, array}, false, true));
+    UnitTest::assertTrue("Check function varargs", function != factory2.getFunctionType(factory2.getVoidType(), {intPtr, array}, false, false));
+    UnitTest::assertTrue("Check function args", function != factory2.getFunctionType(factory2.getVoidType(), {array, intPtr}, false, true));
+
+    UnitTest::assertEquals("Check type by id", typeTable->getType(function->getId()), function);
+    UnitTest::assertEquals("Check builtin by id", typeTable->getType(IRTypeTable::getIntType()->getId()), IRTypeTable::getIntType());
+    UnitTest::assertEquals("Check nb types", typeTable->getNbTypes(), (size_t)IRType::NB_BUILTIN_TYPES + 7);
+
+    // The pointers to the builtin types belong to their table
+    //
+    IRTypeTable otherTable;
+    IRTypePtr otherIntPtr = otherTable.getPointerType(IRTypeTable::getIntType());
+    UnitTest::assertTrue("Check other table", otherIntPtr != intPtr);
+    UnitTest::assertEquals("Check other table id", otherTable.getType(otherIntPtr->getId()), otherIntPtr);
+
+    // A pointer to a type of another table belongs to this table, and isn't
+    // cached in the other table type
+    //
+    {
+        IRTypeTable temporaryTable;
+        IRTypePtr temporaryPtr = temporaryTable.getPointerType(array);
+        UnitTest::assertEquals("Check foreign pointer target", static_cast<const IRPointerType *>(temporaryPtr)->getTargetType(), array);
+        UnitTest::assertEquals("Check foreign pointer uniqued", temporaryTable.getPointerType(array), temporaryPtr);
+        UnitTest::assertEquals("Check foreign pointer id", temporaryTable.getType(temporaryPtr->getId()), temporaryPtr);
+    }
+
+    IRTypePtr arrayPtr = factory1.getPointerType(array);
+    UnitTest::assertEquals("Check own pointer target", static_cast<const IRPointerType *>(arrayPtr)->getTargetType(), array);
+    UnitTest::assertEquals("Check own pointer id", typeTable->getType(arrayPtr->getId()), arrayPtr);
+    UnitTest::assertEquals("Check own pointer cached", factory2.getPointerType(array), arrayPtr);
+}
+
+/**
+ * The flat encoding of an expression has the same tree, in post-order
+ */
+void testFlatIR()
+{
+    const std::string source = "f(a, b = c) + s.x->y * (int)-z[i] ? sizeof (int) : ++k, \"s\"";
+    ExpressionParser parser(source, C90Expression::RECURSIVE_DESCENT);
+    IRExprPtr expr = parser.parser.expression();
+    UnitTest::assertFalse("Check errors", parser.message->anyError());
+
+    std::shared_ptr<FlatIR> ir = std::make_shared<FlatIR>();
+    FlatIRBuilder builder(ir, parser.context->getTypeTable());
+    FlatIR::NodeIndex root = builder.copyExpr(expr);
+
+    UnitTest::assertEquals("Check tree", toString(*ir, *parser.context->getTypeTable(), root), toString(expr));
+    UnitTest::assertEquals("Check nb nodes", ir->getNbNodes(), parser.context->getNbNodes());
+    UnitTest::assertEquals("Check root is last", (size_t)root, ir->getNbNodes() - 1);
+
+    // Operands always come before their node
+    //
+    for( FlatIR::Node node : *ir ) {
+        UnitTest::assertTrue("Check post-order",
+            node.getLeftOperand() == FlatIR::INVALID_INDEX || node.getLeftOperand() < node.getIndex());
+        UnitTest::assertTrue("Check post-order",
+            node.getRightOperand() == FlatIR::INVALID_INDEX || node.getRightOperand() < node.getIndex());
+    }
+
+    // Build directly with the create functions
+    //
+    FlatIR::NodeIndex cast = builder.createCastExpr(builder.getIntType(), builder.createIdExpr(std::make_shared<IdToken>("a")));
+    FlatIR::NodeIndex add = builder.createAddExpr(cast, builder.createIdExpr(std::make_shared<IdToken>("b")));
+    UnitTest::assertEquals("Check built tree", toString(*ir, *parser.context->getTypeTable(), add), "(+ (cast (id a)) (id b))");
+    UnitTest::assertEquals("Check cast type", ir->getTypeId(cast), IRTypeTable::getIntType()->getId());
+}
+
+/**
+ * Long chains of an associative operator are one node, which has the same binary
+ * view as the tree of binary nodes
+ */
+void testAssociativeChain()
+{
+    const int nbOperands = 40;
+    std::string source = "x - a0";
+    std::string expected = "(chain + (- (id x) (id a0))";
+    for( int i = 1; i < nbOperands; ++i ) {
+        source += " + a" + std::to_string(i);
+        expected += " (id a" + std::to_string(i) + ")";
+    }
+    source += " , y && z";
+    expected += ")";
+
+    for( C90Expression::ParseMode parseMode : {C90Expression::RECURSIVE_DESCENT, C90Expression::EXPLICIT_STACK} ) {
+        ExpressionParser chained(source, parseMode);
+        IRExprPtr expr = chained.parser.expression();
+        UnitTest::assertFalse("Check errors", chained.message->anyError());
+        UnitTest::assertEquals("Check comma", expr->getKind(), IRExpr::COMMA);
+
+        const IRBinaryExpr* comma = static_cast<const IRBinaryExpr *>(expr);
+        UnitTest::assertEquals("Check chain", toString(comma->getLeftExpr()), expected);
+        UnitTest::assertEquals("Check nb nodes", chained.context->getNbNodes(), (size_t)nbOperands + 7);
+
+        ExpressionParser binary(source, parseMode);
+        binary.irFactory->setChainThreshold(UINT_MAX);
+        IRExprPtr binaryExpr = binary.parser.expression();
+        UnitTest::assertEquals("Check binary view", toString(IRExprView(expr)), toString(binaryExpr));
+        UnitTest::assertEquals("Check binary nb nodes", binary.context->getNbNodes(), (size_t)nbOperands * 2 + 5);
+
+        std::shared_ptr<FlatIR> ir = std::make_shared<FlatIR>();
+        FlatIR::NodeIndex root = FlatIRBuilder(ir, chained.context->getTypeTable()).copyExpr(expr);
+        UnitTest::assertEquals("Check flat chain", toString(*ir, *chained.context->getTypeTable(), root), toString(expr));
+    }
+}
+
+/**
+ * Constants in a chain are folded as in the binary tree, as long as no non
+ * constant operand comes before them
+ */
+void testChainFolding()
+{
+    ExpressionParser parser("1 + 2 + 3 + 4 + a + 5", C90Expression::RECURSIVE_DESCENT);
+    parser.irFactory->setConstantFolder(std::make_shared<IRConstantFolder>());
+    parser.irFactory->setChainThreshold(3);
+
+    UnitTest::assertEquals("Check folded chain", toString(parser.parser.expression()), "(chain + (int 10) (id a) (int 5))");
+}
+
+/**
+ * The structural hash and equality compare trees, not nodes
+ */
+void testStructuralHash()
+{
+    const std::string source = "s->x[i + 1] * 2.5, s->x[i + 1] * 2.5, s->x[i + 1] * 2.50f, s->x[i - 1] * 2.5";
+    for( IRFactory::HashingMode hashingMode : {IRFactory::NO_HASHING, IRFactory::STRUCTURAL_HASH} ) {
+        ExpressionParser parser(source, C90Expression::RECURSIVE_DESCENT);
+        parser.irFactory->setHashingMode(hashingMode);
+        parser.irFactory->setChainThreshold(3);
+        IRExprPtr expr = parser.parser.expression();
+        UnitTest::assertEquals("Check chain", expr->getKind(), IRExpr::CHAIN);
+
+        const IRChainExpr* chain = static_cast<const IRChainExpr *>(expr);
+        UnitTest::assertTrue("Check distinct nodes", chain->getOperand(0) != chain->getOperand(1));
+        UnitTest::assertTrue("Check equal", IRExpr::isStructurallyEqual(chain->getOperand(0), chain->getOperand(1)));
+        UnitTest::assertFalse("Check float type", IRExpr::isStructurallyEqual(chain->getOperand(0), chain->getOperand(2)));
+        UnitTest::assertFalse("Check operator", IRExpr::isStructurallyEqual(chain->getOperand(0), chain->getOperand(3)));
+
+        if( hashingMode == IRFactory::STRUCTURAL_HASH ) {
+            UnitTest::assertEquals("Check same hash", chain->getOperand(0)->getHash(), chain->getOperand(1)->getHash());
+            UnitTest::assertTrue("Check different hash", chain->getOperand(0)->getHash() != chain->getOperand(3)->getHash());
+        }
+    }
+}
+
+/**
+ * With hash-consing, the repeated expressions without side effects are shared
+ */
+void testHashConsing()
+{
+    const std::string source = "p->a->b + p->a->b * 2, f(p->a->b), f(p->a->b), i++ + i++";
+    ExpressionParser parser(source, C90Expression::EXPLICIT_STACK);
+    parser.irFactory->setHashingMode(IRFactory::HASH_CONSING);
+    IRExprPtr expr = parser.parser.expression();
+    UnitTest::assertFalse("Check errors", parser.message->anyError());
+
+    const IRBinaryExpr* comma1 = static_cast<const IRBinaryExpr *>(expr);
+    const IRBinaryExpr* comma2 = static_cast<const IRBinaryExpr *>(comma1->getLeftExpr());
+    const IRBinaryExpr* comma3 = static_cast<const IRBinaryExpr *>(comma2->getLeftExpr());
+
+    // Shared subexpressions
+    //
+    const IRBinaryExpr* add = static_cast<const IRBinaryExpr *>(comma3->getLeftExpr());
+    IRExprPtr access = add->getLeftExpr();
+    UnitTest::assertEquals("Check shared access", static_cast<const IRBinaryExpr *>(add->getRightExpr())->getLeftExpr(), access);
+
+    // The calls are not shared, but their arguments are
+    //
+    const IRCallExpr* call1 = static_cast<const IRCallExpr *>(comma3->getRightExpr());
+    const IRCallExpr* call2 = static_cast<const IRCallExpr *>(comma2->getRightExpr());
+    UnitTest::assertTrue("Check calls", call1 != call2);
+    UnitTest::assertTrue("Check call side effects", call1->hasSideEffects());
+    UnitTest::assertEquals("Check shared arg", call1->getArg(0), access);
+    UnitTest::assertEquals("Check shared functor", call1->getFunctor(), call2->getFunctor());
+
+    const IRBinaryExpr* incrs = static_cast<const IRBinaryExpr *>(comma1->getRightExpr());
+    UnitTest::assertTrue("Check side effects", incrs->getLeftExpr() != incrs->getRightExpr());
+    UnitTest::assertTrue("Check parent side effects", incrs->hasSideEffects());
+    UnitTest::assertFalse("Check no side effects", add->hasSideEffects());
+
+    // Same tree as without hash-consing, with fewer nodes
+    //
+    ExpressionParser unshared(source, C90Expression::EXPLICIT_STACK);
+    IRExprPtr unsharedExpr = unshared.parser.expression();
+    UnitTest::assertEquals("Check tree", toString(expr), toString(unsharedExpr));
+    UnitTest::assertTrue("Check equal", IRExpr::isStructurallyEqual(expr, unsharedExpr));
+
+    const IRFactory::HashConsingStatistics& statistics = parser.irFactory->getHashConsingStatistics();
+    UnitTest::assertEquals("Check nb nodes", parser.context->getNbNodes() + statistics.nbSharedExprs, unshared.context->getNbNodes());
+    UnitTest::assertEquals("Check nb shared", statistics.nbSharedExprs, 11u);
+    UnitTest::assertEquals("Check bytes saved", statistics.nbBytesSaved,
+        unshared.context->getBytesAllocated() - parser.context->getBytesAllocated());
+
+    // A shared identifier saves its node and its name, nothing is allocated for it
+    //
+    ExpressionParser sameId("abc + abc", C90Expression::RECURSIVE_DESCENT);
+    sameId.irFactory->setHashingMode(IRFactory::HASH_CONSING);
+    sameId.parser.expression();
+    UnitTest::assertEquals("Check id bytes saved", sameId.irFactory->getHashConsingStatistics().nbBytesSaved, sizeof(IRIdExpr) + 4);
+    UnitTest::assertEquals("Check id bytes allocated", sameId.context->getBytesAllocated(), sizeof(IRIdExpr) + 4 + sizeof(IRBinaryExpr));
+
+    // The flat encoding keeps the sharing: one node per tree node
+    //
+    std::shared_ptr<FlatIR> ir = std::make_shared<FlatIR>();
+    FlatIR::NodeIndex root = FlatIRBuilder(ir, parser.context->getTypeTable()).copyExpr(expr);
+    UnitTest::assertEquals("Check flat tree", toString(*ir, *parser.context->getTypeTable(), root), toString(expr));
+    UnitTest::assertEquals("Check flat nb nodes", ir->getNbNodes(), parser.context->getNbNodes());
+}
+
+/**
+ * Visitor handling every node class: the height of an expression
+ */
+class HeightVisitor : public IRExprVisitor<HeightVisitor, unsigned> {
+public:
+    unsigned visitIdExpr(const IRIdExpr*)                   { return 1; }
+    unsigned visitIntLitExpr(const IRIntLitExpr*)           { return 1; }
+    unsigned visitFloatLitExpr(const IRFloatLitExpr*)       { return 1; }
+    unsigned visitStringLitExpr(const IRStringLitExpr*)     { return 1; }
+    unsigned visitSizeofTypeExpr(const IRSizeofTypeExpr*)   { return 1; }
+
+    unsigned visitCallExpr(const IRCallExpr* expr)
+    {
+        unsigned height = visit(expr->getFunctor());
+        for( unsigned i = 0; i < expr->getNbArgs(); ++i ) {
+            height = std::max(height, visit(expr->getArg(i)));
+        }
+        return height + 1;
+    }
+
+    unsigned visitFieldAccessExpr(const IRFieldAccessExpr* expr) { return visit(expr->getStructExpr()) + 1; }
+    unsigned visitUnaryExpr(const IRUnaryExpr* expr)             { return visit(expr->getOperand()) + 1; }
+    unsigned visitCastExpr(const IRCastExpr* expr)               { return visit(expr->getOperand()) + 1; }
+    unsigned visitBinaryExpr(const IRBinaryExpr* expr)           { return std::max(visit(expr->getLeftExpr()), visit(expr->getRightExpr())) + 1; }
+
+    unsigned visitCondExpr(const IRCondExpr* expr)
+    {
+        return std::max(visit(expr->getCond()), std::max(visit(expr->getThenExpr()), visit(expr->getElseExpr()))) + 1;
+    }
+
+    unsigned visitChainExpr(const IRChainExpr* expr)
+    {
+        unsigned height = 0;
+        for( unsigned i = 0; i < expr->getNbOperands(); ++i ) {
+            height = std::max(height, visit(expr->getOperand(i)));
+        }
+        return height + 1;
+    }
+};
+
+/**
+ * Visitor with a fallback: the identifiers of an expression
+ */
+class IdCollector : public IRExprVisitor<IdCollector> {
+public:
+    std::string ids;
+
+    void visitIdExpr(const IRIdExpr* expr)          { ids += expr->getName(); }
+    void visitUnaryExpr(const IRUnaryExpr* expr)    { visit(expr->getOperand()); }
+    void visitBinaryExpr(const IRBinaryExpr* expr)  { visit(expr->getLeftExpr()); visit(expr->getRightExpr()); }
+    void visitExpr(IRExprPtr)                       { ids += "?"; }
+};
+
+/**
+ * Type visitor: C-like spelling of a type
+ */
+class TypeSpeller : public IRTypeVisitor<TypeSpeller, std::string> {
+public:
+    std::string visitBuiltinType(const IRBuiltinType* type)     { return type->getKind() == IRType::INT ? "int" : "builtin"; }
+    std::string visitPointerType(const IRPointerType* type)     { return visit(type->getTargetType()) + "*"; }
+    std::string visitArrayType(const IRArrayType* type)         { return visit(type->getElementType()) + "[" + std::to_string(type->getNbElements()) + "]"; }
+    std::string visitFunctionType(const IRFunctionType* type)   { return visit(type->getReturnType()) + "()"; }
+    std::string visitRecordType(const IRRecordType* type)       { return std::string("struct ") + type->getTag(); }
+};
+
+/**
+ * The visitors dispatch on the node kinds
+ */
+void testVisitors()
+{
+    ExpressionParser parser("a ? f(b.c, -d[e]) : (int)g + h * 2 + 1.5, i", C90Expression::RECURSIVE_DESCENT);
+    IRExprPtr expr = parser.parser.expression();
+    UnitTest::assertFalse("Check errors", parser.message->anyError());
+
+    HeightVisitor heightVisitor;
+    UnitTest::assertEquals("Check height", heightVisitor.visit(expr), 6u);
+
+    IdCollector idCollector;
+    idCollector.visit(expr);
+    UnitTest::assertEquals("Check ids", idCollector.ids, "?i");
+
+    IdCollector binaryIdCollector;
+    binaryIdCollector.visit(static_cast<const IRCondExpr *>(static_cast<const IRBinaryExpr *>(expr)->getLeftExpr())->getElseExpr());
+    UnitTest::assertEquals("Check binary ids", binaryIdCollector.ids, "?h??");
+
+    IRTypeTable typeTable;
+    IRTypePtr intPtr = typeTable.getPointerType(IRTypeTable::getIntType());
+    IRTypePtr function = typeTable.getFunctionType(typeTable.getArrayType(intPtr, 3), {}, true, false);
+    UnitTest::assertEquals("Check type", TypeSpeller().visit(typeTable.getPointerType(function)), "int*[3]()*");
+}
+
+/**
+ * An image has the same nodes as its flat IR, and rejects being used when it is damaged
+ */
+void testIRImage()
+{
+    const std::string source = "f(a, b = c) + s.x->y * (int)-z[i] ? sizeof (int) : ++k, a + 2.5 + 7 + s.x";
+    ExpressionParser parser(source, C90Expression::RECURSIVE_DESCENT);
+    IRExprPtr expr = parser.parser.expression();
+    UnitTest::assertFalse("Check errors", parser.message->anyError());
+
+    std::shared_ptr<FlatIR> ir = std::make_shared<FlatIR>();
+    FlatIRBuilder builder(ir, parser.context->getTypeTable());
+    builder.copyExpr(expr);
+    IRTypePtr arrayType = builder.getArrayType(builder.getPointerType(builder.getIntType()), 1ULL << 40);
+    FlatIR::NodeIndex sizeofArray = builder.createSizeofTypeExpr(builder.getFunctionType(arrayType, {builder.getIntType()}, false, true));
+
+    const uint64_t sourcesHash = 0x1234;
+    std::vector<char> image;
+    IRImage::write(*ir, *parser.context->getTypeTable(), sourcesHash, image);
+
+    IRImage::Status status;
+    std::shared_ptr<IRImage> loaded = IRImage::useMemory(image.data(), image.size(), sourcesHash, status);
+    UnitTest::assertEquals("Check status", status, IRImage::OK);
+    UnitTest::assertEquals("Check nb nodes", loaded->getNbNodes(), ir->getNbNodes());
+    UnitTest::assertEquals("Check interned strings", loaded->getNbStrings(), 10u);
+
+    for( FlatIR::Node node : *ir ) {
+        FlatIR::NodeIndex index = node.getIndex();
+        UnitTest::assertEquals("Check kind", loaded->getKind(index), node.getKind());
+        UnitTest::assertEquals("Check type", loaded->getTypeId(index), node.getTypeId());
+        UnitTest::assertEquals("Check left", loaded->getLeftOperand(index), node.getLeftOperand());
+        UnitTest::assertEquals("Check right", loaded->getRightOperand(index), node.getRightOperand());
+
+        switch( node.getKind() ) {
+            case IRExpr::ID:
+            case IRExpr::FIELD_DIRECT_ACCESS:
+            case IRExpr::FIELD_INDIRECT_ACCESS:
+                UnitTest::assertEquals("Check string", std::string(loaded->getString(index), loaded->getStringLength(index)), node.getString());
+                break;
+
+            case IRExpr::INT_LITERAL:
+                UnitTest::assertEquals("Check int", loaded->getIntValue(index), node.getIntValue());
+                break;
+
+            case IRExpr::FLOAT_LITERAL:
+                UnitTest::assertEquals("Check float", loaded->getFloatValue(index), node.getFloatValue());
+                break;
+
+            case IRExpr::CALL:
+                UnitTest::assertEquals("Check nb args", loaded->getNbArgs(index), node.getNbArgs());
+                UnitTest::assertEquals("Check arg", loaded->getArg(index, 1), node.getArg(1));
+                break;
+
+            default:
+                UnitTest::assertEquals("Check data", loaded->getElseOperand(index), node.getElseOperand());
+                break;
+        }
+    }
+
+    // The types are imported in another table
+    //
+    IRTypeTable otherTable;
+    SymbolTable symbolTable;
+    std::vector<IRTypePtr> typesById;
+    UnitTest::assertTrue("Check import", loaded->importTypes(otherTable, symbolTable, typesById));
+    IRTypePtr functionType = typesById[loaded->getTypeOperandId(sizeofArray)];
+    UnitTest::assertEquals("Check function type", functionType->getKind(), IRType::FUNCTION);
+    IRTypePtr otherArrayType = static_cast<const IRFunctionType *>(functionType)->getReturnType();
+    UnitTest::assertEquals("Check array type", otherArrayType,
+        otherTable.getArrayType(otherTable.getPointerType(IRTypeTable::getIntType()), 1ULL << 40));
+
+    // Mapped from a file
+    //
+    const std::string fileName = "UnitTestExpression.irimage";
+    UnitTest::assertEquals("Check write", IRImage::writeFile(*ir, *parser.context->getTypeTable(), sourcesHash, fileName), IRImage::OK);
+    std::shared_ptr<IRImage> mapped = IRImage::mapFile(fileName, sourcesHash, status);
+    UnitTest::assertEquals("Check mapped", status, IRImage::OK);
+    UnitTest::assertEquals("Check mapped root", mapped->getKind(static_cast<FlatIR::NodeIndex>(ir->getNbNodes() - 1)), IRExpr::SIZEOF_TYPE);
+    UnitTest::assertTrue("Check other sources", IRImage::mapFile(fileName, sourcesHash + 1, status) == nullptr);
+    UnitTest::assertEquals("Check stale", status, IRImage::STALE);
+    std::remove(fileName.c_str());
+
+    UnitTest::assertTrue("Check missing file", IRImage::mapFile(fileName, sourcesHash, status) == nullptr);
+    UnitTest::assertEquals("Check cannot open", status, IRImage::CANNOT_OPEN);
+
+    // Damaged images
+    //
+    std::vector<char> corrupted(image);
+    corrupted[corrupted.size() / 2] ^= 1;
+    UnitTest::assertTrue("Check corrupted", IRImage::useMemory(corrupted.data(), corrupted.size(), sourcesHash, status) == nullptr);
+    UnitTest::assertEquals("Check checksum", status, IRImage::BAD_CHECKSUM);
+
+    UnitTest::assertTrue("Check truncated", IRImage::useMemory(image.data(), image.size() - 8, sourcesHash, status) == nullptr);
+    UnitTest::assertEquals("Check truncated status", status, IRImage::TOO_SMALL);
+
+    std::vector<char> otherVersion(image);
+    otherVersion[8] += 1;
+    UnitTest::assertTrue("Check version", IRImage::useMemory(otherVersion.data(), otherVersion.size(), sourcesHash, status) == nullptr);
+    UnitTest::assertEquals("Check version status", status, IRImage::BAD_VERSION);
+
+    std::vector<char> notImage(image);
+    notImage[0] = 'X';
+    UnitTest::assertTrue("Check magic", IRImage::useMemory(notImage.data(), notImage.size(), IRImage::ANY_SOURCES, status) == nullptr);
+    UnitTest::assertEquals("Check magic status", status, IRImage::BAD_MAGIC);
+}
+
+/**
+ * The records used by an image come back with their tag and their members, a
+ * member pointing to its own record included
+ */
+void testIRImageRecords()
+{
+    std::shared_ptr<IRTypeTable> typeTable = std::make_shared<IRTypeTable>();
+    SymbolTable symbolTable;
+    const IRRecordType* node = typeTable->createRecordType(IRType::STRUCT, "node");
+    const IRRecordType* incomplete = typeTable->createRecordType(IRType::UNION, nullptr);
+    typeTable->completeRecordType(node, {
+        IRField{symbolTable.getIdentifier("value"), IRTypeTable::getIntType(), IRField::NOT_BIT_FIELD},
+        IRField{symbolTable.getIdentifier("flags"), IRTypeTable::getUnsignedType(), 3},
+        IRField{nullptr, IRTypeTable::getIntType(), 5},
+        IRField{symbolTable.getIdentifier("next"), typeTable->getPointerType(node), IRField::NOT_BIT_FIELD},
+        IRField{symbolTable.getIdentifier("other"), typeTable->getPointerType(incomplete), IRField::NOT_BIT_FIELD}
+    });
+
+    std::shared_ptr<FlatIR> ir = std::make_shared<FlatIR>();
+    FlatIRBuilder builder(ir, typeTable);
+    builder.createSizeofTypeExpr(node);
+
+    std::vector<char> image;
+    IRImage::write(*ir, *typeTable, IRImage::ANY_SOURCES, image);
+    IRImage::Status status;
+    std::shared_ptr<IRImage> loaded = IRImage::useMemory(image.data(), image.size(), IRImage::ANY_SOURCES, status);
+    UnitTest::assertEquals("Check status", status, IRImage::OK);
+
+    IRTypeTable otherTable;
+    SymbolTable otherSymbolTable;
+    std::vector<IRTypePtr> typesById;
+    UnitTest::assertTrue("Check import", loaded->importTypes(otherTable, otherSymbolTable, typesById));
+
+    IRTypePtr otherNode = typesById[loaded->getTypeOperandId(0)];
+    UnitTest::assertEquals("Check kind", otherNode->getKind(), IRType::STRUCT);
+    const IRRecordType* record = static_cast<const IRRecordType *>(otherNode);
+    UnitTest::assertEquals("Check tag", std::string(record->getTag()), "node");
+    UnitTest::assertTrue("Check complete", record->isComplete());
+    UnitTest::assertEquals("Check nb fields", record->getNbFields(), 5u);
+
+    UnitTest::assertEquals("Check value", record->getField(0).name, otherSymbolTable.getIdentifier("value"));
+    UnitTest::assertEquals("Check value type", record->getField(0).type, IRTypeTable::getIntType());
+    UnitTest::assertFalse("Check value not bit-field", record->getField(0).isBitField());
+    UnitTest::assertEquals("Check flags", record->getField(1).name, otherSymbolTable.getIdentifier("flags"));
+    UnitTest::assertEquals("Check flags type", record->getField(1).type, IRTypeTable::getUnsignedType());
+    UnitTest::assertEquals("Check flags width", record->getField(1).bitWidth, 3u);
+    UnitTest::assertTrue("Check unnamed", record->getField(2).name == nullptr);
+    UnitTest::assertEquals("Check unnamed width", record->getField(2).bitWidth, 5u);
+    UnitTest::assertEquals("Check next", record->getField(3).name, otherSymbolTable.getIdentifier("next"));
+    UnitTest::assertEquals("Check next type", record->getField(3).type, otherTable.getPointerType(record));
+
+    IRTypePtr otherPointer = record->getField(4).type;
+    UnitTest::assertEquals("Check other pointer", otherPointer->getKind(), IRType::POINTER);
+    const IRRecordType* otherIncomplete = static_cast<const IRRecordType *>(static_cast<const IRPointerType *>(otherPointer)->getTargetType());
+    UnitTest::assertEquals("Check union", otherIncomplete->getKind(), IRType::UNION);
+    UnitTest::assertTrue("Check no tag", otherIncomplete->getTag() == nullptr);
+    UnitTest::assertFalse("Check incomplete", otherIncomplete->isComplete());
+}
+
+/**
+ * The syntax checker parses like the IR parser, without creating any node
+ */
+void testSyntaxChecker()
+{
+    std::string source = "a ? f(b.c, -d[e]) : (int)g + h * 2 + 1.5, sizeof(int) << i-- && !j->k";
+    for( int i = 0; i < 1000; ++i ) {
+        source += " + x" + std::to_string(i) + " * (y | 1)";
+    }
+
+    for( C90Expression::ParseMode parseMode : {C90Expression::RECURSIVE_DESCENT, C90Expression::EXPLICIT_STACK} ) {
+        std::shared_ptr<UnitTestMessage> message = std::make_shared<UnitTestMessage>();
+        std::shared_ptr<Lexer> lexer = std::make_shared<C90Lexer>(std::make_shared<MyCharReader>(source), message);
+        std::shared_ptr<IRContext> context = std::make_shared<IRContext>();
+        std::shared_ptr<IRFactory> irFactory = std::make_shared<IRFactory>(context);
+
+        C90SyntaxChecker checker(lexer, std::make_shared<IntTypeParser>(lexer, irFactory), std::make_shared<NullIRBuilder>());
+        checker.setParseMode(parseMode);
+        message->resetError();
+
+        UnitTest::assertTrue("Check no expression", checker.expression() == nullptr);
+        UnitTest::assertFalse("Check errors", message->anyError());
+        UnitTest::assertEquals("Check end", lexer->peekToken()->getKind(), LexerToken::END_OF_FILE);
+        UnitTest::assertEquals("Check nb nodes", context->getNbNodes(), 0u);
+
+        // Syntax errors are still found
+        //
+        std::shared_ptr<Lexer> badLexer = std::make_shared<C90Lexer>(std::make_shared<MyCharReader>("f(a, (b + c)"), message);
+        C90SyntaxChecker badChecker(badLexer, std::make_shared<IntTypeParser>(badLexer, irFactory), std::make_shared<NullIRBuilder>());
+        badChecker.setParseMode(parseMode);
+        badChecker.expression();
+        UnitTest::assertTrue("Check syntax error", message->anyError());
+    }
+}
+
+/**
+ * Declarations hide the ones of the enclosing scopes until their scope is popped
+ */
+void testSymbolTable()
+{
+    SymbolTable symbolTable;
+    IRTypePtr intType = IRTypeTable::getIntType();
+    IRTypePtr doubleType = IRTypeTable::getDoubleType();
+
+    Identifier* t = symbolTable.getIdentifier("T");
+    UnitTest::assertTrue("Check interned", symbolTable.getIdentifier(std::string("T")) == t);
+    UnitTest::assertTrue("Check not interned", symbolTable.findIdentifier("U") == nullptr);
+
+    Symbol* typedefT = symbolTable.declare(t, Symbol::TYPEDEF, intType);
+    UnitTest::assertTrue("Check typedef", symbolTable.isTypedefName("T"));
+    UnitTest::assertTrue("Check redeclaration", symbolTable.declare(t, Symbol::OBJECT, intType) == nullptr);
+
+    symbolTable.pushScope();
+    Symbol* objectT = symbolTable.declare(t, Symbol::OBJECT, doubleType);
+    UnitTest::assertTrue("Check shadowing", symbolTable.lookup(t) == objectT);
+    UnitTest::assertTrue("Check shadow chain", objectT->getShadowed() == typedefT);
+    UnitTest::assertFalse("Check hidden typedef", t->isTypedefName());
+
+    symbolTable.pushScope();
+    symbolTable.declare(t, Symbol::TYPEDEF, doubleType);
+    UnitTest::assertTrue("Check inner typedef", t->isTypedefName());
+    UnitTest::assertEquals("Check depth", symbolTable.getScopeDepth(), 2u);
+
+    symbolTable.popScope();
+    UnitTest::assertTrue("Check restored object", symbolTable.lookup(t) == objectT);
+    UnitTest::assertFalse("Check restored bit", t->isTypedefName());
+
+    symbolTable.popScope();
+    UnitTest::assertTrue("Check restored typedef", symbolTable.lookup(t) == typedefT);
+    UnitTest::assertTrue("Check restored typedef bit", t->isTypedefName());
+    UnitTest::assertEquals("Check nb symbols", symbolTable.getNbSymbols(), 1u);
+
+    // Many globals, and many blocks reusing the same memory
+    //
+    const int nbGlobals = 100000;
+    for( int i = 0; i < nbGlobals; ++i ) {
+        UnitTest::assertTrue("Check global", symbolTable.declare(symbolTable.getIdentifier("g" + std::to_string(i)), Symbol::OBJECT, intType) != nullptr);
+    }
+
+    UnitTest::assertEquals("Check nb identifiers", symbolTable.getNbIdentifiers(), (size_t)nbGlobals + 1);
+    UnitTest::assertTrue("Check global lookup", symbolTable.lookup(symbolTable.findIdentifier("g12345"))->getType() == intType);
+
+    size_t bytesAllocated = 0;
+    for( int i = 0; i < 100; ++i ) {
+        symbolTable.pushScope();
+        for( int j = 0; j < 100; ++j ) {
+            symbolTable.declare(symbolTable.getIdentifier("g" + std::to_string(j)), Symbol::TYPEDEF, doubleType);
+        }
+
+        UnitTest::assertTrue("Check block typedef", symbolTable.isTypedefName("g99"));
+        symbolTable.popScope();
+
+        if( i == 0 ) {
+            bytesAllocated = symbolTable.getBytesAllocated();
+        }
+    }
+
+    UnitTest::assertEquals("Check reused memory", symbolTable.getBytesAllocated(), bytesAllocated);
+    UnitTest::assertFalse("Check popped typedef", symbolTable.isTypedefName("g99"));
+    UnitTest::assertEquals("Check nb globals", symbolTable.getNbSymbols(), (size_t)nbGlobals + 1);
+}
+
+/**
+ * A parenthesized typedef name starts a cast, or a sizeof of a type, while an
+ * identifier hiding it is an expression.  The specifiers of a type name go
+ * through the resolver.
+ */
+void testTypedefNames()
+{
+    std::shared_ptr<SymbolTable> symbolTable = std::make_shared<SymbolTable>();
+    symbolTable->declare(symbolTable->getIdentifier("T"), Symbol::TYPEDEF, IRTypeTable::getIntType());
+
+    auto parse = [&](const std::string& source) {
+        std::shared_ptr<UnitTestMessage> message = std::make_shared<UnitTestMessage>();
+        std::shared_ptr<Lexer> lexer = std::make_shared<C90Lexer>(std::make_shared<MyCharReader>(source), message);
+        std::shared_ptr<IRFactory> irFactory = std::make_shared<IRFactory>(std::make_shared<IRContext>());
+        C90Expression parser(lexer, std::make_shared<C90TypeParser>(lexer, message, symbolTable, irFactory->getContext()->getTypeTable(), std::make_shared<IRLayoutEngine>()), irFactory);
+
+        message->resetError();
+        std::string result = toString(parser.expression());
+        UnitTest::assertFalse("Check errors", message->anyError());
+        return result;
+    };
+
+    UnitTest::assertEquals("Check cast", parse("(T)a + sizeof(T)"), "(+ (cast (id a)) (sizeof-type))");
+    UnitTest::assertEquals("Check expression", parse("(a)(b)"), "(call (id a) (id b))");
+
+    symbolTable->pushScope();
+    symbolTable->declare(symbolTable->getIdentifier("T"), Symbol::OBJECT, IRTypeTable::getIntType());
+    UnitTest::assertEquals("Check hidden typedef", parse("(T)-a + sizeof(T)"), "(+ (- (id T) (id a)) (sizeof (id T)))");
+
+    symbolTable->popScope();
+    UnitTest::assertEquals("Check visible typedef", parse("(T)-a"), "(cast (- (id a)))");
+
+    // Builtin types and typedef names, with qualifiers and declarators
+    //
+    UnitTest::assertEquals("Check builtin cast", parse("(unsigned char)a + sizeof(long double)"), "(+ (cast (id a)) (sizeof-type))");
+    UnitTest::assertEquals("Check qualified typedef", parse("(const T *)p - (T volatile)a"),
+        "(- (cast (id p)) (cast (id a)))");
+    UnitTest::assertEquals("Check sizeof pointer", parse("sizeof(T **) * sizeof(char (*)[2])"), "(* (sizeof-type) (sizeof-type))");
+
+    // The resolver reports the invalid combinations, of builtin types and with a
+    // typedef name
+    //
+    std::shared_ptr<UnitTestMessage> message = std::make_shared<UnitTestMessage>();
+    auto parseError = [&](const std::string& source) {
+        std::shared_ptr<Lexer> lexer = std::make_shared<C90Lexer>(std::make_shared<MyCharReader>(source), message);
+        std::shared_ptr<IRFactory> irFactory = std::make_shared<IRFactory>(std::make_shared<IRContext>());
+        C90Expression parser(lexer, std::make_shared<C90TypeParser>(lexer, message, symbolTable, irFactory->getContext()->getTypeTable(), std::make_shared<IRLayoutEngine>()), irFactory);
+
+        message->resetError();
+        std::string result = toString(parser.expression());
+        UnitTest::assertTrue("Check error", message->anyError());
+        return result;
+    };
+
+    UnitTest::assertEquals("Check void int", parseError("(void int)a"), "(cast (id a))");
+    UnitTest::assertEquals("Check void int error", message->getMessage(), Message::ERROR_INVALID_TYPE_COMBO);
+    UnitTest::assertEquals("Check void int names", message->getArgs()[0] + " " + message->getArgs()[1], "void int");
+
+    UnitTest::assertEquals("Check long long", parseError("sizeof(long long)"), "(sizeof-type)");
+    UnitTest::assertEquals("Check long long error", message->getMessage(), Message::ERROR_DUPLICATE_TYPE);
+
+    parseError("(T unsigned)a");
+    UnitTest::assertEquals("Check typedef combo error", message->getMessage(), Message::ERROR_INVALID_TYPE_COMBO);
+    UnitTest::assertEquals("Check typedef combo names", message->getArgs()[0] + " " + message->getArgs()[1], "T unsigned");
+}
+
+/**
+ * Type names with builtin type specifiers, qualifiers and abstract declarators
+ */
+void testTypeNames()
+{
+    std::shared_ptr<SymbolTable> symbolTable = std::make_shared<SymbolTable>();
+    std::shared_ptr<IRContext> context = std::make_shared<IRContext>();
+    std::shared_ptr<IRTypeTable> typeTable = context->getTypeTable();
+    std::shared_ptr<IRLayoutEngine> layoutEngine = std::make_shared<IRLayoutEngine>();
+    std::shared_ptr<UnitTestMessage> message = std::make_shared<UnitTestMessage>();
+
+    auto parseType = [&](const std::string& source) {
+        std::shared_ptr<Lexer> lexer = std::make_shared<C90Lexer>(std::make_shared<MyCharReader>(source), message);
+        message->resetError();
+        IRTypePtr type = C90TypeParser(lexer, message, symbolTable, typeTable, layoutEngine).typeName();
+        UnitTest::assertEquals("Check end of " + source, lexer->peekToken()->getKind(), LexerToken::END_OF_FILE);
+        return type;
+    };
+
+    IRTypePtr intType = IRTypeTable::getIntType();
+    IRTypePtr charPtr = typeTable->getPointerType(IRTypeTable::getCharType());
+
+    UnitTest::assertTrue("Check int", parseType("int") == intType);
+    UnitTest::assertTrue("Check unsigned long", parseType("unsigned long") == IRTypeTable::getUnsignedLongType());
+    UnitTest::assertTrue("Check qualified", parseType("const unsigned volatile char") == IRTypeTable::getUnsignedCharType());
+    UnitTest::assertTrue("Check pointer", parseType("char *") == charPtr);
+    UnitTest::assertTrue("Check qualified pointer", parseType("char * const * volatile") == typeTable->getPointerType(charPtr));
+    UnitTest::assertTrue("Check array of pointers", parseType("char *[4]") == typeTable->getArrayType(charPtr, 4));
+    UnitTest::assertTrue("Check array of arrays", parseType("int [2][3]") == typeTable->getArrayType(typeTable->getArrayType(intType, 3), 2));
+    UnitTest::assertTrue("Check pointer to array", parseType("int (*)[3]") == typeTable->getPointerType(typeTable->getArrayType(intType, 3)));
+    UnitTest::assertTrue("Check function pointer", parseType("int (*)(char *, double [], ...)") ==
+        typeTable->getPointerType(typeTable->getFunctionType(intType, {charPtr, typeTable->getPointerType(IRTypeTable::getDoubleType())}, false, true)));
+    UnitTest::assertTrue("Check void parameters", parseType("void (*)(void)") ==
+        typeTable->getPointerType(typeTable->getFunctionType(IRTypeTable::getVoidType(), {}, false, false)));
+    UnitTest::assertTrue("Check K&R function", parseType("long ()") == typeTable->getFunctionType(IRTypeTable::getLongType(), {}, true, false));
+    UnitTest::assertTrue("Check function parameter", parseType("int (*)(int (int))") ==
+        typeTable->getPointerType(typeTable->getFunctionType(intType,
+            {typeTable->getPointerType(typeTable->getFunctionType(intType, {intType}, false, false))}, false, false)));
+    UnitTest::assertFalse("Check no errors", message->anyError());
+
+    // The array bounds are integer constant expressions
+    //
+    symbolTable->declare(symbolTable->getIdentifier("N"), Symbol::ENUM_CONSTANT, IRTypeTable::getIntType(), 4);
+    UnitTest::assertTrue("Check sizeof bound", parseType("char [sizeof(int)]") == typeTable->getArrayType(IRTypeTable::getCharType(), 4));
+    UnitTest::assertTrue("Check enum bound", parseType("int [N + 1]") == typeTable->getArrayType(intType, 5));
+    UnitTest::assertTrue("Check shift bound", parseType("int [1 << 4]") == typeTable->getArrayType(intType, 16));
+    UnitTest::assertTrue("Check conditional bound", parseType("int (*)[N > 2 ? N : 2][2u]") ==
+        typeTable->getPointerType(typeTable->getArrayType(typeTable->getArrayType(intType, 2), 4)));
+    UnitTest::assertFalse("Check no bound errors", message->anyError());
+
+    UnitTest::assertTrue("Check variable bound", parseType("int [x]") == typeTable->getArrayType(intType, 0));
+    UnitTest::assertEquals("Check variable bound error", message->getMessage(), Message::ERROR_ARRAY_BOUND_NOT_CONSTANT);
+    parseType("int [2.0]");
+    UnitTest::assertEquals("Check floating bound error", message->getMessage(), Message::ERROR_ARRAY_BOUND_NOT_CONSTANT);
+    parseType("int [N - 4]");
+    UnitTest::assertEquals("Check zero bound error", message->getMessage(), Message::ERROR_INVALID_ARRAY_BOUND);
+    parseType("int [-1]");
+    UnitTest::assertEquals("Check negative bound error", message->getMessage(), Message::ERROR_INVALID_ARRAY_BOUND);
+    UnitTest::assertEquals("Check negative bound value", message->getArgs()[0], "-1");
+
+    // The tagged types are reported, and replaced by int
+    //
+    UnitTest::assertTrue("Check struct", parseType("struct s *") == typeTable->getPointerType(intType));
+    UnitTest::assertEquals("Check struct error", message->getMessage(), Message::ERROR_UNSUPPORTED_TYPE_SPECIFIER);
+    UnitTest::assertEquals("Check struct name", message->getArgs()[0], "struct");
+    UnitTest::assertTrue("Check union", parseType("const union u [2]") == typeTable->getArrayType(intType, 2));
+    UnitTest::assertEquals("Check union name", message->getArgs()[0], "union");
+    UnitTest::assertTrue("Check enum", parseType("enum") == intType);
+    UnitTest::assertEquals("Check enum name", message->getArgs()[0], "enum");
+
+    std::shared_ptr<Lexer> lexer = std::make_shared<C90Lexer>(std::make_shared<MyCharReader>("x"), message);
+    UnitTest::assertTrue("Check not a type name", C90TypeParser(lexer, message, symbolTable, typeTable, layoutEngine).typeName() == nullptr);
+    UnitTest::assertEquals("Check not consumed", lexer->peekToken()->getKind(), LexerToken::IDENTIFIER);
+
+    // The casts and sizeof of the expressions
+    //
+    auto parse = [&](const std::string& source) {
+        std::shared_ptr<Lexer> lexer = std::make_shared<C90Lexer>(std::make_shared<MyCharReader>(source), message);
+        std::shared_ptr<IRFactory> irFactory = std::make_shared<IRFactory>(context);
+        C90Expression parser(lexer, std::make_shared<C90TypeParser>(lexer, message, symbolTable, typeTable, layoutEngine), irFactory);
+
+        message->resetError();
+        IRExprPtr expr = parser.expression();
+        UnitTest::assertFalse("Check errors of " + source, message->anyError());
+        return expr;
+    };
+
+    IRExprPtr cast = parse("(int)x");
+    UnitTest::assertEquals("Check int cast", toString(cast), "(cast (id x))");
+    UnitTest::assertTrue("Check int cast type", static_cast<const IRCastExpr *>(cast)->getType() == intType);
+
+    IRExprPtr size = parse("sizeof(unsigned long)");
+    UnitTest::assertEquals("Check sizeof", toString(size), "(sizeof-type)");
+    UnitTest::assertTrue("Check sizeof type", static_cast<const IRSizeofTypeExpr *>(size)->getType() == IRTypeTable::getUnsignedLongType());
+
+    IRExprPtr pointerCast = parse("(char *)p + 1");
+    UnitTest::assertEquals("Check pointer cast", toString(pointerCast), "(+ (cast (id p)) (int 1))");
+    UnitTest::assertTrue("Check pointer cast type",
+        static_cast<const IRCastExpr *>(static_cast<const IRBinaryExpr *>(pointerCast)->getLeftExpr())->getType() == charPtr);
+}
+
+/**
+ * Declaration specifiers resolve to a builtin type, or to an error
+ */
+void testDeclarationSpecifiers()
+{
+    std::shared_ptr<UnitTestMessage> message = std::make_shared<UnitTestMessage>();
+    TypeNameResolver resolver(message);
+
+    auto resolve = [&](std::initializer_list<LexerToken::Kind> tokens) {
+        message->resetError();
+        resolver.reset();
+        for( LexerToken::Kind token : tokens ) {
+            if( !resolver.setFlag(TypeNameResolver::getFlag(token)) ) {
+                return IRTypePtr(nullptr);
+            }
+        }
+
+        return resolver.resolve();
+    };
+
+    UnitTest::assertTrue("Check implicit int", resolve({LexerToken::STATIC}) == IRTypeTable::getIntType());
+    UnitTest::assertTrue("Check signed", resolve({LexerToken::SIGNED}) == IRTypeTable::getIntType());
+    UnitTest::assertTrue("Check signed char", resolve({LexerToken::CHAR, LexerToken::SIGNED}) == IRTypeTable::getSignedCharType());
+    UnitTest::assertTrue("Check short", resolve({LexerToken::SHORT, LexerToken::SIGNED, LexerToken::INT}) == IRTypeTable::getShortType());
+    UnitTest::assertTrue("Check unsigned short", resolve({LexerToken::UNSIGNED, LexerToken::SHORT}) == IRTypeTable::getUnsignedShortType());
+    UnitTest::assertTrue("Check unsigned long", resolve({LexerToken::LONG, LexerToken::UNSIGNED, LexerToken::INT}) == IRTypeTable::getUnsignedLongType());
+    UnitTest::assertTrue("Check long double", resolve({LexerToken::LONG, LexerToken::DOUBLE}) == IRTypeTable::getLongDoubleType());
+    UnitTest::assertTrue("Check void", resolve({LexerToken::VOID}) == IRTypeTable::getVoidType());
+
+    UnitTest::assertTrue("Check qualified", resolve({LexerToken::CONST, LexerToken::EXTERN, LexerToken::VOLATILE, LexerToken::FLOAT}) == IRTypeTable::getFloatType());
+    UnitTest::assertTrue("Check const", resolver.isConst() && resolver.isVolatile());
+    UnitTest::assertEquals("Check storage class", resolver.getStorageClass(), TypeNameResolver::EXTERN);
+    UnitTest::assertFalse("Check no errors", message->anyError());
+
+    UnitTest::assertTrue("Check void int", resolve({LexerToken::INT, LexerToken::VOID}) == nullptr);
+    UnitTest::assertEquals("Check combo error", message->getMessage(), Message::ERROR_INVALID_TYPE_COMBO);
+    UnitTest::assertEquals("Check combo names", message->getArgs()[0] + " " + message->getArgs()[1], "void int");
+
+    UnitTest::assertTrue("Check signed unsigned", resolve({LexerToken::SIGNED, LexerToken::LONG, LexerToken::UNSIGNED}) == nullptr);
+    UnitTest::assertEquals("Check sign names", message->getArgs()[0] + " " + message->getArgs()[1], "signed unsigned");
+
+    UnitTest::assertTrue("Check long long", resolve({LexerToken::LONG, LexerToken::LONG}) == nullptr);
+    UnitTest::assertEquals("Check duplicate error", message->getMessage(), Message::ERROR_DUPLICATE_TYPE);
+
+    UnitTest::assertTrue("Check storage classes", resolve({LexerToken::STATIC, LexerToken::INT, LexerToken::REGISTER}) == nullptr);
+    UnitTest::assertEquals("Check storage class error", message->getMessage(), Message::ERROR_INVALID_TYPE_COMBO);
+    UnitTest::assertEquals("Check not a specifier", TypeNameResolver::getFlag(LexerToken::STRUCT), TypeNameResolver::NB_FLAGS);
+}
+
+/**
+ * Records are laid out like the System V compilers do, and their members are
+ * found by name
+ */
+void testRecordLayout()
+{
+    SymbolTable symbolTable;
+    IRTypeTable typeTable;
+    IRLayoutEngine layoutEngine;
+    IRLayoutEngine layoutEngine32(TargetABI::getILP32());
+
+    auto field = [&](const char* name, IRTypePtr type, uint32_t bitWidth) {
+        return IRField{name != nullptr ? symbolTable.getIdentifier(name) : nullptr, type, bitWidth};
+    };
+    auto createRecord = [&](IRType::Kind kind, std::initializer_list<IRField> fields) {
+        const IRRecordType* recordType = typeTable.createRecordType(kind, "r");
+        typeTable.completeRecordType(recordType, fields);
+        return recordType;
+    };
+
+    const uint32_t NOT_BIT_FIELD = IRField::NOT_BIT_FIELD;
+    IRTypePtr charType = IRTypeTable::getCharType();
+    IRTypePtr intType = IRTypeTable::getIntType();
+    IRTypePtr unsignedType = IRTypeTable::getUnsignedType();
+
+    // struct { char c; int i; short s; }
+    //
+    const IRRecordType* simple = createRecord(IRType::STRUCT, {
+        field("c", charType, NOT_BIT_FIELD), field("i", intType, NOT_BIT_FIELD), field("s", IRTypeTable::getShortType(), NOT_BIT_FIELD)
+    });
+    const IRRecordLayout* simpleLayout = layoutEngine.getRecordLayout(simple);
+    UnitTest::assertEquals("Check size", simpleLayout->getSize(), 12u);
+    UnitTest::assertEquals("Check alignment", simpleLayout->getAlignment(), 4u);
+    UnitTest::assertEquals("Check offset", simpleLayout->getFieldLayout(simpleLayout->findField(symbolTable.getIdentifier("s"))).offset, 8u);
+    UnitTest::assertTrue("Check cached", layoutEngine.getRecordLayout(simple) == simpleLayout);
+    UnitTest::assertEquals("Check no field", simpleLayout->findField(symbolTable.getIdentifier("x")), IRRecordLayout::NO_FIELD);
+
+    // struct { char c; long double d; }, on both targets
+    //
+    const IRRecordType* longDouble = createRecord(IRType::STRUCT, {
+        field("c", charType, NOT_BIT_FIELD), field("d", IRTypeTable::getLongDoubleType(), NOT_BIT_FIELD)
+    });
+    UnitTest::assertEquals("Check LP64 size", layoutEngine.getSize(longDouble), 32u);
+    UnitTest::assertEquals("Check ILP32 size", layoutEngine32.getSize(longDouble), 16u);
+    UnitTest::assertEquals("Check ILP32 pointer", layoutEngine32.getSize(typeTable.getPointerType(longDouble)), 4u);
+
+    // struct { unsigned a:3; unsigned b:30; char c; }: b doesn't fit after a
+    //
+    const IRRecordType* bitFields = createRecord(IRType::STRUCT, {
+        field("a", unsignedType, 3), field("b", unsignedType, 30), field("c", charType, NOT_BIT_FIELD)
+    });
+    const IRRecordLayout* bitFieldsLayout = layoutEngine.getRecordLayout(bitFields);
+    UnitTest::assertEquals("Check b offset", bitFieldsLayout->getFieldLayout(1).offset, 4u);
+    UnitTest::assertEquals("Check c offset", bitFieldsLayout->getFieldLayout(2).offset, 8u);
+    UnitTest::assertEquals("Check bit-fields size", bitFieldsLayout->getSize(), 12u);
+
+    // struct { char c; unsigned a:4; unsigned short b:13; }: a shares the storage unit of c
+    //
+    const IRRecordType* packed = createRecord(IRType::STRUCT, {
+        field("c", charType, NOT_BIT_FIELD), field("a", unsignedType, 4), field("b", IRTypeTable::getUnsignedShortType(), 13)
+    });
+    const IRRecordLayout* packedLayout = layoutEngine.getRecordLayout(packed);
+    UnitTest::assertEquals("Check a bit offset", packedLayout->getFieldLayout(1).bitOffset, 8u);
+    UnitTest::assertEquals("Check b unit", packedLayout->getFieldLayout(2).offset, 2u);
+    UnitTest::assertEquals("Check packed size", packedLayout->getSize(), 4u);
+
+    // struct { char c; int :0; char d; }: the unnamed bit-field doesn't align the struct
+    //
+    const IRRecordType* zeroWidth = createRecord(IRType::STRUCT, {
+        field("c", charType, NOT_BIT_FIELD), field(nullptr, intType, 0), field("d", charType, NOT_BIT_FIELD)
+    });
+    UnitTest::assertEquals("Check d offset", layoutEngine.getRecordLayout(zeroWidth)->getFieldLayout(2).offset, 4u);
+    UnitTest::assertEquals("Check zero width size", layoutEngine.getSize(zeroWidth), 5u);
+
+    // union { char c[5]; int i; }, and an array of them
+    //
+    const IRRecordType* unionType = createRecord(IRType::UNION, {
+        field("c", typeTable.getArrayType(charType, 5), NOT_BIT_FIELD), field("i", intType, NOT_BIT_FIELD)
+    });
+    UnitTest::assertEquals("Check union size", layoutEngine.getSize(unionType), 8u);
+    UnitTest::assertEquals("Check union offset", layoutEngine.getRecordLayout(unionType)->getFieldLayout(1).offset, 0u);
+    UnitTest::assertEquals("Check array size", layoutEngine.getSize(typeTable.getArrayType(typeTable.getArrayType(unionType, 4), 3)), 96u);
+
+    // Incomplete records have no layout until they are completed
+    //
+    const IRRecordType* incomplete = typeTable.createRecordType(IRType::STRUCT, "incomplete");
+    UnitTest::assertTrue("Check incomplete", layoutEngine.getRecordLayout(incomplete) == nullptr);
+    UnitTest::assertEquals("Check incomplete size", layoutEngine.getSize(incomplete), 0u);
+    typeTable.completeRecordType(incomplete, {field("x", simple, NOT_BIT_FIELD)});
+    UnitTest::assertEquals("Check completed size", layoutEngine.getSize(incomplete), 12u);
+
+    // Register map with many members
+    //
+    const unsigned nbRegisters = 5000;
+    std::vector<IRField> registers;
+    for( unsigned i = 0; i < nbRegisters; ++i ) {
+        registers.push_back(field(("reg" + std::to_string(i)).c_str(), unsignedType, NOT_BIT_FIELD));
+    }
+
+    const IRRecordType* registerMap = typeTable.createRecordType(IRType::STRUCT, "registers");
+    typeTable.completeRecordType(registerMap, registers);
+    const IRRecordLayout* registerMapLayout = layoutEngine.getRecordLayout(registerMap);
+    UnitTest::assertEquals("Check register map size", registerMapLayout->getSize(), nbRegisters * 4);
+
+    for( unsigned i = 0; i < nbRegisters; ++i ) {
+        unsigned index = registerMapLayout->findField(symbolTable.getIdentifier("reg" + std::to_string(i)));
+        UnitTest::assertEquals("Check register index", index, i);
+        UnitTest::assertEquals("Check register offset", registerMapLayout->getFieldLayout(index).offset, i * 4);
+    }
+}
+
+/**
+ * Integer constant expressions, with the enumeration constants of the symbol
+ * table and the sizes of the layout engine
+ */
+void testConstantEvaluator()
+{
+    auto symbolTable = std::make_shared<SymbolTable>();
+    IRConstantEvaluator evaluator(symbolTable, std::make_shared<IRLayoutEngine>());
+
+    // The nodes must outlive the evaluator
+    //
+    std::vector<std::shared_ptr<ExpressionParser>> parsers;
+    auto parse = [&](const std::string& source) {
+        parsers.push_back(std::make_shared<ExpressionParser>(source, C90Expression::EXPLICIT_STACK));
+        return parsers.back()->parser.expression();
+    };
+    auto evaluate = [&](const std::string& source) {
+        return evaluator.evaluate(parse(source));
+    };
+    auto checkValue = [&](const std::string& source, int64_t value, IRType::Kind typeKind) {
+        IRConstantEvaluator::Result result = evaluate(source);
+        UnitTest::assertEquals("Check constant: " + source, result.status, IRConstantEvaluator::CONSTANT);
+        UnitTest::assertEquals("Check value: " + source, result.value.getSignedValue(), value);
+        UnitTest::assertEquals("Check type: " + source, result.value.type->getKind(), typeKind);
+    };
+    auto checkStatus = [&](const std::string& source, IRConstantEvaluator::Status status, IRExpr::Kind culpritKind) {
+        IRConstantEvaluator::Result result = evaluate(source);
+        UnitTest::assertEquals("Check status: " + source, result.status, status);
+        UnitTest::assertEquals("Check culprit: " + source, result.culprit->getKind(), culpritKind);
+    };
+
+    // Arithmetic, with the promotions and conversions of the folder
+    //
+    checkValue("(1 + 2) * 3 - 4 / 2 % 3", 7, IRType::INT);
+    checkValue("-1 < 0u", 0, IRType::INT);
+    checkValue("0xffffffff + 1", 0, IRType::UNSIGNED);
+    checkValue("(int)3.9 + (int)2.5", 5, IRType::INT);
+    checkValue("1 ? 2 : 3l", 2, IRType::LONG);
+    checkValue("sizeof (int) * 2", 8, IRType::UNSIGNED_LONG);
+    checkValue("sizeof 1l", 8, IRType::UNSIGNED_LONG);
+
+    // The operands that are not evaluated may be anything
+    //
+    checkValue("0 && 1 / 0", 0, IRType::INT);
+    checkValue("1 || x", 1, IRType::INT);
+    checkValue("0 ? x : 4", 4, IRType::INT);
+
+    checkStatus("2 + 1 / 0", IRConstantEvaluator::UNDEFINED, IRExpr::DIV);
+    checkStatus("1 << 40", IRConstantEvaluator::UNDEFINED, IRExpr::SHIFT_LEFT);
+    checkStatus("a + 1", IRConstantEvaluator::NOT_ENUM_CONSTANT, IRExpr::ID);
+    checkStatus("1 + (a = 2)", IRConstantEvaluator::NOT_CONSTANT, IRExpr::ASSIGN);
+    checkStatus("(1, 2)", IRConstantEvaluator::NOT_CONSTANT, IRExpr::COMMA);
+    checkStatus("2.5 + 1", IRConstantEvaluator::NOT_INTEGER, IRExpr::FLOAT_LITERAL);
+    checkStatus("(int)2.5 + 1.0", IRConstantEvaluator::NOT_INTEGER, IRExpr::FLOAT_LITERAL);
+    checkStatus("sizeof a", IRConstantEvaluator::UNKNOWN_TYPE, IRExpr::SIZEOF_EXPR);
+
+    // Enumeration constants, and the invalidation when the declarations change
+    //
+    symbolTable->declare(symbolTable->getIdentifier("RED"), Symbol::ENUM_CONSTANT, IRTypeTable::getIntType(), 5);
+    IRExprPtr red = parse("RED * 2");
+    UnitTest::assertEquals("Check enum", evaluator.evaluate(red).value.getSignedValue(), 10);
+
+    symbolTable->pushScope();
+    symbolTable->declare(symbolTable->getIdentifier("RED"), Symbol::OBJECT, IRTypeTable::getIntType());
+    UnitTest::assertEquals("Check hidden enum", evaluator.evaluate(red).status, IRConstantEvaluator::NOT_ENUM_CONSTANT);
+    symbolTable->popScope();
+    UnitTest::assertEquals("Check visible enum", evaluator.evaluate(red).value.getSignedValue(), 10);
+
+    // Shared nodes are evaluated once, and the results are reused
+    //
+    size_t nbEvaluated = evaluator.getNbEvaluatedExprs();
+    parsers.push_back(std::make_shared<ExpressionParser>("(RED + 1) * (RED + 1) + (RED + 1)", C90Expression::EXPLICIT_STACK));
+    std::shared_ptr<ExpressionParser> shared = parsers.back();
+    shared->irFactory->setHashingMode(IRFactory::HASH_CONSING);
+    IRExprPtr sharedExpr = shared->parser.expression();
+    UnitTest::assertEquals("Check shared value", evaluator.evaluate(sharedExpr).value.getSignedValue(), 42);
+    UnitTest::assertEquals("Check nb evaluated", evaluator.getNbEvaluatedExprs() - nbEvaluated, 5u);
+    evaluator.evaluate(sharedExpr);
+    UnitTest::assertEquals("Check cached", evaluator.getNbEvaluatedExprs() - nbEvaluated, 5u);
+
+    // sizeof of an incomplete type is evaluated again once the type is complete
+    //
+    IRTypeTable typeTable;
+    const IRRecordType* recordType = typeTable.createRecordType(IRType::STRUCT, "s");
+    IRExprPtr sizeofRecord = shared->irFactory->createSizeofTypeExpr(recordType);
+    UnitTest::assertEquals("Check incomplete", evaluator.evaluate(sizeofRecord).status, IRConstantEvaluator::INCOMPLETE_TYPE);
+    typeTable.completeRecordType(recordType, {IRField{symbolTable->getIdentifier("x"), IRTypeTable::getLongType(), IRField::NOT_BIT_FIELD}});
+    UnitTest::assertEquals("Check completed", evaluator.evaluate(sizeofRecord).value.getSignedValue(), 8);
+
+    // Enumerators defined from the previous ones: each one costs the same
+    //
+    const unsigned nbEnumerators = 10000;
+    symbolTable->declare(symbolTable->getIdentifier("E0"), Symbol::ENUM_CONSTANT, IRTypeTable::getIntType(), 0);
+    nbEvaluated = evaluator.getNbEvaluatedExprs();
+    for( unsigned i = 1; i < nbEnumerators; ++i ) {
+        IRConstantEvaluator::Result result = evaluate("E" + std::to_string(i - 1) + " * 1 + 1");
+        symbolTable->declare(symbolTable->getIdentifier("E" + std::to_string(i)), Symbol::ENUM_CONSTANT, IRTypeTable::getIntType(), result.value.getSignedValue());
+    }
+    UnitTest::assertEquals("Check last enumerator", symbolTable->lookup(symbolTable->getIdentifier("E9999"))->getValue(), nbEnumerators - 1);
+    UnitTest::assertEquals("Check linear", evaluator.getNbEvaluatedExprs() - nbEvaluated, (nbEnumerators - 1) * 5);
+
+    // Deep expression
+    //
+    std::string deep = "1";
+    for( unsigned i = 1; i < 100000; ++i ) {
+        deep += "+1";
+    }
+    checkValue(deep, 100000, IRType::INT);
+}
+
+/**
+ * Spellings of preprocessed tokens, separated by spaces
+ */
+std::string spellTokens(const PPExpandedTokenList& tokens)
+{
+    std::string result;
+    for( const PPExpandedToken& token : tokens ) {
+        result += (result.empty() ? "" : " ") + token.getSpelling();
+    }
+    return result;
+}
+
+/**
+ * A compilation resumes after its prefix header from a precompiled header: same
+ * macros, include guards, symbols, types and IR.  The image is rejected for
+ * another configuration, or once the header changed.
+ */
+void testPrecompiledHeader()
+{
+    const char* prefixName = "UnitTestExpression_prefix.h";
+    const char* onceName = "UnitTestExpression_once.h";
+    const char* imageName = "UnitTestExpression.pch";
+    const char* prefixText = "#ifndef PREFIX_H\n#define PREFIX_H\n#include \"UnitTestExpression_once.h\"\n"
+                             "#define SQUARE(x) ((x) * (x))\n#define LIMIT 10\n#endif\n";
+    std::ofstream(prefixName) << prefixText;
+    std::ofstream(onceName) << "#pragma once\n#define ONCE 1\n";
+
+    // The prefix header is the file preprocessed
+    //
+    auto msg = std::make_shared<UnitTestMessage>();
+    msg->resetError();
+    C90Preprocessor preprocessor(msg);
+    PPExpandedTokenList output;
+    UnitTest::assertTrue("Check prefix read", preprocessor.preprocessMainFile(prefixName, output));
+
+    // What parsing the header would declare: struct S { int a; struct S* next; unsigned bits : 3; } and
+    // typedef struct S T; int table[LIMIT]; T* f(int); enum { RED = 2 };
+    //
+    ExpressionParser parser("f(RED) + table[1]", C90Expression::RECURSIVE_DESCENT);
+    std::shared_ptr<IRTypeTable> typeTable = parser.context->getTypeTable();
+    SymbolTable symbolTable;
+    const IRRecordType* recordS = typeTable->createRecordType(IRType::STRUCT, "S");
+    typeTable->completeRecordType(recordS, {
+        IRField{symbolTable.getIdentifier("a"), IRTypeTable::getIntType(), IRField::NOT_BIT_FIELD},
+        IRField{symbolTable.getIdentifier("next"), typeTable->getPointerType(recordS), IRField::NOT_BIT_FIELD},
+        IRField{symbolTable.getIdentifier("bits"), IRTypeTable::getUnsignedType(), 3}
+    });
+    symbolTable.declare(symbolTable.getIdentifier("T"), Symbol::TYPEDEF, recordS);
+    symbolTable.declare(symbolTable.getIdentifier("table"), Symbol::OBJECT, typeTable->getArrayType(IRTypeTable::getIntType(), 10));
+    symbolTable.declare(symbolTable.getIdentifier("f"), Symbol::FUNCTION,
+        typeTable->getFunctionType(typeTable->getPointerType(recordS), {IRTypeTable::getIntType()}, false, false));
+    symbolTable.declare(symbolTable.getIdentifier("RED"), Symbol::ENUM_CONSTANT, IRTypeTable::getIntType(), 2);
+    symbolTable.pushScope();
+    symbolTable.declare(symbolTable.getIdentifier("local"), Symbol::OBJECT, IRTypeTable::getIntType());
+
+    std::shared_ptr<FlatIR> ir = std::make_shared<FlatIR>();
+    FlatIRBuilder builder(ir, typeTable);
+    builder.copyExpr(parser.parser.expression());
+    UnitTest::assertFalse("Check errors", parser.message->anyError() || msg->anyError());
+
+    uint64_t configurationHash = PCHImage::hashConfiguration(preprocessor.getIncludePaths(), TargetABI::getLP64(), 1);
+    UnitTest::assertEquals("Check write", PCHImage::writeFile(preprocessor, symbolTable, *typeTable, ir.get(), configurationHash, imageName), PCHImage::OK);
+
+    // The next compilation
+    //
+    PCHImage::Status status;
+    std::shared_ptr<PCHImage> image = PCHImage::mapFile(imageName, configurationHash, status);
+    UnitTest::assertEquals("Check status", status, PCHImage::OK);
+    UnitTest::assertEquals("Check dependencies", image->getNbDependencies(), 2u);
+    UnitTest::assertEquals("Check macros", image->getNbMacros(), 4u);
+    UnitTest::assertEquals("Check symbols", image->getNbSymbols(), 4u);
+
+    C90Preprocessor resumed(msg);
+    SymbolTable resumedSymbols;
+    IRTypeTable resumedTypes;
+    std::vector<IRTypePtr> typesById;
+    UnitTest::assertTrue("Check restore", image->restore(resumed, resumedSymbols, resumedTypes, typesById));
+
+    PPSource source(std::string("#include \"UnitTestExpression_prefix.h\"\n#include \"UnitTestExpression_once.h\"\nSQUARE(LIMIT) ONCE\n"),
+        std::make_shared<std::string>("main.c"));
+    PPExpandedTokenList resumedOutput;
+    resumed.preprocess(source, resumedOutput);
+    UnitTest::assertEquals("Check expansion", spellTokens(resumedOutput), "( ( 10 ) * ( 10 ) ) 1");
+    UnitTest::assertEquals("Check skipped includes", resumed.getNbSkippedIncludes(), 2u);
+    UnitTest::assertTrue("Check same dependencies", resumed.getDependencies() == preprocessor.getDependencies());
+
+    UnitTest::assertTrue("Check typedef", resumedSymbols.isTypedefName("T"));
+    UnitTest::assertTrue("Check no block scope", resumedSymbols.findIdentifier("local") == nullptr ||
+        resumedSymbols.lookup(resumedSymbols.findIdentifier("local")) == nullptr);
+    UnitTest::assertEquals("Check enum", resumedSymbols.lookup(resumedSymbols.getIdentifier("RED"))->getValue(), 2);
+
+    const IRRecordType* resumedS = static_cast<const IRRecordType *>(resumedSymbols.lookup(resumedSymbols.getIdentifier("T"))->getType());
+    UnitTest::assertEquals("Check record", resumedS->getKind(), IRType::STRUCT);
+    UnitTest::assertEquals("Check tag", std::string(resumedS->getTag()), "S");
+    UnitTest::assertEquals("Check fields", resumedS->getNbFields(), 3u);
+    UnitTest::assertTrue("Check field name", resumedS->getField(1).name == resumedSymbols.getIdentifier("next"));
+    UnitTest::assertEquals("Check recursive field", resumedS->getField(1).type, resumedTypes.getPointerType(resumedS));
+    UnitTest::assertEquals("Check bit-field", resumedS->getField(2).bitWidth, 3u);
+    UnitTest::assertEquals("Check array", resumedSymbols.lookup(resumedSymbols.getIdentifier("table"))->getType(),
+        resumedTypes.getArrayType(IRTypeTable::getIntType(), 10));
+    UnitTest::assertEquals("Check function", resumedSymbols.lookup(resumedSymbols.getIdentifier("f"))->getType(),
+        resumedTypes.getFunctionType(resumedTypes.getPointerType(resumedS), {IRTypeTable::getIntType()}, false, false));
+
+    const std::shared_ptr<IRImage>& resumedIR = image->getIR();
+    FlatIR::NodeIndex root = static_cast<FlatIR::NodeIndex>(ir->getNbNodes() - 1);
+    UnitTest::assertEquals("Check IR", resumedIR->getNbNodes(), ir->getNbNodes());
+    UnitTest::assertEquals("Check IR root", resumedIR->getKind(root), IRExpr::ADD);
+    UnitTest::assertEquals("Check IR string", std::string(resumedIR->getString(resumedIR->getOperand(resumedIR->getLeftOperand(root)))), "f");
+    UnitTest::assertFalse("Check any error", msg->anyError());
+
+    // Another configuration, then a header changed
+    //
+    uint64_t otherConfiguration = PCHImage::hashConfiguration(preprocessor.getIncludePaths(), TargetABI::getILP32(), 1);
+    UnitTest::assertTrue("Check other configuration", PCHImage::mapFile(imageName, otherConfiguration, status) == nullptr);
+    UnitTest::assertEquals("Check configuration status", status, PCHImage::BAD_CONFIGURATION);
+
+    std::ofstream(prefixName, std::ios::app) << "#define LATE 1\n";
+    UnitTest::assertTrue("Check stale", PCHImage::mapFile(imageName, configurationHash, status) == nullptr);
+    UnitTest::assertEquals("Check stale status", status, PCHImage::STALE);
+
+    // The hashes are the ones of the files as read: an image written after a
+    // header changed is stale too
+    //
+    std::ofstream(prefixName) << prefixText;
+    UnitTest::assertTrue("Check same content", PCHImage::mapFile(imageName, configurationHash, status) != nullptr);
+    std::ofstream(onceName, std::ios::app) << "#define LATER 1\n";
+    UnitTest::assertEquals("Check rewrite", PCHImage::writeFile(preprocessor, symbolTable, *typeTable, ir.get(), configurationHash, imageName), PCHImage::OK);
+    UnitTest::assertTrue("Check stale rewrite", PCHImage::mapFile(imageName, configurationHash, status) == nullptr);
+    UnitTest::assertEquals("Check stale rewrite status", status, PCHImage::STALE);
+
+    for( const char* fileName : {prefixName, onceName, imageName} ) {
+        std::remove(fileName);
+    }
+}
+
+UnitTest::TestPtr buildExpressionUnitTests()
+{
+    return UnitTest::makeMultipleTest(
+        "Test expressions",
+        {
+            makeExpressionTest("testPrecedence", "a + b * c", "(+ (id a) (* (id b) (id c)))"),
+            makeExpressionTest("testLeftAssociativity", "a - b - c", "(- (- (id a) (id b)) (id c))"),
+            makeExpressionTest("testRightAssociativity", "a = b += c", "(= (id a) (+= (id b) (id c)))"),
+            makeExpressionTest("testAllLevels",
+                "a || b && c | d ^ e & f == g < h << i + j * k",
+                "(|| (id a) (&& (id b) (| (id c) (^ (id d) (& (id e) (== (id f) (< (id g) (<< (id h) (+ (id i) (* (id j) (id k)))))))))))"),
+            makeExpressionTest("testMultiplicativeOperators", "a * b / c % d * e",
+                "(* (% (/ (* (id a) (id b)) (id c)) (id d)) (id e))"),
+            makeExpressionTest("testAdditiveOperators", "a - b + c - d", "(- (+ (- (id a) (id b)) (id c)) (id d))"),
+            makeExpressionTest("testShiftOperators", "a << b >> c << d + e",
+                "(<< (>> (<< (id a) (id b)) (id c)) (+ (id d) (id e)))"),
+            makeExpressionTest("testRelationalOperators", "a < b > c <= d >= e << f",
+                "(>= (<= (> (< (id a) (id b)) (id c)) (id d)) (<< (id e) (id f)))"),
+            makeExpressionTest("testEqualityOperators", "a == b != c == d < e",
+                "(== (!= (== (id a) (id b)) (id c)) (< (id d) (id e)))"),
+            makeExpressionTest("testBitOperators", "a & b ^ c | d ^ e & f",
+                "(| (^ (& (id a) (id b)) (id c)) (^ (id d) (& (id e) (id f))))"),
+            makeExpressionTest("testLogicalOperators", "a && b || c && d | e",
+                "(|| (&& (id a) (id b)) (&& (id c) (| (id d) (id e))))"),
+            makeExpressionTest("testAssignmentOperators", "a *= b /= c %= d += e -= f <<= g >>= h &= i ^= j |= k = l || m",
+                "(*= (id a) (/= (id b) (%= (id c) (+= (id d) (-= (id e) (<<= (id f) (>>= (id g) (&= (id h) (^= (id i) (|= (id j) (= (id k) (|| (id l) (id m)))))))))))))"),
+            makeExpressionTest("testCommaInArguments", "f(a, (b, c), d ? e, g : h)",
+                "(call (id f) (id a) (, (id b) (id c)) (?: (id d) (, (id e) (id g)) (id h)))"),
+            makeExpressionTest("testCommaLoosest", "a || b, c = d ? e : f",
+                "(, (|| (id a) (id b)) (= (id c) (?: (id d) (id e) (id f))))"),
+            UnitTest::makeSimpleTest("testLevelEntryPoints", testLevelEntryPoints),
+            makeExpressionTest("testConditional", "a ? b : c ? d : e",
+                "(?: (id a) (id b) (?: (id c) (id d) (id e)))"),
+            makeExpressionTest("testConditionalAssign", "x = a ? b, c : d",
+                "(= (id x) (?: (id a) (, (id b) (id c)) (id d)))"),
+            makeExpressionTest("testComma", "a, b = c, d", "(, (, (id a) (= (id b) (id c))) (id d))"),
+            makeExpressionTest("testUnary", "-a * !b + ~*p++",
+                "(+ (* (- (id a)) (! (id b))) (~ (* (post++ (id p)))))"),
+            makeExpressionTest("testPostfix", "x[a + b](c, d = e).f->g--",
+                "(post-- (-> (. (call ([] (id x) (+ (id a) (id b))) (id c) (= (id d) (id e))) f) g))"),
+            makeExpressionTest("testCast", "(int)-a * (b)[c]", "(* (cast (- (id a))) ([] (id b) (id c)))"),
+            makeExpressionTest("testSizeof", "sizeof (int) + sizeof a + sizeof (b)[c]",
+                "(+ (+ (sizeof-type) (sizeof (id a))) (sizeof ([] (id b) (id c))))"),
+            makeExpressionTest("testPreIncrParenthesis", "++(a)[b]", "(++ ([] (id a) (id b)))"),
+            makeExpressionTest("testLiterals", "1 + 2.5 * c", "(+ (int 1) (* (float 2.5) (id c)))"),
+            makeFoldingTest("testFoldPartial", "4*1024*sizeof(x)+OFFSET-1",
+                "(- (+ (* (int 4096) (sizeof (id x))) (id OFFSET)) (int 1))"),
+            makeFoldingTest("testFoldArithmetic", "(1 + 2) * 3 - 4 / 2 % 3", "(int 7)"),
+            makeFoldingTest("testFoldUsualConversions", "-1 < 0u", "(int 0)"),
+            makeFoldingTest("testFoldUnsignedWrap", "0xffffffff + 1", "(int 0u)"),
+            makeFoldingTest("testFoldSignedOverflow", "2147483647 + 1", "(+ (int 2147483647) (int 1))"),
+            makeFoldingTest("testFoldLongLiteral", "2147483647 + 1l + -2147483648", "(int 0l)"),
+            makeFoldingTest("testFoldDivByZero", "1 / 0 + 1 % 0", "(+ (/ (int 1) (int 0)) (% (int 1) (int 0)))"),
+            makeFoldingTest("testFoldShifts", "(1u << 31) + (-8 >> 1) + (1 << 32) + (1 << 31)",
+                "(+ (+ (int 2147483644u) (<< (int 1) (int 32))) (<< (int 1) (int 31)))"),
+            makeFoldingTest("testFoldCasts", "(int)300.7 + (int)3.9 + (int)-2.5", "(int 301)"),
+            makeFoldingTest("testFoldCastOverflow", "(int)1e10", "(cast (float 1e+10))"),
+            makeFoldingTest("testFoldFloating", "1.5 * 2 + 1 / 2.0f", "(float 3.5)"),
+            makeFoldingTest("testFoldFloatDivByZero", "1.0 / 0", "(/ (float 1) (int 0))"),
+            makeFoldingTest("testFoldFloatType", "1 / 4.0f", "(float 0.25f)"),
+            makeFoldingTest("testFoldLongDouble", "1.5L * 2 + (1.5 + 1.0l) + (int)2.0L", "(+ (+ (* (float 1.5l) (int 2)) (+ (float 1.5) (float 1l))) (cast (float 2l)))"),
+            makeFoldingTest("testFoldLogical", "!0 + ~0 + (5 && 0.0) + (0 || 2)", "(int 1)"),
+            makeFoldingTest("testFoldCond", "1 ? 2 : 3.0", "(float 2)"),
+            makeFoldingTest("testFoldInAssign", "a = 2 * 3", "(= (id a) (int 6))"),
+            UnitTest::makeSimpleTest("testFoldNarrowTypes", testFoldNarrowTypes),
+            UnitTest::makeSimpleTest("testFoldingStatistics", testFoldingStatistics),
+            UnitTest::makeSimpleTest("testDeepNesting", testDeepNesting),
+            UnitTest::makeSimpleTest("testExplicitStackSameTree", testExplicitStackSameTree),
+            UnitTest::makeSimpleTest("testExplicitStackSmallThread", testExplicitStackSmallThread),
+            UnitTest::makeSimpleTest("testContextArena", testContextArena),
+            UnitTest::makeSimpleTest("testTypeUniquing", testTypeUniquing),
+            UnitTest::makeSimpleTest("testFlatIR", testFlatIR),
+            UnitTest::makeSimpleTest("testAssociativeChain", testAssociativeChain),
+            UnitTest::makeSimpleTest("testChainFolding", testChainFolding),
+            UnitTest::makeSimpleTest("testStructuralHash", testStructuralHash),
+            UnitTest::makeSimpleTest("testHashConsing", testHashConsing),
+            UnitTest::makeSimpleTest("testVisitors", testVisitors),
+            UnitTest::makeSimpleTest("testIRImage", testIRImage),
+            UnitTest::makeSimpleTest("testIRImageRecords", testIRImageRecords),
+            UnitTest::makeSimpleTest("testSyntaxChecker", testSyntaxChecker),
+            UnitTest::makeSimpleTest("testSymbolTable", testSymbolTable),
+            UnitTest::makeSimpleTest("testTypedefNames", testTypedefNames),
+            UnitTest::makeSimpleTest("testTypeNames", testTypeNames),
+            UnitTest::makeSimpleTest("testDeclarationSpecifiers", testDeclarationSpecifiers),
+            UnitTest::makeSimpleTest("testRecordLayout", testRecordLayout),
+            UnitTest::makeSimpleTest("testConstantEvaluator", testConstantEvaluator),
+            UnitTest::makeSimpleTest("testPrecompiledHeader", testPrecompiledHeader)
+        }
+    );
+}
+
+/**
+ * Just run the unit tests
+ */
+int main()
+{
+    return buildExpressionUnitTests()->runTest();
+}
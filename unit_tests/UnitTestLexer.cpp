@@ -191,6 +191,76 @@ void testC90OtherKeywords()
     UnitTest::assertTrue("Test sizeof", c90Lexer.nextToken()->getKind() == LexerToken::SIZEOF);
 }
 
+/**
+ * Integer and floating constants
+ */
+void testC90Numbers()
+{
+    std::shared_ptr<CharReader> myReader = std::make_shared<MyCharReader>("42 0 017 0x1fUL 10u 7l 4294967296 1.5 2e3 .5 3.f 1e-2L .25e1f s.x");
+    std::shared_ptr<UnitTestMessage> myMessage = std::make_shared<UnitTestMessage>();
+    myMessage->resetError();
+    C90Lexer c90Lexer(myReader, myMessage);
+
+    auto checkInt = [&](const std::string& testStr, uint64_t value, bool isUnsigned, bool isLong, bool isDecimal) {
+        LexerTokenPtr token = c90Lexer.nextToken();
+        UnitTest::assertEquals(testStr + " kind", token->getKind(), LexerToken::INTEGER_LITERAL);
+        const IntLiteralToken* intToken = static_cast<const IntLiteralToken *>(token.get());
+        UnitTest::assertEquals(testStr + " value", intToken->getValue(), value);
+        UnitTest::assertEquals(testStr + " unsigned", intToken->isUnsigned(), isUnsigned);
+        UnitTest::assertEquals(testStr + " long", intToken->isLong(), isLong);
+        UnitTest::assertEquals(testStr + " decimal", intToken->isDecimal(), isDecimal);
+    };
+
+    auto checkFloat = [&](const std::string& testStr, double value, FloatLiteralToken::Suffix suffix) {
+        LexerTokenPtr token = c90Lexer.nextToken();
+        UnitTest::assertEquals(testStr + " kind", token->getKind(), LexerToken::FLOAT_LITERAL);
+        const FloatLiteralToken* floatToken = static_cast<const FloatLiteralToken *>(token.get());
+        UnitTest::assertEquals(testStr + " value", floatToken->getValue(), value);
+        UnitTest::assertEquals(testStr + " suffix", floatToken->getSuffix(), suffix);
+    };
+
+    checkInt("Test 42", 42, false, false, true);
+    checkInt("Test 0", 0, false, false, true);
+    checkInt("Test 017", 15, false, false, false);
+    checkInt("Test 0x1fUL", 31, true, true, false);
+    checkInt("Test 10u", 10, true, false, true);
+    checkInt("Test 7l", 7, false, true, true);
+    checkInt("Test 4294967296", UINT64_C(4294967296), false, false, true);
+    checkFloat("Test 1.5", 1.5, FloatLiteralToken::NO_SUFFIX);
+    checkFloat("Test 2e3", 2000.0, FloatLiteralToken::NO_SUFFIX);
+
+    checkFloat("Test .5", 0.5, FloatLiteralToken::NO_SUFFIX);
+
+    checkFloat("Test 3.f", 3.0, FloatLiteralToken::FLOAT_SUFFIX);
+    checkFloat("Test 1e-2L", 1e-2, FloatLiteralToken::LONG_SUFFIX);
+    checkFloat("Test .25e1f", 2.5, FloatLiteralToken::FLOAT_SUFFIX);
+
+    // A dot followed by a letter is still an operator
+    //
+    UnitTest::assertEquals("Test s", c90Lexer.nextToken()->getKind(), LexerToken::IDENTIFIER);
+    UnitTest::assertEquals("Test dot", c90Lexer.nextToken()->getKind(), LexerToken::DOT);
+    UnitTest::assertEquals("Test x", c90Lexer.nextToken()->getKind(), LexerToken::IDENTIFIER);
+    UnitTest::assertFalse("Test no error", myMessage->anyError());
+    UnitTest::assertEquals("Test end", c90Lexer.nextToken()->getKind(), LexerToken::END_OF_FILE);
+}
+
+/**
+ * Malformed constants
+ */
+void testC90InvalidNumbers()
+{
+    const char* const sources[] = {"08", "0x", "1e", "12lul", "1.5u", "99999999999999999999"};
+    for( const char* source : sources ) {
+        std::shared_ptr<UnitTestMessage> myMessage = std::make_shared<UnitTestMessage>();
+        myMessage->resetError();
+        C90Lexer c90Lexer(std::make_shared<MyCharReader>(source), myMessage);
+
+        LexerTokenPtr token = c90Lexer.nextToken();
+        UnitTest::assertTrue(std::string("Test error ") + source, myMessage->anyError());
+        UnitTest::assertEquals(std::string("Test end ") + source, c90Lexer.nextToken()->getKind(), LexerToken::END_OF_FILE);
+    }
+}
+
 /**
  * Make lexer unit tests.  Pass a test name, the string to read, the list of assert strings + expected tokens
  */
@@ -245,6 +315,8 @@ UnitTest::TestPtr buildLexerUnitTests()
             UnitTest::makeSimpleTest("basicC90InterfaceTests", basicC90InterfaceTests),
             UnitTest::makeSimpleTest("testC90TypeKeywords", testC90TypeKeywords),
             UnitTest::makeSimpleTest("testC90OtherKeywords", testC90OtherKeywords),
+            UnitTest::makeSimpleTest("testC90Numbers", testC90Numbers),
+            UnitTest::makeSimpleTest("testC90InvalidNumbers", testC90InvalidNumbers),
             makeLexerUnitTest(
                 "testC90AssignOps", 
                 "= += -= *= /= %= &= |= ^= <<= >>=",
@@ -296,11 +368,11 @@ UnitTest::TestPtr buildLexerUnitTests()
             ),
             makeLexerUnitTest(
                 "testC90MemberOtherOps",
-                "( ) , ? : ...",
-                {"Test (", "Test )", "Test ,", "Test ?", "Test :", "Test ..."},
+                "( ) , ? : ...)",
+                {"Test (", "Test )", "Test ,", "Test ?", "Test :", "Test ...", "Test ) after ..."},
                 {LexerToken::LEFT_PARAR, LexerToken::RIGHT_PARAR, 
                     LexerToken::COMMA, LexerToken::QUESTION_MARK,
-                    LexerToken::COLON, LexerToken::DOT_DOT_DOT}
+                    LexerToken::COLON, LexerToken::DOT_DOT_DOT, LexerToken::RIGHT_PARAR}
             )
         }
     );
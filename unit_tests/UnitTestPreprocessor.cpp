@@ -6,8 +6,18 @@
 //
 
 #include "C90Preprocess.hpp"
+#include "PPMacro.hpp"
+#include "PPParser.hpp"
 #include "UnitTest.hpp"
 #include "UnitTestMessage.hpp"
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
 
 
 /**
@@ -33,7 +43,7 @@ UnitTest::TestPtr makeTrigraphSuccessTest(const char* testName, char origChar, c
 
         PreprocessorPhases().convertNewlinesAndTrigraphs(source, target, msg);
 
-        UnitTest::assertEquals("Test size", target.size(), 2);
+        UnitTest::assertEquals("Test size", target.size(), 2u);
         UnitTest::assertEquals("CheckStr1", target[0].getStream(), newExpectedString1);
         UnitTest::assertEquals("CheckStr2", target[1].getStream(), newExpectedString2);
         UnitTest::assertEquals("CheckFile1", target[0].getSourcePosition().getFilename(), filename);
@@ -65,7 +75,7 @@ void testReplaceLineFeedNewlines()
     auto msg = std::make_shared<UnitTestMessage>();
     PreprocessorPhases().convertNewlinesAndTrigraphs(source, target, msg);
 
-    UnitTest::assertEquals("Test size", target.size(), 1);
+    UnitTest::assertEquals("Test size", target.size(), 1u);
     UnitTest::assertEquals("CheckStr1", target[0].getStream(), "a \n");
     UnitTest::assertEquals("CheckFile1", target[0].getSourcePosition().getFilename(), filename);
     UnitTest::assertEquals("CheckLine1", target[0].getSourcePosition().getLineNumber(), 1);
@@ -94,7 +104,7 @@ UnitTest::TestPtr makeTestUnrecognizedCharacters(const char* testName, char theC
 
         //std::cout << "target: " << target.size() << std::endl;
 
-        UnitTest::assertEquals("Test size", target.size(), 2);
+        UnitTest::assertEquals("Test size", target.size(), 2u);
         UnitTest::assertEquals("CheckStr1", target[0].getStream(), "a ");
         UnitTest::assertEquals("CheckStr2", target[1].getStream(), " b");
         UnitTest::assertEquals("CheckFile1", target[0].getSourcePosition().getFilename(), filename);
@@ -130,7 +140,7 @@ void testNonTrigraphs()
     auto msg = std::make_shared<UnitTestMessage>();
     PreprocessorPhases().convertNewlinesAndTrigraphs(source, target, msg);
 
-    UnitTest::assertEquals("Test size", target.size(), 5);
+    UnitTest::assertEquals("Test size", target.size(), 5u);
     UnitTest::assertEquals("CheckStr1", target[0].getStream(), "a ??? \n");
     UnitTest::assertEquals("CheckStr2", target[1].getStream(), "b ??");
     UnitTest::assertEquals("CheckStr3", target[2].getStream(), " \n");
@@ -185,7 +195,7 @@ void testSimplePhase2()
     source.push_back(CharacterStream("c\n", SourcePosition(filename, 3, 1)));
 
     PreprocessorPhases().removeEndOfLineBacklashes(source, target);
-    UnitTest::assertEquals("test size", target.size(), 3);
+    UnitTest::assertEquals("test size", target.size(), 3u);
     UnitTest::assertEquals("test str1", target[0].getStream(), "a \n");
     UnitTest::assertEquals("test str2", target[1].getStream(), "b ");
     UnitTest::assertEquals("test str3", target[2].getStream(), "c\n");
@@ -218,7 +228,7 @@ void testPhase2CornerCases()
     source.push_back(CharacterStream("c \\", SourcePosition(filename, 3, 1)));
 
     PreprocessorPhases().removeEndOfLineBacklashes(source, target);
-    UnitTest::assertEquals("test size", target.size(), 3);
+    UnitTest::assertEquals("test size", target.size(), 3u);
     UnitTest::assertEquals("test str1", target[0].getStream(), "a \\");
     UnitTest::assertEquals("test str2", target[1].getStream(), "b ");
     UnitTest::assertEquals("test str3", target[2].getStream(), "c \\");
@@ -240,6 +250,886 @@ UnitTest::TestPtr makePhase2UnitTests()
 }
 
 
+/**
+ * Spellings of the tokens, separated by spaces, without the END_OF_FILE
+ */
+std::string spellTokens(const PPSource& source, const PPTokenList& tokens)
+{
+    std::string result;
+    for( const PPToken& token : tokens ) {
+        if( token.getKind() != PPToken::END_OF_FILE ) {
+            result += (result.empty() ? "" : " ") + token.getSpelling(source);
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Make a unit test for the pp-tokens of a source
+ */
+UnitTest::TestPtr makePPTokensTest(const char* testName, const std::string& text, const std::string& expectedSpellings)
+{
+    auto theFunc = [=]() {
+        auto msg = std::make_shared<UnitTestMessage>();
+        msg->resetError();
+        PPSource source(text, std::make_shared<std::string>("myfile.c"));
+        PPTokenList tokens;
+        preprocessorParser(source, msg, tokens);
+
+        UnitTest::assertEquals("Check spellings", spellTokens(source, tokens), expectedSpellings);
+        UnitTest::assertEquals("Check end", tokens.back().getKind(), PPToken::END_OF_FILE);
+        UnitTest::assertFalse("Check any error", msg->anyError());
+    };
+
+    return UnitTest::makeSimpleTest(testName, theFunc);
+}
+
+/**
+ * Kinds, punctuators and flags of the tokens
+ */
+void testPPTokenKinds()
+{
+    auto msg = std::make_shared<UnitTestMessage>();
+    msg->resetError();
+    PPSource source("#define x(a) a##1 /* comment\n */ L'c'\n  \"s\" @ 1.5e+3;", std::make_shared<std::string>("myfile.c"));
+    PPTokenList tokens;
+    preprocessorParser(source, msg, tokens);
+
+    UnitTest::assertEquals("Check size", tokens.size(), 15u);
+    UnitTest::assertEquals("Check hash", tokens[0].getPunctuator(), LexerToken::HASH);
+    UnitTest::assertTrue("Check start of line", tokens[0].isStartOfLine());
+    UnitTest::assertEquals("Check define", tokens[1].getKind(), PPToken::IDENTIFIER);
+    UnitTest::assertFalse("Check no space", tokens[1].hasLeadingSpace());
+    UnitTest::assertFalse("Check no space before (", tokens[3].hasLeadingSpace());
+    UnitTest::assertEquals("Check paste", tokens[7].getPunctuator(), LexerToken::HASH_HASH);
+    UnitTest::assertEquals("Check number", tokens[8].getKind(), PPToken::PP_NUMBER);
+
+    // A comment with a newline is a space, not a new line
+    //
+    UnitTest::assertEquals("Check wide char", tokens[9].getKind(), PPToken::CHAR_CONSTANT);
+    UnitTest::assertTrue("Check comment space", tokens[9].hasLeadingSpace());
+    UnitTest::assertFalse("Check comment line", tokens[9].isStartOfLine());
+
+    UnitTest::assertEquals("Check string", tokens[10].getKind(), PPToken::STRING_LITERAL);
+    UnitTest::assertTrue("Check line", tokens[10].isStartOfLine());
+    UnitTest::assertTrue("Check indentation", tokens[10].hasLeadingSpace());
+    UnitTest::assertEquals("Check other", tokens[11].getKind(), PPToken::OTHER);
+    UnitTest::assertEquals("Check float", tokens[12].getSpelling(source), "1.5e+3");
+    UnitTest::assertEquals("Check semicolon", tokens[13].getPunctuator(), LexerToken::SEMICOLON);
+    UnitTest::assertFalse("Check any error", msg->anyError());
+
+    UnitTest::assertTrue("Check compact", sizeof(PPToken) <= 12);
+}
+
+/**
+ * Source positions of the tokens, through phases 1 and 2
+ */
+void testPPTokenPositions()
+{
+    auto filename = std::make_shared<std::string>("myfile2.c");
+    CharacterStreamList source;
+    CharacterStreamList phase1;
+    CharacterStreamList phase2;
+    auto msg = std::make_shared<UnitTestMessage>();
+
+    source.push_back(CharacterStream("a ?\?= b\n", SourcePosition(filename, 1, 1)));
+    source.push_back(CharacterStream("c \\\n", SourcePosition(filename, 2, 1)));
+    source.push_back(CharacterStream("d\n  e", SourcePosition(filename, 3, 1)));
+    PreprocessorPhases().convertNewlinesAndTrigraphs(source, phase1, msg);
+    PreprocessorPhases().removeEndOfLineBacklashes(phase1, phase2);
+
+    PPSource ppSource(phase2);
+    PPTokenList tokens;
+    msg->resetError();
+    preprocessorParser(ppSource, msg, tokens);
+
+    UnitTest::assertEquals("Check spellings", spellTokens(ppSource, tokens), "a # b c d e");
+    UnitTest::assertTrue("Check spliced line", !tokens[4].isStartOfLine());
+
+    SourcePosition positionB = ppSource.getSourcePosition(tokens[2].getOffset());
+    UnitTest::assertEquals("Check line b", positionB.getLineNumber(), 1);
+    UnitTest::assertEquals("Check column b", positionB.getColumnNumber(), 7);
+
+    SourcePosition positionE = ppSource.getSourcePosition(tokens[5].getOffset());
+    UnitTest::assertEquals("Check line e", positionE.getLineNumber(), 4);
+    UnitTest::assertEquals("Check column e", positionE.getColumnNumber(), 3);
+    UnitTest::assertEquals("Check file e", positionE.getFilename(), filename);
+}
+
+/**
+ * Unterminated comments and literals
+ */
+void testPPTokenErrors()
+{
+    auto msg = std::make_shared<UnitTestMessage>();
+    for( const char* text : {"a /* b", "'a\nb", "\"a\\\"" } ) {
+        msg->resetError();
+        PPSource source(text, std::make_shared<std::string>("myfile.c"));
+        PPTokenList tokens;
+        preprocessorParser(source, msg, tokens);
+
+        UnitTest::assertTrue(std::string("Check error: ") + text, msg->anyError());
+        UnitTest::assertEquals(std::string("Check end: ") + text, tokens.back().getKind(), PPToken::END_OF_FILE);
+    }
+
+    UnitTest::assertEquals("Check message", msg->getMessage(), Message::ERROR_UNTERMINATED_LITERAL);
+}
+
+/**
+ * Unit tests for phase 3 of translation
+ */
+UnitTest::TestPtr makePhase3UnitTests()
+{
+    return UnitTest::makeMultipleTest(
+        "Phase 3 translation unit tests",
+        {
+            makePPTokensTest("Test maximal munch", "a+++++b<<=c...d..e->f", "a ++ ++ + b <<= c ... d . . e -> f"),
+            makePPTokensTest("Test pp-numbers", "0x1e+2 1.2.3 .5f 12ul e+1", "0x1e+2 1.2.3 .5f 12ul e + 1"),
+            makePPTokensTest("Test literals", "\"a\\\"b\" '\\'' L\"w\" Lx", "\"a\\\"b\" '\\'' L\"w\" Lx"),
+            makePPTokensTest("Test comments", "a/**/b/* * / */c", "a b c"),
+            makePPTokensTest("Test empty", " \n\t/* */\n", ""),
+            UnitTest::makeSimpleTest("Test kinds", testPPTokenKinds),
+            UnitTest::makeSimpleTest("Test positions", testPPTokenPositions),
+            UnitTest::makeSimpleTest("Test errors", testPPTokenErrors)
+        }
+    );
+}
+
+
+/**
+ * Spellings of the tokens of an expansion, separated by spaces
+ */
+std::string spellExpandedTokens(const PPExpandedTokenList& tokens)
+{
+    std::string result;
+    for( const PPExpandedToken& token : tokens ) {
+        result += (result.empty() ? "" : " ") + token.getSpelling();
+    }
+
+    return result;
+}
+
+/**
+ * Phases 3 and 4 of a text.  The output refers to the source returned.
+ */
+std::shared_ptr<PPSource> preprocessText(C90Preprocessor& preprocessor, const std::string& text, PPExpandedTokenList& output)
+{
+    auto source = std::make_shared<PPSource>(text, std::make_shared<std::string>("myfile.c"));
+    preprocessor.preprocess(*source, output);
+    return source;
+}
+
+/**
+ * Make a unit test for the macro expansion of a text
+ */
+UnitTest::TestPtr makeMacroTest(const char* testName, const std::string& text, const std::string& expectedSpellings)
+{
+    auto theFunc = [=]() {
+        auto msg = std::make_shared<UnitTestMessage>();
+        msg->resetError();
+        C90Preprocessor preprocessor(msg);
+        PPExpandedTokenList output;
+        auto source = preprocessText(preprocessor, text, output);
+
+        UnitTest::assertEquals("Check spellings", spellExpandedTokens(output), expectedSpellings);
+        UnitTest::assertFalse("Check any error", msg->anyError());
+    };
+
+    return UnitTest::makeSimpleTest(testName, theFunc);
+}
+
+/**
+ * Errors of the directives and of the invocations
+ */
+void testMacroErrors()
+{
+    std::vector<std::pair<const char *, Message::Msg>> cases = {
+        {"#define F(a) a\nF(1, 2)", Message::ERROR_MACRO_ARG_COUNT},
+        {"#define F(a, b) a\nF()", Message::ERROR_MACRO_ARG_COUNT},
+        {"#define F(a) a\nF((1)", Message::ERROR_UNTERMINATED_MACRO_CALL},
+        {"#define F(a) a\n#define G F(\nG 1", Message::ERROR_UNTERMINATED_MACRO_CALL},
+        {"#define C(a, b) a ## b\nC(+, /)", Message::ERROR_INVALID_PASTE},
+        {"#define A 1\n#define A 2", Message::ERROR_MACRO_REDEFINED},
+        {"#define F(a) a\n#define F(b) b", Message::ERROR_MACRO_REDEFINED},
+        {"#define F(a, a) a", Message::ERROR_INVALID_DIRECTIVE},
+        {"#define F(a, ) a", Message::ERROR_INVALID_DIRECTIVE},
+        {"#define S(a) #b", Message::ERROR_INVALID_DIRECTIVE},
+        {"#define P ## a", Message::ERROR_INVALID_DIRECTIVE},
+        {"#define 1", Message::ERROR_INVALID_DIRECTIVE},
+        {"#undef", Message::ERROR_INVALID_DIRECTIVE},
+        {"#foo", Message::ERROR_INVALID_DIRECTIVE}
+    };
+
+    for( auto& errorCase : cases ) {
+        auto msg = std::make_shared<UnitTestMessage>();
+        msg->resetError();
+        C90Preprocessor preprocessor(msg);
+        PPExpandedTokenList output;
+        auto source = preprocessText(preprocessor, errorCase.first, output);
+
+        UnitTest::assertTrue(std::string("Check error: ") + errorCase.first, msg->anyError());
+        UnitTest::assertEquals(std::string("Check message: ") + errorCase.first, msg->getMessage(), errorCase.second);
+    }
+}
+
+/**
+ * Invocations nested deeply: the arguments are collected without reading the
+ * inner invocations at each level
+ */
+void testDeepMacroNesting()
+{
+    const size_t depth = 2000;
+    std::string text = "#define X(a) a\n";
+    for( size_t i = 0; i < depth; ++i ) {
+        text += "X(";
+    }
+    text += "1";
+    text += std::string(depth, ')');
+
+    auto msg = std::make_shared<UnitTestMessage>();
+    msg->resetError();
+    C90Preprocessor preprocessor(msg);
+    PPExpandedTokenList output;
+    auto source = preprocessText(preprocessor, text, output);
+
+    const PPMacroExpander::Statistics& statistics = preprocessor.getMacroExpander().getStatistics();
+    UnitTest::assertEquals("Check spellings", spellExpandedTokens(output), "1");
+    UnitTest::assertEquals("Check expansions", statistics.nbExpansions, depth);
+    UnitTest::assertTrue("Check tokens read", statistics.nbTokensRead < 10 * depth);
+    UnitTest::assertFalse("Check any error", msg->anyError());
+}
+
+/**
+ * Large X-macro table, and the reuse of the buffers and of the hidesets
+ */
+void testXMacroTable()
+{
+    const size_t nbEntries = 5000;
+    std::string text = "#define TABLE";
+    std::string expected;
+    for( size_t i = 0; i < nbEntries; ++i ) {
+        text += " E(n" + std::to_string(i) + ")";
+        expected += (i == 0 ? "n" : " n") + std::to_string(i) + " ,";
+    }
+    text += "\n#define E(n) n,\nTABLE\n#undef E\n#define E(n) case n:\nTABLE";
+
+    auto msg = std::make_shared<UnitTestMessage>();
+    msg->resetError();
+    C90Preprocessor preprocessor(msg);
+    PPExpandedTokenList output;
+    auto source = preprocessText(preprocessor, text, output);
+
+    const PPMacroExpander& expander = preprocessor.getMacroExpander();
+    UnitTest::assertEquals("Check size", output.size(), 5 * nbEntries);
+    UnitTest::assertEquals("Check table", spellExpandedTokens(PPExpandedTokenList(output.begin(), output.begin() + 2 * nbEntries)), expected);
+    UnitTest::assertEquals("Check case", output[2 * nbEntries + 3].getSpelling(), "case");
+    UnitTest::assertEquals("Check expansions", expander.getStatistics().nbExpansions, 2 * nbEntries + 2);
+    UnitTest::assertTrue("Check buffers", expander.getStatistics().nbBuffersCreated < 10);
+    UnitTest::assertTrue("Check hidesets", expander.getNbHidesets() < 10);
+    UnitTest::assertEquals("Check macros", preprocessor.getMacroTable()->getNbMacros(), 2u);
+    UnitTest::assertFalse("Check any error", msg->anyError());
+}
+
+/**
+ * Lines written by the preprocessor, with their source positions
+ */
+void testPreprocessorLines()
+{
+    auto filename = std::make_shared<std::string>("myfile3.c");
+    CharacterStreamList source;
+    CharacterStreamList output;
+    auto msg = std::make_shared<UnitTestMessage>();
+    msg->resetError();
+
+    source.push_back(CharacterStream("#define A(x) x + \\\n", SourcePosition(filename, 1, 1)));
+    source.push_back(CharacterStream("   1\n", SourcePosition(filename, 2, 1)));
+    source.push_back(CharacterStream("int i = A(2);\n", SourcePosition(filename, 3, 1)));
+    source.push_back(CharacterStream("  j = A\n(i) ;\n", SourcePosition(filename, 4, 1)));
+    C90Preprocessor(msg).doPreprocessor(source, output);
+
+    UnitTest::assertEquals("Check size", output.size(), 2u);
+    UnitTest::assertEquals("Check line 1", output[0].getStream(), "int i = 2 + 1;\n");
+    UnitTest::assertEquals("Check position 1", output[0].getSourcePosition().getLineNumber(), 3);
+    UnitTest::assertEquals("Check line 2", output[1].getStream(), "j = i + 1 ;\n");
+    UnitTest::assertEquals("Check position 2", output[1].getSourcePosition().getLineNumber(), 4);
+    UnitTest::assertEquals("Check column 2", output[1].getSourcePosition().getColumnNumber(), 3);
+    UnitTest::assertFalse("Check any error", msg->anyError());
+}
+
+/**
+ * Unit tests for phase 4 of translation: macro expansion
+ */
+UnitTest::TestPtr makeMacroUnitTests()
+{
+    return UnitTest::makeMultipleTest(
+        "Macro expansion unit tests",
+        {
+            makeMacroTest("Test object-like", "#define N 10\n#define M N+N\nM N x\n#undef N\nM", "10 + 10 10 x N + N"),
+            makeMacroTest("Test function-like", "#define F(a, b) a * b\n#define G() g\nF(1+2, (3,4)) F ; G() F\n(x,y)", "1 + 2 * ( 3 , 4 ) F ; g x * y"),
+            makeMacroTest("Test # and ##", "#define STR(a) #a\n#define CAT(a, b) a ## b\nSTR( x  \"y\\n\"  'z' ) CAT(x, 1) CAT(, y) CAT(z, ) CAT(+, =) STR()",
+                "\"x \\\"y\\\\n\\\" 'z'\" x1 y z += \"\""),
+            makeMacroTest("Test ## with empty operands",
+                "#define F(x, y) a x ## y\n#define G(x, y, z) x ## y ## z\nF(, b) F(b, ) F(,) G(, , c) G(a, , c) G(, b, ) G(a, b, c)",
+                "a b a b a c ac b abc"),
+            makeMacroTest("Test recursion", "#define foo foo a\n#define f(x) f(x) + 1\n#define p q\n#define q p\nfoo f(f(2)) p q",
+                "foo a f ( f ( 2 ) + 1 ) + 1 p q"),
+            makeMacroTest("Test same definition", "#define A 1 + 2\n#define A 1 /* */ + 2\nA", "1 + 2"),
+            makeMacroTest("Test C90 example",
+                "#define x 3\n#define f(a) f(x * (a))\n#undef x\n#define x 2\n#define g f\n#define z z[0]\n#define h g(~\n"
+                "#define m(a) a(w)\n#define w 0,1\n#define t(a) a\n"
+                "f(y+1) + f(f(z)) % t(t(g)(0) + t)(1);\ng(x+(3,4)-w) | h 5) & m\n     (f)^m(m);",
+                "f ( 2 * ( y + 1 ) ) + f ( 2 * ( f ( 2 * ( z [ 0 ] ) ) ) ) % f ( 2 * ( 0 ) ) + t ( 1 ) ; "
+                "f ( 2 * ( 2 + ( 3 , 4 ) - 0 , 1 ) ) | f ( 2 * ( ~ 5 ) ) & f ( 2 * ( 0 , 1 ) ) ^ m ( 0 , 1 ) ;"),
+            UnitTest::makeSimpleTest("Test errors", testMacroErrors),
+            UnitTest::makeSimpleTest("Test deep nesting", testDeepMacroNesting),
+            UnitTest::makeSimpleTest("Test X-macro table", testXMacroTable),
+            UnitTest::makeSimpleTest("Test lines", testPreprocessorLines)
+        }
+    );
+}
+
+
+/**
+ * Write a file for the include tests
+ */
+void writeTestFile(const std::string& fileName, const std::string& text)
+{
+    std::ofstream file(fileName, std::ios::trunc);
+    file << text;
+}
+
+/**
+ * Include guards and #pragma once: the files are read once, even through other
+ * paths, while their guard is defined
+ */
+void testIncludeGuards()
+{
+    writeTestFile("UnitTestPP_guard.h", "/* guard */\n#ifndef GUARD_H\n#define GUARD_H\ng\n#endif /* GUARD_H */\n\n");
+    writeTestFile("UnitTestPP_defined.h", "#if !defined(DEFINED_H)\n#define DEFINED_H\nd\n#endif\n");
+    writeTestFile("UnitTestPP_once.h", "#pragma once\no\n");
+    writeTestFile("UnitTestPP_plain.h", "p\n");
+    writeTestFile("UnitTestPP_after.h", "#ifndef AFTER_H\n#define AFTER_H\n#endif\na\n");
+    writeTestFile("UnitTestPP_else.h", "#ifndef ELSE_H\n#define ELSE_H\n#else\ne\n#endif\n");
+
+    auto msg = std::make_shared<UnitTestMessage>();
+    msg->resetError();
+    C90Preprocessor preprocessor(msg);
+    PPExpandedTokenList output;
+    auto source = preprocessText(preprocessor,
+        "#include \"UnitTestPP_guard.h\"\n#include \"./UnitTestPP_guard.h\"\n"
+        "#include \"UnitTestPP_defined.h\"\n#include \"UnitTestPP_defined.h\"\n"
+        "#define ONCE \"UnitTestPP_once.h\"\n#include ONCE\n#include ONCE\n"
+        "#include \"UnitTestPP_plain.h\"\n#include \"UnitTestPP_plain.h\"\n"
+        "#include \"UnitTestPP_after.h\"\n#include \"UnitTestPP_after.h\"\n"
+        "#include \"UnitTestPP_else.h\"\n#include \"UnitTestPP_else.h\"\n"
+        "#undef GUARD_H\n#include \"UnitTestPP_guard.h\"\nend",
+        output);
+
+    UnitTest::assertEquals("Check spellings", spellExpandedTokens(output), "g d o p p a a e g end");
+    UnitTest::assertEquals("Check includes", preprocessor.getNbIncludes(), 10u);
+    UnitTest::assertEquals("Check skipped", preprocessor.getNbSkippedIncludes(), 3u);
+    UnitTest::assertEquals("Check guarded files", preprocessor.getIncludeGuards().getNbGuardedFiles(), 3u);
+    UnitTest::assertFalse("Check any error", msg->anyError());
+
+    for( const char* fileName : {"UnitTestPP_guard.h", "UnitTestPP_defined.h", "UnitTestPP_once.h", "UnitTestPP_plain.h",
+                                 "UnitTestPP_after.h", "UnitTestPP_else.h"} ) {
+        std::remove(fileName);
+    }
+}
+
+/**
+ * Lines of the included files, with their positions
+ */
+void testIncludeLines()
+{
+    writeTestFile("UnitTestPP_lines.h", "#define ONE 1\n\nint one = ONE;\n");
+
+    auto filename = std::make_shared<std::string>("myfile4.c");
+    CharacterStreamList source;
+    CharacterStreamList output;
+    auto msg = std::make_shared<UnitTestMessage>();
+    msg->resetError();
+
+    source.push_back(CharacterStream("#include <UnitTestPP_lines.h>\n", SourcePosition(filename, 1, 1)));
+    source.push_back(CharacterStream("int two = ONE + ONE;\n", SourcePosition(filename, 2, 1)));
+    C90Preprocessor preprocessor(msg);
+    preprocessor.addIncludePath(".");
+    preprocessor.doPreprocessor(source, output);
+
+    UnitTest::assertEquals("Check size", output.size(), 2u);
+    UnitTest::assertEquals("Check line 1", output[0].getStream(), "int one = 1;\n");
+    UnitTest::assertEquals("Check file 1", *output[0].getSourcePosition().getFilename(), "./UnitTestPP_lines.h");
+    UnitTest::assertEquals("Check position 1", output[0].getSourcePosition().getLineNumber(), 3);
+    UnitTest::assertEquals("Check line 2", output[1].getStream(), "int two = 1 + 1;\n");
+    UnitTest::assertEquals("Check file 2", output[1].getSourcePosition().getFilename(), filename);
+    UnitTest::assertFalse("Check any error", msg->anyError());
+
+    std::remove("UnitTestPP_lines.h");
+}
+
+/**
+ * Dependency scan: the directives are executed, the text is skipped, and each
+ * included file is listed once.  Included files needing phases 1 and 2 are
+ * converted.
+ */
+void testDependencyScan()
+{
+    writeTestFile("UnitTestPP_dep_a.h", "#ifndef DEP_A\n#define DEP_A\nconst char* s = \"/*\";\n#include \"UnitTestPP_dep_b.h\"\n#endif\n");
+    writeTestFile("UnitTestPP_dep_b.h", "#pragma once\nint b = 'b'; /* #include \"UnitTestPP_dep_x.h\"\n */ #define FROM_X 1\n# define FROM_B 2\n");
+    writeTestFile("UnitTestPP_dep_c.h", "#define FROM_C \\\n 3\nc\n");
+    writeTestFile("UnitTestPP_dep_d.h", "d\n");
+
+    const char* text =
+        "#include \"UnitTestPP_dep_a.h\"\nint x; #include \"UnitTestPP_dep_x.h\"\n#include \"UnitTestPP_dep_a.h\"\n"
+        "#if FROM_B == 2\n#include \"UnitTestPP_dep_c.h\"\n#endif\n"
+        "#if FROM_C == 3\n#define DEP_D \"UnitTestPP_dep_d.h\"\n#else\n#include \"UnitTestPP_dep_x.h\"\n#endif\n"
+        "#include DEP_D\n#include \"./UnitTestPP_dep_d.h\"\nint y = FROM_C;\n";
+
+    auto msg = std::make_shared<UnitTestMessage>();
+    msg->resetError();
+    C90Preprocessor scanner(msg);
+    auto source = std::make_shared<PPSource>(text, std::make_shared<std::string>("myfile5.c"));
+    scanner.scanDependencies(*source);
+
+    std::vector<std::string> expected = {"UnitTestPP_dep_a.h", "UnitTestPP_dep_b.h", "UnitTestPP_dep_c.h", "UnitTestPP_dep_d.h"};
+    UnitTest::assertTrue("Check dependencies", scanner.getDependencies() == expected);
+    UnitTest::assertFalse("Check any error", msg->anyError());
+
+    C90Preprocessor preprocessor(msg);
+    PPExpandedTokenList output;
+    preprocessor.preprocess(*source, output);
+
+    UnitTest::assertEquals("Check spellings", spellExpandedTokens(output),
+        "const char * s = \"/*\" ; int b = 'b' ; # define FROM_X 1 int x ; # include \"UnitTestPP_dep_x.h\" c d d int y = 3 ;");
+    UnitTest::assertTrue("Check same dependencies", preprocessor.getDependencies() == expected);
+    UnitTest::assertTrue("Check lexed", scanner.getNbTokensLexed() < preprocessor.getNbTokensLexed());
+    UnitTest::assertFalse("Check any error", msg->anyError());
+
+    expected.insert(expected.begin(), "my file$.c");
+    UnitTest::assertEquals("Check rule", makeDependencyRule("my#file.o", expected),
+        "my\\#file.o: \\\n  my\\ file$$.c \\\n  UnitTestPP_dep_a.h \\\n  UnitTestPP_dep_b.h \\\n  UnitTestPP_dep_c.h \\\n  UnitTestPP_dep_d.h\n");
+
+    for( const char* fileName : {"UnitTestPP_dep_a.h", "UnitTestPP_dep_b.h", "UnitTestPP_dep_c.h", "UnitTestPP_dep_d.h"} ) {
+        std::remove(fileName);
+    }
+}
+
+/**
+ * Header search shared by translation units: the directories are listed once, the
+ * lookups are cached, the files not found too, until a directory changes
+ */
+void testHeaderSearch()
+{
+    const char* directories[] = {"UnitTestPP_dir1", "UnitTestPP_dir2", "UnitTestPP_dir3", "UnitTestPP_dir3/sys"};
+    for( const char* directory : directories ) {
+        ::mkdir(directory, 0755);
+    }
+    writeTestFile("UnitTestPP_dir3/a.h", "a\n");
+    writeTestFile("UnitTestPP_dir3/b.h", "#include \"sys/c.h\"\nb\n");
+    writeTestFile("UnitTestPP_dir3/sys/c.h", "c\n");
+
+    auto msg = std::make_shared<UnitTestMessage>();
+    msg->resetError();
+    auto headerSearch = std::make_shared<PPHeaderSearch>();
+    const size_t nbUnits = 20;
+    for( size_t i = 0; i < nbUnits; ++i ) {
+        C90Preprocessor preprocessor(msg, headerSearch);
+        preprocessor.addIncludePath("UnitTestPP_dir1");
+        preprocessor.addIncludePath("UnitTestPP_dir2/");
+        preprocessor.addIncludePath("UnitTestPP_dir3");
+        PPExpandedTokenList output;
+        auto source = preprocessText(preprocessor, "#include <a.h>\n#include <b.h>\n#include <sys/c.h>\n", output);
+        UnitTest::assertEquals("Check spellings", spellExpandedTokens(output), "a c b c");
+    }
+
+    // Without the cache, each lookup would stat each directory until it's found.
+    // With it, the first unit lists the 4 directories, checks that the 2 missing
+    // sys directories don't exist, and finds the 3 headers; the next ones only
+    // check the modification times of these 6 directories.
+    //
+    size_t nbLookups = nbUnits * (3 + 3 + 1 + 3);
+    const size_t nbDirectories = 6;
+    UnitTest::assertEquals("Check lookups", headerSearch->getNbLookups(), nbLookups);
+    UnitTest::assertEquals("Check hits", headerSearch->getNbHits(), nbLookups - 9);
+    UnitTest::assertEquals("Check system calls", headerSearch->getNbSystemCalls(), nbDirectories + 4 + 3 + (nbUnits - 1) * nbDirectories);
+    UnitTest::assertFalse("Check any error", msg->anyError());
+
+    // A header added in a directory searched first is found by the next unit,
+    // and a header removed is not found anymore
+    //
+    writeTestFile("UnitTestPP_dir1/a.h", "new_a\n");
+    std::remove("UnitTestPP_dir3/sys/c.h");
+    C90Preprocessor preprocessor(msg, headerSearch);
+    preprocessor.addIncludePath("UnitTestPP_dir1");
+    preprocessor.addIncludePath("UnitTestPP_dir3");
+    PPExpandedTokenList output;
+    auto source = preprocessText(preprocessor, "#include <a.h>\n#include <sys/c.h>\n", output);
+
+    UnitTest::assertEquals("Check new spellings", spellExpandedTokens(output), "new_a");
+    UnitTest::assertEquals("Check message", msg->getMessage(), Message::ERROR_INCLUDE_NOT_FOUND);
+
+    for( const char* fileName : {"UnitTestPP_dir1/a.h", "UnitTestPP_dir3/a.h", "UnitTestPP_dir3/b.h"} ) {
+        std::remove(fileName);
+    }
+    for( size_t i = 4; i > 0; --i ) {
+        ::rmdir(directories[i - 1]);
+    }
+}
+
+/**
+ * Headers lexed once for the translation units of several threads, then lexed
+ * again when their content changes
+ */
+void testHeaderCache()
+{
+    writeTestFile("UnitTestPP_cached.h",
+        "#ifndef CACHED_H\n#define CACHED_H\n#define TWICE(x) ((x) + (x))\n#if 0\n'skipped\n#endif\nint cached = TWICE(1);\n#endif\n");
+    writeTestFile("UnitTestPP_trigraph.h", "int t?\?(1?\?) = 0;\n");
+    writeTestFile("UnitTestPP_unterminated.h", "int u = 'u;\n");
+
+    auto headerCache = std::make_shared<PPHeaderCache>();
+    const char* text = "#include \"UnitTestPP_cached.h\"\n#include \"UnitTestPP_cached.h\"\nint main = TWICE(2);\n";
+    const char* expected = "int cached = ( ( 1 ) + ( 1 ) ) ; int main = ( ( 2 ) + ( 2 ) ) ;";
+
+    const size_t nbThreads = 4;
+    const size_t nbUnits = 10;
+    std::vector<std::string> spellings(nbThreads * nbUnits);
+    std::vector<std::thread> threads;
+    for( size_t i = 0; i < nbThreads; ++i ) {
+        threads.push_back(std::thread([&, i]() {
+            for( size_t j = 0; j < nbUnits; ++j ) {
+                auto msg = std::make_shared<UnitTestMessage>();
+                msg->resetError();
+                C90Preprocessor preprocessor(msg);
+                preprocessor.setHeaderCache(headerCache);
+                PPExpandedTokenList output;
+                auto source = preprocessText(preprocessor, text, output);
+                spellings[i * nbUnits + j] = msg->anyError() ? "error" : spellExpandedTokens(output);
+            }
+        }));
+    }
+    for( std::thread& thread : threads ) {
+        thread.join();
+    }
+
+    for( const std::string& spelling : spellings ) {
+        UnitTest::assertEquals("Check spellings", spelling, expected);
+    }
+
+    PPHeaderCache::Statistics statistics = headerCache->getStatistics();
+    UnitTest::assertEquals("Check lookups", statistics.nbLookups, nbThreads * nbUnits);
+    UnitTest::assertTrue("Check hits", statistics.nbHits >= nbThreads * (nbUnits - 1));
+    UnitTest::assertEquals("Check headers", statistics.nbHeaders, 1u);
+    UnitTest::assertTrue("Check memory", statistics.memorySize > 100);
+
+    // The messages are issued again: the header with a trigraph is not cached, the
+    // one with an unterminated literal keeps its error
+    //
+    auto msg = std::make_shared<UnitTestMessage>();
+    for( const char* header : {"#include \"UnitTestPP_trigraph.h\"\n", "#include \"UnitTestPP_unterminated.h\"\n"} ) {
+        for( size_t i = 0; i < 2; ++i ) {
+            msg->resetError();
+            C90Preprocessor preprocessor(msg);
+            preprocessor.setHeaderCache(headerCache);
+            PPExpandedTokenList output;
+            auto source = preprocessText(preprocessor, header, output);
+            UnitTest::assertTrue("Check message", msg->anyError());
+        }
+    }
+    UnitTest::assertEquals("Check not cached", headerCache->getStatistics().nbHeaders, 2u);
+
+    // A new content replaces the old one
+    //
+    writeTestFile("UnitTestPP_cached.h", "#define TWICE(x) 2 * x\n");
+    msg->resetError();
+    C90Preprocessor preprocessor(msg);
+    preprocessor.setHeaderCache(headerCache);
+    PPExpandedTokenList output;
+    auto source = preprocessText(preprocessor, text, output);
+
+    UnitTest::assertEquals("Check new spellings", spellExpandedTokens(output), "int main = 2 * 2 ;");
+    UnitTest::assertEquals("Check replaced", headerCache->getStatistics().nbHeaders, 2u);
+    UnitTest::assertFalse("Check any error", msg->anyError());
+
+    for( const char* fileName : {"UnitTestPP_cached.h", "UnitTestPP_trigraph.h", "UnitTestPP_unterminated.h"} ) {
+        std::remove(fileName);
+    }
+}
+
+/**
+ * Headers lexed by one compilation, then loaded from disk by the next ones; the
+ * images of another configuration, damaged or too old are not used
+ */
+void testDiskCache()
+{
+    const char* directory = "UnitTestPP_cache";
+    ::mkdir(directory, 0755);
+    writeTestFile("UnitTestPP_disk.h", "#define SPLICED(x) \\\n  (x + 1)\nint disk = SPLICED(2);\nint u = 'u;\n");
+    const char* text = "#include \"UnitTestPP_disk.h\"\n";
+    const char* expected = "int disk = ( 2 + 1 ) ; int u = 'u;";
+
+    // Each compilation has its own cache object, as a new process would
+    //
+    auto compile = [&](const std::shared_ptr<PPDiskCache>& diskCache, std::string& spelling) {
+        auto msg = std::make_shared<UnitTestMessage>();
+        msg->resetError();
+        C90Preprocessor preprocessor(msg);
+        preprocessor.setDiskCache(diskCache);
+        PPExpandedTokenList output;
+        auto source = preprocessText(preprocessor, text, output);
+        spelling = spellExpandedTokens(output);
+        return msg->getMessage();
+    };
+
+    std::string spelling;
+    auto firstCache = std::make_shared<PPDiskCache>(directory, 1 << 20, 1);
+    UnitTest::assertEquals("Check message", compile(firstCache, spelling), Message::ERROR_UNTERMINATED_LITERAL);
+    UnitTest::assertEquals("Check spellings", spelling, expected);
+    UnitTest::assertEquals("Check stores", firstCache->getStatistics().nbStores, 1u);
+
+    auto secondCache = std::make_shared<PPDiskCache>(directory, 1 << 20, 1);
+    UnitTest::assertEquals("Check loaded message", compile(secondCache, spelling), Message::ERROR_UNTERMINATED_LITERAL);
+    UnitTest::assertEquals("Check loaded spellings", spelling, expected);
+    UnitTest::assertEquals("Check hits", secondCache->getStatistics().nbHits, 1u);
+    UnitTest::assertEquals("Check no store", secondCache->getStatistics().nbStores, 0u);
+
+    // The positions after the line splice are the ones of the file
+    //
+    std::string headerText;
+    readSourceFile("UnitTestPP_disk.h", headerText);
+    uint64_t contentHash = PPHeaderCache::hashContent(headerText);
+    PPDiskCache::Status status;
+    auto header = secondCache->load(contentHash, "UnitTestPP_disk.h", status);
+    UnitTest::assertEquals("Check status", status, PPDiskCache::OK);
+    SourcePosition position = header->getSource()->getSourcePosition(header->getTokens()[7].getOffset());
+    UnitTest::assertEquals("Check token", header->getTokens()[7].getSpelling(*header->getSource()), "x");
+    UnitTest::assertEquals("Check line", position.getLineNumber(), 2);
+    UnitTest::assertEquals("Check column", position.getColumnNumber(), 4);
+    UnitTest::assertEquals("Check filename", *position.getFilename(), "UnitTestPP_disk.h");
+    UnitTest::assertEquals("Check tokens in place", header->getMemorySize(),
+        sizeof(PPCachedHeader) + header->getSource()->getMemorySize() + header->getErrors().size() * sizeof(PPLexer::Error));
+
+    // Another configuration has its own images; an image of another content is stale
+    //
+    PPDiskCache otherCache(directory, 1 << 20, 2);
+    UnitTest::assertTrue("Check other configuration", otherCache.load(contentHash, "UnitTestPP_disk.h", status) == nullptr);
+    UnitTest::assertEquals("Check not found", status, PPDiskCache::NOT_FOUND);
+
+    std::string imagePath = secondCache->getImagePath(contentHash);
+    std::string stalePath = secondCache->getImagePath(contentHash + 1);
+    std::rename(imagePath.c_str(), stalePath.c_str());
+    UnitTest::assertTrue("Check stale", secondCache->load(contentHash + 1, "UnitTestPP_disk.h", status) == nullptr);
+    UnitTest::assertEquals("Check stale status", status, PPDiskCache::STALE);
+    std::rename(stalePath.c_str(), imagePath.c_str());
+
+    // A damaged image is rejected, then replaced
+    //
+    {
+        std::fstream image(imagePath, std::ios::in | std::ios::out | std::ios::binary);
+        image.seekp(-1, std::ios::end);
+        image.put('\x7f');
+    }
+    UnitTest::assertTrue("Check damaged", secondCache->load(contentHash, "UnitTestPP_disk.h", status) == nullptr);
+    UnitTest::assertEquals("Check damaged status", status, PPDiskCache::BAD_CHECKSUM);
+    UnitTest::assertEquals("Check lexed again", compile(secondCache, spelling), Message::ERROR_UNTERMINATED_LITERAL);
+    UnitTest::assertEquals("Check lexed spellings", spelling, expected);
+    UnitTest::assertTrue("Check replaced", secondCache->load(contentHash, "UnitTestPP_disk.h", status) != nullptr);
+
+    // With room for two images, the least recently used one is removed
+    //
+    struct stat imageStat;
+    ::stat(imagePath.c_str(), &imageStat);
+    PPDiskCache smallCache(directory, 2 * static_cast<uint64_t>(imageStat.st_size), 1);
+    std::vector<std::string> imagePaths;
+    for( uint64_t i = 1; i <= 2; ++i ) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        UnitTest::assertEquals("Check store", smallCache.store(contentHash + i, *header), PPDiskCache::OK);
+        imagePaths.push_back(smallCache.getImagePath(contentHash + i));
+    }
+    UnitTest::assertEquals("Check evictions", smallCache.getStatistics().nbEvictions, 1u);
+    UnitTest::assertTrue("Check evicted", ::access(imagePath.c_str(), F_OK) != 0);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    UnitTest::assertTrue("Check used", smallCache.load(contentHash + 1, "UnitTestPP_disk.h", status) != nullptr);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    smallCache.store(contentHash, *header);
+    UnitTest::assertEquals("Check more evictions", smallCache.getStatistics().nbEvictions, 2u);
+    UnitTest::assertTrue("Check kept", ::access(imagePaths[0].c_str(), F_OK) == 0);
+    UnitTest::assertTrue("Check least recently used", ::access(imagePaths[1].c_str(), F_OK) != 0);
+
+    // The temporary file of a store that never finished is removed once old,
+    // not the one of a store that may be in progress
+    //
+    std::string oldTemporaryPath = imagePath + ".1.0.tmp";
+    std::string newTemporaryPath = imagePath + ".1.1.tmp";
+    writeTestFile(oldTemporaryPath, "old");
+    writeTestFile(newTemporaryPath, "new");
+    struct timespec times[2] = { {::time(nullptr) - 2 * 60 * 60, 0}, {::time(nullptr) - 2 * 60 * 60, 0} };
+    ::utimensat(AT_FDCWD, oldTemporaryPath.c_str(), times, 0);
+    smallCache.evict();
+    UnitTest::assertEquals("Check temporary removed", smallCache.getStatistics().nbTemporaryFilesRemoved, 1u);
+    UnitTest::assertTrue("Check old temporary", ::access(oldTemporaryPath.c_str(), F_OK) != 0);
+    UnitTest::assertTrue("Check new temporary", ::access(newTemporaryPath.c_str(), F_OK) == 0);
+
+    for( const std::string& path : {imagePath, imagePaths[0], newTemporaryPath} ) {
+        std::remove(path.c_str());
+    }
+    std::remove("UnitTestPP_disk.h");
+    ::rmdir(directory);
+}
+
+/**
+ * Errors of the conditionals and of the includes
+ */
+void testConditionalErrors()
+{
+    writeTestFile("UnitTestPP_open.h", "#ifdef A\n");
+    writeTestFile("UnitTestPP_self.h", "#include \"UnitTestPP_self.h\"\n");
+
+    std::vector<std::pair<const char *, Message::Msg>> cases = {
+        {"#endif", Message::ERROR_UNMATCHED_CONDITIONAL},
+        {"#if 1\n#else\n#else\n#endif", Message::ERROR_UNMATCHED_CONDITIONAL},
+        {"#if 0\n#else\n#elif 1\n#endif", Message::ERROR_UNMATCHED_CONDITIONAL},
+        {"#ifndef A\nx", Message::ERROR_UNTERMINATED_CONDITIONAL},
+        {"#include \"UnitTestPP_open.h\"\n#endif", Message::ERROR_UNMATCHED_CONDITIONAL},
+        {"#ifdef\n#endif", Message::ERROR_INVALID_DIRECTIVE},
+        {"#include \"UnitTestPP_missing.h\"", Message::ERROR_INCLUDE_NOT_FOUND},
+        {"#include UnitTestPP_open.h", Message::ERROR_INVALID_DIRECTIVE},
+        {"#include \"UnitTestPP_self.h\"", Message::ERROR_INCLUDE_TOO_DEEP},
+        {"#if\n#endif", Message::ERROR_INVALID_CONDITION},
+        {"#if 1 +\n#endif", Message::ERROR_INVALID_CONDITION},
+        {"#if (1\n#endif", Message::ERROR_INVALID_CONDITION},
+        {"#if 1 2\n#endif", Message::ERROR_INVALID_CONDITION},
+        {"#if A = 1\n#endif", Message::ERROR_INVALID_CONDITION},
+        {"#if 1, 2\n#endif", Message::ERROR_INVALID_CONDITION},
+        {"#if 1.0\n#endif", Message::ERROR_INVALID_NUMBER},
+        {"#if 0x1g\n#endif", Message::ERROR_INVALID_NUMBER},
+        {"#if 99999999999999999999\n#endif", Message::ERROR_INTEGER_TOO_LARGE},
+        {"#if 1 / 0\n#endif", Message::ERROR_DIVISION_BY_ZERO},
+        {"#if 0 || 1 % (2 - 2)\n#endif", Message::ERROR_DIVISION_BY_ZERO}
+    };
+
+    for( auto& errorCase : cases ) {
+        auto msg = std::make_shared<UnitTestMessage>();
+        msg->resetError();
+        C90Preprocessor preprocessor(msg);
+        PPExpandedTokenList output;
+        auto source = preprocessText(preprocessor, errorCase.first, output);
+
+        UnitTest::assertTrue(std::string("Check error: ") + errorCase.first, msg->anyError());
+        UnitTest::assertEquals(std::string("Check message: ") + errorCase.first, msg->getMessage(), errorCase.second);
+    }
+
+    std::remove("UnitTestPP_open.h");
+    std::remove("UnitTestPP_self.h");
+}
+
+/**
+ * Chains of ?: are evaluated up to the nesting limit, and rejected past it
+ * instead of overflowing the stack
+ */
+void testDeepConditions()
+{
+    auto evaluateChain = [](size_t nbArms, bool nestInThen) -> std::string {
+        std::string text = "#if ";
+        for( size_t i = 0; i < nbArms; ++i ) {
+            text += nestInThen ? "1 ? " : "0 ? 1 : ";
+        }
+        text += "2";
+        for( size_t i = 0; nestInThen && i < nbArms; ++i ) {
+            text += " : 3";
+        }
+        text += " == 2\na\n#endif\n";
+
+        auto msg = std::make_shared<UnitTestMessage>();
+        msg->resetError();
+        C90Preprocessor preprocessor(msg);
+        PPExpandedTokenList output;
+        auto source = preprocessText(preprocessor, text, output);
+        if( msg->anyError() ) {
+            return msg->getMessage() == Message::ERROR_INVALID_CONDITION ? "invalid" : "other error";
+        }
+        return output.size() == 1 ? output[0].getSpelling() : "";
+    };
+
+    UnitTest::assertEquals("Check else chain", evaluateChain(200, false), "a");
+    UnitTest::assertEquals("Check then chain", evaluateChain(200, true), "a");
+    UnitTest::assertEquals("Check deep else chain", evaluateChain(100000, false), "invalid");
+    UnitTest::assertEquals("Check deep then chain", evaluateChain(100000, true), "invalid");
+}
+
+/**
+ * Header with most of its lines in skipped groups: only the directives are lexed
+ */
+void testSkippedGroups()
+{
+    const size_t nbBlocks = 1000;
+    std::string text;
+    for( size_t i = 0; i < nbBlocks; ++i ) {
+        text += "#ifdef NEVER_DEFINED\n";
+        for( size_t j = 0; j < 8; ++j ) {
+            text += "    static int disabled_" + std::to_string(j) + "(int a, int b) { return a * b + 'c'; } /* # */\n";
+        }
+        text += "#else\nint enabled_" + std::to_string(i) + " = 0;\nint other_" + std::to_string(i) + " = 1;\n#endif\n";
+    }
+
+    auto msg = std::make_shared<UnitTestMessage>();
+    msg->resetError();
+    C90Preprocessor preprocessor(msg);
+    PPExpandedTokenList output;
+    auto source = preprocessText(preprocessor, text, output);
+
+    PPTokenList allTokens;
+    preprocessorParser(*source, msg, allTokens);
+
+    UnitTest::assertEquals("Check size", output.size(), 10 * nbBlocks);
+    UnitTest::assertEquals("Check first", output[1].getSpelling(), "enabled_0");
+    UnitTest::assertEquals("Check skipped", preprocessor.getNbSkippedGroups(), nbBlocks);
+    UnitTest::assertTrue("Check lexed", preprocessor.getNbTokensLexed() * 5 < allTokens.size());
+    UnitTest::assertFalse("Check any error", msg->anyError());
+}
+
+/**
+ * Unit tests for phase 4 of translation: conditional inclusion and source file
+ * inclusion
+ */
+UnitTest::TestPtr makeIncludeUnitTests()
+{
+    return UnitTest::makeMultipleTest(
+        "Conditional and source file inclusion unit tests",
+        {
+            makeMacroTest("Test #ifdef", "#define A\n#ifdef A\na\n#else\nb\n#endif\n#ifndef A\nc\n#else\nd\n#endif", "a d"),
+            makeMacroTest("Test #elif", "#if 0\na\n#elif !defined B\nb\n#elif 1\nc\n#else\nd\n#endif", "b"),
+            makeMacroTest("Test nesting", "#if 0\n#if 1\na\n#else\nb\n#endif\n#foo\n#define X\n#elif 1\n#ifdef X\nc\n#endif\nd\n#endif", "d"),
+            makeMacroTest("Test #if arithmetic",
+                "#if 1 + 2 * 3 == 7 && (10 - 4) / 3 == 2 && 7 % 4 == 3 && -8 >> 1 == -4 && (1 << 40) > 0\na\n#endif\n"
+                "#if (0x1F & 07) == 7 && (5 | 2 ^ 3) == 5 && ~0 == -1 && !0 && +1\nb\n#endif", "a b"),
+            makeMacroTest("Test #if unsigned",
+                "#if -1 < 0u\na\n#endif\n#if -1 > 0u && 0xFFFFFFFFFFFFFFFF == -1 && 18446744073709551615 / 2 > 0\nb\n#endif\n"
+                "#if (0 ? 1u : -1) > 0 && 2147483648 > 0 && -2147483648 < 0\nc\n#endif", "b c"),
+            makeMacroTest("Test #if short circuit",
+                "#if 0 && 1 / 0\na\n#elif 1 || 1 % 0\nb\n#endif\n#if 1 ? 2 : 1 / 0\nc\n#endif\n#if 0 ? 1 / 0 : 0 ? 2 : 3\nd\n#endif", "b c d"),
+            makeMacroTest("Test #if characters", "#if 'a' == 97 && '\\n' == 10 && '\\0' == 0 && '\\x41' == 65 && '\\377' < 0\na\n#endif", "a"),
+            makeMacroTest("Test #if macros",
+                "#define VERSION 3\n#define AT_LEAST(v) (VERSION >= (v))\n#define HAS_B defined(B)\n"
+                "#if AT_LEAST(2) && !AT_LEAST(4) && UNKNOWN == 0 && !HAS_B && defined VERSION\na\n#endif\n"
+                "#if defined(UNKNOWN) || defined B\nb\n#endif", "a"),
+            makeMacroTest("Test skipped lines", "#if 0\n'unterminated\n/* comment\n#endif */ don't\n  /**/ # if 1\n#else\n#endif\n\"x\n#endif\ny", "y"),
+            UnitTest::makeSimpleTest("Test skipped groups", testSkippedGroups),
+            UnitTest::makeSimpleTest("Test include guards", testIncludeGuards),
+            UnitTest::makeSimpleTest("Test include lines", testIncludeLines),
+            UnitTest::makeSimpleTest("Test dependency scan", testDependencyScan),
+            UnitTest::makeSimpleTest("Test header search", testHeaderSearch),
+            UnitTest::makeSimpleTest("Test header cache", testHeaderCache),
+            UnitTest::makeSimpleTest("Test disk cache", testDiskCache),
+            UnitTest::makeSimpleTest("Test errors", testConditionalErrors),
+            UnitTest::makeSimpleTest("Test deep conditions", testDeepConditions)
+        }
+    );
+}
+
+
 /**
  * All unit tests for preprocessing
  */
@@ -250,7 +1140,10 @@ UnitTest::TestPtr makePreprocessingUnitTests()
         "Preprocessor unit tests",
         {
             makePhase1TranslationUnitTests(),
-            makePhase2UnitTests()
+            makePhase2UnitTests(),
+            makePhase3UnitTests(),
+            makeMacroUnitTests(),
+            makeIncludeUnitTests()
         }
     );    
 }